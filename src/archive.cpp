@@ -0,0 +1,494 @@
+#include "archive.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_map>
+
+#include "fmt/format.h"
+#include "mapped_file.h"
+#include "options.h"
+#include "zlib.h"
+
+struct archive {
+	mapped_file         *mapping = nullptr;
+	std::vector<uint8_t> contents; // the whole archive, if it couldn't be mapped
+	const uint8_t       *data = nullptr;
+	uint64_t             size = 0;
+
+	std::vector<archive_entry>                                          entries;
+	std::unordered_map<std::string, size_t>                             by_name;
+	std::unordered_map<std::string, std::vector<const archive_entry *>> children;
+};
+
+static uint16_t get16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	return (uint32_t)get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+static uint64_t get64(const uint8_t *p)
+{
+	return (uint64_t)get32(p) | ((uint64_t)get32(p + 4) << 32);
+}
+
+static std::string parent_of(const std::string &name)
+{
+	const size_t slash = name.find_last_of('/');
+	return slash == std::string::npos ? "" : name.substr(0, slash);
+}
+
+// Strip "./", leading and trailing slashes and empty path elements. Names that climb out of the
+// archive with ".." come back empty, and are skipped.
+static std::string normalize_name(const std::string &name)
+{
+	std::string result;
+	size_t      start = 0;
+	while (start <= name.length()) {
+		size_t end = name.find_first_of("/\\", start);
+		if (end == std::string::npos) {
+			end = name.length();
+		}
+		const std::string element = name.substr(start, end - start);
+		if (element == "..") {
+			return "";
+		}
+		if (!element.empty() && element != ".") {
+			if (!result.empty()) {
+				result += '/';
+			}
+			result += element;
+		}
+		start = end + 1;
+	}
+	return result;
+}
+
+static void add_entry(archive *arc, archive_entry &&entry)
+{
+	entry.name = normalize_name(entry.name);
+	if (entry.name.empty()) {
+		return;
+	}
+	if (!entry.is_directory && entry.offset + entry.stored_size > arc->size) {
+		options_log_verbose("Archive entry runs past the end of the archive: {}\n", entry.name);
+		return;
+	}
+
+	// A later entry with the same name replaces an earlier one, as it would when extracting.
+	if (const auto found = arc->by_name.find(entry.name); found != arc->by_name.end()) {
+		arc->entries[found->second] = std::move(entry);
+	} else {
+		arc->by_name[entry.name] = arc->entries.size();
+		arc->entries.push_back(std::move(entry));
+	}
+}
+
+static void build_index(archive *arc)
+{
+	// Add the directories that are only implied by the names of the things inside them.
+	for (size_t i = 0; i < arc->entries.size(); ++i) {
+		for (std::string parent = parent_of(arc->entries[i].name); !parent.empty() && arc->by_name.find(parent) == arc->by_name.end(); parent = parent_of(parent)) {
+			archive_entry dir;
+			dir.name         = parent;
+			dir.offset       = 0;
+			dir.stored_size  = 0;
+			dir.size         = 0;
+			dir.deflated     = false;
+			dir.is_directory = true;
+			dir.mtime        = arc->entries[i].mtime;
+
+			arc->by_name[parent] = arc->entries.size();
+			arc->entries.push_back(std::move(dir));
+		}
+	}
+
+	archive_entry root;
+	root.name         = "";
+	root.offset       = 0;
+	root.stored_size  = 0;
+	root.size         = 0;
+	root.deflated     = false;
+	root.is_directory = true;
+	root.mtime        = 0;
+
+	arc->by_name[""] = arc->entries.size();
+	arc->entries.push_back(std::move(root));
+
+	// The entries won't move from here on.
+	for (const archive_entry &entry : arc->entries) {
+		if (!entry.name.empty()) {
+			arc->children[parent_of(entry.name)].push_back(&entry);
+		}
+	}
+	for (auto &[name, children] : arc->children) {
+		std::sort(children.begin(), children.end(), [](const archive_entry *a, const archive_entry *b) { return a->name < b->name; });
+	}
+}
+
+static time_t dos_time(uint16_t time, uint16_t date)
+{
+	tm t       = {};
+	t.tm_sec   = (time & 0x1f) * 2;
+	t.tm_min   = (time >> 5) & 0x3f;
+	t.tm_hour  = time >> 11;
+	t.tm_mday  = date & 0x1f;
+	t.tm_mon   = ((date >> 5) & 0x0f) - 1;
+	t.tm_year  = (date >> 9) + 80;
+	t.tm_isdst = -1;
+	return mktime(&t);
+}
+
+static bool parse_zip(archive *arc)
+{
+	const uint8_t *data = arc->data;
+	const uint64_t size = arc->size;
+
+	// The end of central directory record is followed by a comment of up to 64KB.
+	if (size < 22) {
+		return false;
+	}
+	uint64_t eocd = size - 22;
+	for (;; --eocd) {
+		if (get32(data + eocd) == 0x06054b50) {
+			break;
+		}
+		if (eocd == 0 || size - eocd >= 22 + 0xffff) {
+			return false;
+		}
+	}
+
+	uint64_t count     = get16(data + eocd + 10);
+	uint64_t cd_size   = get32(data + eocd + 12);
+	uint64_t cd_offset = get32(data + eocd + 16);
+	if (eocd >= 20 && get32(data + eocd - 20) == 0x07064b50) {
+		const uint64_t eocd64 = get64(data + eocd - 20 + 8);
+		if (eocd64 + 56 > size || get32(data + eocd64) != 0x06064b50) {
+			return false;
+		}
+		count     = get64(data + eocd64 + 32);
+		cd_size   = get64(data + eocd64 + 40);
+		cd_offset = get64(data + eocd64 + 48);
+	}
+	if (cd_offset + cd_size > size) {
+		return false;
+	}
+
+	uint64_t pos = cd_offset;
+	for (uint64_t i = 0; i < count; ++i) {
+		if (pos + 46 > cd_offset + cd_size || get32(data + pos) != 0x02014b50) {
+			return false;
+		}
+		const uint8_t *header      = data + pos;
+		const uint16_t flags       = get16(header + 8);
+		const uint16_t method      = get16(header + 10);
+		uint64_t       stored_size = get32(header + 20);
+		uint64_t       full_size   = get32(header + 24);
+		const uint16_t name_len    = get16(header + 28);
+		const uint16_t extra_len   = get16(header + 30);
+		const uint16_t comment_len = get16(header + 32);
+		uint64_t       local       = get32(header + 42);
+
+		pos += 46 + name_len + extra_len + comment_len;
+		if (pos > cd_offset + cd_size) {
+			return false;
+		}
+
+		// Sizes and offsets that don't fit in 32 bits are in the zip64 extra field, in this order.
+		const uint8_t *extra_end = header + 46 + name_len + extra_len;
+		for (const uint8_t *extra = header + 46 + name_len; extra + 4 <= extra_end;) {
+			const uint16_t id     = get16(extra);
+			const uint16_t length = get16(extra + 2);
+			if (extra + 4 + length > extra_end) {
+				break;
+			}
+			if (id == 0x0001) {
+				const uint8_t *field = extra + 4;
+				if (full_size == 0xffffffff && field + 8 <= extra + 4 + length) {
+					full_size = get64(field);
+					field += 8;
+				}
+				if (stored_size == 0xffffffff && field + 8 <= extra + 4 + length) {
+					stored_size = get64(field);
+					field += 8;
+				}
+				if (local == 0xffffffff && field + 8 <= extra + 4 + length) {
+					local = get64(field);
+				}
+			}
+			extra += 4 + length;
+		}
+
+		archive_entry entry;
+		entry.name         = std::string((const char *)header + 46, name_len);
+		entry.is_directory = entry.name.ends_with('/');
+		entry.deflated     = method == 8;
+		entry.stored_size  = entry.is_directory ? 0 : stored_size;
+		entry.size         = entry.is_directory ? 0 : full_size;
+		entry.mtime        = dos_time(get16(header + 12), get16(header + 14));
+
+		if (!entry.is_directory && ((flags & 1) || (method != 0 && method != 8))) {
+			options_log_verbose("Skipping encrypted or unsupported archive entry: {}\n", entry.name);
+			continue;
+		}
+		if (local + 30 > size || get32(data + local) != 0x04034b50) {
+			return false;
+		}
+		entry.offset = local + 30 + get16(data + local + 26) + get16(data + local + 28);
+		if (!entry.deflated && entry.stored_size != entry.size) {
+			continue;
+		}
+		add_entry(arc, std::move(entry));
+	}
+	return true;
+}
+
+// Tar numbers are octal text, or big-endian binary if the top bit of the first byte is set.
+static uint64_t tar_number(const uint8_t *field, size_t length)
+{
+	uint64_t value = 0;
+	if (field[0] & 0x80) {
+		value = field[0] & 0x7f;
+		for (size_t i = 1; i < length; ++i) {
+			value = (value << 8) | field[i];
+		}
+		return value;
+	}
+	for (size_t i = 0; i < length && field[i] != 0; ++i) {
+		if (field[i] >= '0' && field[i] <= '7') {
+			value = (value << 3) | (field[i] - '0');
+		}
+	}
+	return value;
+}
+
+static std::string tar_string(const uint8_t *field, size_t length)
+{
+	return std::string((const char *)field, strnlen((const char *)field, length));
+}
+
+static bool parse_tar(archive *arc)
+{
+	const uint8_t *data = arc->data;
+	const uint64_t size = arc->size;
+
+	std::string long_name;
+	for (uint64_t pos = 0; pos + 512 <= size;) {
+		const uint8_t *header = data + pos;
+		if (header[0] == 0) {
+			break; // end of archive
+		}
+
+		uint64_t checksum = 0;
+		for (int i = 0; i < 512; ++i) {
+			checksum += (i >= 148 && i < 156) ? ' ' : header[i];
+		}
+		if (checksum != tar_number(header + 148, 8)) {
+			return false;
+		}
+
+		const uint64_t entry_size = tar_number(header + 124, 12);
+		const char     type       = (char)header[156];
+		const uint64_t offset     = pos + 512;
+		pos                       = offset + ((entry_size + 511) & ~(uint64_t)511);
+		if (offset + entry_size > size) {
+			return false;
+		}
+
+		if (type == 'L') {
+			// GNU long name for the next entry
+			long_name = tar_string(data + offset, entry_size);
+			continue;
+		}
+		if (type == 'x') {
+			// pax extended header, of which we only want the path
+			std::string records((const char *)data + offset, entry_size);
+			for (size_t record = 0; record < records.length();) {
+				const size_t length = strtoul(records.c_str() + record, nullptr, 10);
+				const size_t key    = records.find(' ', record);
+				if (length == 0 || key == std::string::npos || record + length > records.length()) {
+					break;
+				}
+				if (records.compare(key + 1, 5, "path=") == 0) {
+					long_name = records.substr(key + 6, record + length - (key + 6) - 1);
+				}
+				record += length;
+			}
+			continue;
+		}
+
+		archive_entry entry;
+		if (!long_name.empty()) {
+			entry.name = std::move(long_name);
+			long_name.clear();
+		} else if (memcmp(header + 257, "ustar", 5) == 0 && header[345] != 0) {
+			entry.name = tar_string(header + 345, 155) + "/" + tar_string(header, 100);
+		} else {
+			entry.name = tar_string(header, 100);
+		}
+		entry.offset       = offset;
+		entry.stored_size  = entry_size;
+		entry.size         = entry_size;
+		entry.deflated     = false;
+		entry.is_directory = type == '5';
+		entry.mtime        = (time_t)tar_number(header + 136, 12);
+
+		// Links, devices and the like have no contents of their own.
+		if (type == '0' || type == '\0' || type == '7' || entry.is_directory) {
+			add_entry(arc, std::move(entry));
+		}
+	}
+	return true;
+}
+
+static bool is_gzipped_tar(const std::filesystem::path &path)
+{
+	const std::string name = path.generic_string();
+	return name.ends_with(".tar.gz") || name.ends_with(".tgz");
+}
+
+bool archive_detect(const std::filesystem::path &path)
+{
+	const std::string name = path.generic_string();
+	return name.ends_with(".zip") || name.ends_with(".tar") || is_gzipped_tar(path);
+}
+
+archive *archive_open(const std::filesystem::path &path)
+{
+	archive *arc = new archive;
+
+	if (is_gzipped_tar(path)) {
+		// There's no getting at anything in the middle of a gzip stream without inflating what
+		// comes before it, so the whole tar is inflated into memory once.
+		gzFile zfile = gzopen(path.generic_string().c_str(), "rb");
+		if (zfile == Z_NULL) {
+			fmt::print("Could not open archive: {}\n", path.generic_string());
+			delete arc;
+			return nullptr;
+		}
+		uint8_t buffer[64 * 1024];
+		int     read;
+		while ((read = gzread(zfile, buffer, sizeof(buffer))) > 0) {
+			arc->contents.insert(arc->contents.end(), buffer, buffer + read);
+		}
+		gzclose(zfile);
+		if (read < 0) {
+			fmt::print("Could not decompress archive: {}\n", path.generic_string());
+			delete arc;
+			return nullptr;
+		}
+	} else {
+		arc->mapping = mapped_file_open(path, false);
+		if (arc->mapping == nullptr) {
+			std::ifstream file(path, std::ios_base::in | std::ios_base::binary);
+			if (!file.is_open()) {
+				fmt::print("Could not open archive: {}\n", path.generic_string());
+				delete arc;
+				return nullptr;
+			}
+			arc->contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+	}
+
+	if (arc->mapping != nullptr) {
+		arc->data = mapped_file_data(arc->mapping);
+		arc->size = mapped_file_size(arc->mapping);
+	} else {
+		arc->data = arc->contents.data();
+		arc->size = arc->contents.size();
+	}
+
+	const bool parsed = path.generic_string().ends_with(".zip") ? parse_zip(arc) : parse_tar(arc);
+	if (!parsed) {
+		fmt::print("Could not read the index of archive: {}\n", path.generic_string());
+		archive_close(arc);
+		return nullptr;
+	}
+	build_index(arc);
+
+	options_log_verbose("Opened archive {} ({} entries)\n", path.generic_string(), arc->entries.size() - 1);
+	return arc;
+}
+
+void archive_close(archive *arc)
+{
+	if (arc == nullptr) {
+		return;
+	}
+	if (arc->mapping != nullptr) {
+		mapped_file_close(arc->mapping);
+	}
+	delete arc;
+}
+
+const archive_entry *archive_find(const archive *arc, const std::string &name)
+{
+	const auto found = arc->by_name.find(normalize_name(name));
+	return found != arc->by_name.end() ? &arc->entries[found->second] : nullptr;
+}
+
+const std::vector<const archive_entry *> &archive_list(const archive *arc, const std::string &name)
+{
+	static const std::vector<const archive_entry *> empty;
+
+	const auto found = arc->children.find(normalize_name(name));
+	return found != arc->children.end() ? found->second : empty;
+}
+
+bool archive_extract(const archive *arc, const archive_entry &entry, const uint8_t *&data, uint8_t *&owned)
+{
+	owned = nullptr;
+	if (!entry.deflated) {
+		data = arc->data + entry.offset;
+		return true;
+	}
+
+	uint8_t *buffer = (uint8_t *)malloc(entry.size ? entry.size : 1);
+	if (buffer == nullptr) {
+		return false;
+	}
+
+	z_stream stream = {};
+	if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+		free(buffer);
+		return false;
+	}
+
+	// zlib counts in 32 bits, so anything bigger goes through it in pieces.
+	const uint8_t *in      = arc->data + entry.offset;
+	uint64_t       in_left = entry.stored_size;
+	uint64_t       out     = 0;
+	int            result  = Z_OK;
+	while (result == Z_OK) {
+		const uInt in_chunk  = (uInt)std::min<uint64_t>(in_left, UINT_MAX);
+		const uInt out_chunk = (uInt)std::min<uint64_t>(entry.size - out, UINT_MAX);
+		stream.next_in       = const_cast<Bytef *>(in);
+		stream.avail_in      = in_chunk;
+		stream.next_out      = buffer + out;
+		stream.avail_out     = out_chunk;
+		result               = inflate(&stream, in_chunk == in_left ? Z_FINISH : Z_NO_FLUSH);
+		in += in_chunk - stream.avail_in;
+		in_left -= in_chunk - stream.avail_in;
+		out += out_chunk - stream.avail_out;
+		if (result == Z_BUF_ERROR && out == entry.size) {
+			break; // more input than the entry claims to need
+		}
+	}
+	inflateEnd(&stream);
+
+	if ((result != Z_STREAM_END && result != Z_BUF_ERROR) || out != entry.size) {
+		fmt::print("Could not inflate archive entry: {}\n", entry.name);
+		free(buffer);
+		return false;
+	}
+
+	data  = buffer;
+	owned = buffer;
+	return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#if !defined(ARCHIVE_H)
+#	define ARCHIVE_H
+
+#	include <filesystem>
+#	include <stdint.h>
+#	include <string>
+#	include <time.h>
+#	include <vector>
+
+//
+// Read-only zip and tar archives
+//
+// The archive is memory-mapped when possible and read into memory otherwise, and its index is
+// parsed once when it's opened. Stored entries (and everything in a tar) are served straight out
+// of that image without copying; deflated zip entries are inflated into a buffer of their own.
+//
+// Entry names are '/'-separated and relative to the top of the archive, without a trailing '/'.
+// Directories that only exist implicitly, as the prefix of some other entry, are added to the
+// index as well, so every entry's parent can be found in it.
+//
+
+struct archive;
+
+struct archive_entry {
+	std::string name;
+	uint64_t    offset;      // of the entry's data in the archive
+	uint64_t    stored_size; // of the data as it's stored in the archive
+	uint64_t    size;        // of the data once extracted
+	bool        deflated;
+	bool        is_directory;
+	time_t      mtime;
+};
+
+// Whether 'path' looks like an archive we can open, going by its extension.
+bool archive_detect(const std::filesystem::path &path);
+
+archive *archive_open(const std::filesystem::path &path);
+void     archive_close(archive *arc);
+
+// The entry called 'name', or nullptr. "" is the top level directory.
+const archive_entry *archive_find(const archive *arc, const std::string &name);
+
+// The entries directly inside the directory 'name', sorted by name.
+const std::vector<const archive_entry *> &archive_list(const archive *arc, const std::string &name);
+
+// Point 'data' at an entry's contents. If they had to be inflated, 'owned' is set to a malloc()ed
+// buffer holding them that the caller must free(); otherwise it's set to nullptr and 'data' stays
+// valid until the archive is closed.
+bool archive_extract(const archive *arc, const archive_entry &entry, const uint8_t *&data, uint8_t *&owned);
+
+#endif
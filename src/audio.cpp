@@ -4,6 +4,7 @@
 
 #include "audio.h"
 
+#include <algorithm>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -16,12 +17,15 @@
 
 static SDL_AudioDeviceID Audio_dev            = 0;
 static int               Obtained_sample_rate = 0;
-static int               Clocks_per_sample    = 0;
+static int               Device_samples       = 0;
 
 static int16_t Ym_buffer[2 * SAMPLES_PER_BUFFER];
 static int16_t Psg_buffer[2 * SAMPLES_PER_BUFFER];
 static int16_t Pcm_buffer[2 * SAMPLES_PER_BUFFER];
 
+static int16_t Ym_voice_buffers[MAX_YM2151_VOICES][2 * SAMPLES_PER_BUFFER];
+static int16_t Psg_channel_buffers[PSG_NUM_CHANNELS][2 * SAMPLES_PER_BUFFER];
+
 struct audio_buffer {
 	int16_t data[SAMPLES_PER_BUFFER * 2];
 };
@@ -30,20 +34,88 @@ struct audio_buffer {
 static ring_allocator<audio_buffer, BACKBUFFER_COUNT> Audio_backbuffer;
 
 static constexpr size_t Low_buffer_threshold = 2;
-static int              Clocks_rendered      = 0;
+
+// CPU clocks are accumulated in 16.16 fixed point, so that the number of samples rendered per
+// emulated second is exact and can be nudged by the latency controller below.
+static constexpr int Clock_fraction_bits = 16;
+static uint64_t      Clocks_per_buffer   = 0;
+static uint64_t      Clocks_rendered     = 0;
+
+// Latency controller: the queued audio is smoothed over many buffers and compared against the
+// target latency, and the difference steers the rendering rate by a few hundred ppm either way.
+// Underruns (the device replaying a buffer) and overruns (queued audio exceeding twice the target)
+// are the fallbacks when the controller cannot keep up, such as when warping or stalling.
+static constexpr float Max_rate_adjust_ppm = 500.0f;
+static constexpr float Latency_smoothing   = 1.0f / 64.0f;
+static constexpr float Latency_gain_p      = 2.0f;
+static constexpr float Latency_gain_i      = 0.001f;
+
+static int    Target_latency_ms      = 20;
+static float  Target_latency_samples = 0.0f;
+static size_t Max_queued_buffers     = BACKBUFFER_COUNT - 1;
+static float  Latency_samples        = 0.0f;
+static float  Latency_integral       = 0.0f;
+static float  Rate_adjust_ppm        = 0.0f;
+
+static std::atomic<bool>     Oldest_played = false;
+static std::atomic<uint32_t> Underruns     = 0;
+static std::atomic<uint32_t> Overruns      = 0;
 
 static uint32_t limiter_amp = 0;
 
 static volatile audio_render_callback Render_callback = nullptr;
+static volatile audio_stem_callback   Stem_callback   = nullptr;
+static bool                           Render_voices   = false;
 
 audio_lock_scope::audio_lock_scope()
 {
-	SDL_LockAudio();
+	SDL_LockAudioDevice(Audio_dev);
 }
 
 audio_lock_scope::~audio_lock_scope()
 {
-	SDL_UnlockAudio();
+	SDL_UnlockAudioDevice(Audio_dev);
+}
+
+static size_t audio_queued_buffers()
+{
+	const size_t count = Audio_backbuffer.count();
+	return Oldest_played ? count - !!count : count;
+}
+
+// Samples rendered per emulated second, including the latency controller's adjustment.
+static double audio_get_render_rate()
+{
+	return Obtained_sample_rate * (1.0 + Rate_adjust_ppm * 1e-6);
+}
+
+static void audio_update_rate()
+{
+	Clocks_per_buffer = (uint64_t)((8000000.0 * SAMPLES_PER_BUFFER * (1 << Clock_fraction_bits)) / audio_get_render_rate());
+}
+
+static void audio_update_latency()
+{
+	const float queued = (float)(audio_queued_buffers() * SAMPLES_PER_BUFFER + Device_samples);
+	Latency_samples += (queued - Latency_samples) * Latency_smoothing;
+
+	const float error = Latency_samples - Target_latency_samples;
+	Latency_integral  = std::clamp(Latency_integral + error * Latency_gain_i, -Max_rate_adjust_ppm, Max_rate_adjust_ppm);
+	Rate_adjust_ppm   = std::clamp(-(error * Latency_gain_p + Latency_integral), -Max_rate_adjust_ppm, Max_rate_adjust_ppm);
+
+	audio_update_rate();
+}
+
+static void audio_update_target()
+{
+	// Measured the same way as audio_update_latency(): whole queued buffers plus whatever the device
+	// holds, with the queue rounded to the nearest buffer.
+	const int    min_buffers    = (int)Low_buffer_threshold + 1;
+	const int    target_samples = Target_latency_ms * Obtained_sample_rate / 1000 - Device_samples;
+	const size_t target_buffers = (size_t)SDL_max((target_samples + SAMPLES_PER_BUFFER / 2) / SAMPLES_PER_BUFFER, min_buffers);
+
+	Target_latency_samples = (float)(target_buffers * SAMPLES_PER_BUFFER + Device_samples);
+	Max_queued_buffers     = SDL_min(target_buffers * 2, (size_t)BACKBUFFER_COUNT - 1);
 }
 
 static void audio_callback_nop(const int16_t *, const int)
@@ -52,8 +124,21 @@ static void audio_callback_nop(const int16_t *, const int)
 
 static void audio_render_buffer()
 {
-	YM_render(Ym_buffer, SAMPLES_PER_BUFFER, Obtained_sample_rate);
-	psg_render(Psg_buffer, SAMPLES_PER_BUFFER);
+	if (Render_voices) {
+		int16_t *ym_voices[MAX_YM2151_VOICES];
+		for (int i = 0; i < MAX_YM2151_VOICES; ++i) {
+			ym_voices[i] = Ym_voice_buffers[i];
+		}
+		int16_t *psg_channels[PSG_NUM_CHANNELS];
+		for (int i = 0; i < PSG_NUM_CHANNELS; ++i) {
+			psg_channels[i] = Psg_channel_buffers[i];
+		}
+		YM_render(Ym_buffer, SAMPLES_PER_BUFFER, audio_get_render_rate(), ym_voices);
+		psg_render_channels(Psg_buffer, psg_channels, SAMPLES_PER_BUFFER);
+	} else {
+		YM_render(Ym_buffer, SAMPLES_PER_BUFFER, audio_get_render_rate());
+		psg_render(Psg_buffer, SAMPLES_PER_BUFFER);
+	}
 	pcm_render(Pcm_buffer, SAMPLES_PER_BUFFER);
 
 	int16_t buffer[2 * SAMPLES_PER_BUFFER];
@@ -74,11 +159,32 @@ static void audio_render_buffer()
 	// Commit to the backbuffer
 	{
 		audio_lock_scope lock;
-		audio_buffer *   backbuffer = Audio_backbuffer.allocate();
+		while (Audio_backbuffer.count() >= Max_queued_buffers) {
+			Audio_backbuffer.free_oldest();
+			Oldest_played = false;
+			++Overruns;
+		}
+		audio_buffer *backbuffer = Audio_backbuffer.allocate();
 		memcpy(backbuffer->data, buffer, sizeof(buffer));
 	}
 
 	Render_callback(reinterpret_cast<int16_t *>(buffer), SAMPLES_PER_BUFFER);
+
+	if (Stem_callback != nullptr) {
+		const int16_t *stems[AUDIO_STEM_COUNT] = {};
+		stems[AUDIO_STEM_YM]  = Ym_buffer;
+		stems[AUDIO_STEM_PSG] = Psg_buffer;
+		stems[AUDIO_STEM_PCM] = Pcm_buffer;
+		if (Render_voices) {
+			for (int i = 0; i < MAX_YM2151_VOICES; ++i) {
+				stems[AUDIO_STEM_YM_VOICE + i] = Ym_voice_buffers[i];
+			}
+			for (int i = 0; i < PSG_NUM_CHANNELS; ++i) {
+				stems[AUDIO_STEM_PSG_CHANNEL + i] = Psg_channel_buffers[i];
+			}
+		}
+		Stem_callback(stems, SAMPLES_PER_BUFFER);
+	}
 }
 
 static void audio_callback(void *, Uint8 *stream, int len)
@@ -89,11 +195,28 @@ static void audio_callback(void *, Uint8 *stream, int len)
 		return;
 	}
 
+	// The last buffer is kept around to be replayed if nothing newer arrives in time,
+	// but as soon as something newer is available, skip straight to it.
+	if (Oldest_played && Audio_backbuffer.count() > 1) {
+		Audio_backbuffer.free_oldest();
+		Oldest_played = false;
+	}
+
 	const audio_buffer *buffer = Audio_backbuffer.get_oldest();
+	if (buffer == nullptr) {
+		memset(stream, 0, len);
+		++Underruns;
+		return;
+	}
+	if (Oldest_played) {
+		++Underruns;
+	}
 	memcpy(stream, buffer->data, len);
 
 	if (Audio_backbuffer.count() > 1) {
 		Audio_backbuffer.free_oldest();
+	} else {
+		Oldest_played = true;
 	}
 }
 
@@ -125,13 +248,24 @@ void audio_init(const char *dev_name, int /*num_audio_buffers*/)
 	}
 
 	Obtained_sample_rate = obtained.freq;
-	Clocks_per_sample    = 8000000 / Obtained_sample_rate;
+	Device_samples       = obtained.samples;
 	limiter_amp = (1 << 16);
 
+	audio_update_target();
+	Latency_samples  = Target_latency_samples;
+	Latency_integral = 0.0f;
+	Rate_adjust_ppm  = 0.0f;
+	Clocks_rendered  = 0;
+	Underruns        = 0;
+	Overruns         = 0;
+	audio_update_rate();
+	YM_clear_backbuffer();
+
 	fmt::print("INFO: Audio buffer is {} bytes\n", obtained.size);
 
 	// Prime the buffer
 	{
+		Oldest_played   = false;
 		auto backbuffer = Audio_backbuffer.allocate();
 		memset(backbuffer->data, 0, sizeof(backbuffer->data));
 	}
@@ -152,19 +286,15 @@ void audio_close(void)
 
 void audio_render(int cpu_clocks)
 {
-	YM_prerender(cpu_clocks);
-
 	if (Audio_dev == 0) {
-		YM_clear_backbuffer();
 		return;
 	}
 
-	Clocks_rendered += cpu_clocks;
-	int samples_to_render = Clocks_rendered / Clocks_per_sample;
-	while (samples_to_render >= SAMPLES_PER_BUFFER) {
+	Clocks_rendered += (uint64_t)cpu_clocks << Clock_fraction_bits;
+	while (Clocks_rendered >= Clocks_per_buffer) {
+		Clocks_rendered -= Clocks_per_buffer;
 		audio_render_buffer();
-		samples_to_render -= SAMPLES_PER_BUFFER;
-		Clocks_rendered -= Clocks_per_sample * SAMPLES_PER_BUFFER;
+		audio_update_latency();
 	}
 
 	while (Audio_backbuffer.count() < Low_buffer_threshold) {
@@ -213,8 +343,41 @@ int audio_get_sample_rate()
 	return Obtained_sample_rate;
 }
 
+void audio_set_target_latency(int ms)
+{
+	Target_latency_ms = SDL_max(ms, 0);
+	if (Audio_dev != 0) {
+		audio_lock_scope lock;
+		audio_update_target();
+	}
+}
+
+void audio_get_stats(audio_stats *stats)
+{
+	stats->latency_ms        = Obtained_sample_rate ? Latency_samples * 1000.0f / Obtained_sample_rate : 0.0f;
+	stats->target_latency_ms = Obtained_sample_rate ? Target_latency_samples * 1000.0f / Obtained_sample_rate : 0.0f;
+	stats->rate_adjust_ppm   = Rate_adjust_ppm;
+	stats->queued_buffers    = (uint32_t)audio_queued_buffers();
+	stats->underruns         = Underruns;
+	stats->overruns          = Overruns;
+}
+
+void audio_reset_stats()
+{
+	Underruns = 0;
+	Overruns  = 0;
+}
+
 void audio_set_render_callback(audio_render_callback cb)
 {
 	audio_lock_scope lock;
 	Render_callback = cb;
 }
+
+void audio_set_stem_callback(audio_stem_callback cb, bool voices)
+{
+	audio_lock_scope lock;
+	Stem_callback = cb;
+	Render_voices = (cb != nullptr) && voices;
+	YM_set_voice_capture(Render_voices);
+}
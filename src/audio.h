@@ -7,6 +7,9 @@
 
 #include <SDL.h>
 
+#include "vera/vera_psg.h"
+#include "ym2151/ym2151.h"
+
 #define SAMPLERATE (25000000 / 512)
 #ifdef __EMSCRIPTEN__
 #	define SAMPLES_PER_BUFFER (1024)
@@ -23,6 +26,28 @@ public:
 
 using audio_render_callback = void (*)(const int16_t *samples, const int num_samples);
 
+// Individual chip (and, optionally, per-voice) outputs, before mixing.
+enum audio_stem {
+	AUDIO_STEM_YM = 0,
+	AUDIO_STEM_PSG,
+	AUDIO_STEM_PCM,
+	AUDIO_STEM_YM_VOICE,
+	AUDIO_STEM_PSG_CHANNEL = AUDIO_STEM_YM_VOICE + MAX_YM2151_VOICES,
+	AUDIO_STEM_COUNT       = AUDIO_STEM_PSG_CHANNEL + PSG_NUM_CHANNELS
+};
+
+// stems[] is indexed by audio_stem, entries which were not rendered are nullptr.
+using audio_stem_callback = void (*)(const int16_t *const *stems, const int num_samples);
+
+struct audio_stats {
+	float    latency_ms;        // Smoothed amount of queued audio, including the device's own buffer
+	float    target_latency_ms; // Latency the rate controller is steering towards
+	float    rate_adjust_ppm;   // Current deviation of the rendering rate from the device rate
+	uint32_t queued_buffers;
+	uint32_t underruns;         // Buffers replayed or silenced because nothing new was ready
+	uint32_t overruns;          // Buffers dropped because too much audio was queued
+};
+
 void audio_init(const char *dev_name, int num_audio_buffers);
 void audio_close(void);
 void audio_render(int cpu_clocks);
@@ -35,3 +60,8 @@ void audio_get_ym_buffer(int16_t *dst);
 
 int audio_get_sample_rate();
 void audio_set_render_callback(audio_render_callback cb);
+
+void audio_set_target_latency(int ms);
+void audio_get_stats(audio_stats *stats);
+void audio_reset_stats();
+void audio_set_stem_callback(audio_stem_callback cb, bool voices);
@@ -0,0 +1,168 @@
+#pragma once
+#if !defined(BACKGROUND_WRITER_H)
+#	define BACKGROUND_WRITER_H
+
+#	include <deque>
+#	include <functional>
+#	include <vector>
+
+#	include "SDL.h"
+#	include "fmt/format.h"
+
+//
+// Background writer
+//
+// Hands blocks filled on the emulation thread to a worker thread that writes them out, so the
+// emulation thread doesn't wait on compression or file output. Written blocks are recycled
+// through a free list, so once a recording is underway there are no further allocations. If the
+// thread can't be created, blocks are written as they are submitted instead.
+//
+
+template <typename T>
+class background_writer
+{
+public:
+	// 'max_queued' blocks can be waiting before submit() blocks until the writer catches up, or
+	// any number if it is 0.
+	background_writer(const char *name, std::function<T *()> create, std::function<void(T *)> write, int max_queued = 0)
+	    : m_name(name), m_create(create), m_write(write), m_max_queued(max_queued)
+	{
+		// Nothing to do.
+	}
+
+	void start()
+	{
+		if (m_thread != nullptr) {
+			return;
+		}
+
+		m_mutex     = SDL_CreateMutex();
+		m_work_cond = SDL_CreateCond();
+		m_idle_cond = SDL_CreateCond();
+		m_quit      = false;
+		m_thread    = SDL_CreateThread(thread_main, m_name, this);
+		if (m_thread == nullptr) {
+			fmt::print("WARN: Could not create {} writer thread, writing from the emulation thread instead: {}\n", m_name, SDL_GetError());
+		}
+	}
+
+	// Writes whatever is still queued, then stops the thread.
+	void stop()
+	{
+		if (m_thread != nullptr) {
+			SDL_LockMutex(m_mutex);
+			m_quit = true;
+			SDL_CondSignal(m_work_cond);
+			SDL_UnlockMutex(m_mutex);
+			SDL_WaitThread(m_thread, nullptr);
+			m_thread = nullptr;
+		}
+
+		for (T *block : m_free_blocks) {
+			delete block;
+		}
+		m_free_blocks.clear();
+
+		if (m_mutex != nullptr) {
+			SDL_DestroyCond(m_idle_cond);
+			SDL_DestroyCond(m_work_cond);
+			SDL_DestroyMutex(m_mutex);
+			m_idle_cond = nullptr;
+			m_work_cond = nullptr;
+			m_mutex     = nullptr;
+		}
+	}
+
+	// A recycled block if there is one, or a new one. Its previous contents are left in place.
+	T *alloc()
+	{
+		T *block = nullptr;
+		if (m_mutex != nullptr) {
+			SDL_LockMutex(m_mutex);
+			if (!m_free_blocks.empty()) {
+				block = m_free_blocks.back();
+				m_free_blocks.pop_back();
+			}
+			SDL_UnlockMutex(m_mutex);
+		}
+		return block != nullptr ? block : m_create();
+	}
+
+	void submit(T *block)
+	{
+		if (m_thread == nullptr) {
+			m_write(block);
+			m_free_blocks.push_back(block);
+			return;
+		}
+
+		SDL_LockMutex(m_mutex);
+		while (m_max_queued > 0 && m_busy_blocks >= m_max_queued) {
+			SDL_CondWait(m_idle_cond, m_mutex);
+		}
+		m_queue.push_back(block);
+		++m_busy_blocks;
+		SDL_CondSignal(m_work_cond);
+		SDL_UnlockMutex(m_mutex);
+	}
+
+	// Wait until every submitted block has been written.
+	void wait_idle()
+	{
+		if (m_thread == nullptr) {
+			return;
+		}
+
+		SDL_LockMutex(m_mutex);
+		while (m_busy_blocks > 0) {
+			SDL_CondWait(m_idle_cond, m_mutex);
+		}
+		SDL_UnlockMutex(m_mutex);
+	}
+
+private:
+	static int thread_main(void *data)
+	{
+		background_writer *writer = static_cast<background_writer *>(data);
+
+		SDL_LockMutex(writer->m_mutex);
+		for (;;) {
+			while (writer->m_queue.empty() && !writer->m_quit) {
+				SDL_CondWait(writer->m_work_cond, writer->m_mutex);
+			}
+			if (writer->m_queue.empty()) {
+				break;
+			}
+
+			T *block = writer->m_queue.front();
+			writer->m_queue.pop_front();
+			SDL_UnlockMutex(writer->m_mutex);
+
+			writer->m_write(block);
+
+			SDL_LockMutex(writer->m_mutex);
+			writer->m_free_blocks.push_back(block);
+			--writer->m_busy_blocks;
+			SDL_CondBroadcast(writer->m_idle_cond);
+		}
+		SDL_UnlockMutex(writer->m_mutex);
+		return 0;
+	}
+
+	const char               *m_name;
+	std::function<T *()>      m_create;
+	std::function<void(T *)>  m_write;
+	int                       m_max_queued;
+
+	SDL_Thread *m_thread      = nullptr;
+	SDL_mutex  *m_mutex       = nullptr;
+	SDL_cond   *m_work_cond   = nullptr;
+	SDL_cond   *m_idle_cond   = nullptr;
+	bool        m_quit        = false;
+	int         m_busy_blocks = 0;
+
+	std::deque<T *>  m_queue;
+	std::vector<T *> m_free_blocks;
+};
+
+#endif
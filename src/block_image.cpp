@@ -0,0 +1,511 @@
+#include "block_image.h"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <map>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+
+#include "files.h"
+#include "fmt/format.h"
+#include "zlib.h"
+
+static constexpr char     Signature[8] = { 'B', 'X', '1', '6', 'B', 'L', 'K', 'Z' };
+static constexpr uint32_t Version      = 1;
+static constexpr uint32_t Block_size   = 64 * 1024;
+
+// 4MB of decompressed blocks.
+static constexpr size_t Cache_blocks = 64;
+
+struct image_header {
+	char     signature[8];
+	uint32_t version;
+	uint32_t block_size;
+	uint64_t image_size;
+	uint64_t index_offset;
+	uint32_t num_blocks;
+	uint32_t reserved;
+};
+
+struct index_entry {
+	uint64_t offset;
+	uint32_t size;     // 0 for an all-zero block, Block_size for one stored uncompressed
+	uint32_t capacity; // bytes available at offset
+};
+
+struct cached_block {
+	uint32_t             block;
+	bool                 dirty;
+	std::vector<uint8_t> data;
+};
+
+struct block_image {
+	std::fstream             file;
+	bool                     writable;
+	image_header             header;
+	std::vector<index_entry> index;
+	bool                     index_dirty;
+
+	// End of the used part of the file.
+	uint64_t data_end;
+
+	// Whether each block is still where the index on disk says it is, in which case it is never
+	// written over.
+	std::vector<bool> committed;
+	uint64_t          committed_index_size;
+
+	// Space the index on disk doesn't refer to, by offset, which new blocks and indexes reuse
+	// before growing the file. Space given up since the index was last written only joins it once
+	// the header points at the new index.
+	std::map<uint64_t, uint64_t>                 free_space;
+	std::vector<std::pair<uint64_t, uint64_t>> pending_free;
+
+	// Most recently used first.
+	std::list<cached_block>                                         cache;
+	std::unordered_map<uint32_t, std::list<cached_block>::iterator> cache_map;
+
+	std::vector<uint8_t> buffer;
+};
+
+// Compress a block into 'out', returning the size to store: 0 if it is all zeros, Block_size if it
+// didn't compress.
+static uint32_t pack_block(const uint8_t *data, std::vector<uint8_t> &out)
+{
+	if (std::all_of(data, data + Block_size, [](uint8_t b) { return b == 0; })) {
+		return 0;
+	}
+
+	out.resize(compressBound(Block_size));
+	uLongf compressed_size = (uLongf)out.size();
+	if (compress2(out.data(), &compressed_size, data, Block_size, 6) != Z_OK || compressed_size >= Block_size) {
+		out.assign(data, data + Block_size);
+		return Block_size;
+	}
+	return (uint32_t)compressed_size;
+}
+
+static bool load_block(block_image *image, uint32_t block, std::vector<uint8_t> &data)
+{
+	data.assign(Block_size, 0);
+
+	const index_entry &entry = image->index[block];
+	if (entry.size == 0) {
+		return true;
+	}
+
+	image->buffer.resize(entry.size);
+	image->file.seekg(entry.offset);
+	image->file.read(reinterpret_cast<char *>(image->buffer.data()), entry.size);
+	if (!image->file) {
+		image->file.clear();
+		return false;
+	}
+
+	if (entry.size == Block_size) {
+		data = image->buffer;
+		return true;
+	}
+	uLongf size = Block_size;
+	return uncompress(data.data(), &size, image->buffer.data(), entry.size) == Z_OK && size == Block_size;
+}
+
+static void release_space(block_image *image, uint64_t offset, uint64_t size)
+{
+	if (size == 0) {
+		return;
+	}
+
+	auto next = image->free_space.lower_bound(offset);
+	if (next != image->free_space.end() && offset + size == next->first) {
+		size += next->second;
+		next = image->free_space.erase(next);
+	}
+	if (next != image->free_space.begin()) {
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == offset) {
+			prev->second += size;
+			return;
+		}
+	}
+	image->free_space.emplace(offset, size);
+}
+
+// First fit from the free space, or the end of the file.
+static uint64_t allocate_space(block_image *image, uint64_t size)
+{
+	for (auto free = image->free_space.begin(); free != image->free_space.end(); ++free) {
+		if (free->second >= size) {
+			const uint64_t offset    = free->first;
+			const uint64_t remaining = free->second - size;
+			image->free_space.erase(free);
+			if (remaining > 0) {
+				image->free_space.emplace(offset + size, remaining);
+			}
+			return offset;
+		}
+	}
+
+	const uint64_t offset = image->data_end;
+	image->data_end += size;
+	return offset;
+}
+
+static bool store_block(block_image *image, uint32_t block, const std::vector<uint8_t> &data)
+{
+	index_entry   &entry = image->index[block];
+	const uint32_t size  = pack_block(data.data(), image->buffer);
+	if (size > entry.capacity || image->committed[block]) {
+		if (image->committed[block]) {
+			image->pending_free.push_back({ entry.offset, entry.capacity });
+		} else {
+			release_space(image, entry.offset, entry.capacity);
+		}
+		image->committed[block] = false;
+
+		entry.offset   = size != 0 ? allocate_space(image, size) : 0;
+		entry.capacity = size;
+	}
+	entry.size         = size;
+	image->index_dirty = true;
+
+	if (size != 0) {
+		image->file.seekp(entry.offset);
+		image->file.write(reinterpret_cast<const char *>(image->buffer.data()), size);
+		if (!image->file) {
+			image->file.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+static cached_block *get_block(block_image *image, uint32_t block)
+{
+	if (const auto cached = image->cache_map.find(block); cached != image->cache_map.end()) {
+		image->cache.splice(image->cache.begin(), image->cache, cached->second);
+		return &image->cache.front();
+	}
+
+	if (image->cache.size() >= Cache_blocks) {
+		cached_block &oldest = image->cache.back();
+		if (oldest.dirty && !store_block(image, oldest.block, oldest.data)) {
+			fmt::print("Could not write block {} of block image\n", oldest.block);
+		}
+		image->cache_map.erase(oldest.block);
+		image->cache.pop_back();
+	}
+
+	image->cache.push_front({ block, false, {} });
+	if (!load_block(image, block, image->cache.front().data)) {
+		fmt::print("Could not read block {} of block image\n", block);
+		image->cache.pop_front();
+		return nullptr;
+	}
+	image->cache_map[block] = image->cache.begin();
+	return &image->cache.front();
+}
+
+bool block_image_detect(const std::filesystem::path &path)
+{
+	std::ifstream file(path, std::ios_base::in | std::ios_base::binary);
+	char          signature[sizeof(Signature)];
+	return file.read(signature, sizeof(signature)) && memcmp(signature, Signature, sizeof(Signature)) == 0;
+}
+
+block_image *block_image_open(const std::filesystem::path &path, bool writable)
+{
+	block_image *image = new block_image;
+	image->writable    = writable;
+	image->index_dirty = false;
+	image->file.open(path, std::ios_base::in | std::ios_base::binary | (writable ? std::ios_base::out : std::ios_base::openmode()));
+
+	if (!image->file.read(reinterpret_cast<char *>(&image->header), sizeof(image->header)) || memcmp(image->header.signature, Signature, sizeof(Signature)) != 0) {
+		fmt::print("Not a block image: {}\n", path.generic_string());
+		delete image;
+		return nullptr;
+	}
+	if (image->header.version != Version || image->header.block_size != Block_size) {
+		fmt::print("Unsupported block image version or block size: {}\n", path.generic_string());
+		delete image;
+		return nullptr;
+	}
+
+	image->index.resize(image->header.num_blocks);
+	image->file.seekg(image->header.index_offset);
+	if (!image->file.read(reinterpret_cast<char *>(image->index.data()), image->index.size() * sizeof(index_entry))) {
+		fmt::print("Could not read block image index: {}\n", path.generic_string());
+		delete image;
+		return nullptr;
+	}
+
+	// Nothing the index refers to is written over, so the image stays consistent until the header
+	// is rewritten to point at a new one. Everything else between the header and the end of the
+	// file, left behind by earlier sessions, is free.
+	std::vector<std::pair<uint64_t, uint64_t>> used;
+	used.push_back({ image->header.index_offset, image->index.size() * sizeof(index_entry) });
+	for (const index_entry &entry : image->index) {
+		if (entry.capacity != 0) {
+			used.push_back({ entry.offset, entry.capacity });
+		}
+	}
+	std::sort(used.begin(), used.end());
+
+	image->data_end = sizeof(image_header);
+	for (const auto &[offset, size] : used) {
+		if (offset > image->data_end) {
+			release_space(image, image->data_end, offset - image->data_end);
+		}
+		image->data_end = std::max(image->data_end, offset + size);
+	}
+	image->committed.assign(image->index.size(), true);
+	image->committed_index_size = image->index.size() * sizeof(index_entry);
+	return image;
+}
+
+void block_image_close(block_image *image)
+{
+	if (image == nullptr) {
+		return;
+	}
+	if (image->writable && !block_image_flush(image)) {
+		fmt::print("Could not write block image\n");
+	}
+	delete image;
+}
+
+uint64_t block_image_size(const block_image *image)
+{
+	return image->header.image_size;
+}
+
+size_t block_image_read(block_image *image, uint64_t pos, void *data, size_t size)
+{
+	if (pos >= image->header.image_size) {
+		return 0;
+	}
+	size = (size_t)std::min<uint64_t>(size, image->header.image_size - pos);
+
+	uint8_t *out  = static_cast<uint8_t *>(data);
+	size_t   done = 0;
+	while (done < size) {
+		const uint32_t block  = (uint32_t)((pos + done) / Block_size);
+		const uint32_t offset = (uint32_t)((pos + done) % Block_size);
+		const size_t   count  = std::min<size_t>(size - done, Block_size - offset);
+
+		cached_block *cached = get_block(image, block);
+		if (cached == nullptr) {
+			break;
+		}
+		memcpy(out + done, cached->data.data() + offset, count);
+		done += count;
+	}
+	return done;
+}
+
+size_t block_image_write(block_image *image, uint64_t pos, const void *data, size_t size)
+{
+	if (!image->writable) {
+		return 0;
+	}
+
+	if (pos + size > image->header.image_size) {
+		image->header.image_size = pos + size;
+		image->header.num_blocks = (uint32_t)((image->header.image_size + Block_size - 1) / Block_size);
+		image->index.resize(image->header.num_blocks, { 0, 0, 0 });
+		image->committed.resize(image->header.num_blocks, false);
+		image->index_dirty = true;
+	}
+
+	const uint8_t *in   = static_cast<const uint8_t *>(data);
+	size_t         done = 0;
+	while (done < size) {
+		const uint32_t block  = (uint32_t)((pos + done) / Block_size);
+		const uint32_t offset = (uint32_t)((pos + done) % Block_size);
+		const size_t   count  = std::min<size_t>(size - done, Block_size - offset);
+
+		cached_block *cached = get_block(image, block);
+		if (cached == nullptr) {
+			break;
+		}
+		memcpy(cached->data.data() + offset, in + done, count);
+		cached->dirty = true;
+		done += count;
+	}
+	return done;
+}
+
+bool block_image_flush(block_image *image)
+{
+	bool ok = true;
+	for (cached_block &cached : image->cache) {
+		if (cached.dirty) {
+			ok = store_block(image, cached.block, cached.data) && ok;
+			cached.dirty = false;
+		}
+	}
+	if (!image->index_dirty) {
+		return ok;
+	}
+
+	// The old index stays valid until the header no longer points at it.
+	const uint64_t old_index_offset = image->header.index_offset;
+	const uint64_t index_size       = image->index.size() * sizeof(index_entry);
+	image->header.index_offset      = allocate_space(image, index_size);
+	image->file.seekp(image->header.index_offset);
+	image->file.write(reinterpret_cast<const char *>(image->index.data()), index_size);
+
+	image->file.seekp(0);
+	image->file.write(reinterpret_cast<const char *>(&image->header), sizeof(image->header));
+	image->file.flush();
+	if (!image->file) {
+		image->file.clear();
+		release_space(image, image->header.index_offset, index_size);
+		image->header.index_offset = old_index_offset;
+		return false;
+	}
+	image->pending_free.push_back({ old_index_offset, image->committed_index_size });
+	image->index_dirty          = false;
+	image->committed_index_size = index_size;
+	image->committed.assign(image->index.size(), true);
+	for (const auto &[offset, size] : image->pending_free) {
+		release_space(image, offset, size);
+	}
+	image->pending_free.clear();
+	return ok;
+}
+
+bool block_image_convert(const std::filesystem::path &from, const std::filesystem::path &to)
+{
+	// Each source type reads the next chunk of the image into a buffer, returning the bytes read.
+	std::function<size_t(uint8_t *, size_t)> read_source;
+
+	block_image  *source_image = nullptr;
+	gzFile        source_gz    = Z_NULL;
+	std::ifstream source_raw;
+	uint64_t      source_pos = 0;
+
+	if (block_image_detect(from)) {
+		source_image = block_image_open(from, false);
+		if (source_image == nullptr) {
+			return false;
+		}
+		read_source = [&](uint8_t *data, size_t size) {
+			const size_t read = block_image_read(source_image, source_pos, data, size);
+			source_pos += read;
+			return read;
+		};
+	} else if (file_is_compressed_type(from)) {
+		source_gz = gzopen(from.generic_string().c_str(), "rb");
+		if (source_gz == Z_NULL) {
+			fmt::print("Could not open file for decompression: {}\n", from.generic_string());
+			return false;
+		}
+		gzbuffer(source_gz, 1024 * 1024);
+		read_source = [&](uint8_t *data, size_t size) {
+			const int read = gzread(source_gz, data, (unsigned int)size);
+			return read > 0 ? (size_t)read : 0;
+		};
+	} else {
+		source_raw.open(from, std::ios_base::in | std::ios_base::binary);
+		if (!source_raw.is_open()) {
+			fmt::print("Could not open file for read: {}\n", from.generic_string());
+			return false;
+		}
+		read_source = [&](uint8_t *data, size_t size) {
+			source_raw.read(reinterpret_cast<char *>(data), size);
+			return (size_t)source_raw.gcount();
+		};
+	}
+
+	auto close_source = [&]() {
+		block_image_close(source_image);
+		source_image = nullptr;
+		if (source_gz != Z_NULL) {
+			gzclose(source_gz);
+			source_gz = Z_NULL;
+		}
+		source_raw.close();
+	};
+
+	// The image is built next to 'to' and only moved over it once complete, so converting an image
+	// onto its own path compacts it instead of truncating the source before it has been read.
+	const std::filesystem::path tmp_path = to.generic_string() + ".tmp";
+
+	std::ofstream out(tmp_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+	if (!out.is_open()) {
+		fmt::print("Could not open file for write: {}\n", tmp_path.generic_string());
+		close_source();
+		return false;
+	}
+
+	image_header header = {};
+	memcpy(header.signature, Signature, sizeof(Signature));
+	header.version    = Version;
+	header.block_size = Block_size;
+	out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+	fmt::print("Converting {} to block image {}\n", from.generic_string(), to.generic_string());
+
+	std::vector<index_entry> index;
+	std::vector<uint8_t>     block(Block_size);
+	std::vector<uint8_t>     packed;
+	uint64_t                 offset             = sizeof(header);
+	const uint64_t           progress_increment = 128 * 1024 * 1024;
+	uint64_t                 progress_threshold = progress_increment;
+	while (true) {
+		// Short reads are allowed from gz streams, so fill the block before deciding it is the last.
+		size_t filled = 0;
+		while (filled < Block_size) {
+			const size_t read = read_source(block.data() + filled, Block_size - filled);
+			if (read == 0) {
+				break;
+			}
+			filled += read;
+		}
+		if (filled == 0) {
+			break;
+		}
+		std::fill(block.begin() + filled, block.end(), 0);
+
+		const uint32_t size = pack_block(block.data(), packed);
+		out.write(reinterpret_cast<const char *>(packed.data()), size);
+		index.push_back({ offset, size, size });
+		offset += size;
+		header.image_size += filled;
+
+		if (header.image_size >= progress_threshold) {
+			fmt::print("{:d} MB\n", header.image_size / (1024 * 1024));
+			progress_threshold += progress_increment;
+		}
+		if (filled < Block_size) {
+			break;
+		}
+	}
+	close_source();
+
+	header.index_offset = offset;
+	header.num_blocks   = (uint32_t)index.size();
+	out.write(reinterpret_cast<const char *>(index.data()), index.size() * sizeof(index_entry));
+	out.seekp(0);
+	out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	out.close();
+	if (!out) {
+		fmt::print("Could not write block image: {}\n", tmp_path.generic_string());
+		std::filesystem::remove(tmp_path);
+		return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tmp_path, to, error);
+	if (error) {
+		fmt::print("Could not replace {}: {}\n", to.generic_string(), error.message());
+		std::filesystem::remove(tmp_path, error);
+		return false;
+	}
+
+	fmt::print("{:d} MB in {:d} MB\n", header.image_size / (1024 * 1024), (offset + index.size() * sizeof(index_entry)) / (1024 * 1024));
+	return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#if !defined(BLOCK_IMAGE_H)
+#	define BLOCK_IMAGE_H
+
+#	include <filesystem>
+#	include <stdint.h>
+
+//
+// Block-compressed disk images
+//
+// A block image holds a disk image as independently deflated 64KB blocks, with an index at the
+// end of the file, so any sector can be reached without decompressing what comes before it.
+// Blocks are decompressed the first time they are touched and kept in a small LRU cache; blocks
+// that were written are compressed again when they leave the cache or the image is closed, and
+// only those are rewritten. All-zero blocks take no space at all.
+//
+// A rewritten block never goes over the copy the index on disk refers to, so the image stays
+// consistent if the emulator stops before the new index is written. It goes into space no longer
+// referred to by that index, which includes old copies of blocks and old indexes once a newer one
+// has been written, and only to the end of the file if none is big enough. Free space is found
+// again when an image is opened. The file never shrinks, though; converting an image onto itself
+// with -convert_sdcard compacts it.
+//
+
+struct block_image;
+
+// Whether 'path' starts with the block image signature.
+bool block_image_detect(const std::filesystem::path &path);
+
+block_image *block_image_open(const std::filesystem::path &path, bool writable);
+void         block_image_close(block_image *image);
+
+uint64_t block_image_size(const block_image *image);
+
+size_t block_image_read(block_image *image, uint64_t pos, void *data, size_t size);
+size_t block_image_write(block_image *image, uint64_t pos, const void *data, size_t size);
+
+// Write all modified blocks and the index back to disk.
+bool block_image_flush(block_image *image);
+
+// Convert a raw image, a gzipped raw image or another block image into a block image.
+bool block_image_convert(const std::filesystem::path &from, const std::filesystem::path &to);
+
+#endif
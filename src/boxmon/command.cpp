@@ -9,12 +9,19 @@
 
 #include "cpu/fake6502.h"
 #include "cpu/mnemonics.h"
+#include "coverage.h"
+#include "cpu_history.h"
 #include "disasm.h"
 #include "debugger.h"
 #include "glue.h"
 #include "hypercalls.h"
+#include "irq_stats.h"
 #include "memory.h"
+#include "profiler.h"
+#include "raster_timeline.h"
+#include "rewind.h"
 #include "vera/sdcard.h"
+#include "vera/sdcard_overlay.h"
 #include "vera/vera_video.h"
 
 namespace boxmon
@@ -236,6 +243,249 @@ BOXMON_COMMAND(break, "break [load|store|exec] [address [address] [if <cond_expr
 
 BOXMON_ALIAS(br, break);
 
+BOXMON_COMMAND(watch, "watch [load|store|change] [vram] [address [address]]")
+{
+	if (help) {
+		boxmon_console_print("Create a watchpoint over a range of memory.");
+		boxmon_console_print("\tload: Break if the CPU reads from the range.");
+		boxmon_console_print("\tstore: Break if the CPU writes to the range.");
+		boxmon_console_print("\tchange: Break if the CPU writes a different value to the range than the one already there.");
+		boxmon_console_print("\tvram: The range is in VRAM rather than CPU memory, and is checked for accesses through the VERA data ports.");
+		boxmon_console_print("\taddress: The first and last addresses of the range. If only one address is given, the range is that single address.");
+		boxmon_console_print("\t         For CPU memory, addresses above $FFFF select a bank, so $5A000 $5BFFF covers all of RAM bank 5.");
+		boxmon_console_print("If no option is specified, the watchpoint breaks on stores.");
+		boxmon_console_print("If no address is specified, the current watchpoints are listed.");
+		return true;
+	}
+	uint8_t watch_flags = 0;
+	bool    vram        = false;
+	for (int option; parser.parse_option(option, { "load", "store", "change", "vram" }, input);) {
+		if (option == 3) {
+			vram = true;
+		} else {
+			watch_flags |= (1 << option);
+		}
+	}
+	if (watch_flags == 0) {
+		watch_flags = DEBUGGER_WATCH_WRITE;
+	}
+
+	boxmon::address_type start;
+	boxmon::address_type end;
+	if (!parser.parse_address_range(start, end, input)) {
+		for (auto &wp : debugger_get_watchpoints()) {
+			boxmon_console_print("{:3d}: {}{}{} {} {}-{}{} hits:{}", wp.id,
+			    (wp.flags & DEBUGGER_WATCH_READ) ? 'L' : '-',
+			    (wp.flags & DEBUGGER_WATCH_WRITE) ? 'S' : '-',
+			    (wp.flags & DEBUGGER_WATCH_CHANGE) ? 'C' : '-',
+			    wp.vram ? "VRAM" : "CPU ",
+			    debugger_format_watch_address(wp, wp.start),
+			    debugger_format_watch_address(wp, wp.end),
+			    wp.enabled ? "" : " (disabled)",
+			    wp.hits);
+		}
+		return true;
+	}
+
+	uint32_t id = 0;
+	if (vram) {
+		id = debugger_add_vram_watchpoint((std::get<1>(start) << 16) | std::get<0>(start), (std::get<1>(end) << 16) | std::get<0>(end), watch_flags);
+	} else {
+		id = debugger_add_watchpoint(std::get<0>(start), std::get<1>(start), std::get<0>(end), std::get<1>(end), watch_flags);
+	}
+
+	if (id == 0) {
+		boxmon_warning_print("Could not add watchpoint, the range is out of bounds.");
+	} else {
+		boxmon_console_print("Watchpoint {} added.", id);
+	}
+	return true;
+}
+
+BOXMON_ALIAS(w, watch);
+
+BOXMON_COMMAND(unwatch, "unwatch <id>")
+{
+	if (help) {
+		boxmon_console_print("Remove a watchpoint by the number shown by \"watch\".");
+		return true;
+	}
+
+	int id = 0;
+	if (!parser.parse_dec_number(id, input)) {
+		return false;
+	}
+	debugger_remove_watchpoint(static_cast<uint32_t>(id));
+	return true;
+}
+
+BOXMON_COMMAND(trace, "trace [log] [address [address] [if <cond_expr>]]")
+{
+	if (help) {
+		boxmon_console_print("Create a tracepoint, optionally with a conditional expression.");
+		boxmon_console_print("Each time the CPU executes an instruction at a tracepoint, the cycle count, bank, PC, and registers are recorded without pausing execution.");
+		boxmon_console_print("\tlog: Also print each recorded event to the console. This is much slower than recording alone.");
+		boxmon_console_print("\taddress: One or more addresses to set as tracepoints.");
+		boxmon_console_print("\tcond_expr: Conditional expression following the same rules and syntax as \"eval\". If specified, an event is only recorded when the expression evaluates to a non-zero value.");
+		boxmon_console_print("If no address is specified, the current tracepoints are listed.");
+		boxmon_console_print("See also \"tracevalue\", \"untrace\", and \"tracedump\".");
+		return true;
+	}
+	uint8_t trace_flags = 0;
+	if (int option; parser.parse_option(option, { "log" }, input)) {
+		trace_flags |= DEBUGGER_TRACE_LOG;
+	}
+
+	std::list<boxmon::address_type> tps;
+	for (boxmon::address_type tp; parser.parse_address(tp, input);) {
+		tps.push_back(tp);
+	}
+
+	if (tps.empty()) {
+		for (auto &[address, bank] : debugger_get_tracepoints()) {
+			std::string values;
+			for (auto &value : debugger_get_tracepoint_values(address, bank)) {
+				values += fmt::format(" {}", value);
+			}
+			const std::string condition = debugger_get_tracepoint_condition(address, bank);
+			boxmon_console_print("{:02x}:{:04x}{}{}{}{}", bank, address,
+			    (debugger_get_tracepoint_flags(address, bank) & DEBUGGER_TRACE_LOG) ? " log" : "",
+			    values.empty() ? "" : " values:", values,
+			    condition.empty() ? "" : fmt::format(" if {}", condition));
+		}
+		return true;
+	}
+
+	for (auto tp : tps) {
+		debugger_add_tracepoint(std::get<0>(tp), std::get<1>(tp), trace_flags);
+	}
+
+	if (int option; parser.parse_option(option, { "if" }, input)) {
+		if (const boxmon::expression *expr = nullptr; parser.parse_expression(expr, input, boxmon::expression_parse_flags_must_consume_all)) {
+			for (auto tp : tps) {
+				debugger_set_tracepoint_condition(std::get<0>(tp), std::get<1>(tp), expr->get_string());
+			}
+		}
+	}
+
+	return true;
+}
+
+BOXMON_ALIAS(tr, trace);
+
+BOXMON_COMMAND(tracevalue, "tracevalue <address> [<expr>]")
+{
+	if (help) {
+		boxmon_console_print("Add an expression to be evaluated and recorded alongside the registers each time a tracepoint is hit.");
+		boxmon_console_print("Up to {} values may be recorded per tracepoint. Use the dereference operator to record memory, for example \"@$22\".", Num_debugger_trace_values);
+		boxmon_console_print("If no expression is specified, all values are removed from the tracepoint.");
+		return true;
+	}
+
+	boxmon::address_type tp;
+	if (!parser.parse_address(tp, input)) {
+		return false;
+	}
+
+	const auto [address, bank] = tp;
+	if (!debugger_has_tracepoint(address, bank)) {
+		boxmon_warning_print("No tracepoint at {:02x}:{:04x}", bank, address);
+		return true;
+	}
+
+	if (*input == '\0') {
+		debugger_clear_tracepoint_values(address, bank);
+		return true;
+	}
+
+	const boxmon::expression *expr = nullptr;
+	if (!parser.parse_expression(expr, input, boxmon::expression_parse_flags_must_consume_all)) {
+		return false;
+	}
+
+	if (!debugger_add_tracepoint_value(address, bank, expr->get_string())) {
+		boxmon_warning_print("Could not add value, tracepoints may only record {} values.", Num_debugger_trace_values);
+	}
+	return true;
+}
+
+BOXMON_ALIAS(tv, tracevalue);
+
+BOXMON_COMMAND(untrace, "untrace <address> [address]")
+{
+	if (help) {
+		boxmon_console_print("Remove one or more tracepoints. Events already recorded are kept.");
+		return true;
+	}
+
+	bool found = false;
+	for (boxmon::address_type tp; parser.parse_address(tp, input);) {
+		debugger_remove_tracepoint(std::get<0>(tp), std::get<1>(tp));
+		found = true;
+	}
+	return found;
+}
+
+BOXMON_COMMAND(tracedump, "tracedump [clear] | [<count>] [at <address>]")
+{
+	if (help) {
+		boxmon_console_print("Print the most recent events recorded by tracepoints, oldest first.");
+		boxmon_console_print("\tclear: Discard all recorded events.");
+		boxmon_console_print("\tcount: The number of events to print. If omitted, the default is 32. 0 prints every recorded event.");
+		boxmon_console_print("\taddress: Only print events recorded at this address.");
+		return true;
+	}
+
+	if (int option; parser.parse_option(option, { "clear" }, input)) {
+		debugger_clear_trace();
+		return true;
+	}
+
+	int count = 32;
+	(void)parser.parse_dec_number(count, input);
+
+	bool                 filter = false;
+	boxmon::address_type at;
+	if (int option; parser.parse_option(option, { "at" }, input)) {
+		if (!parser.parse_address(at, input)) {
+			return false;
+		}
+		if (std::get<0>(at) < 0xa000) {
+			std::get<1>(at) = 0;
+		}
+		filter = true;
+	}
+
+	auto matches = [&](const tracepoint_event &event) {
+		return !filter || (event.state.pc == std::get<0>(at) && event.bank == std::get<1>(at));
+	};
+
+	// Walk backwards to find where the requested number of matching events starts.
+	const size_t num_events = debugger_get_trace_count();
+	size_t       first      = num_events;
+	for (int found = 0; first > 0 && (count <= 0 || found < count);) {
+		--first;
+		if (matches(debugger_get_trace_event(first))) {
+			++found;
+		}
+	}
+
+	for (size_t i = first; i < num_events; ++i) {
+		const tracepoint_event &event = debugger_get_trace_event(i);
+		if (matches(event)) {
+			boxmon_console_print("{}", debugger_format_trace_event(event));
+		}
+	}
+
+	const uint64_t total = debugger_get_trace_total();
+	if (total > num_events) {
+		boxmon_console_print("({} older events were overwritten)", total - num_events);
+	}
+	return true;
+}
+
+BOXMON_ALIAS(td, tracedump);
+
 BOXMON_COMMAND(add_label, "add_label <address> <label>")
 {
 	if (help) {
@@ -310,14 +560,157 @@ BOXMON_COMMAND(backtrace, "backtrace")
 BOXMON_ALIAS(bt, backtrace);
 
 //// Machine state commands
-BOXMON_COMMAND(cpuhistory, "cpuhistory [length]")
+static void print_history_line(uint64_t ago, uint8_t opcode, uint8_t bank, const _state6502 &state, const std::string &suffix = std::string())
+{
+	char const *op = mnemonics[opcode];
+
+	boxmon_console_print("{: 3d}: {} PC:{:02x}:{:04x} A:{:02x} X:{:02x} Y:{:02x} SP:{:02x} ST:{:c}{:c}-{:c}{:c}{:c}{:c}{:c}{}", ago, op, bank, state.pc, state.a, state.x, state.y, state.sp, state.status & 0x80 ? 'N' : '-', state.status & 0x40 ? 'V' : '-', state.status & 0x10 ? 'B' : '-', state.status & 0x08 ? 'D' : '-', state.status & 0x04 ? 'I' : '-', state.status & 0x02 ? 'Z' : '-', state.status & 0x01 ? 'C' : '-', suffix);
+}
+
+static void print_history_entry(const cpu_history_entry &entry)
+{
+	std::string writes;
+	for (int i = 0; i < entry.num_writes; ++i) {
+		const cpu_history_store &w = entry.writes[i];
+		writes += w.address >= 0xa000 ? fmt::format(" {:02x}:{:04x}={:02x}", w.bank, w.address, w.value) : fmt::format(" {:04x}={:02x}", w.address, w.value);
+	}
+	print_history_line(cpu_history_end() - entry.index, entry.opcode, entry.bank, entry.state, writes);
+}
+
+// Print up to 'length' entries of the -history log ending just before 'before', optionally only branches.
+static void print_history_log(uint64_t before, int length, bool branches_only)
+{
+	std::vector<cpu_history_entry> entries;
+	cpu_history_for_each_reverse(before, [&](const cpu_history_entry &entry) {
+		if (!branches_only || disasm_is_branch(entry.opcode)) {
+			entries.push_back(entry);
+		}
+		return --length <= 0;
+	});
+
+	for (auto i = entries.rbegin(); i != entries.rend(); ++i) {
+		print_history_entry(*i);
+	}
+}
+
+BOXMON_COMMAND(coverage, "coverage [on|off|clear] | save <file> | merge <file> | lcov <file> [<dbgfile> [<bank>]]")
+{
+	if (help) {
+		boxmon_console_print("Collect code coverage: which instructions executed, and which ways each branch went.");
+		boxmon_console_print("With no arguments, show whether coverage is being collected and how many addresses have executed.");
+		boxmon_console_print("  on: Start collecting. Coverage accumulates until cleared.");
+		boxmon_console_print("  off: Stop collecting, keeping what has been collected.");
+		boxmon_console_print("  clear: Discard the coverage collected so far.");
+		boxmon_console_print("  save <file>: Write the coverage to <file> in Box16's compact coverage format.");
+		boxmon_console_print("  merge <file>: Add the coverage saved in <file> to the current coverage.");
+		boxmon_console_print("  lcov <file> [<dbgfile> [<bank>]]: Write an lcov tracefile. With a ca65 debug file, coverage is reported against its source lines, with the code it describes in <bank>.");
+		return true;
+	}
+
+	int option = 0;
+	if (!parser.parse_option(option, { "on", "off", "clear", "save", "merge", "lcov" }, input)) {
+		boxmon_console_print("Coverage is {}, {} addresses executed.", coverage_is_running() ? "on" : "off", coverage_count());
+		return true;
+	}
+
+	switch (option) {
+		case 0:
+			coverage_start();
+			break;
+		case 1:
+			coverage_stop();
+			break;
+		case 2:
+			coverage_clear();
+			break;
+		default: {
+			std::string path;
+			if (!parser.parse_string(path, input)) {
+				return false;
+			}
+
+			bool ok = false;
+			if (option == 3) {
+				ok = coverage_save(path);
+			} else if (option == 4) {
+				ok = coverage_merge(path);
+			} else {
+				std::string dbg_path;
+				uint8_t     bank = 0;
+				if (parser.parse_string(dbg_path, input)) {
+					(void)parser.parse_number(bank, input);
+				}
+				ok = coverage_export_lcov(path, dbg_path, bank);
+			}
+			if (!ok) {
+				boxmon_error_print("Could not {} {}", option == 4 ? "read coverage from" : "write coverage to", path);
+				return false;
+			}
+			break;
+		}
+	}
+	return true;
+}
+
+BOXMON_COMMAND(cpuhistory, "cpuhistory [length] | back <count> [length] | pc <address> | write <address>")
 {
 	if (help) {
 		boxmon_console_print("Show a history of recently-executed instructions, up to the specified number of instructions ago.");
 		boxmon_console_print("If omitted, the default is 128 instructions.");
+		boxmon_console_print("When a -history log is being recorded, the whole log is available and each instruction lists the stores it made:");
+		boxmon_console_print("  back <count> [length]: Show the instructions leading up to <count> instructions ago.");
+		boxmon_console_print("  pc <address>: Show the instructions leading up to the last time the CPU executed at <address>.");
+		boxmon_console_print("  write <address>: Show the instructions leading up to the last store to <address>.");
+		return true;
+	}
+
+	int option = 0;
+	if (parser.parse_option(option, { "back", "pc", "write" }, input)) {
+		if (!cpu_history_is_recording()) {
+			boxmon_error_print("No -history log is being recorded.");
+			return false;
+		}
+
+		uint64_t before = cpu_history_end();
+		if (option == 0) {
+			int count = 0;
+			if (!parser.parse_dec_number(count, input)) {
+				return false;
+			}
+			before -= std::min<uint64_t>(before, std::max(count, 1) - 1);
+		} else {
+			boxmon::address_type addr;
+			if (!parser.parse_address(addr, input)) {
+				return false;
+			}
+
+			const auto &[address, bank] = addr;
+			uint64_t    index           = 0;
+			const bool  found           = option == 1 ? cpu_history_find_pc(address, bank, before, index) : cpu_history_find_write(address, bank, before, index);
+			if (!found) {
+				boxmon_console_print("Not found in the {} instructions of history.", before - cpu_history_first());
+				return true;
+			}
+			before = index + 1;
+		}
+
+		int history_length = 0;
+		if (!parser.parse_dec_number(history_length, input)) {
+			history_length = option == 0 ? 128 : 16;
+		}
+		print_history_log(before, history_length, false);
 		return true;
 	}
+
 	int history_length = 0;
+	if (cpu_history_is_recording()) {
+		if (!parser.parse_dec_number(history_length, input)) {
+			history_length = 128;
+		}
+		print_history_log(cpu_history_end(), history_length, false);
+		return true;
+	}
+
 	if (parser.parse_dec_number(history_length, input)) {
 		history_length = history_length <= static_cast<int>(history6502.count()) ? history_length : static_cast<int>(history6502.count());
 	} else {
@@ -326,10 +719,7 @@ BOXMON_COMMAND(cpuhistory, "cpuhistory [length]")
 
 	for (size_t i = history6502.count() - static_cast<size_t>(history_length); i < history6502.count(); ++i) {
 		const auto &history = history6502[i];
-
-		char const *op = mnemonics[history.opcode];
-
-		boxmon_console_print("{: 3d}: {} PC:{:02x}:{:04x} A:{:02x} X:{:02x} Y:{:02x} SP:{:02x} ST:{:c}{:c}-{:c}{:c}{:c}{:c}{:c}", history6502.count() - i, op, history.bank, history.state.pc, history.state.a, history.state.x, history.state.y, history.state.sp, history.state.status & 0x80 ? 'N' : '-', history.state.status & 0x40 ? 'V' : '-', history.state.status & 0x10 ? 'B' : '-', history.state.status & 0x08 ? 'D' : '-', history.state.status & 0x04 ? 'I' : '-', history.state.status & 0x02 ? 'Z' : '-', history.state.status & 0x01 ? 'C' : '-');
+		print_history_line(history6502.count() - i, history.opcode, history.bank, history.state);
 	}
 	return true;
 }
@@ -345,6 +735,14 @@ BOXMON_COMMAND(jmphistory, "jmphistory [length]")
 		return true;
 	}
 	int history_length = 0;
+	if (cpu_history_is_recording()) {
+		if (!parser.parse_dec_number(history_length, input)) {
+			history_length = 128;
+		}
+		print_history_log(cpu_history_end(), history_length, true);
+		return true;
+	}
+
 	if (parser.parse_dec_number(history_length, input)) {
 		history_length = history_length <= static_cast<int>(history6502.count()) ? history_length : static_cast<int>(history6502.count());
 	} else {
@@ -354,9 +752,7 @@ BOXMON_COMMAND(jmphistory, "jmphistory [length]")
 	for (size_t i = history6502.count() - static_cast<size_t>(history_length); i < history6502.count(); ++i) {
 		const auto &history = history6502[i];
 		if (disasm_is_branch(history.opcode)) {
-			char const *op = mnemonics[history.opcode];
-
-			boxmon_console_print("{: 3d}: {} PC:{:02x}:{:04x} A:{:02x} X:{:02x} Y:{:02x} SP:{:02x} ST:{:c}{:c}-{:c}{:c}{:c}{:c}{:c}", history6502.count() - i, op, history.bank, history.state.pc, history.state.a, history.state.x, history.state.y, history.state.sp, history.state.status & 0x80 ? 'N' : '-', history.state.status & 0x40 ? 'V' : '-', history.state.status & 0x10 ? 'B' : '-', history.state.status & 0x08 ? 'D' : '-', history.state.status & 0x04 ? 'I' : '-', history.state.status & 0x02 ? 'Z' : '-', history.state.status & 0x01 ? 'C' : '-');
+			print_history_line(history6502.count() - i, history.opcode, history.bank, history.state);
 		}
 	}
 	return true;
@@ -520,11 +916,80 @@ BOXMON_COMMAND(iowide, "iowide")
 
 BOXMON_ALIAS(iow, iowide);
 
-BOXMON_COMMAND(next, "next [<count>]")
+BOXMON_COMMAND(irqstats, "irqstats [on|off|clear] | frames [<count>]")
+{
+	if (help) {
+		boxmon_console_print("Measure interrupt latency and handler time for each IRQ source.");
+		boxmon_console_print("With no arguments, show the latency and handler duration of each source, with histograms.");
+		boxmon_console_print("  on: Start measuring. Statistics accumulate until cleared.");
+		boxmon_console_print("  off: Stop measuring.");
+		boxmon_console_print("  clear: Discard the statistics gathered so far.");
+		boxmon_console_print("  frames [<count>]: Show interrupts, missed interrupts and worst latency for each of the last <count> frames. <count> defaults to 10.");
+		return true;
+	}
+
+	int option = 0;
+	if (!parser.parse_option(option, { "on", "off", "clear", "frames" }, input)) {
+		boxmon_console_print("IRQ statistics are {}.", Irq_stats_enabled ? "on" : "off");
+		for (const auto &line : irq_stats_report()) {
+			boxmon_console_print("{}", line);
+		}
+		return true;
+	}
+
+	switch (option) {
+		case 0:
+			irq_stats_start();
+			break;
+		case 1:
+			irq_stats_stop();
+			break;
+		case 2:
+			irq_stats_clear();
+			break;
+		default: {
+			int count = 0;
+			if (!parser.parse_dec_number(count, input) || count <= 0) {
+				count = 10;
+			}
+			for (const auto &line : irq_stats_frame_report(count)) {
+				boxmon_console_print("{}", line);
+			}
+			break;
+		}
+	}
+	return true;
+}
+
+BOXMON_COMMAND(next, "next [back [over]] [<count>]")
 {
 	if (help) {
 		boxmon_console_print("Execute the next <count> instructions.");
 		boxmon_console_print("If left unspecified, <count> defaults to 1.");
+		boxmon_console_print("With -rewind snapshots being kept, the machine can also be stepped backwards:");
+		boxmon_console_print("  back [<count>]: Go back to the state <count> instructions ago.");
+		boxmon_console_print("  back over: Go back one instruction, skipping over subroutines and interrupts that have returned.");
+		return true;
+	}
+
+	if (int option; parser.parse_option(option, { "back" }, input)) {
+		if (!rewind_is_enabled()) {
+			boxmon_error_print("Rewind is disabled.");
+			return false;
+		}
+
+		bool rewound = false;
+		if (parser.parse_option(option, { "over" }, input)) {
+			rewound = rewind_step_back_over();
+		} else {
+			int count = 0;
+			(void)parser.parse_dec_number(count, input);
+			rewound = rewind_step_back(static_cast<uint32_t>(std::max(count, 1)));
+		}
+		if (!rewound) {
+			boxmon_error_print("Not found in the -rewind window.");
+			return false;
+		}
 		return true;
 	}
 
@@ -540,6 +1005,109 @@ BOXMON_COMMAND(next, "next [<count>]")
 	return true;
 }
 
+BOXMON_COMMAND(profile, "profile [on|off|clear] | report [<count>] | save <file> | flame <file>")
+{
+	if (help) {
+		boxmon_console_print("Profile where the CPU spends its cycles, by function and by instruction.");
+		boxmon_console_print("With no arguments, show whether the profiler is running and how many cycles it has seen.");
+		boxmon_console_print("  on: Start profiling. Cycles accumulate until cleared.");
+		boxmon_console_print("  off: Stop profiling.");
+		boxmon_console_print("  clear: Discard the profile gathered so far.");
+		boxmon_console_print("  report [<count>]: Show the top <count> functions by self and inclusive cycles, and the hottest instructions. <count> defaults to 16.");
+		boxmon_console_print("  save <file>: Write the full report to <file>.");
+		boxmon_console_print("  flame <file>: Write the call stacks to <file> in the collapsed format used by flamegraph.pl.");
+		return true;
+	}
+
+	int option = 0;
+	if (!parser.parse_option(option, { "on", "off", "clear", "report", "save", "flame" }, input)) {
+		boxmon_console_print("Profiler is {}, {} cycles profiled.", profiler_is_running() ? "on" : "off", profiler_total_cycles());
+		return true;
+	}
+
+	switch (option) {
+		case 0:
+			profiler_start();
+			break;
+		case 1:
+			profiler_stop();
+			break;
+		case 2:
+			profiler_clear();
+			break;
+		case 3: {
+			int count = 0;
+			if (!parser.parse_dec_number(count, input) || count <= 0) {
+				count = 16;
+			}
+			for (const auto &line : profiler_report(count)) {
+				boxmon_console_print("{}", line);
+			}
+			break;
+		}
+		default: {
+			std::string path;
+			if (!parser.parse_string(path, input)) {
+				return false;
+			}
+			const bool saved = option == 4 ? profiler_save_report(path) : profiler_save_collapsed(path);
+			if (!saved) {
+				boxmon_error_print("Could not write to {}", path);
+				return false;
+			}
+			break;
+		}
+	}
+	return true;
+}
+
+BOXMON_COMMAND(raster, "raster [on|off|clear] | csv <file> [<frames>]")
+{
+	if (help) {
+		boxmon_console_print("Record how the CPU's cycles fall across the scanlines of each frame.");
+		boxmon_console_print("With no arguments, show whether the timeline is recording and how many frames it holds.");
+		boxmon_console_print("  on: Start recording. The last {} frames are kept.", Raster_timeline_frames);
+		boxmon_console_print("  off: Stop recording.");
+		boxmon_console_print("  clear: Discard the recorded frames.");
+		boxmon_console_print("  csv <file> [<frames>]: Write the last <frames> frames to <file>, one row per scanline. <frames> defaults to 1.");
+		return true;
+	}
+
+	int option = 0;
+	if (!parser.parse_option(option, { "on", "off", "clear", "csv" }, input)) {
+		boxmon_console_print("Raster timeline is {}, {} frames recorded.", Raster_timeline_enabled ? "on" : "off", raster_timeline_frame_count());
+		return true;
+	}
+
+	switch (option) {
+		case 0:
+			raster_timeline_start();
+			break;
+		case 1:
+			raster_timeline_stop();
+			break;
+		case 2:
+			raster_timeline_clear();
+			break;
+		default: {
+			std::string path;
+			if (!parser.parse_string(path, input)) {
+				return false;
+			}
+			int frames = 0;
+			if (!parser.parse_dec_number(frames, input) || frames <= 0) {
+				frames = 1;
+			}
+			if (!raster_timeline_save_csv(path, frames)) {
+				boxmon_error_print("Could not write to {}", path);
+				return false;
+			}
+			break;
+		}
+	}
+	return true;
+}
+
 // TODO: registers
 // bool parse_registers(char const *&input);
 
@@ -566,6 +1134,87 @@ BOXMON_COMMAND(return, "return")
 	return true;
 }
 
+BOXMON_COMMAND(reverse, "reverse")
+{
+	if (help) {
+		boxmon_console_print("Go back to the last time execution reached a breakpoint, within the -rewind window.");
+		return true;
+	}
+
+	if (!rewind_is_enabled()) {
+		boxmon_error_print("Rewind is disabled.");
+		return false;
+	}
+	if (!rewind_continue_back()) {
+		boxmon_error_print("No breakpoint was reached in the -rewind window.");
+		return false;
+	}
+	return true;
+}
+
+BOXMON_ALIAS(rc, reverse);
+
+BOXMON_COMMAND(sdcard, "sdcard [flush | discard | save <file> | merge]")
+{
+	if (help) {
+		boxmon_console_print("Manage the SD card image and its copy-on-write overlay (-sdcard_overlay).");
+		boxmon_console_print("With no arguments, show how the image is accessed and how many sectors have been read and written.");
+		boxmon_console_print("  flush: Write changed sectors to the image, or to the overlay's delta file.");
+		boxmon_console_print("  discard: Forget everything written to the overlay.");
+		boxmon_console_print("  save <file>: Write the overlay to a new delta file.");
+		boxmon_console_print("  merge: Write the overlay's sectors to the image itself, then empty the overlay.");
+		return true;
+	}
+
+	if (!sdcard_is_attached()) {
+		boxmon_error_print("No SD card is attached.");
+		return false;
+	}
+
+	int option = 0;
+	if (!parser.parse_option(option, { "flush", "discard", "save", "merge" }, input)) {
+		const sdcard_stats &stats = sdcard_get_stats();
+		boxmon_console_print("SD card is {}, {} sectors read, {} written, {} flushes.", sdcard_get_backend_name(), stats.sectors_read, stats.sectors_written, stats.flushes);
+		if (sdcard_has_overlay()) {
+			boxmon_console_print("Overlay holds {} sectors.", sdcard_overlay_sector_count());
+		}
+		return true;
+	}
+
+	if (option == 0) {
+		sdcard_flush();
+		return true;
+	}
+	if (!sdcard_has_overlay()) {
+		boxmon_error_print("The SD card has no overlay.");
+		return false;
+	}
+
+	switch (option) {
+		case 1:
+			sdcard_overlay_discard();
+			break;
+		case 2: {
+			std::string path;
+			if (!parser.parse_string(path, input)) {
+				return false;
+			}
+			if (!sdcard_overlay_save(path)) {
+				boxmon_error_print("Could not write to {}", path);
+				return false;
+			}
+			break;
+		}
+		default:
+			if (!sdcard_merge_overlay()) {
+				boxmon_error_print("Could not merge the overlay into the image.");
+				return false;
+			}
+			break;
+	}
+	return true;
+}
+
 BOXMON_ALIAS(step, next);
 
 BOXMON_COMMAND(stopwatch, "stopwatch")
@@ -81,6 +81,12 @@ namespace boxmon
 		return m_value;
 	}
 
+	bool value_expression::compile(expression_program &program) const
+	{
+		program.emit(expression_opcode::push_value, m_value);
+		return true;
+	}
+
 // TODO: I'm lazy right now and this probably should be put in a separate header file to share with the CPU implementation.
 // But... since this is only happening in this file and the CPU implementation...
 
@@ -93,25 +99,48 @@ namespace boxmon
 #define FLAG_OVERFLOW 0x40
 #define FLAG_SIGN 0x80
 
-	std::set<std::string> symbol_expression::s_cpu_symbols = {
-		".a",	// Accumulator
-		".x",   // Index register X
-		".y",   // Index register Y
-		".pc",  // Program Counter
-		".sp",  // Stack Pointer
-		".p",	// Processor status
-		".pcl", // Program Counter Low byte
-		".pch", // Program Counter High byte
-		".k",   // PC bank
-		"_n",   // Negative flag
-		"_c",   // Carry flag
-		"_z",   // Zero flag
-		"_i",   // Interrupt flag
-		"_b",   // Break flag
-		"_v",   // Overflow flag
-		"_d",   // Decimal flag
+	std::map<std::string, cpu_register> symbol_expression::s_cpu_symbols = {
+		{ ".a", cpu_register::a },        // Accumulator
+		{ ".x", cpu_register::x },        // Index register X
+		{ ".y", cpu_register::y },        // Index register Y
+		{ ".pc", cpu_register::pc },      // Program Counter
+		{ ".sp", cpu_register::sp },      // Stack Pointer
+		{ ".p", cpu_register::p },        // Processor status
+		{ ".pcl", cpu_register::pcl },    // Program Counter Low byte
+		{ ".pch", cpu_register::pch },    // Program Counter High byte
+		{ ".k", cpu_register::k },        // PC bank
+		{ "_n", cpu_register::flag_n },   // Negative flag
+		{ "_c", cpu_register::flag_c },   // Carry flag
+		{ "_z", cpu_register::flag_z },   // Zero flag
+		{ "_i", cpu_register::flag_i },   // Interrupt flag
+		{ "_b", cpu_register::flag_b },   // Break flag
+		{ "_v", cpu_register::flag_v },   // Overflow flag
+		{ "_d", cpu_register::flag_d },   // Decimal flag
 	};
 
+	int read_cpu_register(cpu_register reg)
+	{
+		switch (reg) {
+			case cpu_register::a: return state6502.a;
+			case cpu_register::x: return state6502.x;
+			case cpu_register::y: return state6502.y;
+			case cpu_register::pc: return state6502.pc;
+			case cpu_register::sp: return state6502.sp;
+			case cpu_register::p: return state6502.status;
+			case cpu_register::pcl: return state6502.pc & 0xff;
+			case cpu_register::pch: return (state6502.pc >> 8) & 0xff;
+			case cpu_register::k: return bank6502(state6502.pc);
+			case cpu_register::flag_n: return (state6502.status & FLAG_SIGN) ? 1 : 0;
+			case cpu_register::flag_c: return (state6502.status & FLAG_CARRY) ? 1 : 0;
+			case cpu_register::flag_z: return (state6502.status & FLAG_ZERO) ? 1 : 0;
+			case cpu_register::flag_i: return (state6502.status & FLAG_INTERRUPT) ? 1 : 0;
+			case cpu_register::flag_b: return (state6502.status & FLAG_BREAK) ? 1 : 0;
+			case cpu_register::flag_v: return (state6502.status & FLAG_OVERFLOW) ? 1 : 0;
+			case cpu_register::flag_d: return (state6502.status & FLAG_DECIMAL) ? 1 : 0;
+		}
+		return 0;
+	}
+
 	symbol_expression::symbol_expression(const std::string &symbol)
 	    : expression_base(expression_type::symbol),
 	      m_symbol(symbol)
@@ -125,80 +154,33 @@ namespace boxmon
 	int symbol_expression::evaluate() const
 	{
 		if (const auto &cpu_symbol = s_cpu_symbols.find(m_symbol); cpu_symbol != s_cpu_symbols.end()) {
-			if (m_symbol[0] == '.') {
-				switch (m_symbol[1]) {
-					case 'a': // .a
-						return state6502.a;
-					case 'x': // .x
-						return state6502.x;
-					case 'y': // .y
-						return state6502.y;
-					case 'p': // .p, .pc, .pcl, or .pch
-						if (m_symbol.length() > 2) {
-							switch (m_symbol[2]) {
-								case 'c': // .pc
-									if (m_symbol.length() > 3) {
-										switch (m_symbol[3]) {
-											case 'l': // .pcl
-												return state6502.pc & 0xff;
-											case 'h': // .pch
-												return (state6502.pc >> 8) & 0xff;
-											default:
-												break;
-										}
-									} else {
-										return state6502.pc;
-									}
-								default:
-									break;
-							}
-						} else {
-							return state6502.status;
-						}
-						break;
-					case 's': // .sp
-						return state6502.sp;
-					case 'k': // .k
-						return bank6502(state6502.pc);
-					default:
-						break;
-				}
-			} else if (m_symbol[0] == '_') {
-				switch (m_symbol[1]) {
-					case 'n': // .n
-						return (state6502.status & FLAG_SIGN) ? 1 : 0;
-					case 'c': // .c
-						return (state6502.status & FLAG_CARRY) ? 1 : 0;
-					case 'z': // .z
-						return (state6502.status & FLAG_ZERO) ? 1 : 0;
-					case 'i': // .i
-						return (state6502.status & FLAG_INTERRUPT) ? 1 : 0;
-					case 'b': // .b
-						return (state6502.status & FLAG_BREAK) ? 1 : 0;
-					case 'v': // .v
-						return (state6502.status & FLAG_OVERFLOW) ? 1 : 0;
-					case 'd': // .d
-						return (state6502.status & FLAG_DECIMAL) ? 1 : 0;
-					default:
-						break;
-				}
-			}
+			return read_cpu_register(cpu_symbol->second);
 		}
 
-		auto &namelist = symbols_find(m_symbol);
+		const auto namelist = symbols_find(m_symbol);
 		if (namelist.empty()) {
 			return 0;
 		}
 		return namelist.front();
 	}
 
+	bool symbol_expression::compile(expression_program &program) const
+	{
+		if (const auto &cpu_symbol = s_cpu_symbols.find(m_symbol); cpu_symbol != s_cpu_symbols.end()) {
+			program.emit(expression_opcode::push_register, static_cast<int>(cpu_symbol->second));
+		} else {
+			program.emit_symbol(m_symbol);
+		}
+		return true;
+	}
+
 	bool symbol_expression::is_valid() const
 	{
 		if (const auto &cpu_symbol = s_cpu_symbols.find(m_symbol); cpu_symbol != s_cpu_symbols.end()) {
 			return true;
 		}
 
-		auto &namelist = symbols_find(m_symbol);
+		const auto namelist = symbols_find(m_symbol);
 		return !namelist.empty();
 	}
 
@@ -233,6 +215,21 @@ namespace boxmon
 		return 0;
 	}
 
+	bool unary_expression::compile(expression_program &program) const
+	{
+		if (!m_param->compile(program)) {
+			return false;
+		}
+		switch (get_type()) {
+			case expression_type::dereference: program.emit(expression_opcode::dereference); break;
+			case expression_type::negate: program.emit(expression_opcode::negate); break;
+			case expression_type::bit_not: program.emit(expression_opcode::bit_not); break;
+			case expression_type::logical_not: program.emit(expression_opcode::logical_not); break;
+			default: return false;
+		}
+		return true;
+	}
+
 	binary_expression::binary_expression(expression_type type, const expression_base *lhs, const expression_base *rhs)
 	    : expression_base(type),
 	      m_lhs(lhs),
@@ -255,10 +252,14 @@ namespace boxmon
 				return m_lhs->evaluate() - m_rhs->evaluate();
 			case expression_type::multiply:
 				return m_lhs->evaluate() * m_rhs->evaluate();
-			case expression_type::divide:
-				return m_lhs->evaluate() / m_rhs->evaluate();
-			case expression_type::modulo:
-				return m_lhs->evaluate() % m_rhs->evaluate();
+			case expression_type::divide: {
+				const int rhs = m_rhs->evaluate();
+				return (rhs != 0) ? m_lhs->evaluate() / rhs : 0;
+			}
+			case expression_type::modulo: {
+				const int rhs = m_rhs->evaluate();
+				return (rhs != 0) ? m_lhs->evaluate() % rhs : 0;
+			}
 			case expression_type::pow: {
 				const int lhs    = m_lhs->evaluate();
 				const int rhs    = m_rhs->evaluate();
@@ -299,4 +300,202 @@ namespace boxmon
 		}
 		return 0;
 	}
-} // namespace boxmon
\ No newline at end of file
+
+	bool binary_expression::compile(expression_program &program) const
+	{
+		static const std::map<expression_type, expression_opcode> opcodes = {
+			{ expression_type::addition, expression_opcode::addition },
+			{ expression_type::subtraction, expression_opcode::subtraction },
+			{ expression_type::multiply, expression_opcode::multiply },
+			{ expression_type::divide, expression_opcode::divide },
+			{ expression_type::modulo, expression_opcode::modulo },
+			{ expression_type::pow, expression_opcode::pow },
+			{ expression_type::bit_and, expression_opcode::bit_and },
+			{ expression_type::bit_or, expression_opcode::bit_or },
+			{ expression_type::bit_xor, expression_opcode::bit_xor },
+			{ expression_type::left_shift, expression_opcode::left_shift },
+			{ expression_type::right_shift, expression_opcode::right_shift },
+			{ expression_type::equal, expression_opcode::equal },
+			{ expression_type::not_equal, expression_opcode::not_equal },
+			{ expression_type::lt, expression_opcode::lt },
+			{ expression_type::gt, expression_opcode::gt },
+			{ expression_type::lte, expression_opcode::lte },
+			{ expression_type::gte, expression_opcode::gte },
+		};
+
+		if (!m_lhs->compile(program)) {
+			return false;
+		}
+
+		// Logical operators short-circuit, like evaluate() does.
+		if (get_type() == expression_type::logical_and || get_type() == expression_type::logical_or) {
+			const size_t jump = program.emit(get_type() == expression_type::logical_and ? expression_opcode::jump_if_false : expression_opcode::jump_if_true);
+			if (!m_rhs->compile(program)) {
+				return false;
+			}
+			program.emit(expression_opcode::to_bool);
+			program.patch(jump, (int)program.size());
+			return true;
+		}
+
+		const auto op = opcodes.find(get_type());
+		if (op == opcodes.end() || !m_rhs->compile(program)) {
+			return false;
+		}
+		program.emit(op->second);
+		return true;
+	}
+
+	//
+	// Compiled expression
+	//
+
+	void expression_program::clear()
+	{
+		m_code.clear();
+		m_symbols.clear();
+		m_stack.clear();
+		m_depth = 0;
+	}
+
+	size_t expression_program::emit(expression_opcode op, int operand)
+	{
+		switch (op) {
+			case expression_opcode::push_value:
+			case expression_opcode::push_symbol:
+			case expression_opcode::push_register:
+				++m_depth;
+				break;
+			case expression_opcode::dereference:
+			case expression_opcode::negate:
+			case expression_opcode::bit_not:
+			case expression_opcode::logical_not:
+			case expression_opcode::to_bool:
+				break;
+			default:
+				// Binary operators, and the fall-through path of the jumps, pop one value.
+				--m_depth;
+				break;
+		}
+		if ((size_t)m_depth > m_stack.size()) {
+			m_stack.resize(m_depth);
+		}
+
+		m_code.push_back({ op, operand });
+		return m_code.size() - 1;
+	}
+
+	void expression_program::emit_symbol(const std::string &symbol)
+	{
+		m_symbols.push_back({ emit(expression_opcode::push_symbol), symbol });
+		resolve_symbols();
+	}
+
+	void expression_program::patch(size_t index, int operand)
+	{
+		m_code[index].operand = operand;
+	}
+
+	size_t expression_program::size() const
+	{
+		return m_code.size();
+	}
+
+	void expression_program::resolve_symbols()
+	{
+		for (const auto &[index, symbol] : m_symbols) {
+			const auto namelist    = symbols_find(symbol);
+			m_code[index].operand = namelist.empty() ? 0 : namelist.front();
+		}
+	}
+
+	int expression_program::evaluate() const
+	{
+		if (m_code.empty()) {
+			return 0;
+		}
+
+		int *const bottom = m_stack.data();
+		int       *top    = bottom - 1;
+
+		const expression_instruction *const code = m_code.data();
+		const size_t                        end  = m_code.size();
+		for (size_t pc = 0; pc < end; ++pc) {
+			const expression_instruction &inst = code[pc];
+			switch (inst.op) {
+				case expression_opcode::push_value:
+				case expression_opcode::push_symbol:
+					*++top = inst.operand;
+					break;
+				case expression_opcode::push_register:
+					*++top = read_cpu_register(static_cast<cpu_register>(inst.operand));
+					break;
+
+				case expression_opcode::dereference:
+					*top = debug_read6502(*top & 0xffff, (*top >> 16) & 0xff);
+					break;
+				case expression_opcode::negate:
+					*top = -*top;
+					break;
+				case expression_opcode::bit_not:
+					*top = ~*top;
+					break;
+				case expression_opcode::logical_not:
+					*top = (*top == 0) ? 1 : 0;
+					break;
+				case expression_opcode::to_bool:
+					*top = (*top != 0) ? 1 : 0;
+					break;
+
+				case expression_opcode::jump_if_false:
+					if (*top == 0) {
+						pc = inst.operand - 1;
+					} else {
+						--top;
+					}
+					break;
+				case expression_opcode::jump_if_true:
+					if (*top != 0) {
+						*top = 1;
+						pc   = inst.operand - 1;
+					} else {
+						--top;
+					}
+					break;
+
+				default: {
+					const int rhs = *top--;
+					int      &lhs = *top;
+					switch (inst.op) {
+						case expression_opcode::addition: lhs = lhs + rhs; break;
+						case expression_opcode::subtraction: lhs = lhs - rhs; break;
+						case expression_opcode::multiply: lhs = lhs * rhs; break;
+						case expression_opcode::divide: lhs = (rhs != 0) ? lhs / rhs : 0; break;
+						case expression_opcode::modulo: lhs = (rhs != 0) ? lhs % rhs : 0; break;
+						case expression_opcode::pow: {
+							int result = 1;
+							for (int i = 1; i < rhs; ++i) {
+								result *= lhs;
+							}
+							lhs = result;
+						} break;
+						case expression_opcode::bit_and: lhs = lhs & rhs; break;
+						case expression_opcode::bit_or: lhs = lhs | rhs; break;
+						case expression_opcode::bit_xor: lhs = lhs ^ rhs; break;
+						case expression_opcode::left_shift: lhs = lhs << rhs; break;
+						case expression_opcode::right_shift: lhs = lhs >> rhs; break;
+						case expression_opcode::equal: lhs = lhs == rhs; break;
+						case expression_opcode::not_equal: lhs = lhs != rhs; break;
+						case expression_opcode::lt: lhs = lhs < rhs; break;
+						case expression_opcode::gt: lhs = lhs > rhs; break;
+						case expression_opcode::lte: lhs = lhs <= rhs; break;
+						case expression_opcode::gte: lhs = lhs >= rhs; break;
+						default: break;
+					}
+				} break;
+			}
+		}
+
+		return *top;
+	}
+} // namespace boxmon
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <map>
 #include <string>
-#include <set>
+#include <tuple>
+#include <vector>
 
 namespace boxmon
 {
@@ -59,6 +61,92 @@ namespace boxmon
 
 	const expression_type_info &get_expression_type_info(expression_type type);
 
+	enum class cpu_register : uint8_t {
+		a,
+		x,
+		y,
+		pc,
+		sp,
+		p,
+		pcl,
+		pch,
+		k,
+		flag_n,
+		flag_c,
+		flag_z,
+		flag_i,
+		flag_b,
+		flag_v,
+		flag_d,
+	};
+
+	int read_cpu_register(cpu_register reg);
+
+	//
+	// Compiled expression
+	//
+	// A flat stack-machine program, so that hot paths such as breakpoint conditions
+	// don't have to walk the expression tree or look up names on every evaluation.
+	//
+
+	enum class expression_opcode : uint8_t {
+		push_value,    // operand: value
+		push_symbol,   // operand: resolved address, see resolve_symbols()
+		push_register, // operand: cpu_register
+
+		dereference,
+		negate,
+		bit_not,
+		logical_not,
+
+		addition,
+		subtraction,
+		multiply,
+		divide,
+		modulo,
+		pow,
+		bit_and,
+		bit_or,
+		bit_xor,
+		left_shift,
+		right_shift,
+		equal,
+		not_equal,
+		lt,
+		gt,
+		lte,
+		gte,
+
+		jump_if_false, // operand: target. Leaves 0 and jumps if the top is zero, otherwise pops it.
+		jump_if_true,  // operand: target. Leaves 1 and jumps if the top is non-zero, otherwise pops it.
+		to_bool,
+	};
+
+	struct expression_instruction {
+		expression_opcode op;
+		int               operand;
+	};
+
+	class expression_program
+	{
+	public:
+		void   clear();
+		size_t emit(expression_opcode op, int operand = 0);
+		void   emit_symbol(const std::string &symbol);
+		void   patch(size_t index, int operand);
+		size_t size() const;
+
+		// Look up the current address of every symbol the program refers to.
+		void resolve_symbols();
+		int  evaluate() const;
+
+	private:
+		std::vector<expression_instruction>          m_code;
+		std::vector<std::tuple<size_t, std::string>> m_symbols;
+		mutable std::vector<int>                     m_stack;
+		int                                          m_depth = 0;
+	};
+
 	//
 	// Expression
 	//
@@ -68,7 +156,8 @@ namespace boxmon
 	public:
 		expression_base(expression_type type);
 		virtual ~expression_base();
-		virtual int     evaluate() const = 0;
+		virtual int     evaluate() const                           = 0;
+		virtual bool    compile(expression_program &program) const = 0;
 		expression_type get_type() const;
 
 	private:
@@ -81,7 +170,8 @@ namespace boxmon
 	public:
 		value_expression(const int &value);
 		virtual ~value_expression() override;
-		virtual int evaluate() const override;
+		virtual int  evaluate() const override;
+		virtual bool compile(expression_program &program) const override;
 
 	private:
 		int m_value;
@@ -92,14 +182,15 @@ namespace boxmon
 	public:
 		symbol_expression(const std::string &symbol);
 		virtual ~symbol_expression() override;
-		virtual int evaluate() const override;
+		virtual int  evaluate() const override;
+		virtual bool compile(expression_program &program) const override;
 
 		bool is_valid() const;
 
 	private:
 		std::string m_symbol;
 
-		static std::set<std::string> s_cpu_symbols;
+		static std::map<std::string, cpu_register> s_cpu_symbols;
 	};
 
 	class unary_expression final : public expression_base
@@ -107,7 +198,8 @@ namespace boxmon
 	public:
 		unary_expression(expression_type type, const expression_base *param);
 		virtual ~unary_expression() override;
-		virtual int evaluate() const override;
+		virtual int  evaluate() const override;
+		virtual bool compile(expression_program &program) const override;
 
 	private:
 		const expression_base *m_param;
@@ -118,7 +210,8 @@ namespace boxmon
 	public:
 		binary_expression(expression_type type, const expression_base *lhs, const expression_base *rhs);
 		virtual ~binary_expression() override;
-		virtual int evaluate() const override;
+		virtual int  evaluate() const override;
+		virtual bool compile(expression_program &program) const override;
 
 	private:
 		const expression_base *m_lhs;
@@ -33,6 +33,12 @@ namespace boxmon
 			return m_expression->evaluate();
 		}
 
+		virtual bool compile(expression_program &program) const override
+		{
+			program.clear();
+			return m_expression->compile(program);
+		}
+
 	private:
 		const std::string                m_string;
 		const boxmon::expression_base *m_expression;
@@ -21,14 +21,17 @@ namespace boxmon
 
 	using address_type = std::tuple<uint16_t, uint8_t>;
 
+	class expression_program;
+
 	class expression
 	{
 	public:
 		virtual ~expression()
 		{
 		}
-		virtual const std::string &get_string() const = 0;
-		virtual int                evaluate() const   = 0;
+		virtual const std::string &get_string() const                         = 0;
+		virtual int                evaluate() const                           = 0;
+		virtual bool               compile(expression_program &program) const = 0;
 	};
 
 	enum expression_parse_flags_ {
@@ -0,0 +1,15 @@
+#include "call_tracker.h"
+
+#include "fmt/format.h"
+#include "symbols.h"
+
+std::string call_tracker_function_name(uint32_t function)
+{
+	const uint16_t address = function & 0xffff;
+	const uint8_t  bank    = function >> 16;
+	const auto    &symbols = symbols_find(address, bank);
+	if (!symbols.empty()) {
+		return symbols.front();
+	}
+	return address < 0xa000 ? fmt::format("${:04X}", address) : fmt::format("${:02X}:{:04X}", bank, address);
+}
@@ -0,0 +1,105 @@
+#pragma once
+#if !defined(CALL_TRACKER_H)
+#	define CALL_TRACKER_H
+
+#	include <stdint.h>
+#	include <string>
+#	include <vector>
+
+//
+// Call tracking
+//
+// Shared by the profilers, which follow the calls and interrupts active on the CPU with a shadow
+// stack of stack pointers: an entry is pushed just after a JSR, BRK, IRQ or NMI has pushed its
+// return state, and popped once that has been pulled off the stack again, whichever instruction
+// pulled it. Unlike the CPU's smart stack, this isn't thrown off by code that returns some other
+// way than RTS or RTI.
+//
+
+// Offset of a banked address in the flat space of $A000 bytes plus $6000 per bank that the
+// debugger, profiler and coverage maps use. Only addresses from $A000 up are banked.
+inline uint32_t banked_offset(uint16_t address, uint8_t bank)
+{
+	return address >= 0xa000 ? address + bank * 0x6000 : address;
+}
+
+inline uint16_t banked_address(uint32_t offset, uint8_t &bank)
+{
+	bank = offset < 0xa000 ? 0 : static_cast<uint8_t>((offset - 0xa000) / 0x6000);
+	return static_cast<uint16_t>(offset - bank * 0x6000);
+}
+
+// Functions are identified by bank << 16 | address, with no bank below $A000.
+inline uint32_t call_tracker_function_id(uint16_t address, uint8_t bank)
+{
+	return address < 0xa000 ? address : ((uint32_t)bank << 16) | address;
+}
+
+// The first symbol for a function id, or its address if it has none.
+std::string call_tracker_function_name(uint32_t function);
+
+struct call_tracker_no_data {
+};
+
+// Each entry carries a T for its owner's bookkeeping.
+template <typename T = call_tracker_no_data>
+class call_tracker
+{
+public:
+	// Every call pushes at least two bytes, so more than 128 entries only build up when returns
+	// were missed, for instance because the stack pointer was reset with TXS. The limit just keeps
+	// the stack from growing without bound when that happens.
+	static constexpr size_t Max_depth = 256;
+
+	struct frame {
+		uint8_t sp; // stack pointer just after the call pushed its return state
+		T       data;
+	};
+
+	// Push an entry for a call whose return state was just pushed, leaving 'sp' below it. Returns
+	// false if the stack is already as deep as it can get.
+	bool enter(uint8_t sp, const T &data = T())
+	{
+		if (m_frames.size() >= Max_depth) {
+			return false;
+		}
+		m_frames.push_back({ sp, data });
+		return true;
+	}
+
+	// Pop every call whose return state has been pulled off the stack, innermost first, handing
+	// each to 'on_return' before it goes.
+	template <typename F>
+	void update(uint8_t sp, F &&on_return)
+	{
+		while (!m_frames.empty() && sp > m_frames.back().sp) {
+			on_return(m_frames.back());
+			m_frames.pop_back();
+		}
+	}
+
+	void update(uint8_t sp)
+	{
+		update(sp, [](const frame &) {});
+	}
+
+	void clear()
+	{
+		m_frames.clear();
+	}
+
+	bool empty() const
+	{
+		return m_frames.empty();
+	}
+
+	size_t depth() const
+	{
+		return m_frames.size();
+	}
+
+private:
+	std::vector<frame> m_frames;
+};
+
+#endif
@@ -0,0 +1,394 @@
+#include "coverage.h"
+
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+
+#include "fmt/format.h"
+#include "memory.h"
+#include "symbols.h"
+#include "zlib.h"
+
+uint8_t *Coverage_map = nullptr;
+
+static constexpr uint32_t Coverage_space_size = 0xa000 + 0x6000 * NUM_MAX_RAM_BANKS;
+
+// Collected coverage is kept when collection stops, so it can still be saved or exported.
+static std::unique_ptr<uint8_t[]> Coverage_data;
+
+static constexpr uint32_t Coverage_magic      = 0x56435842; // "BXCV"
+static constexpr uint32_t Coverage_version    = 1;
+static constexpr uint32_t Coverage_block_size = 256;
+
+static void allocate_map()
+{
+	if (!Coverage_data) {
+		Coverage_data = std::make_unique<uint8_t[]>(Coverage_space_size);
+	}
+}
+
+void coverage_start()
+{
+	allocate_map();
+	Coverage_map = Coverage_data.get();
+}
+
+void coverage_stop()
+{
+	Coverage_map = nullptr;
+}
+
+void coverage_clear()
+{
+	if (Coverage_data) {
+		memset(Coverage_data.get(), 0, Coverage_space_size);
+	}
+}
+
+uint8_t coverage_get(uint16_t address, uint8_t bank)
+{
+	return Coverage_data ? Coverage_data[coverage_offset(address, bank)] : 0;
+}
+
+uint32_t coverage_count()
+{
+	uint32_t count = 0;
+	if (Coverage_data) {
+		for (uint32_t i = 0; i < Coverage_space_size; ++i) {
+			count += Coverage_data[i] & COVERAGE_EXECUTED;
+		}
+	}
+	return count;
+}
+
+bool coverage_save(const std::filesystem::path &path)
+{
+	gzFile file = gzopen(path.generic_string().c_str(), "wb6");
+	if (file == Z_NULL) {
+		return false;
+	}
+
+	const uint32_t header[3] = { Coverage_magic, Coverage_version, Coverage_block_size };
+	bool           ok        = gzwrite(file, header, sizeof(header)) == sizeof(header);
+
+	static const uint8_t empty[Coverage_block_size] = {};
+	for (uint32_t block = 0; ok && Coverage_data && block < Coverage_space_size / Coverage_block_size; ++block) {
+		const uint8_t *data = &Coverage_data[block * Coverage_block_size];
+		if (memcmp(data, empty, Coverage_block_size) != 0) {
+			ok = gzwrite(file, &block, sizeof(block)) == sizeof(block) && gzwrite(file, data, Coverage_block_size) == Coverage_block_size;
+		}
+	}
+
+	return gzclose(file) == Z_OK && ok;
+}
+
+bool coverage_merge(const std::filesystem::path &path)
+{
+	gzFile file = gzopen(path.generic_string().c_str(), "rb");
+	if (file == Z_NULL) {
+		return false;
+	}
+
+	uint32_t header[3];
+	if (gzread(file, header, sizeof(header)) != sizeof(header) || header[0] != Coverage_magic || header[1] != Coverage_version || header[2] != Coverage_block_size) {
+		gzclose(file);
+		return false;
+	}
+
+	allocate_map();
+
+	bool     ok = true;
+	uint32_t block;
+	uint8_t  data[Coverage_block_size];
+	while (gzread(file, &block, sizeof(block)) == sizeof(block)) {
+		if (block >= Coverage_space_size / Coverage_block_size || gzread(file, data, Coverage_block_size) != Coverage_block_size) {
+			ok = false;
+			break;
+		}
+		uint8_t *dest = &Coverage_data[block * Coverage_block_size];
+		for (uint32_t i = 0; i < Coverage_block_size; ++i) {
+			dest[i] |= data[i];
+		}
+	}
+
+	gzclose(file);
+	return ok;
+}
+
+//
+// lcov export
+//
+
+struct lcov_line {
+	bool                 hit = false;
+	std::vector<uint8_t> branches;
+};
+
+struct lcov_function {
+	uint32_t    line;
+	std::string name;
+	bool        hit;
+};
+
+struct lcov_file {
+	std::map<uint32_t, lcov_line> lines;
+	std::vector<lcov_function>    functions;
+};
+
+static void add_address(lcov_line &line, uint16_t address, uint8_t bank)
+{
+	const uint8_t flags = coverage_get(address, bank);
+	if (flags & COVERAGE_EXECUTED) {
+		line.hit = true;
+	}
+	if (flags & COVERAGE_BRANCH) {
+		line.branches.push_back(flags);
+	}
+}
+
+static void write_lcov_file(std::ostream &out, const std::string &name, const lcov_file &file)
+{
+	out << "TN:\nSF:" << name << '\n';
+
+	uint32_t functions_hit = 0;
+	for (const auto &function : file.functions) {
+		out << "FN:" << function.line << ',' << function.name << '\n';
+	}
+	for (const auto &function : file.functions) {
+		out << "FNDA:" << (function.hit ? 1 : 0) << ',' << function.name << '\n';
+		functions_hit += function.hit;
+	}
+	out << "FNF:" << file.functions.size() << "\nFNH:" << functions_hit << '\n';
+
+	uint32_t branches       = 0;
+	uint32_t branches_taken = 0;
+	for (const auto &[number, line] : file.lines) {
+		for (size_t b = 0; b < line.branches.size(); ++b) {
+			const uint8_t flags = line.branches[b];
+			out << "BRDA:" << number << ',' << b << ",0," << ((flags & COVERAGE_TAKEN) ? 1 : 0) << '\n';
+			out << "BRDA:" << number << ',' << b << ",1," << ((flags & COVERAGE_NOT_TAKEN) ? 1 : 0) << '\n';
+			branches += 2;
+			branches_taken += ((flags & COVERAGE_TAKEN) ? 1 : 0) + ((flags & COVERAGE_NOT_TAKEN) ? 1 : 0);
+		}
+	}
+	out << "BRF:" << branches << "\nBRH:" << branches_taken << '\n';
+
+	uint32_t lines_hit = 0;
+	for (const auto &[number, line] : file.lines) {
+		out << "DA:" << number << ',' << (line.hit ? 1 : 0) << '\n';
+		lines_hit += line.hit;
+	}
+	out << "LF:" << file.lines.size() << "\nLH:" << lines_hit << "\nend_of_record\n";
+}
+
+// One line of a ca65 debug file: a record type followed by comma-separated key=value pairs.
+static bool parse_dbg_record(const std::string &text, std::string &type, std::unordered_map<std::string, std::string> &fields)
+{
+	fields.clear();
+
+	const size_t tab = text.find_first_of("\t ");
+	if (tab == std::string::npos) {
+		return false;
+	}
+	type = text.substr(0, tab);
+
+	size_t pos = tab + 1;
+	while (pos < text.size()) {
+		const size_t equals = text.find('=', pos);
+		if (equals == std::string::npos) {
+			break;
+		}
+		std::string key = text.substr(pos, equals - pos);
+		std::string value;
+		pos = equals + 1;
+		if (pos < text.size() && text[pos] == '"') {
+			const size_t quote = text.find('"', pos + 1);
+			value              = text.substr(pos + 1, quote - pos - 1);
+			pos                = (quote == std::string::npos) ? text.size() : quote + 1;
+		} else {
+			const size_t comma = text.find(',', pos);
+			value              = text.substr(pos, comma - pos);
+			pos                = (comma == std::string::npos) ? text.size() : comma;
+		}
+		if (pos < text.size() && text[pos] == ',') {
+			++pos;
+		}
+		fields.emplace(std::move(key), std::move(value));
+	}
+	return true;
+}
+
+static uint32_t dbg_number(const std::unordered_map<std::string, std::string> &fields, const char *key)
+{
+	const auto iter = fields.find(key);
+	return iter == fields.end() ? 0 : static_cast<uint32_t>(strtoul(iter->second.c_str(), nullptr, 0));
+}
+
+// Values such as "span=3+17+20" list several ids.
+static std::vector<uint32_t> dbg_ids(const std::unordered_map<std::string, std::string> &fields, const char *key)
+{
+	std::vector<uint32_t> ids;
+	const auto            iter = fields.find(key);
+	if (iter != fields.end()) {
+		std::istringstream list(iter->second);
+		std::string        id;
+		while (std::getline(list, id, '+')) {
+			ids.push_back(static_cast<uint32_t>(strtoul(id.c_str(), nullptr, 0)));
+		}
+	}
+	return ids;
+}
+
+static bool export_dbg(std::ostream &out, const std::filesystem::path &dbg_path, uint8_t bank)
+{
+	std::ifstream in(dbg_path);
+	if (!in) {
+		return false;
+	}
+
+	struct dbg_span {
+		uint32_t seg, start, size;
+	};
+	struct dbg_line {
+		uint32_t              file, line;
+		std::vector<uint32_t> spans;
+	};
+	struct dbg_sym {
+		std::string           name;
+		uint32_t              value;
+		std::vector<uint32_t> defined;
+	};
+
+	std::unordered_map<uint32_t, std::string> files;
+	std::unordered_map<uint32_t, uint32_t>    seg_starts;
+	std::unordered_map<uint32_t, dbg_span>    spans;
+	std::unordered_map<uint32_t, dbg_line>    lines;
+	std::unordered_map<uint32_t, dbg_sym>     syms;
+	std::vector<uint32_t>                     scope_syms;
+
+	std::string                                  text;
+	std::string                                  type;
+	std::unordered_map<std::string, std::string> fields;
+	while (std::getline(in, text)) {
+		if (!parse_dbg_record(text, type, fields)) {
+			continue;
+		}
+		const uint32_t id = dbg_number(fields, "id");
+		if (type == "file") {
+			files[id] = fields["name"];
+		} else if (type == "seg") {
+			seg_starts[id] = dbg_number(fields, "start");
+		} else if (type == "span") {
+			spans[id] = { dbg_number(fields, "seg"), dbg_number(fields, "start"), dbg_number(fields, "size") };
+		} else if (type == "line") {
+			if (fields.count("span")) {
+				lines[id] = { dbg_number(fields, "file"), dbg_number(fields, "line"), dbg_ids(fields, "span") };
+			}
+		} else if (type == "sym") {
+			if (fields["type"] == "lab") {
+				syms[id] = { fields["name"], dbg_number(fields, "val"), dbg_ids(fields, "def") };
+			}
+		} else if (type == "scope") {
+			// Named scopes with a label are .proc blocks, which make the best "functions".
+			if (fields.count("sym") && !fields["name"].empty()) {
+				scope_syms.push_back(dbg_number(fields, "sym"));
+			}
+		}
+	}
+
+	std::map<std::string, lcov_file> report;
+	for (const auto &[id, line] : lines) {
+		const auto file = files.find(line.file);
+		if (file == files.end()) {
+			continue;
+		}
+		lcov_line &entry = report[file->second].lines[line.line];
+		for (uint32_t span_id : line.spans) {
+			const auto span = spans.find(span_id);
+			if (span == spans.end()) {
+				continue;
+			}
+			const uint32_t start = seg_starts[span->second.seg] + span->second.start;
+			for (uint32_t address = start; address < start + span->second.size && address < 0x10000; ++address) {
+				add_address(entry, static_cast<uint16_t>(address), bank);
+			}
+		}
+	}
+
+	for (uint32_t sym_id : scope_syms) {
+		const auto sym = syms.find(sym_id);
+		if (sym == syms.end() || sym->second.defined.empty()) {
+			continue;
+		}
+		const auto line = lines.find(sym->second.defined.front());
+		if (line == lines.end() || !files.count(line->second.file)) {
+			continue;
+		}
+		const bool hit = sym->second.value < 0x10000 && (coverage_get(static_cast<uint16_t>(sym->second.value), bank) & COVERAGE_EXECUTED);
+		report[files[line->second.file]].functions.push_back({ line->second.line, sym->second.name, hit });
+	}
+
+	for (const auto &[name, file] : report) {
+		write_lcov_file(out, name, file);
+	}
+	return true;
+}
+
+// Without line info, each bank becomes a pseudo-file whose "lines" are the addresses executed.
+static void export_banks(std::ostream &out)
+{
+	std::map<std::string, lcov_file> report;
+
+	const auto file_name = [](uint16_t address, uint8_t bank) {
+		if (address < 0xa000) {
+			return std::string("ram");
+		}
+		return fmt::format("{}_bank_{:02x}", address < 0xc000 ? "ram" : "rom", bank);
+	};
+
+	for (uint32_t offset = 0; offset < Coverage_space_size; ++offset) {
+		const uint8_t flags = Coverage_data[offset];
+		if (!(flags & COVERAGE_EXECUTED)) {
+			continue;
+		}
+		uint8_t        bank;
+		const uint16_t address = banked_address(offset, bank);
+		add_address(report[file_name(address, bank)].lines[address], address, bank);
+	}
+
+	symbols_for_each([&](uint16_t address, symbol_bank_type bank, const std::string &name) {
+		const std::string file = file_name(address, bank);
+		if (const auto entry = report.find(file); entry != report.end()) {
+			entry->second.functions.push_back({ address, name, (coverage_get(address, bank) & COVERAGE_EXECUTED) != 0 });
+		}
+	});
+
+	for (const auto &[name, file] : report) {
+		write_lcov_file(out, name, file);
+	}
+}
+
+bool coverage_export_lcov(const std::filesystem::path &path, const std::filesystem::path &dbg_path, uint8_t bank)
+{
+	if (!Coverage_data) {
+		return false;
+	}
+
+	std::ofstream out(path);
+	if (!out) {
+		return false;
+	}
+
+	if (!dbg_path.empty()) {
+		if (!export_dbg(out, dbg_path, bank)) {
+			return false;
+		}
+	} else {
+		export_banks(out);
+	}
+	return out.good();
+}
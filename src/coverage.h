@@ -0,0 +1,76 @@
+#pragma once
+#if !defined(COVERAGE_H)
+#	define COVERAGE_H
+
+#	include <filesystem>
+#	include <stdint.h>
+
+#	include "call_tracker.h"
+#	include "glue.h"
+
+//
+// Code coverage
+//
+// While enabled, every (bank, address) an instruction is executed from gets its executed bit set,
+// and conditional branches also record whether they were taken, not taken, or both. The bits are
+// kept in one byte per address over the same banked space the debugger uses, so the CPU loop only
+// has to OR a byte.
+//
+// Coverage files hold the non-empty 256 byte blocks of that map, gzipped. Merging runs is a
+// bitwise OR, so loading several files into one session and saving again combines them.
+//
+
+enum coverage_flags : uint8_t {
+	COVERAGE_EXECUTED  = 0x01,
+	COVERAGE_BRANCH    = 0x02,
+	COVERAGE_TAKEN     = 0x04,
+	COVERAGE_NOT_TAKEN = 0x08,
+};
+
+// Null while coverage isn't being collected.
+extern uint8_t *Coverage_map;
+
+void coverage_start();
+void coverage_stop();
+void coverage_clear();
+
+inline bool coverage_is_running()
+{
+	return Coverage_map != nullptr;
+}
+
+inline uint32_t coverage_offset(uint16_t address, uint8_t bank)
+{
+	return banked_offset(address, bank);
+}
+
+// Called by the CPU core after each instruction, with the address and bank it executed from.
+inline void coverage_instruction(uint16_t pc, uint8_t bank, uint8_t opcode)
+{
+	uint8_t &flags = Coverage_map[coverage_offset(pc, bank)];
+	flags |= COVERAGE_EXECUTED;
+
+	// Bxx is xxx10000, BBRx/BBSx is xxxx1111 and three bytes long.
+	if ((opcode & 0x1f) == 0x10 || (opcode & 0x0f) == 0x0f) {
+		const uint16_t next = pc + ((opcode & 0x0f) == 0x0f ? 3 : 2);
+		flags |= COVERAGE_BRANCH | (state6502.pc != next ? COVERAGE_TAKEN : COVERAGE_NOT_TAKEN);
+	}
+}
+
+uint8_t coverage_get(uint16_t address, uint8_t bank);
+
+// Number of addresses executed from so far.
+uint32_t coverage_count();
+
+bool coverage_save(const std::filesystem::path &path);
+
+// OR the coverage in 'path' into the current coverage, starting collection if needed.
+bool coverage_merge(const std::filesystem::path &path);
+
+// Write an lcov tracefile. With a ca65 debug file (ld65 --dbgfile), lines of its sources are
+// reported, with the code it describes assumed to be in 'bank'. Without one, each bank is
+// reported as a pseudo-file whose line numbers are addresses, with functions from the loaded
+// symbols.
+bool coverage_export_lcov(const std::filesystem::path &path, const std::filesystem::path &dbg_path = {}, uint8_t bank = 0);
+
+#endif
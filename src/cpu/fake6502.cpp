@@ -66,7 +66,13 @@
 
 #include "fake6502.h"
 
+#include "../coverage.h"
+#include "../cpu_history.h"
 #include "../debugger.h"
+#include "../irq_stats.h"
+#include "../profiler.h"
+#include "../raster_timeline.h"
+#include "../snapshot.h"
 #include <functional>
 #include <ring_buffer.h>
 #include <stdint.h>
@@ -97,6 +103,10 @@ uint8_t  debug6502 = 0;
 uint8_t penaltyop, penaltyaddr;
 uint8_t waiting = 0;
 
+// Cycles to idle for before the next instruction, charged for work done natively on the CPU's
+// behalf. They're used up a few at a time so the rest of the machine keeps pace.
+uint32_t stall6502 = 0;
+
 lazy_ring_buffer<_smart_stack, 512>       stack6502;
 ring_buffer<_cpuhistory, 1024>            history6502;
 ring_buffer<std::function<void(void)>, 8> smartstack_operations;
@@ -150,6 +160,12 @@ void nmi6502()
 	vp6502();
 	state6502.pc = (uint16_t)read6502(0xFFFA) | ((uint16_t)read6502(0xFFFB) << 8);
 	waiting      = 0;
+	if (Profiler_enabled) {
+		profiler_interrupt();
+	}
+	if (Raster_timeline_enabled) {
+		raster_timeline_interrupt();
+	}
 
 	commit_smartstack();
 	auto &ss          = stack6502.allocate();
@@ -171,6 +187,15 @@ void irq6502()
 		cleardecimal();
 		vp6502();
 		state6502.pc = (uint16_t)read6502(0xFFFE) | ((uint16_t)read6502(0xFFFF) << 8);
+		if (Profiler_enabled) {
+			profiler_interrupt();
+		}
+		if (Raster_timeline_enabled) {
+			raster_timeline_interrupt();
+		}
+		if (Irq_stats_enabled) {
+			irq_stats_vector();
+		}
 
 		commit_smartstack();
 		auto &ss          = stack6502.allocate();
@@ -190,6 +215,9 @@ void exec6502(uint32_t tickcount)
 	if (waiting) {
 		clockticks6502 += tickcount;
 		clockgoal6502 = clockticks6502;
+		if (Profiler_enabled) {
+			profiler_wait(tickcount);
+		}
 		return;
 	}
 
@@ -198,11 +226,13 @@ void exec6502(uint32_t tickcount)
 	while (clockticks6502 < clockgoal6502) {
 		debug_state6502                     = state6502;
 		const uint64_t debug_clockticks6502 = clockticks6502;
+		const uint8_t  debug_history_writes = Cpu_history_num_writes;
 
 		opcode = read6502(state6502.pc++);
 		if (debug6502 & DEBUG6502_EXEC) {
-			state6502      = debug_state6502;
-			clockticks6502 = debug_clockticks6502;
+			state6502              = debug_state6502;
+			clockticks6502         = debug_clockticks6502;
+			Cpu_history_num_writes = debug_history_writes;
 			smartstack_operations.clear();
 			return;
 		}
@@ -215,8 +245,9 @@ void exec6502(uint32_t tickcount)
 		(*optable[opcode])();
 
 		if (debug6502 & (DEBUG6502_READ | DEBUG6502_WRITE)) {
-			state6502      = debug_state6502;
-			clockticks6502 = debug_clockticks6502;
+			state6502              = debug_state6502;
+			clockticks6502         = debug_clockticks6502;
+			Cpu_history_num_writes = debug_history_writes;
 			smartstack_operations.clear();
 			return;
 		}
@@ -232,6 +263,15 @@ void exec6502(uint32_t tickcount)
 		history.state  = debug_state6502;
 		history.opcode = opcode;
 		history.bank   = bank6502(debug_state6502.pc);
+		if (Cpu_history_recording) {
+			cpu_history_record(history.state, history.bank, opcode, debug_clockticks6502);
+		}
+		if (Profiler_enabled) {
+			profiler_instruction(history.state.pc, history.bank, opcode, (uint32_t)(clockticks6502 - debug_clockticks6502));
+		}
+		if (Coverage_map != nullptr) {
+			coverage_instruction(history.state.pc, history.bank, opcode);
+		}
 
 		commit_smartstack();
 	}
@@ -244,16 +284,28 @@ void step6502()
 	if (waiting) {
 		++clockticks6502;
 		clockgoal6502 = clockticks6502;
+		if (Profiler_enabled) {
+			profiler_wait(1);
+		}
+		return;
+	}
+	if (stall6502 != 0) {
+		const uint32_t cycles = stall6502 < 8 ? stall6502 : 8;
+		clockticks6502 += cycles;
+		clockgoal6502 = clockticks6502;
+		stall6502 -= cycles;
 		return;
 	}
 
 	debug_state6502                     = state6502;
 	const uint64_t debug_clockticks6502 = clockticks6502;
+	const uint8_t  debug_history_writes = Cpu_history_num_writes;
 
 	opcode = read6502(state6502.pc++);
 	if (debug6502 & DEBUG6502_EXEC) {
-		state6502      = debug_state6502;
-		clockticks6502 = debug_clockticks6502;
+		state6502              = debug_state6502;
+		clockticks6502         = debug_clockticks6502;
+		Cpu_history_num_writes = debug_history_writes;
 		smartstack_operations.clear();
 		return;
 	}
@@ -266,8 +318,9 @@ void step6502()
 	(*optable[opcode])();
 
 	if (debug6502 & (DEBUG6502_READ | DEBUG6502_WRITE)) {
-		state6502      = debug_state6502;
-		clockticks6502 = debug_clockticks6502;
+		state6502              = debug_state6502;
+		clockticks6502         = debug_clockticks6502;
+		Cpu_history_num_writes = debug_history_writes;
 		smartstack_operations.clear();
 		return;
 	}
@@ -284,6 +337,15 @@ void step6502()
 	history.state  = debug_state6502;
 	history.opcode = opcode;
 	history.bank   = bank6502(debug_state6502.pc);
+	if (Cpu_history_recording) {
+		cpu_history_record(history.state, history.bank, opcode, debug_clockticks6502);
+	}
+	if (Profiler_enabled) {
+		profiler_instruction(history.state.pc, history.bank, opcode, (uint32_t)(clockticks6502 - debug_clockticks6502));
+	}
+	if (Coverage_map != nullptr) {
+		coverage_instruction(history.state.pc, history.bank, opcode);
+	}
 
 	commit_smartstack();
 }
@@ -295,8 +357,20 @@ void force6502()
 	if (waiting) {
 		++clockticks6502;
 		clockgoal6502 = clockticks6502;
+		if (Profiler_enabled) {
+			profiler_wait(1);
+		}
 		return;
 	}
+	if (stall6502 != 0) {
+		const uint32_t cycles = stall6502 < 8 ? stall6502 : 8;
+		clockticks6502 += cycles;
+		clockgoal6502 = clockticks6502;
+		stall6502 -= cycles;
+		return;
+	}
+
+	const uint64_t debug_clockticks6502 = clockticks6502;
 
 	opcode = read6502(state6502.pc++);
 	state6502.status |= FLAG_CONSTANT;
@@ -318,10 +392,32 @@ void force6502()
 	history.state  = debug_state6502;
 	history.opcode = opcode;
 	history.bank   = bank6502(debug_state6502.pc);
+	if (Cpu_history_recording) {
+		cpu_history_record(history.state, history.bank, opcode, debug_clockticks6502);
+	}
+	if (Profiler_enabled) {
+		profiler_instruction(history.state.pc, history.bank, opcode, (uint32_t)(clockticks6502 - debug_clockticks6502));
+	}
+	if (Coverage_map != nullptr) {
+		coverage_instruction(history.state.pc, history.bank, opcode);
+	}
 
 	commit_smartstack();
 }
 
+void snapshot6502(machine_snapshot &snapshot)
+{
+	snapshot.io(state6502);
+	snapshot.io(debug_state6502);
+	snapshot.io(instructions);
+	snapshot.io(clockticks6502);
+	snapshot.io(clockgoal6502);
+	snapshot.io(waiting);
+	snapshot.io(stall6502);
+	snapshot.io(stack6502);
+	snapshot.io(history6502);
+}
+
 //  Fixes from http://6502.org/tutorials/65c02opcodes.html
 //
 //  65C02 Cycle Count differences.
@@ -71,4 +71,7 @@ extern void     irq6502();
 extern uint64_t clockticks6502;
 extern uint8_t  debug6502;
 
+class machine_snapshot;
+extern void snapshot6502(machine_snapshot &snapshot);
+
 #endif
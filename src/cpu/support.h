@@ -181,7 +181,8 @@ void reset6502()
 	state6502.status = FLAG_CONSTANT | FLAG_BREAK;
 	setinterrupt();
 	cleardecimal();
-	waiting = 0;
+	waiting   = 0;
+	stall6502 = 0;
 	stack6502.clear();
 	history6502.clear();
 	smartstack_operations.clear();
@@ -0,0 +1,610 @@
+#include "cpu_history.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <vector>
+
+#include "background_writer.h"
+#include "zlib.h"
+
+bool              Cpu_history_recording  = false;
+uint8_t           Cpu_history_num_writes = 0;
+cpu_history_store Cpu_history_writes[Cpu_history_max_writes];
+
+// Records are collected into blocks of roughly this many bytes before being compressed. A block
+// holds around 15k instructions, which is also the most that has to be decoded to answer a query.
+static constexpr size_t Block_data_size = 65536;
+
+// Upper bound on a single encoded record: flags, opcode, clock delta (10), pc delta (3),
+// five registers and bank, write count and four bytes per write.
+static constexpr size_t Max_record_size = 2 + 10 + 3 + 6 + 1 + 4 * Cpu_history_max_writes;
+
+// If the writer falls this far behind, the emulation thread waits for it rather than queueing
+// an unbounded amount of memory.
+static constexpr int Max_queued_blocks = 64;
+
+static constexpr uint32_t Block_magic = 0x31484342; // "BCH1"
+
+enum record_flags : uint8_t {
+	RECORD_A      = 0x01,
+	RECORD_X      = 0x02,
+	RECORD_Y      = 0x04,
+	RECORD_SP     = 0x08,
+	RECORD_STATUS = 0x10,
+	RECORD_BANK   = 0x20,
+	RECORD_WRITES = 0x40,
+};
+
+#pragma pack(push, 1)
+struct block_header {
+	uint32_t magic;
+	uint32_t compressed_size;
+	uint32_t data_size;
+	uint32_t num_records;
+	uint64_t first_index;
+
+	// Decoder state before the first record.
+	uint64_t base_clock;
+	uint16_t base_pc;
+	uint8_t  base_sp;
+	uint8_t  base_a;
+	uint8_t  base_x;
+	uint8_t  base_y;
+	uint8_t  base_status;
+	uint8_t  base_bank;
+
+	// One bit per 256-byte page of the CPU address space.
+	uint8_t pc_pages[32];
+	uint8_t write_pages[32];
+};
+#pragma pack(pop)
+
+struct history_block {
+	block_header         header;
+	std::vector<uint8_t> data;
+	size_t               used = 0;
+};
+
+struct block_index_entry {
+	block_header header;
+	int          segment;
+	uint64_t     offset;
+};
+
+static inline void mark_page(uint8_t *pages, uint16_t address)
+{
+	pages[address >> 11] |= 1 << ((address >> 8) & 7);
+}
+
+static inline bool test_page(const uint8_t *pages, uint16_t address)
+{
+	return (pages[address >> 11] & (1 << ((address >> 8) & 7))) != 0;
+}
+
+static inline uint8_t *put_varint(uint8_t *out, uint64_t value)
+{
+	while (value >= 0x80) {
+		*out++ = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	*out++ = (uint8_t)value;
+	return out;
+}
+
+static inline const uint8_t *get_varint(const uint8_t *in, const uint8_t *end, uint64_t &value)
+{
+	value     = 0;
+	int shift = 0;
+	while (in < end && shift < 64) {
+		const uint8_t b = *in++;
+		value |= (uint64_t)(b & 0x7f) << shift;
+		if ((b & 0x80) == 0) {
+			return in;
+		}
+		shift += 7;
+	}
+	return nullptr;
+}
+
+//
+// Segment files
+//
+// The log is split over two files, <path>.0 and <path>.1, each holding at most half of the disk
+// budget. When the active one is full, the other one (holding the oldest history) is truncated
+// and becomes the active one. The block index is kept in memory.
+//
+
+static std::filesystem::path         Segment_paths[2];
+static uint64_t                      Segment_limit = 0;
+static uint64_t                      Segment_bytes[2];
+static uint32_t                      Segment_generation[2];
+static int                           Segment_active = 0;
+static std::ofstream                 Segment_out;
+static std::deque<block_index_entry> Block_index;
+static std::vector<uint8_t>          Compress_buffer;
+static std::atomic<bool>             Write_failed = false;
+
+static void segment_write_block(history_block *block)
+{
+	if (Write_failed) {
+		return;
+	}
+
+	uLongf compressed_size = (uLongf)Compress_buffer.size();
+	if (compress2(Compress_buffer.data(), &compressed_size, block->data.data(), (uLong)block->used, 1) != Z_OK) {
+		Write_failed = true;
+		return;
+	}
+
+	block->header.compressed_size = (uint32_t)compressed_size;
+	block->header.data_size       = (uint32_t)block->used;
+
+	const uint64_t size = sizeof(block_header) + compressed_size;
+	if (Segment_bytes[Segment_active] > 0 && Segment_bytes[Segment_active] + size > Segment_limit) {
+		Segment_active ^= 1;
+		while (!Block_index.empty() && Block_index.front().segment == Segment_active) {
+			Block_index.pop_front();
+		}
+		++Segment_generation[Segment_active];
+		Segment_bytes[Segment_active] = 0;
+
+		Segment_out.close();
+		Segment_out.open(Segment_paths[Segment_active], std::ios::binary | std::ios::trunc);
+	}
+
+	Segment_out.write(reinterpret_cast<const char *>(&block->header), sizeof(block_header));
+	Segment_out.write(reinterpret_cast<const char *>(Compress_buffer.data()), compressed_size);
+	Segment_out.flush();
+	if (!Segment_out) {
+		Write_failed = true;
+		return;
+	}
+
+	Block_index.push_back({ block->header, Segment_active, Segment_bytes[Segment_active] });
+	Segment_bytes[Segment_active] += size;
+}
+
+//
+// Writer thread
+//
+// Compression and file output happen here, so the emulation thread only pays for encoding each
+// record into the current block.
+//
+
+static background_writer<history_block> Writer(
+    "cpu_history",
+    []() {
+	    history_block *block = new history_block;
+	    block->data.resize(Block_data_size + Max_record_size);
+	    return block;
+    },
+    segment_write_block,
+    Max_queued_blocks);
+
+//
+// Encoder
+//
+
+struct coder_state {
+	uint64_t clock;
+	uint16_t pc;
+	uint8_t  sp;
+	uint8_t  a;
+	uint8_t  x;
+	uint8_t  y;
+	uint8_t  status;
+	uint8_t  bank;
+};
+
+static history_block *Filling    = nullptr;
+static coder_state    Last       = {};
+static uint64_t       Next_index = 0;
+
+static void begin_block(const _state6502 &state, uint8_t bank, uint64_t clock)
+{
+	Filling       = Writer.alloc();
+	Filling->used = 0;
+
+	block_header &header = Filling->header;
+	header               = block_header();
+	header.magic         = Block_magic;
+	header.first_index   = Next_index;
+	header.base_clock    = clock;
+	header.base_pc       = state.pc;
+	header.base_sp       = state.sp;
+	header.base_a        = state.a;
+	header.base_x        = state.x;
+	header.base_y        = state.y;
+	header.base_status   = state.status;
+	header.base_bank     = bank;
+
+	Last = { clock, state.pc, state.sp, state.a, state.x, state.y, state.status, bank };
+}
+
+void cpu_history_record(const _state6502 &state, uint8_t bank, uint8_t opcode, uint64_t clock)
+{
+	if (Filling == nullptr) {
+		begin_block(state, bank, clock);
+	}
+
+	block_header &header = Filling->header;
+	uint8_t      *out    = Filling->data.data() + Filling->used;
+	uint8_t      *flags  = out++;
+	*out++               = opcode;
+
+	const int32_t pc_delta = (int16_t)(state.pc - Last.pc);
+	out                    = put_varint(out, clock - Last.clock);
+	out                    = put_varint(out, ((uint32_t)pc_delta << 1) ^ (uint32_t)(pc_delta >> 31));
+
+	uint8_t f = 0;
+	if (state.a != Last.a) {
+		f |= RECORD_A;
+		*out++ = state.a;
+	}
+	if (state.x != Last.x) {
+		f |= RECORD_X;
+		*out++ = state.x;
+	}
+	if (state.y != Last.y) {
+		f |= RECORD_Y;
+		*out++ = state.y;
+	}
+	if (state.sp != Last.sp) {
+		f |= RECORD_SP;
+		*out++ = state.sp;
+	}
+	if (state.status != Last.status) {
+		f |= RECORD_STATUS;
+		*out++ = state.status;
+	}
+	if (bank != Last.bank) {
+		f |= RECORD_BANK;
+		*out++ = bank;
+	}
+	if (Cpu_history_num_writes > 0) {
+		f |= RECORD_WRITES;
+		*out++ = Cpu_history_num_writes;
+		for (int i = 0; i < Cpu_history_num_writes; ++i) {
+			const cpu_history_store &w = Cpu_history_writes[i];
+			*out++                     = (uint8_t)(w.address & 0xff);
+			*out++                     = (uint8_t)(w.address >> 8);
+			*out++                     = w.bank;
+			*out++                     = w.value;
+			mark_page(header.write_pages, w.address);
+		}
+		Cpu_history_num_writes = 0;
+	}
+	*flags = f;
+	mark_page(header.pc_pages, state.pc);
+
+	Last = { clock, state.pc, state.sp, state.a, state.x, state.y, state.status, bank };
+
+	Filling->used = out - Filling->data.data();
+	++header.num_records;
+	++Next_index;
+
+	if (Filling->used >= Block_data_size) {
+		Writer.submit(Filling);
+		Filling = nullptr;
+
+		if (Write_failed) {
+			fmt::print("WARN: Could not write cpu history to {}, recording stopped.\n", Segment_paths[Segment_active].generic_string());
+			Cpu_history_recording = false;
+		}
+	}
+}
+
+//
+// Decoder
+//
+
+static bool decode_block(const block_header &header, const uint8_t *data, size_t size, std::vector<cpu_history_entry> &entries)
+{
+	entries.resize(header.num_records);
+
+	coder_state last = { header.base_clock, header.base_pc, header.base_sp, header.base_a, header.base_x, header.base_y, header.base_status, header.base_bank };
+
+	const uint8_t *in  = data;
+	const uint8_t *end = data + size;
+	for (uint32_t r = 0; r < header.num_records; ++r) {
+		if (end - in < 2) {
+			return false;
+		}
+		const uint8_t flags  = *in++;
+		const uint8_t opcode = *in++;
+
+		uint64_t clock_delta;
+		uint64_t pc_zigzag;
+		if ((in = get_varint(in, end, clock_delta)) == nullptr || (in = get_varint(in, end, pc_zigzag)) == nullptr) {
+			return false;
+		}
+		last.clock += clock_delta;
+		last.pc += (uint16_t)((pc_zigzag >> 1) ^ (~(pc_zigzag & 1) + 1));
+
+		for (uint8_t bit = RECORD_A; bit <= RECORD_BANK; bit <<= 1) {
+			if (flags & bit) {
+				if (in >= end) {
+					return false;
+				}
+				const uint8_t value = *in++;
+				switch (bit) {
+					case RECORD_A: last.a = value; break;
+					case RECORD_X: last.x = value; break;
+					case RECORD_Y: last.y = value; break;
+					case RECORD_SP: last.sp = value; break;
+					case RECORD_STATUS: last.status = value; break;
+					case RECORD_BANK: last.bank = value; break;
+				}
+			}
+		}
+
+		cpu_history_entry &entry = entries[r];
+		entry.index              = header.first_index + r;
+		entry.clock              = last.clock;
+		entry.state              = { last.pc, last.sp, last.a, last.x, last.y, last.status };
+		entry.bank               = last.bank;
+		entry.opcode             = opcode;
+		entry.num_writes         = 0;
+
+		if (flags & RECORD_WRITES) {
+			if (in >= end || *in > Cpu_history_max_writes || end - in < 1 + 4 * *in) {
+				return false;
+			}
+			entry.num_writes = *in++;
+			for (int i = 0; i < entry.num_writes; ++i) {
+				entry.writes[i] = { (uint16_t)(in[0] | (in[1] << 8)), in[2], in[3] };
+				in += 4;
+			}
+		}
+	}
+	return true;
+}
+
+static std::ifstream                  Segment_in[2];
+static uint32_t                       Segment_in_generation[2];
+static std::vector<uint8_t>           Read_buffer;
+static std::vector<uint8_t>           Inflate_buffer;
+static std::vector<cpu_history_entry> Decoded;
+static uint64_t                       Decoded_first = UINT64_MAX;
+
+// Queries run on the emulation thread, so once the writer has drained its queue nothing else
+// touches the segments or the block index.
+static void query_begin()
+{
+	Writer.wait_idle();
+}
+
+static size_t num_blocks()
+{
+	return Block_index.size() + (Filling != nullptr ? 1 : 0);
+}
+
+static const block_header &block_at(size_t i)
+{
+	return i < Block_index.size() ? Block_index[i].header : Filling->header;
+}
+
+static size_t find_block(uint64_t index)
+{
+	const auto found = std::upper_bound(Block_index.begin(), Block_index.end(), index, [](uint64_t index, const block_index_entry &entry) {
+		return index < entry.header.first_index;
+	});
+
+	if (Filling != nullptr && index >= Filling->header.first_index) {
+		return Block_index.size();
+	}
+	return found == Block_index.begin() ? 0 : (size_t)(found - Block_index.begin()) - 1;
+}
+
+static bool decode_block_at(size_t i)
+{
+	const block_header &header = block_at(i);
+	if (Decoded_first == header.first_index && Decoded.size() == header.num_records) {
+		return true;
+	}
+	Decoded_first = UINT64_MAX;
+
+	if (i == Block_index.size()) {
+		if (!decode_block(header, Filling->data.data(), Filling->used, Decoded)) {
+			return false;
+		}
+		Decoded_first = header.first_index;
+		return true;
+	}
+
+	const block_index_entry &entry = Block_index[i];
+
+	std::ifstream &in = Segment_in[entry.segment];
+	if (!in.is_open() || Segment_in_generation[entry.segment] != Segment_generation[entry.segment]) {
+		in.close();
+		in.open(Segment_paths[entry.segment], std::ios::binary);
+		Segment_in_generation[entry.segment] = Segment_generation[entry.segment];
+	}
+	in.clear();
+	in.seekg(entry.offset + sizeof(block_header));
+
+	Read_buffer.resize(header.compressed_size);
+	in.read(reinterpret_cast<char *>(Read_buffer.data()), header.compressed_size);
+	if (!in) {
+		return false;
+	}
+
+	Inflate_buffer.resize(header.data_size);
+	uLongf data_size = header.data_size;
+	if (uncompress(Inflate_buffer.data(), &data_size, Read_buffer.data(), header.compressed_size) != Z_OK || data_size != header.data_size) {
+		return false;
+	}
+
+	if (!decode_block(header, Inflate_buffer.data(), data_size, Decoded)) {
+		return false;
+	}
+	Decoded_first = header.first_index;
+	return true;
+}
+
+static bool for_each_reverse(uint64_t before, const std::function<bool(const block_header &)> &filter, const std::function<bool(const cpu_history_entry &)> &fn)
+{
+	query_begin();
+
+	before = std::min(before, Next_index);
+	if (num_blocks() == 0 || before == 0) {
+		return false;
+	}
+
+	for (size_t i = find_block(before - 1);; --i) {
+		const block_header &header = block_at(i);
+		if (before > header.first_index && filter(header)) {
+			if (!decode_block_at(i)) {
+				return false;
+			}
+			const uint64_t last = std::min(before, header.first_index + header.num_records);
+			for (uint64_t index = last; index-- > header.first_index;) {
+				if (fn(Decoded[index - header.first_index])) {
+					return true;
+				}
+			}
+		}
+		if (i == 0) {
+			break;
+		}
+	}
+	return false;
+}
+
+//
+// Interface
+//
+
+bool cpu_history_init(const std::filesystem::path &path, uint64_t max_bytes)
+{
+	cpu_history_shutdown();
+
+	Segment_paths[0] = path;
+	Segment_paths[0] += ".0";
+	Segment_paths[1] = path;
+	Segment_paths[1] += ".1";
+
+	Segment_out.open(Segment_paths[1], std::ios::binary | std::ios::trunc);
+	Segment_out.close();
+	Segment_out.open(Segment_paths[0], std::ios::binary | std::ios::trunc);
+	if (!Segment_out) {
+		fmt::print("WARN: Could not open {} for cpu history.\n", Segment_paths[0].generic_string());
+		return false;
+	}
+
+	Segment_limit  = std::max<uint64_t>(max_bytes / 2, Block_data_size * 4);
+	Segment_active = 0;
+	for (int i = 0; i < 2; ++i) {
+		Segment_bytes[i] = 0;
+		++Segment_generation[i];
+	}
+	Compress_buffer.resize(compressBound((uLong)(Block_data_size + Max_record_size)));
+	Write_failed = false;
+
+	Next_index             = 0;
+	Decoded_first          = UINT64_MAX;
+	Cpu_history_num_writes = 0;
+	Cpu_history_recording  = true;
+
+	Writer.start();
+	return true;
+}
+
+void cpu_history_shutdown()
+{
+	if (Filling != nullptr) {
+		if (Filling->header.num_records > 0) {
+			Writer.submit(Filling);
+		} else {
+			delete Filling;
+		}
+		Filling = nullptr;
+	}
+	Writer.wait_idle();
+	Writer.stop();
+
+	Segment_out.close();
+	for (int i = 0; i < 2; ++i) {
+		Segment_in[i].close();
+	}
+	Block_index.clear();
+	Decoded.clear();
+	Decoded_first = UINT64_MAX;
+
+	Cpu_history_recording  = false;
+	Cpu_history_num_writes = 0;
+}
+
+uint64_t cpu_history_first()
+{
+	query_begin();
+	if (!Block_index.empty()) {
+		return Block_index.front().header.first_index;
+	}
+	return Filling != nullptr ? Filling->header.first_index : Next_index;
+}
+
+uint64_t cpu_history_end()
+{
+	return Next_index;
+}
+
+uint64_t cpu_history_bytes_on_disk()
+{
+	query_begin();
+	return Segment_bytes[0] + Segment_bytes[1];
+}
+
+bool cpu_history_get(uint64_t index, cpu_history_entry &entry)
+{
+	query_begin();
+	if (index >= Next_index || num_blocks() == 0) {
+		return false;
+	}
+
+	const size_t        i      = find_block(index);
+	const block_header &header = block_at(i);
+	if (index < header.first_index || index >= header.first_index + header.num_records || !decode_block_at(i)) {
+		return false;
+	}
+	entry = Decoded[index - header.first_index];
+	return true;
+}
+
+bool cpu_history_for_each_reverse(uint64_t before, const std::function<bool(const cpu_history_entry &)> &fn)
+{
+	return for_each_reverse(
+	    before, [](const block_header &) { return true; }, fn);
+}
+
+bool cpu_history_find_pc(uint16_t pc, uint8_t bank, uint64_t before, uint64_t &index)
+{
+	const bool match_bank = pc >= 0xa000;
+	return for_each_reverse(
+	    before, [pc](const block_header &header) { return test_page(header.pc_pages, pc); },
+	    [&](const cpu_history_entry &entry) {
+		    if (entry.state.pc == pc && (!match_bank || entry.bank == bank)) {
+			    index = entry.index;
+			    return true;
+		    }
+		    return false;
+	    });
+}
+
+bool cpu_history_find_write(uint16_t address, uint8_t bank, uint64_t before, uint64_t &index)
+{
+	const bool match_bank = address >= 0xa000;
+	return for_each_reverse(
+	    before, [address](const block_header &header) { return test_page(header.write_pages, address); },
+	    [&](const cpu_history_entry &entry) {
+		    for (int i = 0; i < entry.num_writes; ++i) {
+			    if (entry.writes[i].address == address && (!match_bank || entry.writes[i].bank == bank)) {
+				    index = entry.index;
+				    return true;
+			    }
+		    }
+		    return false;
+	    });
+}
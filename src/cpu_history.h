@@ -0,0 +1,80 @@
+#pragma once
+#if !defined(CPU_HISTORY_H)
+#	define CPU_HISTORY_H
+
+#	include <filesystem>
+#	include <functional>
+
+#	include "cpu/fake6502.h"
+
+//
+// Disk-backed CPU history
+//
+// When enabled with -history, every executed instruction is appended to a compressed log on disk,
+// together with the memory writes it made. Unlike history6502, which only remembers the last 1024
+// instructions, the log keeps as much history as the disk budget allows and can be searched for
+// the last time the PC reached an address or the last write to an address.
+//
+// Records are delta-encoded into 64KB blocks, which are deflated and written by a background
+// thread. Each block carries a summary of the pages its instructions executed from and wrote to,
+// so searches only decode blocks that can contain a match.
+//
+
+constexpr int Cpu_history_max_writes = 8;
+
+struct cpu_history_store {
+	uint16_t address;
+	uint8_t  bank;
+	uint8_t  value;
+};
+
+struct cpu_history_entry {
+	uint64_t          index;
+	uint64_t          clock;
+	_state6502        state;
+	uint8_t           bank;
+	uint8_t           opcode;
+	uint8_t           num_writes;
+	cpu_history_store writes[Cpu_history_max_writes];
+};
+
+// Bookkeeping for the stores made by the instruction being executed. The CPU core saves
+// Cpu_history_num_writes before an instruction and restores it when a debugger hit rewinds the
+// instruction, so stores are not recorded twice when it is re-executed.
+extern bool              Cpu_history_recording;
+extern uint8_t           Cpu_history_num_writes;
+extern cpu_history_store Cpu_history_writes[Cpu_history_max_writes];
+
+bool cpu_history_init(const std::filesystem::path &path, uint64_t max_bytes);
+void cpu_history_shutdown();
+
+// Append the instruction that just executed: state, bank and clock are taken from before it ran.
+void cpu_history_record(const _state6502 &state, uint8_t bank, uint8_t opcode, uint64_t clock);
+
+inline void cpu_history_write(uint16_t address, uint8_t bank, uint8_t value)
+{
+	if (Cpu_history_recording && Cpu_history_num_writes < Cpu_history_max_writes) {
+		Cpu_history_writes[Cpu_history_num_writes++] = { address, bank, value };
+	}
+}
+
+inline bool cpu_history_is_recording()
+{
+	return Cpu_history_recording;
+}
+
+// Recorded entries are numbered from cpu_history_first() up to, but not including, cpu_history_end().
+uint64_t cpu_history_first();
+uint64_t cpu_history_end();
+uint64_t cpu_history_bytes_on_disk();
+
+bool cpu_history_get(uint64_t index, cpu_history_entry &entry);
+
+// Walk backwards from the entry before 'before' until fn returns true. Returns whether fn stopped the walk.
+bool cpu_history_for_each_reverse(uint64_t before, const std::function<bool(const cpu_history_entry &)> &fn);
+
+// Find the most recent entry before 'before' that executed at pc, or wrote to address.
+bool cpu_history_find_pc(uint16_t pc, uint8_t bank, uint64_t before, uint64_t &index);
+bool cpu_history_find_write(uint16_t address, uint8_t bank, uint64_t before, uint64_t &index);
+
+#endif
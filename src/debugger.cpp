@@ -1,21 +1,137 @@
 #include "debugger.h"
+#include "boxmon/boxmon.h"
+#include "boxmon/expression.h"
 #include "boxmon/parser.h"
 #include "cpu/fake6502.h"
 #include "cpu/mnemonics.h"
 #include "glue.h"
 #include "memory.h"
+#include "rewind.h"
+#include "symbols.h"
 
-#include <map>
+#include <algorithm>
+#include <vector>
 
 //
 // Breakpoints
 //
 
-static breakpoint_list                                Breakpoints;
-static breakpoint_list                                Active_breakpoints;
-static uint8_t                                       *Breakpoint_flags = nullptr;
-static std::map<uint32_t, std::string>                Breakpoint_conditions;
-static std::map<uint32_t, const boxmon::expression *> Breakpoint_expressions;
+struct breakpoint_condition {
+	std::string                text;
+	boxmon::expression_program program;
+	uint32_t                   symbols_generation;
+};
+
+// Breakpoint_condition_slots runs alongside Breakpoint_flags and holds an index into
+// Breakpoint_conditions, or 0 if there is no condition at that address.
+static breakpoint_list                   Breakpoints;
+static breakpoint_list                   Active_breakpoints;
+static uint8_t                          *Breakpoint_flags           = nullptr;
+static uint16_t                         *Breakpoint_condition_slots = nullptr;
+static std::vector<breakpoint_condition> Breakpoint_conditions;
+static std::vector<uint16_t>             Free_condition_slots;
+
+struct tracepoint {
+	uint8_t                    flags;
+	std::string                condition_text;
+	boxmon::expression_program condition;
+	bool                       condition_valid;
+	std::vector<std::string>   value_text;
+	boxmon::expression_program values[Num_debugger_trace_values];
+	uint8_t                    num_values;
+	uint32_t                   symbols_generation;
+};
+
+// Tracepoint_slots works like Breakpoint_condition_slots, indexing into Tracepoint_data.
+// Events go into a fixed ring allocated up front, so recording a hit never allocates.
+static tracepoint_list               Tracepoints;
+static uint16_t                     *Tracepoint_slots = nullptr;
+static std::vector<tracepoint>       Tracepoint_data;
+static std::vector<uint16_t>         Free_tracepoint_slots;
+static std::vector<tracepoint_event> Trace_ring;
+static uint64_t                      Trace_head       = 0;
+static uint64_t                      Last_trace_clock = UINT64_MAX;
+
+constexpr const size_t Trace_ring_size = 1 << 16;
+static_assert((Trace_ring_size & (Trace_ring_size - 1)) == 0, "Trace_ring_size must be a power of 2");
+
+// Stabbing queries over possibly-overlapping ranges. Intervals are kept sorted by start,
+// alongside the running maximum of their ends, so a lookup is a binary search followed by
+// a backwards walk that stops as soon as nothing earlier can reach the queried offset.
+class watch_interval_set
+{
+public:
+	void rebuild(const watchpoint_list &watchpoints, bool vram)
+	{
+		m_intervals.clear();
+		for (size_t i = 0; i < watchpoints.size(); ++i) {
+			const watchpoint &wp = watchpoints[i];
+			if (wp.vram == vram && wp.enabled) {
+				m_intervals.push_back({ wp.start, wp.end, i });
+			}
+		}
+		std::sort(m_intervals.begin(), m_intervals.end(), [](const interval &a, const interval &b) { return a.start < b.start; });
+
+		m_max_end.resize(m_intervals.size());
+		uint32_t max_end = 0;
+		for (size_t i = 0; i < m_intervals.size(); ++i) {
+			max_end      = std::max(max_end, m_intervals[i].end);
+			m_max_end[i] = max_end;
+		}
+	}
+
+	template <typename F>
+	void find(uint32_t offset, F fn) const
+	{
+		auto   next = std::upper_bound(m_intervals.begin(), m_intervals.end(), offset, [](uint32_t o, const interval &i) { return o < i.start; });
+		size_t i    = static_cast<size_t>(next - m_intervals.begin());
+		while (i > 0 && m_max_end[i - 1] >= offset) {
+			--i;
+			if (m_intervals[i].end >= offset) {
+				fn(m_intervals[i].index);
+			}
+		}
+	}
+
+private:
+	struct interval {
+		uint32_t start;
+		uint32_t end;
+		size_t   index;
+	};
+
+	std::vector<interval> m_intervals;
+	std::vector<uint32_t> m_max_end;
+};
+
+constexpr const uint32_t Watch_cpu_space_size = 0xa000 + 0x6000 * NUM_MAX_RAM_BANKS;
+
+uint8_t *Debugger_watch_cpu_pages = nullptr;
+uint8_t  Debugger_watch_vram_pages[0x20000 >> 8];
+
+static watchpoint_list    Watchpoints;
+static watch_interval_set Watch_cpu_intervals;
+static watch_interval_set Watch_vram_intervals;
+static uint32_t           Next_watchpoint_id = 1;
+
+static void rebuild_watch_tables()
+{
+	memset(Debugger_watch_cpu_pages, 0, Watch_cpu_space_size >> 8);
+	memset(Debugger_watch_vram_pages, 0, sizeof(Debugger_watch_vram_pages));
+
+	for (const watchpoint &wp : Watchpoints) {
+		if (!wp.enabled) {
+			continue;
+		}
+		uint8_t *pages = wp.vram ? Debugger_watch_vram_pages : Debugger_watch_cpu_pages;
+		for (uint32_t page = wp.start >> 8; page <= (wp.end >> 8); ++page) {
+			pages[page] |= wp.flags;
+		}
+	}
+
+	Watch_cpu_intervals.rebuild(Watchpoints, false);
+	Watch_vram_intervals.rebuild(Watchpoints, true);
+}
 
 static boxmon::parser Condition_parser;
 static const std::string Empty_string("");
@@ -37,6 +153,7 @@ static uint8_t         Step_interrupt  = 0x04;
 static uint8_t         Interrupt_check = 0x04;
 static breakpoint_type Step_target     = { 0, 0 };
 static uint32_t        Step_instruction_count = 0;
+static bool            Watch_hit_pending = false;
 
 uint16_t debug_peek16(uint16_t addr)
 {
@@ -108,8 +225,27 @@ void debugger_init(int max_ram_banks)
 	Breakpoint_flags = new uint8_t[breakpoint_flags_size];
 	memset(Breakpoint_flags, 0, breakpoint_flags_size);
 
+	Breakpoint_condition_slots = new uint16_t[breakpoint_flags_size];
+	memset(Breakpoint_condition_slots, 0, breakpoint_flags_size * sizeof(uint16_t));
+
 	Breakpoint_conditions.clear();
-	Breakpoint_expressions.clear();
+	Breakpoint_conditions.emplace_back(); // Slot 0 means "no condition".
+	Free_condition_slots.clear();
+
+	Tracepoint_slots = new uint16_t[breakpoint_flags_size];
+	memset(Tracepoint_slots, 0, breakpoint_flags_size * sizeof(uint16_t));
+
+	Tracepoints.clear();
+	Tracepoint_data.clear();
+	Tracepoint_data.emplace_back(); // Slot 0 means "no tracepoint".
+	Free_tracepoint_slots.clear();
+
+	Trace_ring.resize(Trace_ring_size);
+	debugger_clear_trace();
+
+	Debugger_watch_cpu_pages = new uint8_t[Watch_cpu_space_size >> 8];
+	Watchpoints.clear();
+	rebuild_watch_tables();
 
 	options_apply_debugger_opts();
 }
@@ -117,12 +253,22 @@ void debugger_init(int max_ram_banks)
 void debugger_shutdown()
 {
 	delete[] Breakpoint_flags;
+	delete[] Breakpoint_condition_slots;
 
-	for (auto [key, value] : Breakpoint_expressions) {
-		delete value;
-	}
-	Breakpoint_expressions.clear();
 	Breakpoint_conditions.clear();
+	Free_condition_slots.clear();
+
+	delete[] Tracepoint_slots;
+
+	Tracepoints.clear();
+	Tracepoint_data.clear();
+	Free_tracepoint_slots.clear();
+	Trace_ring.clear();
+	Trace_ring.shrink_to_fit();
+
+	delete[] Debugger_watch_cpu_pages;
+	Debugger_watch_cpu_pages = nullptr;
+	Watchpoints.clear();
 }
 
 bool debugger_is_paused()
@@ -239,6 +385,12 @@ void debugger_process_cpu()
 		return;
 	}
 
+	if (Watch_hit_pending) {
+		Watch_hit_pending = false;
+		debugger_pause_execution();
+		return;
+	}
+
 	const auto [addr, bank] = get_current_pc();
 	const auto flags        = get_flags(addr, bank);
 	if (flags & DEBUG6502_CONDITION) {
@@ -256,7 +408,8 @@ void debugger_process_cpu()
 
 void debugger_pause_execution()
 {
-	Debug_mode = DEBUG_PAUSE;
+	Debug_mode        = DEBUG_PAUSE;
+	Watch_hit_pending = false;
 }
 
 void debugger_continue_execution()
@@ -346,6 +499,30 @@ uint32_t debugger_step_instructions()
 	return instructions - Step_instructions;
 }
 
+void debugger_rewind_execution()
+{
+	Debug_mode             = DEBUG_PAUSE;
+	Step_clocks            = clockticks6502;
+	Step_instructions      = instructions;
+	Step_interrupt         = state6502.status & 0x04;
+	Interrupt_check        = Step_interrupt;
+	Step_instruction_count = 0;
+	Watch_hit_pending      = false;
+}
+
+bool debugger_exec_breakpoint_hit()
+{
+	const auto [addr, bank] = get_current_pc();
+	const auto flags        = get_flags(addr, bank);
+	if (!(flags & DEBUG6502_EXEC)) {
+		return false;
+	}
+	if (flags & DEBUG6502_CONDITION) {
+		return (flags & DEBUG6502_EXPRESSION) && debugger_evaluate_condition(addr, bank);
+	}
+	return true;
+}
+
 void debugger_interrupt()
 {
 	Interrupt_check |= state6502.status & 0x04;
@@ -366,10 +543,34 @@ uint8_t debugger_get_flags(uint16_t address, uint8_t bank)
 	return flags & 0xf;
 }
 
+static bool compile_expression(const std::string &text, boxmon::expression_program &program)
+{
+	const boxmon::expression *expression = nullptr;
+	const char               *text_cstr  = text.c_str();
+
+	bool compiled = Condition_parser.parse_expression(expression, text_cstr, boxmon::expression_parse_flags_must_consume_all | boxmon::expression_parse_flags_suppress_errors) && expression->compile(program);
+	if (!compiled) {
+		program.clear();
+	}
+	delete expression;
+	return compiled;
+}
+
+static void free_condition(uint32_t offset)
+{
+	if (const uint16_t slot = Breakpoint_condition_slots[offset]; slot != 0) {
+		Breakpoint_conditions[slot].text.clear();
+		Breakpoint_conditions[slot].program.clear();
+		Free_condition_slots.push_back(slot);
+		Breakpoint_condition_slots[offset] = 0;
+	}
+	Breakpoint_flags[offset] &= ~DEBUG6502_EXPRESSION;
+}
+
 std::string debugger_get_condition(uint16_t address, uint8_t bank)
 {
-	if (auto condition = Breakpoint_conditions.find(get_offset(address, bank)); condition != Breakpoint_conditions.end()) {
-		return condition->second;
+	if (const uint16_t slot = Breakpoint_condition_slots[get_offset(address, bank)]; slot != 0) {
+		return Breakpoint_conditions[slot].text;
 	}
 	return "";
 }
@@ -379,38 +580,49 @@ void debugger_set_condition(uint16_t address, uint8_t bank, const std::string &c
 	const uint32_t offset = get_offset(address, bank);
 
 	if (condition.empty()) {
-		Breakpoint_flags[offset] &= ~DEBUG6502_EXPRESSION;
-
-		if (auto citer = Breakpoint_conditions.find(offset); citer != Breakpoint_conditions.end()) {
-			Breakpoint_conditions.erase(citer);
-		}
-		if (auto eiter = Breakpoint_expressions.find(offset); eiter != Breakpoint_expressions.end()) {
-			Breakpoint_expressions.erase(eiter);
-		}
-	} else {
-		Breakpoint_conditions[offset] = condition;
+		free_condition(offset);
+		return;
+	}
 
-		const boxmon::expression *expression = nullptr;
-		const char               *condition_cstr = condition.c_str();
-		if (Condition_parser.parse_expression(expression, condition_cstr, boxmon::expression_parse_flags_must_consume_all | boxmon::expression_parse_flags_suppress_errors)) {
-			Breakpoint_expressions[offset] = expression;
-			Breakpoint_flags[offset] |= DEBUG6502_EXPRESSION;
+	uint16_t slot = Breakpoint_condition_slots[offset];
+	if (slot == 0) {
+		if (!Free_condition_slots.empty()) {
+			slot = Free_condition_slots.back();
+			Free_condition_slots.pop_back();
+		} else if (Breakpoint_conditions.size() <= UINT16_MAX) {
+			slot = (uint16_t)Breakpoint_conditions.size();
+			Breakpoint_conditions.emplace_back();
 		} else {
-			if (auto eiter = Breakpoint_expressions.find(offset); eiter != Breakpoint_expressions.end()) {
-				Breakpoint_expressions.erase(eiter);
-			}
-			Breakpoint_flags[offset] &= ~DEBUG6502_EXPRESSION;
+			return;
 		}
+		Breakpoint_condition_slots[offset] = slot;
+	}
+
+	breakpoint_condition &bc = Breakpoint_conditions[slot];
+	bc.text                  = condition;
+	bc.symbols_generation    = symbols_get_generation();
+
+	// The condition text is kept even if it doesn't parse, so it can be edited.
+	if (compile_expression(condition, bc.program)) {
+		Breakpoint_flags[offset] |= DEBUG6502_EXPRESSION;
+	} else {
+		Breakpoint_flags[offset] &= ~DEBUG6502_EXPRESSION;
 	}
 }
 
 bool debugger_evaluate_condition(uint16_t address, uint8_t bank)
 {
-	const uint32_t offset = get_offset(address, bank);
-	if (auto eiter = Breakpoint_expressions.find(offset); eiter != Breakpoint_expressions.end()) {
-		return (eiter->second->evaluate() != 0);
+	const uint16_t slot = Breakpoint_condition_slots[get_offset(address, bank)];
+	if (slot == 0) {
+		return false;
 	}
-	return false;
+
+	breakpoint_condition &bc = Breakpoint_conditions[slot];
+	if (bc.symbols_generation != symbols_get_generation()) {
+		bc.program.resolve_symbols();
+		bc.symbols_generation = symbols_get_generation();
+	}
+	return bc.program.evaluate() != 0;
 }
 
 bool debugger_has_valid_expression(uint16_t address, uint8_t bank)
@@ -455,13 +667,7 @@ void debugger_remove_breakpoint(uint16_t address, uint8_t bank /* = 0 */, uint8_
 		Breakpoints.erase(old_bp);
 		Active_breakpoints.erase(old_bp);
 
-		const uint32_t offset = get_offset(address, bank);
-		if (auto citer = Breakpoint_conditions.find(offset); citer != Breakpoint_conditions.end()) {
-			Breakpoint_conditions.erase(citer);
-		}
-		if (auto eiter = Breakpoint_expressions.find(offset); eiter != Breakpoint_expressions.end()) {
-			Breakpoint_expressions.erase(eiter);
-		}
+		free_condition(get_offset(address, bank));
 	}
 }
 
@@ -569,3 +775,382 @@ const watch_address_list &debugger_get_watchlist()
 {
 	return Watchlist;
 }
+
+//
+// Watchpoints
+//
+
+static uint32_t add_watchpoint(bool vram, uint32_t start, uint32_t end, uint8_t flags)
+{
+	const uint32_t limit = vram ? 0x1ffff : Watch_cpu_space_size - 1;
+	if (start > end) {
+		std::swap(start, end);
+	}
+	if (start > limit || (flags & (DEBUGGER_WATCH_READ | DEBUGGER_WATCH_WRITE | DEBUGGER_WATCH_CHANGE)) == 0) {
+		return 0;
+	}
+
+	watchpoint &wp = Watchpoints.emplace_back();
+	wp.id          = Next_watchpoint_id++;
+	wp.vram        = vram;
+	wp.enabled     = true;
+	wp.flags       = flags & (DEBUGGER_WATCH_READ | DEBUGGER_WATCH_WRITE | DEBUGGER_WATCH_CHANGE);
+	wp.start       = start;
+	wp.end         = std::min(end, limit);
+	wp.hits        = 0;
+
+	rebuild_watch_tables();
+	return wp.id;
+}
+
+uint32_t debugger_add_watchpoint(uint16_t start_address, uint8_t start_bank, uint16_t end_address, uint8_t end_bank, uint8_t flags)
+{
+	return add_watchpoint(false, get_offset(start_address, start_bank), get_offset(end_address, end_bank), flags);
+}
+
+uint32_t debugger_add_vram_watchpoint(uint32_t start_address, uint32_t end_address, uint8_t flags)
+{
+	return add_watchpoint(true, start_address, end_address, flags);
+}
+
+void debugger_remove_watchpoint(uint32_t id)
+{
+	std::erase_if(Watchpoints, [id](const watchpoint &wp) { return wp.id == id; });
+	rebuild_watch_tables();
+}
+
+void debugger_enable_watchpoint(uint32_t id, bool enabled)
+{
+	for (watchpoint &wp : Watchpoints) {
+		if (wp.id == id) {
+			wp.enabled = enabled;
+		}
+	}
+	rebuild_watch_tables();
+}
+
+const watchpoint_list &debugger_get_watchpoints()
+{
+	return Watchpoints;
+}
+
+std::string debugger_format_watch_address(const watchpoint &wp, uint32_t offset)
+{
+	if (wp.vram) {
+		return fmt::format("{:05x}", offset);
+	}
+	if (offset < 0xa000) {
+		return fmt::format("{:04x}", offset);
+	}
+	const uint32_t banked = offset - 0xa000;
+	return fmt::format("{:02x}:{:04x}", banked / 0x6000, 0xa000 + banked % 0x6000);
+}
+
+static void report_watch_hit(watchpoint &wp, uint32_t offset, uint8_t kind, uint8_t old_value, uint8_t new_value)
+{
+	++wp.hits;
+	const auto [pc, bank] = get_current_pc();
+	if (kind == DEBUGGER_WATCH_READ) {
+		boxmon_console_print("Watchpoint {} hit: read ${:02x} from {} at PC:{:02x}:{:04x}", wp.id, new_value, debugger_format_watch_address(wp, offset), bank, pc);
+	} else {
+		boxmon_console_print("Watchpoint {} hit: write ${:02x} -> ${:02x} to {} at PC:{:02x}:{:04x}", wp.id, old_value, new_value, debugger_format_watch_address(wp, offset), bank, pc);
+	}
+}
+
+static bool match_watch_kind(const watchpoint &wp, uint8_t kind, uint8_t old_value, uint8_t new_value)
+{
+	if (kind == DEBUGGER_WATCH_READ) {
+		return wp.flags & DEBUGGER_WATCH_READ;
+	}
+	return (wp.flags & DEBUGGER_WATCH_WRITE) || ((wp.flags & DEBUGGER_WATCH_CHANGE) && old_value != new_value);
+}
+
+uint8_t debugger_watch_cpu_hit(uint16_t address, uint8_t bank, uint8_t kind, uint8_t value)
+{
+	// The instruction that stopped on a watchpoint is run again when execution resumes, and
+	// accesses re-executed while rewinding have already been reported.
+	if (debugger_step_clocks() == 0 || Rewind_replaying) {
+		return 0;
+	}
+
+	if (address < 0xa000) {
+		bank = 0;
+	}
+	const uint32_t offset    = get_offset(address, bank);
+	const uint8_t  old_value = debug_read6502(address, bank);
+	const uint8_t  new_value = kind == DEBUGGER_WATCH_READ ? old_value : value;
+
+	bool hit = false;
+	Watch_cpu_intervals.find(offset, [&](size_t index) {
+		watchpoint &wp = Watchpoints[index];
+		if (match_watch_kind(wp, kind, old_value, new_value)) {
+			report_watch_hit(wp, offset, kind, old_value, new_value);
+			hit = true;
+		}
+	});
+
+	if (!hit) {
+		return 0;
+	}
+	Watch_hit_pending = true;
+	return kind == DEBUGGER_WATCH_READ ? DEBUG6502_READ : DEBUG6502_WRITE;
+}
+
+void debugger_watch_vram_hit(uint32_t address, uint8_t kind, uint8_t old_value, uint8_t new_value)
+{
+	// VRAM accesses can't be undone, so they stop execution after the current instruction.
+	// Writes made from the debugger UI while paused don't count.
+	if (Debug_mode == DEBUG_PAUSE || Rewind_replaying) {
+		return;
+	}
+
+	bool hit = false;
+	Watch_vram_intervals.find(address, [&](size_t index) {
+		watchpoint &wp = Watchpoints[index];
+		if (match_watch_kind(wp, kind, old_value, new_value)) {
+			report_watch_hit(wp, address, kind, old_value, new_value);
+			hit = true;
+		}
+	});
+
+	if (hit) {
+		debugger_pause_execution();
+	}
+}
+
+//
+// Tracepoints
+//
+
+static const std::vector<std::string> Empty_value_list;
+
+static tracepoint *find_tracepoint(uint16_t address, uint8_t bank)
+{
+	if (address < 0xa000) {
+		bank = 0;
+	}
+	if (const uint16_t slot = Tracepoint_slots[get_offset(address, bank)]; slot != 0) {
+		return &Tracepoint_data[slot];
+	}
+	return nullptr;
+}
+
+void debugger_add_tracepoint(uint16_t address, uint8_t bank /* = 0 */, uint8_t flags /* = 0 */)
+{
+	if (address < 0xa000) {
+		bank = 0;
+	}
+
+	const uint32_t offset = get_offset(address, bank);
+
+	uint16_t slot = Tracepoint_slots[offset];
+	if (slot == 0) {
+		if (!Free_tracepoint_slots.empty()) {
+			slot = Free_tracepoint_slots.back();
+			Free_tracepoint_slots.pop_back();
+		} else if (Tracepoint_data.size() <= UINT16_MAX) {
+			slot = (uint16_t)Tracepoint_data.size();
+			Tracepoint_data.emplace_back();
+		} else {
+			return;
+		}
+		Tracepoint_slots[offset] = slot;
+		Tracepoints.insert({ address, bank });
+
+		tracepoint &tp = Tracepoint_data[slot];
+		tp.condition_text.clear();
+		tp.condition.clear();
+		tp.condition_valid = false;
+		tp.value_text.clear();
+		tp.num_values         = 0;
+		tp.symbols_generation = symbols_get_generation();
+	}
+
+	Tracepoint_data[slot].flags = flags;
+}
+
+void debugger_remove_tracepoint(uint16_t address, uint8_t bank /* = 0 */)
+{
+	if (address < 0xa000) {
+		bank = 0;
+	}
+
+	const uint32_t offset = get_offset(address, bank);
+	if (const uint16_t slot = Tracepoint_slots[offset]; slot != 0) {
+		Free_tracepoint_slots.push_back(slot);
+		Tracepoint_slots[offset] = 0;
+		Tracepoints.erase({ address, bank });
+	}
+}
+
+bool debugger_has_tracepoint(uint16_t address, uint8_t bank /* = 0 */)
+{
+	return find_tracepoint(address, bank) != nullptr;
+}
+
+uint8_t debugger_get_tracepoint_flags(uint16_t address, uint8_t bank)
+{
+	const tracepoint *tp = find_tracepoint(address, bank);
+	return tp != nullptr ? tp->flags : 0;
+}
+
+void debugger_set_tracepoint_flags(uint16_t address, uint8_t bank, uint8_t flags)
+{
+	if (tracepoint *tp = find_tracepoint(address, bank); tp != nullptr) {
+		tp->flags = flags;
+	}
+}
+
+std::string debugger_get_tracepoint_condition(uint16_t address, uint8_t bank)
+{
+	const tracepoint *tp = find_tracepoint(address, bank);
+	return tp != nullptr ? tp->condition_text : Empty_string;
+}
+
+bool debugger_set_tracepoint_condition(uint16_t address, uint8_t bank, const std::string &condition)
+{
+	tracepoint *tp = find_tracepoint(address, bank);
+	if (tp == nullptr) {
+		return false;
+	}
+
+	tp->condition_text  = condition;
+	tp->condition_valid = !condition.empty() && compile_expression(condition, tp->condition);
+	return condition.empty() || tp->condition_valid;
+}
+
+bool debugger_add_tracepoint_value(uint16_t address, uint8_t bank, const std::string &value)
+{
+	tracepoint *tp = find_tracepoint(address, bank);
+	if (tp == nullptr || tp->num_values >= Num_debugger_trace_values) {
+		return false;
+	}
+
+	if (!compile_expression(value, tp->values[tp->num_values])) {
+		return false;
+	}
+	tp->value_text.push_back(value);
+	++tp->num_values;
+	return true;
+}
+
+void debugger_clear_tracepoint_values(uint16_t address, uint8_t bank)
+{
+	if (tracepoint *tp = find_tracepoint(address, bank); tp != nullptr) {
+		tp->value_text.clear();
+		tp->num_values = 0;
+	}
+}
+
+const std::vector<std::string> &debugger_get_tracepoint_values(uint16_t address, uint8_t bank)
+{
+	const tracepoint *tp = find_tracepoint(address, bank);
+	return tp != nullptr ? tp->value_text : Empty_value_list;
+}
+
+const tracepoint_list &debugger_get_tracepoints()
+{
+	return Tracepoints;
+}
+
+void debugger_trace_cpu()
+{
+	if (Tracepoints.empty() || waiting) {
+		return;
+	}
+
+	const uint16_t pc   = state6502.pc;
+	const uint8_t  bank = pc >= 0xa000 ? memory_get_current_bank(pc) : 0;
+	const uint16_t slot = Tracepoint_slots[get_offset(pc, bank)];
+	if (slot == 0) {
+		return;
+	}
+
+	// An instruction that stopped on a breakpoint is tried again when execution resumes.
+	if (clockticks6502 == Last_trace_clock) {
+		return;
+	}
+
+	tracepoint &tp = Tracepoint_data[slot];
+	if (tp.symbols_generation != symbols_get_generation()) {
+		tp.condition.resolve_symbols();
+		for (uint8_t i = 0; i < tp.num_values; ++i) {
+			tp.values[i].resolve_symbols();
+		}
+		tp.symbols_generation = symbols_get_generation();
+	}
+
+	if (!tp.condition_text.empty() && (!tp.condition_valid || tp.condition.evaluate() == 0)) {
+		return;
+	}
+
+	Last_trace_clock = clockticks6502;
+
+	tracepoint_event &event = Trace_ring[Trace_head & (Trace_ring_size - 1)];
+	++Trace_head;
+
+	event.clock      = clockticks6502;
+	event.state      = state6502;
+	event.bank       = bank;
+	event.num_values = tp.num_values;
+	for (uint8_t i = 0; i < tp.num_values; ++i) {
+		event.values[i] = tp.values[i].evaluate();
+	}
+
+	if (tp.flags & DEBUGGER_TRACE_LOG) {
+		boxmon_console_print("{}", debugger_format_trace_event(event));
+	}
+}
+
+void debugger_clear_trace()
+{
+	Trace_head       = 0;
+	Last_trace_clock = UINT64_MAX;
+}
+
+uint64_t debugger_get_trace_total()
+{
+	return Trace_head;
+}
+
+size_t debugger_get_trace_count()
+{
+	return Trace_head < Trace_ring_size ? static_cast<size_t>(Trace_head) : Trace_ring_size;
+}
+
+const tracepoint_event &debugger_get_trace_event(size_t index)
+{
+	const uint64_t first = Trace_head - debugger_get_trace_count();
+	return Trace_ring[(first + index) & (Trace_ring_size - 1)];
+}
+
+std::string debugger_format_trace_event(const tracepoint_event &event)
+{
+	const _state6502 &state = event.state;
+
+	std::string text = fmt::format("{:12d} PC:{:02x}:{:04x} A:{:02x} X:{:02x} Y:{:02x} SP:{:02x} ST:{:c}{:c}-{:c}{:c}{:c}{:c}{:c}",
+	    event.clock, event.bank, state.pc, state.a, state.x, state.y, state.sp,
+	    state.status & 0x80 ? 'N' : '-',
+	    state.status & 0x40 ? 'V' : '-',
+	    state.status & 0x10 ? 'B' : '-',
+	    state.status & 0x08 ? 'D' : '-',
+	    state.status & 0x04 ? 'I' : '-',
+	    state.status & 0x02 ? 'Z' : '-',
+	    state.status & 0x01 ? 'C' : '-');
+
+	const symbol_list_type &symbols = symbols_find(state.pc, event.bank);
+	if (!symbols.empty()) {
+		text += fmt::format(" {}", symbols.front());
+	}
+
+	// Values are labelled with their expressions if the tracepoint is still around to ask.
+	const std::vector<std::string> &value_text = debugger_get_tracepoint_values(state.pc, event.bank);
+	for (uint8_t i = 0; i < event.num_values; ++i) {
+		if (i < value_text.size()) {
+			text += fmt::format(" {}={}", value_text[i], event.values[i]);
+		} else {
+			text += fmt::format(" {}", event.values[i]);
+		}
+	}
+	return text;
+}
@@ -9,6 +9,7 @@
 #	include <string>
 #	include <set>
 #	include <tuple>
+#	include <vector>
 
 #	include "boxmon/parser.h"
 #	include "cpu/fake6502.h"
@@ -39,6 +40,13 @@ uint32_t debugger_step_instructions();
 void     debugger_interrupt();
 bool     debugger_step_interrupted();
 
+// Pause at the current position after the machine has been rewound to it.
+void debugger_rewind_execution();
+
+// Whether an active execution breakpoint, including its condition, matches the current PC.
+// Unlike debugger_process_cpu(), this never changes the debugger's state.
+bool debugger_exec_breakpoint_hit();
+
 uint8_t     debugger_get_flags(uint16_t address, uint8_t bank);
 std::string debugger_get_condition(uint16_t address, uint8_t bank);
 void        debugger_set_condition(uint16_t address, uint8_t bank, const std::string &condition);
@@ -80,4 +88,120 @@ void debugger_remove_watch(uint16_t address, uint8_t bank, uint8_t size);
 
 const watch_address_list &debugger_get_watchlist();
 
+//
+// Watchpoints
+//
+// Watchpoints pause execution when a range of CPU memory or VRAM is read, written, or
+// written with a different value. CPU accesses stop before the instruction completes,
+// like breakpoints, while VRAM accesses stop once the instruction that made them is done.
+//
+
+#	define DEBUGGER_WATCH_READ 0x01
+#	define DEBUGGER_WATCH_WRITE 0x02
+#	define DEBUGGER_WATCH_CHANGE 0x04
+
+struct watchpoint {
+	uint32_t id;
+	bool     vram;
+	bool     enabled;
+	uint8_t  flags;
+	uint32_t start; // CPU offsets are address + bank * $6000 for addresses >= $A000.
+	uint32_t end;   // Inclusive.
+	uint64_t hits;
+};
+
+using watchpoint_list = std::vector<watchpoint>;
+
+uint32_t debugger_add_watchpoint(uint16_t start_address, uint8_t start_bank, uint16_t end_address, uint8_t end_bank, uint8_t flags);
+uint32_t debugger_add_vram_watchpoint(uint32_t start_address, uint32_t end_address, uint8_t flags);
+void     debugger_remove_watchpoint(uint32_t id);
+void     debugger_enable_watchpoint(uint32_t id, bool enabled);
+
+const watchpoint_list &debugger_get_watchpoints();
+
+std::string debugger_format_watch_address(const watchpoint &wp, uint32_t offset);
+
+// Per-page masks of the kinds of watchpoints present, so that accesses to a page without
+// any cost a single lookup.
+extern uint8_t *Debugger_watch_cpu_pages;
+extern uint8_t  Debugger_watch_vram_pages[0x20000 >> 8];
+
+uint8_t debugger_watch_cpu_hit(uint16_t address, uint8_t bank, uint8_t kind, uint8_t value);
+void    debugger_watch_vram_hit(uint32_t address, uint8_t kind, uint8_t old_value, uint8_t new_value);
+
+// Return DEBUG6502_READ or DEBUG6502_WRITE if the access should stop the CPU.
+inline uint8_t debugger_watch_cpu_read(uint16_t address, uint8_t bank)
+{
+	const uint32_t offset = address >= 0xa000 ? address + bank * 0x6000 : address;
+	return (Debugger_watch_cpu_pages[offset >> 8] & DEBUGGER_WATCH_READ) ? debugger_watch_cpu_hit(address, bank, DEBUGGER_WATCH_READ, 0) : 0;
+}
+
+inline uint8_t debugger_watch_cpu_write(uint16_t address, uint8_t bank, uint8_t value)
+{
+	const uint32_t offset = address >= 0xa000 ? address + bank * 0x6000 : address;
+	return (Debugger_watch_cpu_pages[offset >> 8] & (DEBUGGER_WATCH_WRITE | DEBUGGER_WATCH_CHANGE)) ? debugger_watch_cpu_hit(address, bank, DEBUGGER_WATCH_WRITE, value) : 0;
+}
+
+inline void debugger_watch_vram_read(uint32_t address, uint8_t value)
+{
+	address &= 0x1ffff;
+	if (Debugger_watch_vram_pages[address >> 8] & DEBUGGER_WATCH_READ) {
+		debugger_watch_vram_hit(address, DEBUGGER_WATCH_READ, value, value);
+	}
+}
+
+inline void debugger_watch_vram_write(uint32_t address, uint8_t old_value, uint8_t new_value)
+{
+	address &= 0x1ffff;
+	if (Debugger_watch_vram_pages[address >> 8] & (DEBUGGER_WATCH_WRITE | DEBUGGER_WATCH_CHANGE)) {
+		debugger_watch_vram_hit(address, DEBUGGER_WATCH_WRITE, old_value, new_value);
+	}
+}
+
+//
+// Tracepoints
+//
+// A tracepoint records the CPU state into a preallocated ring each time execution reaches
+// its address, without pausing. Logpoints are tracepoints which also print each event to
+// the monitor console.
+//
+
+using tracepoint_list = std::set<breakpoint_type>;
+
+#	define DEBUGGER_TRACE_LOG 0x01
+
+constexpr const uint8_t Num_debugger_trace_values = 4;
+
+struct tracepoint_event {
+	uint64_t   clock;
+	_state6502 state;
+	uint8_t    bank;
+	uint8_t    num_values;
+	int32_t    values[Num_debugger_trace_values];
+};
+
+void debugger_add_tracepoint(uint16_t address, uint8_t bank = 0, uint8_t flags = 0);
+void debugger_remove_tracepoint(uint16_t address, uint8_t bank = 0);
+bool debugger_has_tracepoint(uint16_t address, uint8_t bank = 0);
+
+uint8_t     debugger_get_tracepoint_flags(uint16_t address, uint8_t bank);
+void        debugger_set_tracepoint_flags(uint16_t address, uint8_t bank, uint8_t flags);
+std::string debugger_get_tracepoint_condition(uint16_t address, uint8_t bank);
+bool        debugger_set_tracepoint_condition(uint16_t address, uint8_t bank, const std::string &condition);
+bool        debugger_add_tracepoint_value(uint16_t address, uint8_t bank, const std::string &value);
+void        debugger_clear_tracepoint_values(uint16_t address, uint8_t bank);
+
+const std::vector<std::string> &debugger_get_tracepoint_values(uint16_t address, uint8_t bank);
+const tracepoint_list          &debugger_get_tracepoints();
+
+// Called once per instruction, before it executes.
+void debugger_trace_cpu();
+
+// Events are indexed from the oldest still held in the ring.
+void                    debugger_clear_trace();
+uint64_t                debugger_get_trace_total();
+size_t                  debugger_get_trace_count();
+const tracepoint_event &debugger_get_trace_event(size_t index);
+std::string             debugger_format_trace_event(const tracepoint_event &event);
+
 #endif
@@ -728,10 +728,13 @@ void display_refund_render_time(uint32_t time_us)
 
 namespace ImGui
 {
-	bool TileButton(display_icons icon, bool enabled, bool *hovered)
+	bool TileButton(display_icons icon, bool enabled, bool *hovered, bool mirrored)
 	{
 		ImVec2 topleft{ (float)((int)icon % 16) / 16.0f, (float)((int)icon >> 4) / 16.0f };
 		ImVec2 botright{ topleft.x + 1.0f / 16.0f, topleft.y + 1.0f / 16.0f };
+		if (mirrored) {
+			std::swap(topleft.x, botright.x);
+		}
 
 		ImVec4 tint = [&]() {
 			if (!enabled) {
@@ -743,7 +746,7 @@ namespace ImGui
 			return ImVec4(1, 1, 1, 1);
 		}();
 
-		PushID(icon);
+		PushID(mirrored ? icon | 0x100 : icon);
 		bool result = [&]() {
 			if (enabled) {
 				const std::string title = fmt::format("##{}", (ImTextureID)(intptr_t)Icon_tilemap);
@@ -96,7 +96,7 @@ enum display_icons {
 
 namespace ImGui
 {
-	bool TileButton(display_icons icon, bool enabled = true, bool *hovered = nullptr);
+	bool TileButton(display_icons icon, bool enabled = true, bool *hovered = nullptr, bool mirrored = false);
 	void Tile(display_icons icon, float alpha = 1.0f);
 	void Tile(display_icons icon, ImVec2 size, float alpha = 1.0f);
 	void TileDisabled(display_icons icon);
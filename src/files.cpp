@@ -8,8 +8,10 @@
 #include <unistd.h> // Added to resolve Microsoft c++ warnings around POSIX and other depreciated errors.
 #include <zlib.h>
 
+#include <algorithm>
 #include <sstream>
 
+#include "block_image.h"
 #include "options.h"
 #include "zlib.h"
 
@@ -82,16 +84,103 @@ std::tuple<void *, size_t> files_load(const std::filesystem::path &path)
 struct x16file {
 	std::filesystem::path path;
 
-	SDL_RWops *file;
-	size_t     size;
-	size_t     pos;
-	bool       modified;
+	SDL_RWops     *file;
+	block_image   *image;
+	const uint8_t *memory; // contents of a read-only file that's already in memory
+	bool           memory_owned;
+	size_t         size;
+	size_t       pos;
+	bool         modified;
 
 	x16file *next;
 };
 
 x16file *open_files = NULL;
 
+// Compressed files opened read-only are inflated straight into memory, rather than into a temp
+// file, unless they'd take more than this.
+static constexpr size_t Max_inflated_in_memory = 256 * 1024 * 1024;
+
+static bool is_read_only(const char *attribs)
+{
+	return strchr(attribs, 'w') == NULL && strchr(attribs, 'a') == NULL && strchr(attribs, '+') == NULL;
+}
+
+// The uncompressed size recorded in a gzip file's trailer. It's only kept modulo 4GB, so it's a
+// guess for anything bigger, or for a file with more than one gzip member. Files gzread() passes
+// through uncompressed are their own size.
+static size_t gzip_inflated_size(const std::filesystem::path &path)
+{
+	SDL_RWops *file = SDL_RWFromFile(path.generic_string().c_str(), "rb");
+	if (file == NULL) {
+		return 0;
+	}
+
+	const Sint64 file_size = SDL_RWsize(file);
+	uint8_t      magic[2]  = {};
+	uint8_t      trailer[4];
+	size_t       size = file_size > 0 ? (size_t)file_size : 0;
+	if (SDL_RWread(file, magic, 2, 1) == 1 && magic[0] == 0x1f && magic[1] == 0x8b && SDL_RWseek(file, -4, RW_SEEK_END) >= 0 && SDL_RWread(file, trailer, 4, 1) == 1) {
+		size = (size_t)trailer[0] | ((size_t)trailer[1] << 8) | ((size_t)trailer[2] << 16) | ((size_t)trailer[3] << 24);
+	}
+	SDL_RWclose(file);
+	return size;
+}
+
+// Inflate a whole compressed file into a malloc()ed buffer, starting with one of 'size' bytes.
+// Returns NULL if it can't be decompressed, or turns out to be bigger than Max_inflated_in_memory.
+static uint8_t *inflate_to_memory(const std::filesystem::path &path, size_t &size)
+{
+	gzFile zfile = gzopen(path.generic_string().c_str(), "rb");
+	if (zfile == Z_NULL) {
+		fmt::print("Could not open file for decompression: {}\n", path.generic_string());
+		return NULL;
+	}
+	gzbuffer(zfile, 128 * 1024);
+
+	size_t   capacity = size ? size : 1;
+	uint8_t *buffer   = (uint8_t *)malloc(capacity);
+	size_t   total    = 0;
+	while (buffer != NULL) {
+		if (total == capacity) {
+			if (capacity >= Max_inflated_in_memory) {
+				uint8_t probe;
+				if (gzread(zfile, &probe, 1) == 0) {
+					break;
+				}
+				options_log_verbose("{} is too big to decompress into memory\n", path.generic_string());
+				free(buffer);
+				buffer = NULL;
+				break;
+			}
+
+			// The trailer undersold it; keep going with twice the room.
+			capacity = std::min(capacity * 2, Max_inflated_in_memory);
+			uint8_t *grown = (uint8_t *)realloc(buffer, capacity);
+			if (grown == NULL) {
+				free(buffer);
+				buffer = NULL;
+				break;
+			}
+			buffer = grown;
+		}
+		const int read = gzread(zfile, buffer + total, (unsigned int)std::min<size_t>(capacity - total, INT_MAX));
+		if (read < 0) {
+			fmt::print("Could not decompress file: {}\n", path.generic_string());
+			free(buffer);
+			buffer = NULL;
+			break;
+		} else if (read == 0) {
+			break;
+		}
+		total += read;
+	}
+	gzclose(zfile);
+
+	size = total;
+	return buffer;
+}
+
 static bool get_tmp_name(char *path_buffer, const char *original_path, char const *extension)
 {
 	if (strlen(original_path) > PATH_MAX - strlen(extension)) {
@@ -152,10 +241,33 @@ void files_shutdown()
 x16file *x16open(const std::filesystem::path &path, const char *attribs)
 {
 	x16file *f = new x16file;
-	f->path = path;
+	f->path         = path;
+	f->file         = NULL;
+	f->image        = NULL;
+	f->memory       = NULL;
+	f->memory_owned = false;
+
+	// Sequential, read-only opens of compressed files don't need anything on disk.
+	size_t inflated_size = SIZE_MAX;
+	if (file_is_compressed_type(path) && is_read_only(attribs)) {
+		inflated_size = gzip_inflated_size(path);
+	}
+
+	if (strchr(attribs, 'w') == NULL && block_image_detect(path)) {
+		f->image = block_image_open(path, strchr(attribs, '+') != NULL);
+		if (f->image == NULL) {
+			goto error;
+		}
+		f->size = (size_t)block_image_size(f->image);
+	} else if (inflated_size <= Max_inflated_in_memory && (f->memory = inflate_to_memory(path, inflated_size)) != NULL) {
+		options_log_verbose("Decompressed {} into memory ({} bytes)\n", path.generic_string(), inflated_size);
 
-	if (file_is_compressed_type(path)) {
-		std::filesystem::path tmp_path = path / ".tmp";
+		f->memory_owned = true;
+		f->size         = inflated_size;
+	} else if (file_is_compressed_type(path)) {
+		// Anything that may be written to, or is too big to keep in memory, is decompressed into
+		// a temp file next to it, and compressed again on close if it was modified.
+		std::filesystem::path tmp_path = path.generic_string() + ".tmp";
 
 		gzFile zfile = gzopen(path.generic_string().c_str(), "rb");
 		if (zfile == Z_NULL) {
@@ -219,16 +331,41 @@ error:
 	return NULL;
 }
 
+x16file *x16open_memory(const std::filesystem::path &path, const void *data, size_t size, bool owned)
+{
+	x16file *f      = new x16file;
+	f->path         = path;
+	f->file         = NULL;
+	f->image        = NULL;
+	f->memory       = (const uint8_t *)data;
+	f->memory_owned = owned;
+	f->size         = size;
+	f->pos          = 0;
+	f->modified     = false;
+	f->next         = open_files ? open_files : NULL;
+	open_files      = f;
+
+	return f;
+}
+
 void x16close(x16file *f)
 {
 	if (f == NULL) {
 		return;
 	}
 
-	SDL_RWclose(f->file);
+	if (f->memory != NULL) {
+		if (f->memory_owned) {
+			free((void *)f->memory);
+		}
+	} else if (f->image != NULL) {
+		block_image_close(f->image);
+	} else {
+		SDL_RWclose(f->file);
+	}
 
-	if (file_is_compressed_type(f->path)) {
-		std::filesystem::path tmp_path = f->path / ".tmp";
+	if (f->image == NULL && f->memory == NULL && file_is_compressed_type(f->path)) {
+		std::filesystem::path tmp_path = f->path.generic_string() + ".tmp";
 
 		if (f->modified == false) {
 			std::filesystem::remove(tmp_path);
@@ -362,6 +499,9 @@ int x16seek(x16file *f, size_t pos, int origin)
 				f->pos = f->size;
 			}
 	}
+	if (f->image != NULL || f->memory != NULL) {
+		return (int)f->pos;
+	}
 	return (int)SDL_RWseek(f->file, f->pos, SEEK_SET);
 }
 
@@ -375,11 +515,14 @@ size_t x16tell(x16file *f)
 
 int x16write8(x16file *f, uint8_t val)
 {
-	if (f == NULL) {
+	if (f == NULL || f->memory != NULL) {
 		return 0;
 	}
-	int written = (int)SDL_RWwrite(f->file, &val, 1, 1);
+	int written = f->image != NULL ? (int)block_image_write(f->image, f->pos, &val, 1) : (int)SDL_RWwrite(f->file, &val, 1, 1);
 	f->pos += written;
+	if (f->pos > f->size) {
+		f->size = f->pos;
+	}
 	return written;
 }
 
@@ -389,21 +532,29 @@ uint8_t x16read8(x16file *f)
 		return 0;
 	}
 	uint8_t val;
-	int     read = (int)SDL_RWread(f->file, &val, 1, 1);
+	int     read;
+	if (f->memory != NULL) {
+		read = f->pos < f->size ? 1 : 0;
+	} else {
+		read = f->image != NULL ? (int)block_image_read(f->image, f->pos, &val, 1) : (int)SDL_RWread(f->file, &val, 1, 1);
+	}
 	f->pos += read;
 	return read;
 }
 
 size_t x16write(x16file *f, const void *data, size_t data_size, size_t data_count)
 {
-	if (f == NULL) {
+	if (f == NULL || f->memory != NULL || data_size == 0) {
 		return 0;
 	}
-	size_t written = SDL_RWwrite(f->file, data, data_size, data_count);
+	size_t written = f->image != NULL ? block_image_write(f->image, f->pos, data, data_size * data_count) / data_size : SDL_RWwrite(f->file, data, data_size, data_count);
 	if (written) {
 		f->modified = true;
 	}
 	f->pos += written * data_size;
+	if (f->pos > f->size) {
+		f->size = f->pos;
+	}
 	return written;
 }
 
@@ -414,10 +565,16 @@ size_t x16write(x16file *f, const std::string &str)
 
 size_t x16read(x16file *f, void *data, size_t data_size, size_t data_count)
 {
-	if (f == NULL) {
+	if (f == NULL || data_size == 0) {
 		return 0;
 	}
-	size_t read = SDL_RWread(f->file, data, data_size, data_count);
+	if (f->memory != NULL) {
+		const size_t count = f->pos < f->size ? std::min(data_count, (f->size - f->pos) / data_size) : 0;
+		memcpy(data, f->memory + f->pos, count * data_size);
+		f->pos += count * data_size;
+		return count;
+	}
+	size_t read = f->image != NULL ? block_image_read(f->image, f->pos, data, data_size * data_count) / data_size : SDL_RWread(f->file, data, data_size, data_count);
 	f->pos += read * data_size;
 	return read;
 }
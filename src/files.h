@@ -15,6 +15,8 @@ const char *file_find_extension(const char *path, const char *mark);
 void files_shutdown();
 
 x16file *x16open(const std::filesystem::path &path, const char *attribs);
+// A read-only file over 'size' bytes at 'data'. If 'owned', data was malloc()ed and is freed on close.
+x16file *x16open_memory(const std::filesystem::path &path, const void *data, size_t size, bool owned);
 void     x16close(x16file *f);
 
 size_t x16size(x16file *f);
@@ -29,6 +29,7 @@
 extern _state6502                          state6502;
 extern _state6502                          debug_state6502;
 extern uint8_t                             waiting;
+extern uint32_t                            stall6502;
 extern lazy_ring_buffer<_smart_stack, 512> stack6502;
 extern ring_buffer<_cpuhistory, 1024>      history6502;
 
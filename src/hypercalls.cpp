@@ -6,6 +6,7 @@
 
 #include "glue.h"
 #include "ieee.h"
+#include "kernal_accel.h"
 #include "keyboard.h"
 #include "loadsave.h"
 #include "memory.h"
@@ -36,6 +37,12 @@ static uint16_t Kernal_status        = 0;
 static bool     Has_boot_tasks       = false;
 static bool     prg_finished_loading = false;
 
+uint32_t Hypercall_trap_floor = 0x10000;
+
+// Lowest armed address, which Hypercall_trap_floor drops below while a KERNAL acceleration
+// verification waits for the ROM to return.
+static uint32_t Hypercall_lowest = 0x10000;
+
 static bool (*Hypercall_table[0x200])(void);
 
 static bool is_kernal()
@@ -378,17 +385,49 @@ void hypercalls_update()
 			return false;
 		};
 	}
+
+	if (Options.kernal_accel != kernal_accel_mode_t::NONE) {
+		Hypercall_table[KERNAL_MEMORY_FILL & 0x1ff] = []() -> bool {
+			return kernal_accel_call(KERNAL_MEMORY_FILL);
+		};
+		Hypercall_table[KERNAL_MEMORY_COPY & 0x1ff] = []() -> bool {
+			return kernal_accel_call(KERNAL_MEMORY_COPY);
+		};
+		Hypercall_table[KERNAL_MEMORY_CRC & 0x1ff] = []() -> bool {
+			return kernal_accel_call(KERNAL_MEMORY_CRC);
+		};
+		Hypercall_table[KERNAL_MEMORY_DECOMPRESS & 0x1ff] = []() -> bool {
+			return kernal_accel_call(KERNAL_MEMORY_DECOMPRESS);
+		};
+	}
+
+	Hypercall_lowest = 0x10000;
+	for (uint32_t i = 0; i < 0x200; ++i) {
+		if (Hypercall_table[i] != nullptr) {
+			Hypercall_lowest = 0xfe00 + i;
+			break;
+		}
+	}
+	Hypercall_trap_floor = kernal_accel_verifying() ? 0 : Hypercall_lowest;
 }
 
-void hypercalls_process()
+void hypercalls_dispatch()
 {
-	if (!is_kernal() || state6502.pc < 0xFEB1) {
-		return;
+	if (kernal_accel_verifying()) {
+		kernal_accel_verify_step();
+		if (!kernal_accel_verifying()) {
+			Hypercall_trap_floor = Hypercall_lowest;
+		}
+		if (state6502.pc < Hypercall_lowest) {
+			return;
+		}
 	}
 
 	const auto hypercall = Hypercall_table[state6502.pc & 0x1ff];
-	if (hypercall != nullptr) {
-		if (hypercall()) {
+	if (hypercall != nullptr && is_kernal()) {
+		const bool handled   = hypercall();
+		Hypercall_trap_floor = kernal_accel_verifying() ? 0 : Hypercall_lowest;
+		if (handled) {
 			state6502.pc = (RAM[0x100 + state6502.sp + 1] | (RAM[0x100 + state6502.sp + 2] << 8)) + 1;
 			state6502.sp += 2;
 
@@ -6,9 +6,25 @@
 #if !defined(HYPERCALLS_H)
 #	define HYPERCALLS_H
 
+#	include <stdint.h>
+
+#	include "glue.h"
+
+// Lowest address with a hypercall armed by hypercalls_update(), or past the end of the address
+// space when none are. Hypercalls all live at KERNAL vectors near the top of memory, so this
+// keeps the check after each instruction to a single comparison.
+extern uint32_t Hypercall_trap_floor;
+
 bool hypercalls_init();
 bool hypercalls_allowed();
 void hypercalls_update();
-void hypercalls_process();
+void hypercalls_dispatch();
+
+inline void hypercalls_process()
+{
+	if (state6502.pc >= Hypercall_trap_floor) {
+		hypercalls_dispatch();
+	}
+}
 
 #endif
\ No newline at end of file
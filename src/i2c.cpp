@@ -10,6 +10,7 @@
 #include "ring_buffer.h"
 #include "rtc.h"
 #include "smc.h"
+#include "snapshot.h"
 
 #define LOG_LEVEL 0
 #define LOG_PRINT(LEVEL, ...)          \
@@ -25,6 +26,8 @@
 
 i2c_port_t i2c_port;
 
+static i2c_port_t old_i2c_port;
+
 static int     state     = STATE_STOP;
 static bool    read_mode = false;
 static uint8_t value     = 0;
@@ -67,7 +70,6 @@ void i2c_write(uint8_t device, uint8_t offset, uint8_t value)
 
 void i2c_step()
 {
-	static i2c_port_t old_i2c_port;
 	if (old_i2c_port.clk_in != i2c_port.clk_in || old_i2c_port.data_in != i2c_port.data_in) {
 		LOG_PRINT(5, "I2C({:d}) C:{:d} D:{:d}\n", state, i2c_port.clk_in, i2c_port.data_in);
 		if (state == STATE_STOP && i2c_port.clk_in == 0 && i2c_port.data_in == 0) {
@@ -142,3 +144,17 @@ void i2c_step()
 		old_i2c_port = i2c_port;
 	}
 }
+
+void i2c_snapshot(machine_snapshot &snapshot)
+{
+	snapshot.io(i2c_port);
+	snapshot.io(old_i2c_port);
+	snapshot.io(state);
+	snapshot.io(read_mode);
+	snapshot.io(value);
+	snapshot.io(count);
+	snapshot.io(device);
+	snapshot.io(offset);
+	snapshot.io(power_led);
+	snapshot.io(activity_led);
+}
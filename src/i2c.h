@@ -20,4 +20,7 @@ extern i2c_port_t i2c_port;
 
 void i2c_step();
 
+class machine_snapshot;
+void i2c_snapshot(machine_snapshot &snapshot);
+
 #endif
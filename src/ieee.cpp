@@ -10,6 +10,7 @@
 // * main.c: IEEE KERNAL call hooks (high level)
 
 #include "ieee.h"
+#include "archive.h"
 #include "files.h"
 #include "loadsave.h"
 #include "memory.h"
@@ -18,7 +19,11 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 #include <ctime>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 #include <unistd.h>
 
 //static constexpr bool log_ieee = true;
@@ -41,14 +46,43 @@ int ieee_unit = 8;
 
 std::filesystem::path hostfscwd = "";
 
+// Host directories are read once and kept, sorted by name and with each entry's listing line
+// already rendered, until their modification time changes or something is written through us.
+// Both LOAD"$" and wildcard opens are served from these snapshots.
+struct dir_entry {
+	std::string name;
+	bool        is_directory;
+	bool        is_file;
+	std::string line;      // listing line from the link bytes up to the timestamp
+	std::string timestamp; // " YYYY-MM-DD HH:MM:SS", or empty if unavailable
+};
+
+struct dir_snapshot {
+	std::filesystem::file_time_type mtime;
+	std::vector<dir_entry>          entries;
+};
+
+static constexpr size_t Max_cached_directories = 64;
+
+static std::unordered_map<std::string, std::shared_ptr<const dir_snapshot>> Dir_cache;
+
+// Archives mounted read-only over the host filesystem, each hiding whatever is on the host at and
+// below its mount point.
+struct archive_mount {
+	std::filesystem::path mount_point;
+	archive              *arc;
+};
+
+static std::vector<archive_mount> Mounts;
+
 uint8_t                             dirlist[65536];
 int                                 dirlist_len        = 0;
 int                                 dirlist_pos        = 0;
 bool                                dirlist_cwd        = false; // whether we're doing a cwd dirlist or a normal one
 bool                                dirlist_eof        = true;
 bool                                dirlist_timestmaps = false;
-std::filesystem::directory_iterator dirlist_dirp;
-std::filesystem::directory_iterator dirlist_dirp_end;
+std::shared_ptr<const dir_snapshot> dirlist_snapshot;
+size_t                              dirlist_index = 0;
 char                                dirlist_wildcard[256];
 char                                dirlist_type_filter;
 
@@ -57,10 +91,11 @@ uint16_t cbdos_flags = 0;
 const char *blocks_free = "BLOCKS FREE.";
 
 struct channel_t {
-	char     name[80];
-	bool     read;
-	bool     write;
-	x16file *f;
+	char                  name[80];
+	bool                  read;
+	bool                  write;
+	x16file              *f;
+	std::filesystem::path dir; // directory of a file open for writing
 };
 
 channel_t channels[16];
@@ -183,51 +218,280 @@ static char *parse_dos_filename(const char *name)
 	return newname;
 }
 
-static std::filesystem::path wildcard_match(const std::filesystem::path &origin, const std::string &pattern)
+static std::string dir_cache_key(const std::filesystem::path &dir)
 {
-	for (auto const &dp : std::filesystem::directory_iterator{ origin }) {
-		auto dpname = dp.path().filename().generic_string();
+	return std::filesystem::absolute(dir).lexically_normal().generic_string();
+}
 
-		bool matched = [&]() {
-			// in a wildcard match that starts at first position, leading dot filenames are not considered
-			if (pattern[0] == '?' || pattern[0] == '*') {
-				if(dpname[0] == '.') {
-					return false;
-				}
-			} else if (pattern[0] != dpname[0]) {
-				return false;
+static void invalidate_directory(const std::filesystem::path &dir)
+{
+	Dir_cache.erase(dir_cache_key(dir));
+}
+
+static std::filesystem::path normal_path(const std::filesystem::path &path)
+{
+	const auto normal = std::filesystem::absolute(path).lexically_normal();
+	return normal.has_filename() ? normal : normal.parent_path();
+}
+
+// The archive mounted over 'path', if any, and the name of 'path' within it.
+static const archive *find_mount(const std::filesystem::path &path, std::string &name)
+{
+	if (Mounts.empty()) {
+		return nullptr;
+	}
+
+	const auto normal = normal_path(path);
+	for (const archive_mount &mount : Mounts) {
+		const auto relative = normal.lexically_relative(mount.mount_point);
+		if (relative.empty() || *relative.begin() == "..") {
+			continue;
+		}
+		name = relative == "." ? "" : relative.generic_string();
+		return mount.arc;
+	}
+	return nullptr;
+}
+
+static bool is_mounted(const std::filesystem::path &path)
+{
+	std::string name;
+	return find_mount(path, name) != nullptr;
+}
+
+static bool host_exists(const std::filesystem::path &path)
+{
+	std::string name;
+	if (const archive *arc = find_mount(path, name)) {
+		return archive_find(arc, name) != nullptr;
+	}
+	return std::filesystem::exists(path);
+}
+
+static bool host_is_directory(const std::filesystem::path &path)
+{
+	std::string name;
+	if (const archive *arc = find_mount(path, name)) {
+		const archive_entry *entry = archive_find(arc, name);
+		return entry != nullptr && entry->is_directory;
+	}
+	return std::filesystem::is_directory(path);
+}
+
+static x16file *open_mounted(const std::filesystem::path &path)
+{
+	std::string          name;
+	const archive       *arc   = find_mount(path, name);
+	const archive_entry *entry = archive_find(arc, name);
+	if (entry == nullptr || entry->is_directory) {
+		return nullptr;
+	}
+
+	const uint8_t *data;
+	uint8_t       *owned;
+	if (!archive_extract(arc, *entry, data, owned)) {
+		return nullptr;
+	}
+	return x16open_memory(path, data, (size_t)entry->size, owned != nullptr);
+}
+
+static dir_entry make_dir_entry(const std::string &name, bool is_directory, bool is_file, uintmax_t size, const time_t *fttime)
+{
+	dir_entry entry;
+	entry.name         = name;
+	entry.is_directory = is_directory;
+	entry.is_file      = is_file;
+
+	const int file_size = is_file ? static_cast<int>(std::min<uintmax_t>((size + 255) / 256, 0xFFFF)) : 0;
+
+	std::string &line = entry.line;
+	// link
+	line += (char)1;
+	line += (char)1;
+
+	line += (char)(file_size & 0xFF);
+	line += (char)(file_size >> 8);
+	if (file_size < 1000) {
+		line += ' ';
+		if (file_size < 100) {
+			line += ' ';
+			if (file_size < 10) {
+				line += ' ';
 			}
+		}
+	}
+	line += '"';
+	line += entry.name;
+	line += '"';
+	for (size_t i = entry.name.length(); i < 16; i++) {
+		line += ' ';
+	}
+	line += ' ';
+	line += entry.is_directory ? "DIR" : "PRG";
+	// This would be a '<' if file were protected, but it's a space instead
+	line += ' ';
+
+	if (fttime != nullptr) {
+		// ISO-8601 date+time
+		const tm *mtime = std::localtime(fttime);
+		if (mtime != nullptr) {
+			char buffer[32];
+			buffer[0] = ' '; // space before the date
+			entry.timestamp.assign(buffer, 1 + strftime(buffer + 1, sizeof(buffer) - 1, "%Y-%m-%d %H:%M:%S", mtime));
+		}
+	}
+	return entry;
+}
 
-			for (size_t i = 1, j = 1; i < pattern.length() && j < dpname.length(); ++i) {
-				switch (pattern[i]) {
-					case '?':
-						++j;
-						break;
-					case '*':
-						++i;
-						if (i >= pattern.length()) {
-							return true;
-						}
-						while (pattern[i] != dpname[j] && j < dpname.length()) {
-							++j;
-						}
-						if (j >= dpname.length()) {
-							return false;
-						}
-						break;
-					default:
-						if (pattern[i] != dpname[j]) {
-							return false;
-						}
-						++j;
-						break;
+static dir_entry make_dir_entry(const std::filesystem::directory_entry &dp)
+{
+	std::error_code ec;
+
+	const auto st           = dp.status(ec);
+	const bool is_directory = std::filesystem::is_directory(st);
+	const bool is_file      = std::filesystem::is_regular_file(st);
+
+	uintmax_t size = 0;
+	if (is_file) {
+		size = dp.file_size(ec);
+		size = ec ? 0 : size;
+	}
+
+	const auto   fwtime = dp.last_write_time(ec);
+	const time_t fttime = fwtime.time_since_epoch().count();
+	return make_dir_entry(dp.path().filename().generic_string(), is_directory, is_file, size, ec ? nullptr : &fttime);
+}
+
+static dir_entry make_dir_entry(const archive_entry &entry)
+{
+	const size_t slash = entry.name.find_last_of('/');
+	return make_dir_entry(slash == std::string::npos ? entry.name : entry.name.substr(slash + 1), entry.is_directory, !entry.is_directory, entry.size, &entry.mtime);
+}
+
+// The directory's entries as of its last modification, read again only if it has changed.
+// Directories inside a mounted archive never change, and are listed from the archive's index.
+static std::shared_ptr<const dir_snapshot> get_directory(const std::filesystem::path &dir)
+{
+	const std::string key = dir_cache_key(dir);
+
+	std::string name;
+	if (const archive *arc = find_mount(dir, name)) {
+		if (const auto cached = Dir_cache.find(key); cached != Dir_cache.end()) {
+			return cached->second;
+		}
+		const archive_entry *entry = archive_find(arc, name);
+		if (entry == nullptr || !entry->is_directory) {
+			return nullptr;
+		}
+
+		auto snapshot = std::make_shared<dir_snapshot>();
+		for (const archive_entry *child : archive_list(arc, name)) {
+			snapshot->entries.push_back(make_dir_entry(*child));
+		}
+
+		if (Dir_cache.size() >= Max_cached_directories) {
+			Dir_cache.clear();
+		}
+		Dir_cache[key] = snapshot;
+		return snapshot;
+	}
+
+	std::error_code ec;
+	const auto      mtime = std::filesystem::last_write_time(dir, ec);
+	if (ec) {
+		return nullptr;
+	}
+
+	if (const auto cached = Dir_cache.find(key); cached != Dir_cache.end() && cached->second->mtime == mtime) {
+		return cached->second;
+	}
+
+	auto snapshot   = std::make_shared<dir_snapshot>();
+	snapshot->mtime = mtime;
+	for (auto const &dp : std::filesystem::directory_iterator{ dir, ec }) {
+		if (!is_mounted(dp.path())) {
+			snapshot->entries.push_back(make_dir_entry(dp));
+		}
+	}
+	// Mount points show up as directories whether or not they exist on the host.
+	const auto normal_dir = normal_path(dir);
+	for (const archive_mount &mount : Mounts) {
+		if (mount.mount_point.parent_path() == normal_dir && mount.mount_point.has_filename()) {
+			snapshot->entries.push_back(make_dir_entry(mount.mount_point.filename().generic_string(), true, false, 0, nullptr));
+		}
+	}
+	std::sort(snapshot->entries.begin(), snapshot->entries.end(), [](const dir_entry &a, const dir_entry &b) { return a.name < b.name; });
+
+	if (Dir_cache.size() >= Max_cached_directories) {
+		Dir_cache.clear();
+	}
+	Dir_cache[key] = snapshot;
+	return snapshot;
+}
+
+// The first entry whose name could match 'pattern', found by binary search on the literal
+// characters before its first wildcard.
+static std::vector<dir_entry>::const_iterator first_candidate(const dir_snapshot &snapshot, const std::string &pattern)
+{
+	const std::string prefix = pattern.substr(0, pattern.find_first_of("?*"));
+	return std::lower_bound(snapshot.entries.begin(), snapshot.entries.end(), prefix, [](const dir_entry &entry, const std::string &prefix) { return entry.name < prefix; });
+}
+
+static bool has_prefix(const std::string &name, const std::string &pattern)
+{
+	const size_t literal = std::min(pattern.find_first_of("?*"), pattern.length());
+	return name.compare(0, literal, pattern, 0, literal) == 0;
+}
+
+static bool wildcard_matches(const std::string &pattern, const std::string &dpname)
+{
+	// in a wildcard match that starts at first position, leading dot filenames are not considered
+	if (pattern[0] == '?' || pattern[0] == '*') {
+		if (dpname[0] == '.') {
+			return false;
+		}
+	} else if (pattern[0] != dpname[0]) {
+		return false;
+	}
+
+	for (size_t i = 1, j = 1; i < pattern.length() && j < dpname.length(); ++i) {
+		switch (pattern[i]) {
+			case '?':
+				++j;
+				break;
+			case '*':
+				++i;
+				if (i >= pattern.length()) {
+					return true;
 				}
-			}
-			return true;
-		}();
+				while (pattern[i] != dpname[j] && j < dpname.length()) {
+					++j;
+				}
+				if (j >= dpname.length()) {
+					return false;
+				}
+				break;
+			default:
+				if (pattern[i] != dpname[j]) {
+					return false;
+				}
+				++j;
+				break;
+		}
+	}
+	return true;
+}
+
+static std::filesystem::path wildcard_match(const std::filesystem::path &origin, const std::string &pattern)
+{
+	const auto snapshot = get_directory(origin);
+	if (snapshot == nullptr || pattern.empty()) {
+		return "";
+	}
 
-		if (matched) {
-			return dp.path();
+	for (auto entry = first_candidate(*snapshot, pattern); entry != snapshot->entries.end() && has_prefix(entry->name, pattern); ++entry) {
+		if (wildcard_matches(pattern, entry->name)) {
+			return origin / entry->name;
 		}
 	}
 	return "";
@@ -250,7 +514,7 @@ static std::filesystem::path resolve_path(const std::string &name, bool must_exi
 	}
 
 	const auto resolved_absolute_path = std::filesystem::absolute(resolved_path);
-	if (must_exist && !std::filesystem::exists(resolved_absolute_path)) {
+	if (must_exist && !host_exists(resolved_absolute_path)) {
 		set_error(0x62, 0, 0);
 		return "";
 	}
@@ -335,143 +599,87 @@ static int create_directory_listing(uint8_t *data, char *dirstring)
 	*data++ = ' ';
 	*data++ = 0;
 
-	if (!std::filesystem::is_directory(hostfscwd)) {
+	if (!host_is_directory(hostfscwd)) {
 		return 0;
 	}
 
-	dirlist_dirp     = std::filesystem::directory_iterator{ hostfscwd };
-	dirlist_dirp_end = std::filesystem::end(dirlist_dirp);
-	dirlist_eof      = false;
+	dirlist_snapshot = get_directory(hostfscwd);
+	if (dirlist_snapshot == nullptr) {
+		return 0;
+	}
+	dirlist_index = dirlist_wildcard[0] ? first_candidate(*dirlist_snapshot, dirlist_wildcard) - dirlist_snapshot->entries.begin() : 0;
+	dirlist_eof   = false;
 	return static_cast<int>(data - data_start);
 }
 
-static int continue_directory_listing(uint8_t *data)
+// Whether a listing pattern, as in LOAD"$:MATCH*", matches a filename. '*' matches the rest of
+// the name and '?' any one character.
+static bool listing_matches(const char *pattern, const std::string &filename)
 {
-	uint8_t *data_start = data;
-
-	while (dirlist_dirp != dirlist_dirp_end) {
-		auto const &dp = *dirlist_dirp;
-
-		const auto  &filename = dp.path().filename().generic_string();
-		const size_t namlen   = filename.length();
-		auto         st       = std::filesystem::status(dp.path());
+	// in a wildcard match that starts at first position, leading dot filenames are not considered
+	if ((pattern[0] == '*' || pattern[0] == '?') && filename[0] == '.') {
+		return false;
+	}
 
-		// Type match
-		if (dirlist_type_filter) {
-			switch (dirlist_type_filter) {
-				case 'D':
-					if (!std::filesystem::is_directory(st)) {
-						++dirlist_dirp;
-						continue;
-					}
-					break;
-				case 'P':
-					if (!std::filesystem::is_regular_file(st)) {
-						++dirlist_dirp;
-						continue;
-					}
-					break;
-			}
+	size_t i = 0;
+	for (; pattern[i] != 0 && i < filename.length(); i++) {
+		if (pattern[i] == '*') {
+			return true;
+		} else if (pattern[i] != '?' && pattern[i] != filename[i]) {
+			return false;
 		}
+	}
 
-		// don't show the . or .. in the root directory
-		// this behaves like SD card/FAT32
-		if (!strcmp("..", filename.c_str()) || !strcmp(".", filename.c_str())) {
-			if (hostfscwd == Options.fsroot_path) {
-				++dirlist_dirp;
-				continue;
-			}
-		}
+	// If we reach the end of both strings, it's a match
+	return pattern[i] == 0 && i == filename.length();
+}
 
-		if (dirlist_wildcard[0]) { // wildcard match selected
-			// in a wildcard match that starts at first position, leading dot filenames are not considered
-			if ((dirlist_wildcard[0] == '*' || dirlist_wildcard[0] == '?') && filename[0] == '.') {
-				++dirlist_dirp;
-				continue;
-			}
+static int continue_directory_listing(uint8_t *data)
+{
+	uint8_t *data_start = data;
 
-			bool found = false;
-			size_t i = 0;
-			for (; i < strlen(dirlist_wildcard) && i < filename.length(); i++) {
-				if (dirlist_wildcard[i] == '*') {
-					found = true;
-					break;
-				} else if (dirlist_wildcard[i] == '?') {
-					++dirlist_dirp;
-					continue;
-				} else if (dirlist_wildcard[i] != filename[i]) {
-					break;
-				}
-			}
+	// Entries are rendered in batches, each line only once it's known to fit with room left over
+	// for the footer.
+	const auto  &entries    = dirlist_snapshot->entries;
+	const size_t footer_len = 2 + 2 + strlen(blocks_free) + 1 + 2;
+	while (dirlist_index < entries.size()) {
+		const dir_entry &entry = entries[dirlist_index];
 
-			// If we reach the end of both strings, it's a match
-			if (i == filename.length() && i == strlen(dirlist_wildcard)) {
-				found = true;
+		if (dirlist_wildcard[0]) { // wildcard match selected
+			if (!has_prefix(entry.name, dirlist_wildcard)) {
+				dirlist_index = entries.size();
+				break;
 			}
-
-			if (!found) {
-				++dirlist_dirp;
+			if (!listing_matches(dirlist_wildcard, entry.name)) {
+				++dirlist_index;
 				continue;
 			}
 		}
 
-		int file_size = (!std::filesystem::is_regular_file(st)) ? 0 : static_cast<int>((std::filesystem::file_size(dp.path()) + 255) / 256);
-		if (file_size > 0xFFFF) {
-			file_size = 0xFFFF;
-		}
-
-		// link
-		*data++ = 1;
-		*data++ = 1;
-
-		*data++ = file_size & 0xFF;
-		*data++ = file_size >> 8;
-		if (file_size < 1000) {
-			*data++ = ' ';
-			if (file_size < 100) {
-				*data++ = ' ';
-				if (file_size < 10) {
-					*data++ = ' ';
-				}
-			}
+		// Type match
+		if ((dirlist_type_filter == 'D' && !entry.is_directory) || (dirlist_type_filter == 'P' && !entry.is_file)) {
+			++dirlist_index;
+			continue;
 		}
-		*data++ = '"';
 
-		memcpy(data, filename.c_str(), namlen);
-		data += namlen;
-		*data++ = '"';
-		for (size_t i = namlen; i < 16; i++) {
-			*data++ = ' ';
+		const size_t line_len = entry.line.length() + (dirlist_timestmaps ? entry.timestamp.length() : 0) + 1;
+		if ((size_t)(data - data_start) + line_len + footer_len > sizeof(dirlist)) {
+			break;
 		}
-		*data++ = ' ';
-		if (std::filesystem::is_directory(st)) {
-			*data++ = 'D';
-			*data++ = 'I';
-			*data++ = 'R';
-		} else {
-			*data++ = 'P';
-			*data++ = 'R';
-			*data++ = 'G';
-		}
-		// This would be a '<' if file were protected, but it's a space instead
-		*data++ = ' ';
 
+		memcpy(data, entry.line.data(), entry.line.length());
+		data += entry.line.length();
 		if (dirlist_timestmaps) {
-			auto   fwtime = std::filesystem::last_write_time(dp.path());
-			time_t fttime = fwtime.time_since_epoch().count();
-
-			// ISO-8601 date+time
-			const tm *mtime = std::localtime(&fttime);
-			if (mtime != nullptr) {
-				*data++ = ' '; // space before the date
-				data += strftime((char *)data, 20, "%Y-%m-%d %H:%M:%S", mtime);
-			}
+			memcpy(data, entry.timestamp.data(), entry.timestamp.length());
+			data += entry.timestamp.length();
 		}
-
 		*data++ = 0;
-		++dirlist_dirp;
+		++dirlist_index;
+	}
+	if (dirlist_index < entries.size()) {
 		return static_cast<int>(data - data_start);
 	}
+	dirlist_snapshot = nullptr;
 
 	// link
 	*data++ = 1;
@@ -807,13 +1015,11 @@ static void cchdir(char *dir)
 		return;
 	}
 
-	auto st = std::filesystem::status(resolved);
-
 	// Is it a directory?
-	if (!std::filesystem::exists(st)) {
+	if (!host_exists(resolved)) {
 		// FNF
 		set_error(0x62, 0, 0);
-	} else if (!std::filesystem::is_directory(st)) {
+	} else if (!host_is_directory(resolved)) {
 		// Not a directory
 		set_error(0x39, 0, 0);
 	} else {
@@ -836,6 +1042,12 @@ static void cmkdir(char *dir)
 		return;
 	}
 
+	if (is_mounted(resolved)) {
+		set_error(0x26, 0, 0);
+		return;
+	}
+
+	invalidate_directory(resolved.parent_path());
 	if (!std::filesystem::create_directory(resolved)) {
 		if (std::filesystem::exists(resolved)) {
 			set_error(0x63, 0, 0);
@@ -898,6 +1110,14 @@ static void crename(char *f)
 
 	free(tmp); // we're now done with d and s (part of tmp)
 
+	if (is_mounted(src) || is_mounted(dst)) {
+		set_error(0x26, 0, 0);
+		return;
+	}
+
+	invalidate_directory(src.parent_path());
+	invalidate_directory(dst.parent_path());
+
 	std::error_code ec;
 	std::filesystem::rename(src, dst, ec);
 	if (ec.value() != 0) {
@@ -923,8 +1143,14 @@ static void crmdir(char *dir)
 		return;
 	}
 
+	if (is_mounted(resolved)) {
+		set_error(0x26, 0, 0);
+		return;
+	}
+
 	if (std::filesystem::is_directory(resolved)) {
 		if (std::filesystem::is_empty(resolved)) {
+			invalidate_directory(resolved.parent_path());
 			std::filesystem::remove(resolved);
 		} else {
 			set_error(0x63, 0, 0);
@@ -967,6 +1193,13 @@ static void cunlink(char *f)
 
 	free(tmp); // we're now done with fn (part of tmp)
 
+	if (is_mounted(resolved)) {
+		set_error(0x26, 0, 0);
+		return;
+	}
+
+	invalidate_directory(resolved.parent_path());
+
 	std::error_code ec;
 	if (std::filesystem::remove(resolved, ec)) {
 		switch (ec.value()) {
@@ -1059,12 +1292,25 @@ static int copen(int channel)
 				return -1;
 			}
 
-			if (append) {
-				channels[channel].f = x16open(resolved_filename.generic_string().c_str(), "ab+");
-			} else if (channels[channel].read && channels[channel].write) {
-				channels[channel].f = x16open(resolved_filename.generic_string().c_str(), "rb+");
+			if (is_mounted(resolved_filename)) {
+				if (channels[channel].write) {
+					set_error(0x26, 0, 0); // archives are mounted read-only
+					return -2;
+				}
+				channels[channel].f = open_mounted(resolved_filename);
 			} else {
-				channels[channel].f = x16open(resolved_filename.generic_string().c_str(), channels[channel].write ? "wb6" : "rb");
+				if (channels[channel].write) {
+					channels[channel].dir = resolved_filename.parent_path();
+					invalidate_directory(channels[channel].dir);
+				}
+
+				if (append) {
+					channels[channel].f = x16open(resolved_filename.generic_string().c_str(), "ab+");
+				} else if (channels[channel].read && channels[channel].write) {
+					channels[channel].f = x16open(resolved_filename.generic_string().c_str(), "rb+");
+				} else {
+					channels[channel].f = x16open(resolved_filename.generic_string().c_str(), channels[channel].write ? "wb6" : "rb");
+				}
 			}
 		}
 
@@ -1096,6 +1342,11 @@ static void cclose(int channel)
 		x16close(channels[channel].f);
 		channels[channel].f = nullptr;
 	}
+	if (!channels[channel].dir.empty()) {
+		// The file's size has changed, which doesn't touch its directory's modification time.
+		invalidate_directory(channels[channel].dir);
+		channels[channel].dir.clear();
+	}
 }
 
 static void cseek(int channel, uint32_t pos)
@@ -1154,6 +1405,15 @@ void ieee_init()
 			Options.startin_path = Options.fsroot_path;
 		}
 
+		for (const auto &[archive_path, mount_dir] : Options.archive_mounts) {
+			archive *arc = archive_open(archive_path);
+			if (arc != nullptr) {
+				Mounts.push_back({ normal_path(Options.fsroot_path / std::filesystem::path(mount_dir).relative_path()), arc });
+			}
+		}
+		// Deepest first, so find_mount() finds archives mounted inside other archives.
+		std::sort(Mounts.begin(), Mounts.end(), [](const archive_mount &a, const archive_mount &b) { return a.mount_point.generic_string().length() > b.mount_point.generic_string().length(); });
+
 		for (ch = 0; ch < 16; ch++) {
 			channels[ch].f       = NULL;
 			channels[ch].name[0] = 0;
@@ -1417,6 +1677,38 @@ int TALK(uint8_t a)
 	return ret;
 }
 
+static uint8_t Transfer_buffer[0x10000];
+
+// Copy a MACPTR/MCIOUT buffer to or from the CPU's address space. Outside of stream mode, the
+// address advances and wraps from $BFFF to $A000 of the next RAM bank.
+static void transfer_block(uint16_t &addr, uint8_t *buffer, int size, uint8_t stream_mode, bool to_memory)
+{
+	if (stream_mode) {
+		if (to_memory) {
+			memory_write_stream(addr, buffer, size);
+		} else {
+			memory_read_stream(addr, buffer, size);
+		}
+		return;
+	}
+
+	while (size > 0) {
+		const int span = std::min(size, (addr < 0xc000 ? 0xc000 : 0x10000) - addr);
+		if (to_memory) {
+			memory_write_block(addr, buffer, span);
+		} else {
+			memory_read_block(addr, buffer, span);
+		}
+		addr += (uint16_t)span;
+		buffer += span;
+		size -= span;
+		if (addr == 0xc000) {
+			addr = 0xa000;
+			write6502(0, read6502(0) + 1);
+		}
+	}
+}
+
 int MACPTR(uint16_t addr, uint16_t *c, uint8_t stream_mode)
 {
 	if (log_ieee) {
@@ -1428,7 +1720,28 @@ int MACPTR(uint16_t addr, uint16_t *c, uint8_t stream_mode)
 		int     count    = (*c != 0) ? (*c) : 256;
 		uint8_t ram_bank = read6502(0);
 		int     i        = 0;
-		if (channels[channel].f) {
+		if (channel != 15 && channels[channel].read && channels[channel].name[0] != '$' && channels[channel].f) {
+			// Read the whole block from the file at once. Like ACPTR, send EOI with the last byte.
+			x16file     *f         = channels[channel].f;
+			const size_t remaining = x16size(f) - x16tell(f);
+			if (remaining == 0) {
+				ret = ACPTR(Transfer_buffer);
+				transfer_block(addr, Transfer_buffer, 1, stream_mode, true);
+				i = 1;
+			} else {
+				const size_t wanted = std::min<size_t>(count, remaining);
+				i                   = (int)x16read(f, Transfer_buffer, 1, wanted);
+				ret                 = 0;
+				transfer_block(addr, Transfer_buffer, i, stream_mode, true);
+				if ((size_t)i == remaining) {
+					ret                    = 0x40;
+					channels[channel].read = false;
+					cclose(channel);
+				} else if ((size_t)i < wanted) {
+					ret = 0x42;
+				}
+			}
+		} else if (channels[channel].f) {
 			do {
 				uint8_t byte = 0;
 				ret          = ACPTR(&byte);
@@ -1467,7 +1780,14 @@ int MCIOUT(uint16_t addr, uint16_t *c, uint8_t stream_mode)
 		int     count    = (*c != 0) ? (*c) : 256;
 		uint8_t ram_bank = read6502(0);
 		int     i        = 0;
-		if (channels[channel].f && channels[channel].write) {
+		if (!opening && channel != 15 && channels[channel].f && channels[channel].write) {
+			// Write the whole block to the file at once.
+			transfer_block(addr, Transfer_buffer, count, stream_mode, false);
+			i = (int)x16write(channels[channel].f, Transfer_buffer, 1, count);
+			if (i != count) {
+				ret = 0x40;
+			}
+		} else if (channels[channel].f && channels[channel].write) {
 			do {
 				uint8_t byte;
 				byte = read6502(addr);
@@ -0,0 +1,261 @@
+#include "irq_stats.h"
+
+#include <algorithm>
+#include <math.h>
+
+#include "call_tracker.h"
+#include "fmt/format.h"
+#include "glue.h"
+#include "ring_buffer.h"
+
+bool Irq_stats_enabled = false;
+
+struct pending_irq {
+	bool     asserted;
+	bool     serviced;
+	uint64_t assert_clock;
+};
+
+struct active_handler {
+	uint8_t  sources;
+	uint64_t vector_clock;
+};
+
+static irq_source_stats Sources[IRQ_SOURCE_COUNT];
+static pending_irq      Pending[IRQ_SOURCE_COUNT];
+
+static call_tracker<active_handler> Handlers;
+
+static ring_buffer<irq_frame_stats, Irq_stats_frames> Frames;
+
+static irq_frame_stats Current_frame;
+static uint32_t        Frame_number = 0;
+
+static void histogram_add(irq_histogram &histogram, uint64_t cycles)
+{
+	const uint32_t value = (uint32_t)std::min<uint64_t>(cycles, UINT32_MAX);
+
+	size_t bucket = 0;
+	for (uint32_t v = value; v != 0 && bucket < Irq_stats_buckets - 1; v >>= 1) {
+		++bucket;
+	}
+
+	histogram.min = histogram.count ? std::min(histogram.min, value) : value;
+	++histogram.count;
+	histogram.total += value;
+	histogram.total_squares += (double)value * (double)value;
+	histogram.max = std::max(histogram.max, value);
+	++histogram.buckets[bucket];
+}
+
+static uint32_t bucket_low(size_t bucket)
+{
+	return bucket == 0 ? 0 : 1u << (bucket - 1);
+}
+
+static void reset_tracking()
+{
+	for (auto &pending : Pending) {
+		pending = {};
+	}
+	Handlers.clear();
+}
+
+void irq_stats_start()
+{
+	reset_tracking();
+	Irq_stats_enabled = true;
+}
+
+void irq_stats_stop()
+{
+	Irq_stats_enabled = false;
+}
+
+void irq_stats_clear()
+{
+	for (auto &source : Sources) {
+		source = {};
+	}
+	Frames.clear();
+	Frame_number  = 0;
+	Current_frame = {};
+	reset_tracking();
+}
+
+void irq_stats_sample(bool vera, bool ym2151, bool via1, bool via2)
+{
+	Handlers.update(state6502.sp, [](const call_tracker<active_handler>::frame &handler) {
+		const uint64_t duration = clockticks6502 - handler.data.vector_clock;
+		for (uint8_t s = 0; s < IRQ_SOURCE_COUNT; ++s) {
+			if (handler.data.sources & (1 << s)) {
+				histogram_add(Sources[s].duration, duration);
+			}
+		}
+		if (Handlers.depth() == 1) {
+			Current_frame.handler_cycles += (uint32_t)duration;
+		}
+	});
+
+	const bool lines[IRQ_SOURCE_COUNT] = { vera, ym2151, via1, via2 };
+	for (uint8_t s = 0; s < IRQ_SOURCE_COUNT; ++s) {
+		pending_irq &pending = Pending[s];
+		if (lines[s] == pending.asserted) {
+			continue;
+		}
+		if (lines[s]) {
+			pending.assert_clock = clockticks6502;
+			pending.serviced     = false;
+			++Sources[s].asserts;
+			++Current_frame.asserts[s];
+		} else if (!pending.serviced) {
+			++Sources[s].missed;
+			++Current_frame.missed[s];
+		}
+		pending.asserted = lines[s];
+	}
+}
+
+void irq_stats_frame()
+{
+	Current_frame.frame = Frame_number++;
+	Frames.add(Current_frame);
+	Current_frame = {};
+}
+
+void irq_stats_vector()
+{
+	uint8_t sources = 0;
+	for (uint8_t s = 0; s < IRQ_SOURCE_COUNT; ++s) {
+		pending_irq &pending = Pending[s];
+		if (!pending.asserted) {
+			continue;
+		}
+		sources |= 1 << s;
+		if (!pending.serviced) {
+			pending.serviced       = true;
+			const uint64_t latency = clockticks6502 - pending.assert_clock;
+			histogram_add(Sources[s].latency, latency);
+			Current_frame.max_latency[s] = std::max(Current_frame.max_latency[s], (uint32_t)std::min<uint64_t>(latency, UINT32_MAX));
+		}
+		if (!Handlers.empty()) {
+			++Sources[s].nested;
+		}
+	}
+
+	++Current_frame.handlers;
+	if (!Handlers.empty()) {
+		++Current_frame.nested;
+	}
+
+	// Anything deeper than the stack can hold has lost track of its RTIs.
+	if (!Handlers.enter(state6502.sp, { sources, clockticks6502 })) {
+		Handlers.clear();
+		Handlers.enter(state6502.sp, { sources, clockticks6502 });
+	}
+}
+
+const char *irq_stats_source_name(irq_source source)
+{
+	switch (source) {
+		case IRQ_SOURCE_VERA:
+			return "VERA";
+		case IRQ_SOURCE_YM2151:
+			return "YM2151";
+		case IRQ_SOURCE_VIA1:
+			return "VIA1";
+		case IRQ_SOURCE_VIA2:
+			return "VIA2";
+		default:
+			return "?";
+	}
+}
+
+const irq_source_stats &irq_stats_get(irq_source source)
+{
+	return Sources[source];
+}
+
+size_t irq_stats_frame_count()
+{
+	return Frames.count();
+}
+
+const irq_frame_stats &irq_stats_get_frame(size_t index)
+{
+	return Frames.get_newest(index);
+}
+
+static std::string histogram_summary(const irq_histogram &histogram)
+{
+	if (histogram.count == 0) {
+		return fmt::format("{:>8} {:>8} {:>8} {:>8}", "-", "-", "-", "-");
+	}
+	const double mean     = (double)histogram.total / (double)histogram.count;
+	const double variance = std::max(0.0, histogram.total_squares / (double)histogram.count - mean * mean);
+	return fmt::format("{:>8} {:>8.1f} {:>8} {:>8.1f}", histogram.min, mean, histogram.max, sqrt(variance));
+}
+
+static void histogram_table(std::vector<std::string> &lines, const char *title, irq_histogram irq_source_stats::*member)
+{
+	size_t first = Irq_stats_buckets, last = 0;
+	for (size_t b = 0; b < Irq_stats_buckets; ++b) {
+		for (const auto &source : Sources) {
+			if ((source.*member).buckets[b] != 0) {
+				first = std::min(first, b);
+				last  = std::max(last, b);
+			}
+		}
+	}
+	if (first > last) {
+		return;
+	}
+
+	lines.push_back("");
+	lines.push_back(title);
+	std::string header = fmt::format("{:>13}", "Cycles");
+	for (uint8_t s = 0; s < IRQ_SOURCE_COUNT; ++s) {
+		header += fmt::format(" {:>10}", irq_stats_source_name((irq_source)s));
+	}
+	lines.push_back(header);
+	for (size_t b = first; b <= last; ++b) {
+		std::string line = b == Irq_stats_buckets - 1 ? fmt::format("{:>6}-{:<6}", bucket_low(b), "") : fmt::format("{:>6}-{:<6}", bucket_low(b), b == 0 ? 0 : bucket_low(b + 1) - 1);
+		for (const auto &source : Sources) {
+			line += fmt::format(" {:>10}", (source.*member).buckets[b]);
+		}
+		lines.push_back(line);
+	}
+}
+
+std::vector<std::string> irq_stats_report()
+{
+	std::vector<std::string> lines;
+	lines.push_back(fmt::format("{:<8} {:>8} {:>8} {:>8}  {:>8} {:>8} {:>8} {:>8}  {:>8} {:>8} {:>8} {:>8}", "Source", "Asserts", "Missed", "Nested", "Lat min", "mean", "max", "jitter", "Dur min", "mean", "max", "jitter"));
+	for (uint8_t s = 0; s < IRQ_SOURCE_COUNT; ++s) {
+		const irq_source_stats &source = Sources[s];
+		lines.push_back(fmt::format("{:<8} {:>8} {:>8} {:>8}  {}  {}", irq_stats_source_name((irq_source)s), source.asserts, source.missed, source.nested, histogram_summary(source.latency), histogram_summary(source.duration)));
+	}
+	histogram_table(lines, "Latency:", &irq_source_stats::latency);
+	histogram_table(lines, "Handler duration:", &irq_source_stats::duration);
+	return lines;
+}
+
+std::vector<std::string> irq_stats_frame_report(size_t count)
+{
+	std::vector<std::string> lines;
+	std::string              header = fmt::format("{:>8} {:>8} {:>6} {:>8}", "Frame", "Handlers", "Nested", "Cycles");
+	for (uint8_t s = 0; s < IRQ_SOURCE_COUNT; ++s) {
+		header += fmt::format("  {:>6} {:>6} {:>6}", irq_stats_source_name((irq_source)s), "missed", "max");
+	}
+	lines.push_back(header);
+
+	for (size_t f = std::min(count, Frames.count()); f-- > 0;) {
+		const irq_frame_stats &frame = irq_stats_get_frame(f);
+		std::string            line  = fmt::format("{:>8} {:>8} {:>6} {:>8}", frame.frame, frame.handlers, frame.nested, frame.handler_cycles);
+		for (uint8_t s = 0; s < IRQ_SOURCE_COUNT; ++s) {
+			line += fmt::format("  {:>6} {:>6} {:>6}", frame.asserts[s], frame.missed[s], frame.max_latency[s]);
+		}
+		lines.push_back(line);
+	}
+	return lines;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#if !defined(IRQ_STATS_H)
+#	define IRQ_STATS_H
+
+#	include <stdint.h>
+#	include <string>
+#	include <vector>
+
+//
+// IRQ statistics
+//
+// While enabled, the main loop samples each IRQ source every step and notes the cycle it asserted.
+// When the CPU vectors, every source asserted at that point is charged the latency since it
+// asserted, and the handler is timed until the stack pointer shows its RTI. A source that stops
+// asserting before the CPU ever vectored to it is counted as missed, and a vector taken while
+// another handler is still running as nested.
+//
+
+enum irq_source : uint8_t {
+	IRQ_SOURCE_VERA,
+	IRQ_SOURCE_YM2151,
+	IRQ_SOURCE_VIA1,
+	IRQ_SOURCE_VIA2,
+	IRQ_SOURCE_COUNT
+};
+
+// Bucket 0 holds 0 cycles, bucket n holds [2^(n-1), 2^n) cycles, and the last bucket everything above.
+constexpr size_t Irq_stats_buckets = 16;
+
+struct irq_histogram {
+	uint64_t count;
+	uint64_t total;
+	double   total_squares;
+	uint32_t min;
+	uint32_t max;
+	uint64_t buckets[Irq_stats_buckets];
+};
+
+struct irq_source_stats {
+	uint64_t      asserts;
+	uint64_t      missed;
+	uint64_t      nested;
+	irq_histogram latency;  // cycles from asserting to the CPU vectoring
+	irq_histogram duration; // cycles from vectoring to the handler's RTI
+};
+
+constexpr size_t Irq_stats_frames = 60;
+
+struct irq_frame_stats {
+	uint32_t frame;
+	uint16_t asserts[IRQ_SOURCE_COUNT];
+	uint16_t missed[IRQ_SOURCE_COUNT];
+	uint32_t max_latency[IRQ_SOURCE_COUNT];
+	uint16_t handlers;
+	uint16_t nested;
+	uint32_t handler_cycles; // cycles spent inside at least one handler
+};
+
+extern bool Irq_stats_enabled;
+
+void irq_stats_start();
+void irq_stats_stop();
+void irq_stats_clear();
+
+// Called by the main loop each step with the state of every IRQ line, before the CPU is interrupted.
+void irq_stats_sample(bool vera, bool ym2151, bool via1, bool via2);
+
+// Called by the main loop when VERA finishes a frame.
+void irq_stats_frame();
+
+// Called by the CPU core after vectoring to the IRQ handler.
+void irq_stats_vector();
+
+const char             *irq_stats_source_name(irq_source source);
+const irq_source_stats &irq_stats_get(irq_source source);
+
+// Completed frames, 0 being the most recent.
+size_t                 irq_stats_frame_count();
+const irq_frame_stats &irq_stats_get_frame(size_t index);
+
+// Per-source summaries and histograms of latency and handler duration.
+std::vector<std::string> irq_stats_report();
+
+// One line per frame for the most recent 'count' frames, oldest first.
+std::vector<std::string> irq_stats_frame_report(size_t count);
+
+#endif
@@ -3,6 +3,8 @@
 #include <SDL.h>
 #include <unordered_map>
 
+#include "snapshot.h"
+
 #define LOG_JOYSTICK(...) // fmt::format(__VA_ARGS__)
 
 struct joystick_info {
@@ -221,4 +223,27 @@ void joystick_for_each_slot(std::function<void(int, int, SDL_GameController *)>
 			}
 		}
 	}
-}
\ No newline at end of file
+}
+
+void joystick_snapshot(machine_snapshot &snapshot)
+{
+	snapshot.io(Joystick_latch);
+	snapshot.io(Joystick_data);
+
+	for (int i = 0; i < NUM_JOYSTICKS; ++i) {
+		uint16_t button_mask = 0xffff;
+		uint16_t shift_mask  = 0;
+
+		const auto &joy = Joystick_controllers.find(Joystick_slots[i]);
+		if (joy != Joystick_controllers.end() && snapshot.saving()) {
+			button_mask = joy->second.button_mask;
+			shift_mask  = joy->second.shift_mask;
+		}
+		snapshot.io(button_mask);
+		snapshot.io(shift_mask);
+		if (joy != Joystick_controllers.end() && !snapshot.saving()) {
+			joy->second.button_mask = button_mask;
+			joy->second.shift_mask  = shift_mask;
+		}
+	}
+}
@@ -30,4 +30,8 @@ void joystick_set_clock(bool value);
 void joystick_for_each(std::function<void(int, SDL_GameController *, int current_slot)> fn);
 void joystick_for_each_slot(std::function<void(int, int, SDL_GameController *)> fn);
 
+// Button state is kept per slot, so it restores onto whichever controllers are plugged in now.
+class machine_snapshot;
+void joystick_snapshot(machine_snapshot &snapshot);
+
 #endif
@@ -0,0 +1,365 @@
+#include "kernal_accel.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "fmt/format.h"
+#include "glue.h"
+#include "memory.h"
+#include "options.h"
+
+// Cycles charged in timed mode. These approximate the inner loops of the ROM's routines, plus
+// the call itself; verify mode prints the ROM's actual counts when they're off by much.
+static constexpr uint32_t Call_cycles                = 40;
+static constexpr uint32_t Fill_cycles_per_byte       = 11;
+static constexpr uint32_t Copy_cycles_per_byte       = 16;
+static constexpr uint32_t Crc_cycles_per_byte        = 40;
+static constexpr uint32_t Decompress_cycles_per_byte = 24;
+
+struct memory_change {
+	uint16_t address;
+	uint8_t  bank;
+	uint8_t  value;
+};
+
+// While set, every byte written is logged with its old value, so the call can be undone.
+static bool                       Recording = false;
+static std::vector<memory_change> Undo_log;
+
+struct verification {
+	const char                *name;
+	uint16_t                   return_pc;
+	uint8_t                    return_sp;
+	uint64_t                   start_clock;
+	uint32_t                   estimated_cycles;
+	std::vector<memory_change> expected;
+
+	// Every address the ROM writes, keyed by bank << 16 | address, with the value it had before.
+	std::map<uint32_t, uint8_t> rom_writes;
+};
+
+bool Kernal_accel_verifying = false;
+
+static verification Pending;
+
+static bool is_io(uint16_t address)
+{
+	return (address >> 8) == 0x9f;
+}
+
+static uint16_t get_register(int r)
+{
+	return RAM[2 + r * 2] | (RAM[3 + r * 2] << 8);
+}
+
+static uint8_t read_byte(uint16_t address)
+{
+	uint8_t value;
+	memory_read_block(address, &value, 1);
+	return value;
+}
+
+static void write_span(uint16_t address, const uint8_t *data, uint32_t size)
+{
+	if (Recording) {
+		for (uint32_t i = 0; i < size; ++i) {
+			const uint16_t a = (uint16_t)(address + i);
+			const uint8_t  bank = memory_get_current_bank(a);
+			Undo_log.push_back({ a, bank, debug_read6502(a, bank) });
+		}
+	}
+	memory_write_block(address, data, size);
+}
+
+static void write_byte(uint16_t address, uint8_t value)
+{
+	write_span(address, &value, 1);
+}
+
+static void set_register(int r, uint16_t value)
+{
+	const uint8_t bytes[2] = { (uint8_t)(value & 0xff), (uint8_t)(value >> 8) };
+	write_span(2 + r * 2, bytes, 2);
+}
+
+// Both read and write the I/O page without advancing, like the ROM.
+static void read_buffer(uint16_t address, uint8_t *data, uint32_t size)
+{
+	if (is_io(address)) {
+		memory_read_stream(address, data, size);
+	} else {
+		memory_read_block(address, data, size);
+	}
+}
+
+static void write_buffer(uint16_t address, const uint8_t *data, uint32_t size)
+{
+	if (is_io(address)) {
+		memory_write_stream(address, data, size);
+	} else {
+		write_span(address, data, size);
+	}
+}
+
+static uint32_t memory_fill()
+{
+	const uint16_t address = get_register(0);
+	const uint16_t size    = get_register(1);
+
+	const std::vector<uint8_t> data(size, state6502.a);
+	write_buffer(address, data.data(), size);
+	return size * Fill_cycles_per_byte;
+}
+
+static uint32_t memory_copy()
+{
+	const uint16_t source = get_register(0);
+	const uint16_t target = get_register(1);
+	const uint16_t size   = get_register(2);
+
+	// Reading everything first gives overlapping copies the same result as the ROM's.
+	std::vector<uint8_t> data(size);
+	read_buffer(source, data.data(), size);
+	write_buffer(target, data.data(), size);
+	return size * Copy_cycles_per_byte;
+}
+
+static uint32_t memory_crc()
+{
+	const uint16_t address = get_register(0);
+	const uint16_t size    = get_register(1);
+
+	std::vector<uint8_t> data(size);
+	read_buffer(address, data.data(), size);
+
+	// CRC-16/CCITT-FALSE: polynomial $1021, initial value $FFFF, no reflection.
+	uint16_t crc = 0xffff;
+	for (const uint8_t byte : data) {
+		crc ^= byte << 8;
+		for (int bit = 0; bit < 8; ++bit) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+		}
+	}
+	set_register(2, crc);
+	return size * Crc_cycles_per_byte;
+}
+
+// Decode a raw LZSA2 stream, byte by byte like the ROM, so in-place decompression and matches
+// overlapping their own output behave the same way.
+static uint32_t memory_decompress()
+{
+	uint16_t in  = get_register(0);
+	uint16_t out = get_register(1);
+
+	uint8_t nibbles     = 0;
+	bool    have_nibble = false;
+
+	auto next_byte = [&]() -> uint8_t {
+		return read_byte(in++);
+	};
+	auto next_nibble = [&]() -> uint8_t {
+		if (have_nibble) {
+			have_nibble = false;
+			return nibbles & 0x0f;
+		}
+		nibbles     = next_byte();
+		have_nibble = true;
+		return nibbles >> 4;
+	};
+
+	const uint16_t start  = out;
+	uint16_t       offset = 0;
+	uint32_t       total  = 0;
+	while (total < 0x10000) {
+		const uint8_t token = next_byte();
+
+		uint32_t literals = (token >> 3) & 3;
+		if (literals == 3) {
+			literals += next_nibble();
+			if (literals == 18) {
+				const uint8_t extra = next_byte();
+				if (extra == 239) {
+					literals = next_byte();
+					literals |= next_byte() << 8;
+				} else {
+					literals += extra;
+				}
+			}
+		}
+		for (uint32_t i = 0; i < literals; ++i) {
+			write_byte(out++, next_byte());
+		}
+		total += literals;
+
+		const uint8_t z = ((token >> 5) & 1) ^ 1;
+		switch (token >> 6) {
+			case 0:
+				offset = 0xffe0 | (next_nibble() << 1) | z;
+				break;
+			case 1:
+				offset = 0xfe00 | (z << 8) | next_byte();
+				break;
+			case 2: {
+				const uint8_t high = next_nibble();
+				offset             = (uint16_t)((0xe000 | (high << 9) | (z << 8) | next_byte()) - 512);
+				break;
+			}
+			default:
+				if (z) {
+					offset = next_byte() << 8;
+					offset |= next_byte();
+				}
+				// Otherwise, repeat the last offset.
+				break;
+		}
+
+		uint32_t match = (token & 7) + 2;
+		if (match == 9) {
+			match += next_nibble();
+			if (match == 24) {
+				const uint8_t extra = next_byte();
+				if (extra == 233) {
+					break; // end of data
+				} else if (extra == 232) {
+					match = next_byte();
+					match |= next_byte() << 8;
+				} else {
+					match += extra;
+				}
+			}
+		}
+
+		uint16_t from = out + offset;
+		for (uint32_t i = 0; i < match; ++i) {
+			write_byte(out++, read_byte(from++));
+		}
+		total += match;
+	}
+
+	set_register(1, out);
+	return (uint16_t)(out - start) * Decompress_cycles_per_byte;
+}
+
+bool kernal_accel_call(uint16_t entry)
+{
+	const char *name = nullptr;
+	uint32_t (*routine)() = nullptr;
+	bool touches_io       = false;
+	switch (entry) {
+		case KERNAL_MEMORY_FILL:
+			name       = "memory_fill";
+			routine    = memory_fill;
+			touches_io = is_io(get_register(0));
+			break;
+		case KERNAL_MEMORY_COPY:
+			name       = "memory_copy";
+			routine    = memory_copy;
+			touches_io = is_io(get_register(0)) || is_io(get_register(1));
+			break;
+		case KERNAL_MEMORY_CRC:
+			name       = "memory_crc";
+			routine    = memory_crc;
+			touches_io = is_io(get_register(0));
+			break;
+		case KERNAL_MEMORY_DECOMPRESS:
+			// The ROM reads back what it has already written to a VERA data port, which only
+			// works with its own port setup, and the native decoder walks its input byte by
+			// byte, so leave either end being in the I/O page to the ROM.
+			if (is_io(get_register(0)) || is_io(get_register(1))) {
+				return false;
+			}
+			name    = "memory_decompress";
+			routine = memory_decompress;
+			break;
+		default:
+			return false;
+	}
+
+	if (Options.kernal_accel != kernal_accel_mode_t::VERIFY) {
+		const uint32_t cycles = routine();
+		if (Options.kernal_accel == kernal_accel_mode_t::TIMED) {
+			stall6502 += Call_cycles + cycles;
+		}
+		return true;
+	}
+
+	if (touches_io || Kernal_accel_verifying) {
+		return false;
+	}
+
+	// Run it natively, note what changed, put everything back, and let the ROM have its turn.
+	Recording = true;
+	Undo_log.clear();
+	Pending.estimated_cycles = Call_cycles + routine();
+	Recording                = false;
+
+	Pending.expected.clear();
+	for (const auto &change : Undo_log) {
+		Pending.expected.push_back({ change.address, change.bank, debug_read6502(change.address, change.bank) });
+	}
+	for (auto change = Undo_log.rbegin(); change != Undo_log.rend(); ++change) {
+		debug_write6502(change->address, change->bank, change->value);
+	}
+	Undo_log.clear();
+
+	Pending.rom_writes.clear();
+	Kernal_accel_verifying = true;
+	Pending.name           = name;
+	Pending.return_pc      = (RAM[0x100 + ((state6502.sp + 1) & 0xff)] | (RAM[0x100 + ((state6502.sp + 2) & 0xff)] << 8)) + 1;
+	Pending.return_sp      = state6502.sp + 2;
+	Pending.start_clock    = clockticks6502;
+	return false;
+}
+
+void kernal_accel_record_write(uint16_t address, uint8_t bank)
+{
+	Pending.rom_writes.emplace((uint32_t)bank << 16 | address, debug_read6502(address, bank));
+}
+
+void kernal_accel_verify_step()
+{
+	if (state6502.pc != Pending.return_pc || state6502.sp != Pending.return_sp) {
+		return;
+	}
+	Kernal_accel_verifying = false;
+
+	size_t             mismatches = 0;
+	std::set<uint32_t> native_writes;
+	for (const auto &change : Pending.expected) {
+		native_writes.insert((uint32_t)change.bank << 16 | change.address);
+		const uint8_t actual = debug_read6502(change.address, change.bank);
+		if (actual != change.value) {
+			if (mismatches == 0) {
+				fmt::print("KERNAL accel: {} differs from the ROM at {:02X}:{:04X} (native ${:02X}, ROM ${:02X})\n", Pending.name, change.bank, change.address, change.value, actual);
+			}
+			++mismatches;
+		}
+	}
+
+	// Anything else the ROM changed was left alone by the native routine. Stack bytes below the
+	// caller's stack pointer are the ROM's own scratch space and don't count.
+	for (const auto &[key, original] : Pending.rom_writes) {
+		const uint16_t address = key & 0xffff;
+		const uint8_t  bank    = key >> 16;
+		if (native_writes.count(key) != 0 || ((address >> 8) == 1 && (address & 0xff) <= Pending.return_sp)) {
+			continue;
+		}
+		const uint8_t actual = debug_read6502(address, bank);
+		if (actual != original) {
+			if (mismatches == 0) {
+				fmt::print("KERNAL accel: {} differs from the ROM at {:02X}:{:04X} (native left ${:02X}, ROM ${:02X})\n", Pending.name, bank, address, original, actual);
+			}
+			++mismatches;
+		}
+	}
+	Pending.rom_writes.clear();
+	if (mismatches > 1) {
+		fmt::print("KERNAL accel: {} differs from the ROM at {} addresses in total\n", Pending.name, mismatches);
+	}
+
+	const uint64_t rom_cycles = clockticks6502 - Pending.start_clock;
+	if (rom_cycles > Pending.estimated_cycles * 2 || rom_cycles * 2 < Pending.estimated_cycles) {
+		fmt::print("KERNAL accel: {} took {} cycles in the ROM, timed mode charges {}\n", Pending.name, rom_cycles, Pending.estimated_cycles);
+	}
+}
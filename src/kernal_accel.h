@@ -0,0 +1,52 @@
+#pragma once
+#if !defined(KERNAL_ACCEL_H)
+#	define KERNAL_ACCEL_H
+
+#	include <stdint.h>
+
+//
+// KERNAL acceleration
+//
+// With -kernal_accel, calls to the KERNAL's memory_fill, memory_copy, memory_crc and
+// memory_decompress (LZSA2) are carried out natively instead of by the ROM. Like the ROM, they
+// leave I/O page addresses in place rather than advancing them, so a VERA data port can be the
+// source or destination, and they use whichever RAM bank is current without wrapping.
+// Decompression to or from the I/O page is always left to the ROM.
+//
+// In timed mode, the CPU is then stalled for roughly as many cycles as the ROM would have taken.
+// In verify mode, the routine is run natively and undone, then the ROM runs it, recording what it
+// writes, and the two sets of changes are compared once it returns. Calls involving the I/O page
+// aren't verified, since their side effects can't be undone.
+//
+
+#	define KERNAL_MEMORY_FILL (0xfee4)
+#	define KERNAL_MEMORY_COPY (0xfee7)
+#	define KERNAL_MEMORY_CRC (0xfeea)
+#	define KERNAL_MEMORY_DECOMPRESS (0xfeed)
+
+// Called when execution reaches one of the entry points above. Returns true if the call was
+// handled, or false to let the ROM run it.
+bool kernal_accel_call(uint16_t entry);
+
+// Set while a verification is waiting for the ROM's routine to return.
+extern bool Kernal_accel_verifying;
+
+// Note a byte the ROM is about to write while verifying.
+void kernal_accel_record_write(uint16_t address, uint8_t bank);
+
+inline void kernal_accel_write(uint16_t address, uint8_t bank)
+{
+	if (Kernal_accel_verifying) {
+		kernal_accel_record_write(address, bank);
+	}
+}
+
+inline bool kernal_accel_verifying()
+{
+	return Kernal_accel_verifying;
+}
+
+// Called after each instruction while verifying.
+void kernal_accel_verify_step();
+
+#endif
@@ -12,6 +12,7 @@
 #include "i2c.h"
 #include "ring_buffer.h"
 #include "rom_symbols.h"
+#include "snapshot.h"
 #include "unicode.h"
 #include "utf8.h"
 #include "files.h"
@@ -299,3 +300,52 @@ uint8_t mouse_get_next_byte()
 {
 	return (Mouse_buffer.count() > 0) ? Mouse_buffer.pop_oldest() : 0;
 }
+
+void keyboard_snapshot(machine_snapshot &snapshot)
+{
+	uint32_t num_events = static_cast<uint32_t>(Keyboard_event_list.size());
+	snapshot.io(num_events);
+
+	if (snapshot.saving()) {
+		for (keyboard_event &evt : Keyboard_event_list) {
+			snapshot.io(evt.type);
+			if (evt.type == keyboard_event_type::key_event) {
+				snapshot.io(evt.data.key_event);
+			} else {
+				std::string text(evt.data.text_input.c);
+				snapshot.io(text);
+				snapshot.io(evt.data.text_input.run_after_load);
+			}
+		}
+	} else {
+		for (keyboard_event &evt : Keyboard_event_list) {
+			if (evt.type == keyboard_event_type::text_input) {
+				delete[] evt.data.text_input.file_chars;
+			}
+		}
+		Keyboard_event_list.clear();
+
+		for (uint32_t i = 0; i < num_events; ++i) {
+			keyboard_event evt;
+			snapshot.io(evt.type);
+			if (evt.type == keyboard_event_type::key_event) {
+				snapshot.io(evt.data.key_event);
+			} else {
+				std::string text;
+				snapshot.io(text);
+				char *text_copy = new char[text.length() + 1];
+				strcpy(text_copy, text.c_str());
+				evt.data.text_input.file_chars = text_copy;
+				evt.data.text_input.c          = text_copy;
+				snapshot.io(evt.data.text_input.run_after_load);
+			}
+			Keyboard_event_list.push_back(evt);
+		}
+	}
+
+	snapshot.io(Keyboard_buffer);
+	snapshot.io(Mouse_buffer);
+	snapshot.io(buttons);
+	snapshot.io(mouse_diff_x);
+	snapshot.io(mouse_diff_y);
+}
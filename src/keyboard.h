@@ -26,4 +26,8 @@ void    mouse_send_state();
 
 uint8_t mouse_get_next_byte();
 
+// Covers the keyboard and mouse queues, including text that is still being typed in.
+class machine_snapshot;
+void keyboard_snapshot(machine_snapshot &snapshot);
+
 #endif
\ No newline at end of file
@@ -20,6 +20,8 @@
 #include "boxmon/boxmon.h"
 #include "cpu/fake6502.h"
 #include "cpu/mnemonics.h"
+#include "coverage.h"
+#include "cpu_history.h"
 #include "debugger.h"
 #include "disasm.h"
 #include "display.h"
@@ -29,13 +31,16 @@
 #include "hypercalls.h"
 #include "i2c.h"
 #include "ieee.h"
+#include "irq_stats.h"
 #include "joystick.h"
 #include "keyboard.h"
 #include "memory.h"
 #include "midi.h"
 #include "options.h"
+#include "raster_timeline.h"
 #include "overlay/cpu_visualization.h"
 #include "overlay/overlay.h"
+#include "rewind.h"
 #include "ring_buffer.h"
 #include "rtc.h"
 #include "sdl_events.h"
@@ -131,6 +136,7 @@ void machine_reset()
 	vera_video_reset();
 	YM_reset();
 	reset6502();
+	rewind_clear();
 }
 
 void machine_toggle_warp()
@@ -269,6 +275,7 @@ int main(int argc, char **argv)
 	if (!Options.sdcard_path.empty()) {
 		std::filesystem::path sdcard_path;
 		if (options_find_file(sdcard_path, Options.sdcard_path)) {
+			sdcard_set_overlay(Options.sdcard_overlay);
 			sdcard_set_file(sdcard_path.generic_string().c_str());
 		}
 	}
@@ -288,6 +295,7 @@ int main(int argc, char **argv)
 	SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS | SDL_INIT_GAMECONTROLLER | SDL_INIT_AUDIO);
 
 	if (!Options.no_sound) {
+		audio_set_target_latency(Options.audio_latency);
 		audio_init(Options.audio_dev_name.size() > 0 ? Options.audio_dev_name.c_str() : nullptr, Options.audio_buffers);
 		audio_set_render_callback(wav_recorder_process);
 		YM_set_irq_enabled(Options.ym_irq);
@@ -322,6 +330,16 @@ int main(int argc, char **argv)
 	}
 
 	if (!Options.wav_path.empty()) {
+		switch (Options.wav_stems) {
+			case wav_stems_t::WAV_STEMS_CHIPS:
+				wav_recorder_set_stems(RECORD_WAV_STEMS_CHIPS);
+				break;
+			case wav_stems_t::WAV_STEMS_VOICES:
+				wav_recorder_set_stems(RECORD_WAV_STEMS_VOICES);
+				break;
+			default:
+				break;
+		}
 		wav_recorder_set_path(Options.wav_path.generic_string().c_str());
 		switch (Options.wav_start) {
 			case wav_recorder_start_t::WAV_RECORDER_START_WAIT:
@@ -341,6 +359,19 @@ int main(int argc, char **argv)
 	gif_recorder_init(SCREEN_WIDTH, SCREEN_HEIGHT);
 	wav_recorder_init();
 
+	if (!Options.history_path.empty()) {
+		cpu_history_init(Options.history_path, (uint64_t)Options.history_size << 20);
+	}
+
+	rewind_init(Options.rewind_seconds);
+
+	if (!Options.coverage_path.empty()) {
+		if (std::filesystem::exists(Options.coverage_path) && !coverage_merge(Options.coverage_path)) {
+			fmt::print("Could not read coverage from {}\n", Options.coverage_path.generic_string());
+		}
+		coverage_start();
+	}
+
 	joystick_init();
 
 	midi_init();
@@ -383,6 +414,12 @@ void main_shutdown()
 	sdcard_shutdown();
 	audio_close();
 	wav_recorder_shutdown();
+	cpu_history_shutdown();
+	rewind_shutdown();
+
+	if (!Options.coverage_path.empty() && !coverage_save(Options.coverage_path)) {
+		fmt::print("Could not write coverage to {}\n", Options.coverage_path.generic_string());
+	}
 	gif_recorder_shutdown();
 	debugger_shutdown();
 	display_shutdown();
@@ -391,8 +428,13 @@ void main_shutdown()
 
 void emulator_loop()
 {
+	bool was_paused = false;
 	for (;;) {
 		if (debugger_is_paused()) {
+			if (!was_paused) {
+				rewind_pause();
+				was_paused = true;
+			}
 			vera_video_force_redraw_screen();
 			display_process();
 			if (!sdl_events_update()) {
@@ -401,6 +443,10 @@ void emulator_loop()
 			timing_update();
 			continue;
 		}
+		if (was_paused) {
+			rewind_resume();
+			was_paused = false;
+		}
 
 		//
 		// Trace functionality preserved for comparison with official emulator releases
@@ -445,6 +491,8 @@ void emulator_loop()
 		}
 #endif
 
+		debugger_trace_cpu();
+
 		uint64_t old_clockticks6502 = clockticks6502;
 		step6502();
 		if (debug6502) {
@@ -458,6 +506,9 @@ void emulator_loop()
 		cpu_visualization_step();
 		uint8_t clocks    = (uint8_t)(clockticks6502 - old_clockticks6502);
 		bool    new_frame = vera_video_step(MHZ, clocks);
+		if (Raster_timeline_enabled) {
+			raster_timeline_step(clocks);
+		}
 		via1_step(clocks);
 		via2_step(clocks);
 		rtc_step(clocks);
@@ -468,6 +519,7 @@ void emulator_loop()
 
 		if (new_frame) {
 			midi_process();
+			sdcard_frame();
 			gif_recorder_update(vera_video_get_framebuffer());
 			static uint32_t last_display_us = timing_total_microseconds_realtime();
 			const uint32_t  display_us      = timing_total_microseconds_realtime();
@@ -475,9 +527,11 @@ void emulator_loop()
 				display_process();
 				last_display_us = display_us;
 			}
+			rewind_input_begin();
 			if (!sdl_events_update()) {
 				break;
 			}
+			rewind_input_end();
 
 			timing_update();
 #ifdef __EMSCRIPTEN__
@@ -486,6 +540,9 @@ void emulator_loop()
 #endif
 		}
 
+		if (Irq_stats_enabled) {
+			irq_stats_sample(vera_video_get_irq_out(), YM_irq(), via1_irq(), via2_irq());
+		}
 		if (vera_video_get_irq_out() || YM_irq() || via1_irq() || via2_irq()) {
 			irq6502();
 			debugger_interrupt();
@@ -501,5 +558,12 @@ void emulator_loop()
 		}
 
 		keyboard_process();
+
+		if (new_frame) {
+			if (Irq_stats_enabled) {
+				irq_stats_frame();
+			}
+			rewind_frame();
+		}
 	}
 }
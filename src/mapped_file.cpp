@@ -0,0 +1,140 @@
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+#	include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+struct mapped_file {
+	uint8_t *data;
+	uint64_t size;
+#if defined(_WIN32)
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+};
+
+#if defined(_WIN32)
+
+mapped_file *mapped_file_open(const std::filesystem::path &path, bool writable)
+{
+	HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ | (writable ? GENERIC_WRITE : 0), FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return nullptr;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 || (uint64_t)size.QuadPart > SIZE_MAX) {
+		CloseHandle(file);
+		return nullptr;
+	}
+
+	HANDLE mapping = CreateFileMappingW(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		CloseHandle(file);
+		return nullptr;
+	}
+
+	void *data = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return nullptr;
+	}
+
+	return new mapped_file{ static_cast<uint8_t *>(data), (uint64_t)size.QuadPart, file, mapping };
+}
+
+void mapped_file_close(mapped_file *file)
+{
+	if (file == nullptr) {
+		return;
+	}
+	UnmapViewOfFile(file->data);
+	CloseHandle(file->mapping);
+	CloseHandle(file->file);
+	delete file;
+}
+
+bool mapped_file_flush(mapped_file *file, uint64_t offset, uint64_t size)
+{
+	return FlushViewOfFile(file->data + offset, (SIZE_T)size) && FlushFileBuffers(file->file);
+}
+
+#elif !defined(__EMSCRIPTEN__)
+
+mapped_file *mapped_file_open(const std::filesystem::path &path, bool writable)
+{
+	const int fd = open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+	if (fd < 0) {
+		return nullptr;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0 || (uint64_t)st.st_size > SIZE_MAX) {
+		close(fd);
+		return nullptr;
+	}
+
+	void *data = mmap(nullptr, (size_t)st.st_size, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		close(fd);
+		return nullptr;
+	}
+
+	return new mapped_file{ static_cast<uint8_t *>(data), (uint64_t)st.st_size, fd };
+}
+
+void mapped_file_close(mapped_file *file)
+{
+	if (file == nullptr) {
+		return;
+	}
+	munmap(file->data, (size_t)file->size);
+	close(file->fd);
+	delete file;
+}
+
+bool mapped_file_flush(mapped_file *file, uint64_t offset, uint64_t size)
+{
+	// msync() wants a page-aligned start.
+	const uint64_t page  = (uint64_t)sysconf(_SC_PAGESIZE);
+	const uint64_t start = offset - offset % page;
+	return msync(file->data + start, (size_t)(offset + size - start), MS_SYNC) == 0;
+}
+
+#else
+
+// The browser build has no real files to map.
+mapped_file *mapped_file_open(const std::filesystem::path &, bool)
+{
+	return nullptr;
+}
+
+void mapped_file_close(mapped_file *file)
+{
+	delete file;
+}
+
+bool mapped_file_flush(mapped_file *, uint64_t, uint64_t)
+{
+	return false;
+}
+
+#endif
+
+uint8_t *mapped_file_data(mapped_file *file)
+{
+	return file->data;
+}
+
+uint64_t mapped_file_size(const mapped_file *file)
+{
+	return file->size;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#if !defined(MAPPED_FILE_H)
+#	define MAPPED_FILE_H
+
+#	include <filesystem>
+#	include <stdint.h>
+
+//
+// Memory-mapped files
+//
+// A thin wrapper over mmap() and its Windows equivalent. Writes through the mapping reach the file
+// whenever the OS decides to write the pages back, or when mapped_file_flush() forces them out.
+//
+
+struct mapped_file;
+
+// Returns nullptr if the file can't be mapped, e.g. because it's empty or too large for the
+// address space, so callers can fall back to ordinary file I/O.
+mapped_file *mapped_file_open(const std::filesystem::path &path, bool writable);
+void         mapped_file_close(mapped_file *file);
+
+uint8_t *mapped_file_data(mapped_file *file);
+uint64_t mapped_file_size(const mapped_file *file);
+
+// Write the pages covering [offset, offset + size) back to the file and wait for them.
+bool mapped_file_flush(mapped_file *file, uint64_t offset, uint64_t size);
+
+#endif
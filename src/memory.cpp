@@ -5,6 +5,7 @@
 
 #include "memory.h"
 
+#include <algorithm>
 #include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,11 +14,14 @@
 #include <fmt/format.h>
 
 #include "cpu/fake6502.h"
+#include "cpu_history.h"
 #include "debugger.h"
 #include "files.h"
 #include "gif_recorder.h"
 #include "glue.h"
 #include "hypercalls.h"
+#include "kernal_accel.h"
+#include "snapshot.h"
 #include "unicode.h"
 #include "vera/vera_video.h"
 #include "via.h"
@@ -159,6 +163,17 @@ void memory_reset()
 	memory_set_rom_bank(0);
 }
 
+void memory_snapshot(machine_snapshot &snapshot)
+{
+	// The RAM bank register is RAM[0], and the upper ROM banks double as cartridge RAM.
+	snapshot.io_pages(RAM, RAM_SIZE);
+	snapshot.io_pages(ROM, ROM_SIZE);
+	snapshot.io(rom_bank_register);
+	snapshot.io(addr_ym);
+	snapshot.io(clock_snap);
+	snapshot.io(clock_base);
+}
+
 //
 // Banked RAM access
 //
@@ -501,7 +516,9 @@ uint8_t debug_read6502(uint16_t address, uint8_t bank)
 
 uint8_t read6502(uint16_t address)
 {
-	debug6502 |= (DEBUG6502_READ | DEBUG6502_EXEC) & debugger_get_flags(address, address >= 0xc000 ? memory_get_rom_bank() : memory_get_ram_bank());
+	const uint8_t bank = address >= 0xc000 ? memory_get_rom_bank() : memory_get_ram_bank();
+	debug6502 |= (DEBUG6502_READ | DEBUG6502_EXEC) & debugger_get_flags(address, bank);
+	debug6502 |= debugger_watch_cpu_read(address, bank);
 
 	uint8_t value = real_read<memory_map_hi, 1>(address);
 #if defined(TRACE)
@@ -519,14 +536,18 @@ void debug_write6502(uint16_t address, uint8_t bank, uint8_t value)
 
 void write6502(uint16_t address, uint8_t value)
 {
-	debug6502 |= DEBUG6502_WRITE & debugger_get_flags(address, address >= 0xc000 ? memory_get_rom_bank() : memory_get_ram_bank());
+	const uint8_t bank = address >= 0xc000 ? memory_get_rom_bank() : memory_get_ram_bank();
+	debug6502 |= DEBUG6502_WRITE & debugger_get_flags(address, bank);
+	debug6502 |= debugger_watch_cpu_write(address, bank, value);
 	if (~debug6502 & DEBUG6502_WRITE) {
 #if defined(TRACE)
 		if (Options.log_mem_write) {
 			fmt::print("{:02X} -> {:04X}\n", value, address);
 		}
 #endif
+		kernal_accel_write(address, bank);
 		real_write<memory_map_hi, 1>(address, value);
+		cpu_history_write(address, bank, value);
 	}
 }
 
@@ -535,6 +556,157 @@ uint8_t bank6502(uint16_t address)
 	return memory_get_current_bank(address);
 }
 
+// Offset into RAM of the run of plain RAM starting at 'address', and how long it is. Zero page's
+// bank registers and the I/O area are left out, since writing them has side effects.
+static uint32_t ram_span(uint16_t address, uint32_t size, uint32_t &offset)
+{
+	if (address >= 2 && address < 0x9f00) {
+		offset = address;
+		return std::min<uint32_t>(size, 0x9f00 - address);
+	}
+	if (address >= 0xa000 && address < 0xc000) {
+		offset = ((uint32_t)effective_ram_bank() << 13) + address;
+		return std::min<uint32_t>(size, 0xc000 - address);
+	}
+	return 0;
+}
+
+// Hypercalls can't be rewound and run again like an instruction, so while any breakpoints,
+// watchpoints, CPU history or KERNAL accel verification are in use, their transfers go byte by
+// byte through the same checks as write6502() and read6502(), but always complete. A hit pauses
+// the debugger once the hypercall has returned.
+static bool memory_is_observed()
+{
+	return !debugger_get_breakpoints().empty() || !debugger_get_watchpoints().empty() || cpu_history_is_recording() || kernal_accel_verifying();
+}
+
+static void observed_write6502(uint16_t address, uint8_t value)
+{
+	const uint8_t bank = address >= 0xc000 ? memory_get_rom_bank() : memory_get_ram_bank();
+	const uint8_t hit  = (DEBUG6502_WRITE & debugger_get_flags(address, bank)) | debugger_watch_cpu_write(address, bank, value);
+	kernal_accel_write(address, bank);
+	real_write<memory_map_hi, 1>(address, value);
+	cpu_history_write(address, bank, value);
+	if (hit) {
+		debugger_pause_execution();
+	}
+}
+
+static uint8_t observed_read6502(uint16_t address)
+{
+	const uint8_t bank = address >= 0xc000 ? memory_get_rom_bank() : memory_get_ram_bank();
+	if ((DEBUG6502_READ & debugger_get_flags(address, bank)) | debugger_watch_cpu_read(address, bank)) {
+		debugger_pause_execution();
+	}
+	return real_read<memory_map_hi, 1>(address);
+}
+
+void memory_write_block(uint16_t address, const uint8_t *data, uint32_t size)
+{
+	if (memory_is_observed()) {
+		for (uint32_t i = 0; i < size; ++i) {
+			observed_write6502(address++, data[i]);
+		}
+		return;
+	}
+
+	while (size > 0) {
+		uint32_t       offset;
+		const uint32_t span = ram_span(address, size, offset);
+		if (span == 0) {
+			write6502(address++, *data++);
+			--size;
+			continue;
+		}
+
+		memcpy(RAM + offset, data, span);
+		for (uint32_t i = offset; i < offset + span; ++i) {
+			RAM_written[i >> 6] |= (uint64_t)1 << (i & 0x3f);
+			++RAM_write_counts[i];
+		}
+		address += (uint16_t)span;
+		data += span;
+		size -= span;
+	}
+}
+
+void memory_read_block(uint16_t address, uint8_t *data, uint32_t size)
+{
+	if (memory_is_observed()) {
+		for (uint32_t i = 0; i < size; ++i) {
+			data[i] = observed_read6502(address++);
+		}
+		return;
+	}
+
+	while (size > 0) {
+		uint32_t       offset;
+		const uint32_t span = ram_span(address, size, offset);
+		if (span == 0) {
+			*data++ = read6502(address++);
+			--size;
+			continue;
+		}
+
+		memcpy(data, RAM + offset, span);
+		for (uint32_t i = offset; i < offset + span; ++i) {
+			++RAM_read_counts[i];
+		}
+		address += (uint16_t)span;
+		data += span;
+		size -= span;
+	}
+}
+
+static bool is_vera_register(uint16_t address)
+{
+	return memory_map_hi[address >> 8] == MEMMAP_IO && memory_map_io[address & 0xff] == MEMMAP_IO_VIDEO;
+}
+
+void memory_write_stream(uint16_t address, const uint8_t *data, uint32_t size)
+{
+	if (memory_is_observed()) {
+		for (uint32_t i = 0; i < size; ++i) {
+			observed_write6502(address, data[i]);
+		}
+		return;
+	}
+	if (!is_vera_register(address)) {
+		for (uint32_t i = 0; i < size; ++i) {
+			write6502(address, data[i]);
+		}
+		return;
+	}
+
+	RAM_write_counts[address] += size;
+	const uint8_t reg = address & 0x1f;
+	for (uint32_t i = 0; i < size; ++i) {
+		vera_video_write(reg, data[i]);
+	}
+}
+
+void memory_read_stream(uint16_t address, uint8_t *data, uint32_t size)
+{
+	if (memory_is_observed()) {
+		for (uint32_t i = 0; i < size; ++i) {
+			data[i] = observed_read6502(address);
+		}
+		return;
+	}
+	if (!is_vera_register(address)) {
+		for (uint32_t i = 0; i < size; ++i) {
+			data[i] = read6502(address);
+		}
+		return;
+	}
+
+	RAM_read_counts[address] += size;
+	const uint8_t reg = address & 0x1f;
+	for (uint32_t i = 0; i < size; ++i) {
+		data[i] = vera_video_read(reg);
+	}
+}
+
 void vp6502(void)
 {
 	ROM_BANK = 0;
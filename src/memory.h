@@ -29,6 +29,18 @@ uint8_t read6502(uint16_t address);
 void    debug_write6502(uint16_t address, uint8_t bank, uint8_t value);
 void    write6502(uint16_t address, uint8_t value);
 uint8_t bank6502(uint16_t address);
+
+// Copy a buffer to or from consecutive addresses as the CPU sees them with the current banks,
+// for hypercalls that move whole blocks. RAM is copied directly unless breakpoints, watchpoints,
+// the CPU history or KERNAL accel verification need to see each access, in which case a hit
+// pauses the debugger after the hypercall rather than stopping the transfer. Addresses wrap from
+// $FFFF to $0000.
+void memory_write_block(uint16_t address, const uint8_t *data, uint32_t size);
+void memory_read_block(uint16_t address, uint8_t *data, uint32_t size);
+
+// Write a buffer to, or read one from, the same address repeatedly, like a VERA data port.
+void memory_write_stream(uint16_t address, const uint8_t *data, uint32_t size);
+void memory_read_stream(uint16_t address, uint8_t *data, uint32_t size);
 void    memory_save(x16file *f, bool dump_ram, bool dump_bank);
 void    vp6502(void);
 
@@ -43,4 +55,7 @@ uint8_t memory_get_current_bank(uint16_t address);
 
 void memory_dump_usage_counts();
 
+class machine_snapshot;
+void memory_snapshot(machine_snapshot &snapshot);
+
 #endif
@@ -4,6 +4,7 @@
 #include <type_traits>
 
 #include "audio.h"
+#include "block_image.h"
 #include "debugger.h"
 #include "display.h"
 #include "overlay/overlay.h"
@@ -58,10 +59,22 @@ static void usage()
 	fmt::print("\tIs provided for backward-compatibility with x16emu toolchains,\n");
 	fmt::print("\tbut is non-functional in Box16.\n");
 
+	fmt::print("-alatency <milliseconds>\n");
+	fmt::print("\tTarget amount of queued audio. The audio rendering rate is\n");
+	fmt::print("\tadjusted slightly to stay at this latency. (Default: 20)\n");
+
 	fmt::print("-bas <app.txt>\n");
 	fmt::print("\tInject a BASIC program in ASCII encoding through the\n");
 	fmt::print("\tkeyboard.\n");
 
+	fmt::print("-convert_sdcard <image> <block image>\n");
+	fmt::print("\tConvert an SD card image (.img or .img.gz) into a block-compressed image that -sdcard\n");
+	fmt::print("\tcan use directly, decompressing only the parts that are accessed, then exit.\n");
+
+	fmt::print("-coverage <file>\n");
+	fmt::print("\tCollect code coverage from startup, merged with any coverage already in <file>,\n");
+	fmt::print("\tand save it back to <file> on exit.\n");
+
 	fmt::print("-debug <address>\n");
 	fmt::print("\tSet a breakpoint in the debugger\n");
 
@@ -81,6 +94,11 @@ static void usage()
 	fmt::print("-fullscreen\n");
 	fmt::print("\tStart up in fullscreen mode instead of in a window.\n");
 
+	fmt::print("-history <file>[,<megabytes>]\n");
+	fmt::print("\tRecord every executed instruction and its memory writes to a compressed log on disk,\n");
+	fmt::print("\tfor the \"cpuhistory\" monitor command. The log is kept in <file>.0 and <file>.1.\n");
+	fmt::print("\tThe oldest history is discarded beyond the given size (default 1024).\n");
+
 	fmt::print("-hypercall_path <path>\n");
 	fmt::print("\tSet the base path for hypercalls (effectively, the current working directory when no SD card is attached).\n");
 
@@ -99,6 +117,11 @@ static void usage()
 	fmt::print("\tIf -ignore_ini is also specified, this will set the location of the ini file, but not actually load settings from it.\n");
 	fmt::print("\tIf -save_ini is also specified, the emulator settings for this run will be saved to this ini file.\n");
 
+	fmt::print("-kernal_accel [{{fast|timed|verify}}]\n");
+	fmt::print("\tRun the KERNAL's memory_fill, memory_copy, memory_crc and memory_decompress natively.\n");
+	fmt::print("\t\"fast\" (the default) returns immediately, \"timed\" stalls the CPU for about as long\n");
+	fmt::print("\tas the ROM would have taken, and \"verify\" runs both and reports any differences.\n");
+
 	fmt::print("-keymap <keymap>\n");
 	fmt::print("\tEnable a specific keyboard layout decode table.\n");
 
@@ -124,6 +147,10 @@ static void usage()
 	fmt::print("-memorystats\n");
 	fmt::print("\tGenerate a memory_stats.txt file when the emulator exits.\n");
 
+	fmt::print("-mount <archive>[,<dir>]\n");
+	fmt::print("\tMount a .zip, .tar or .tar.gz read-only over the host filesystem, at <dir> below the\n");
+	fmt::print("\thypercall path or in place of it if <dir> is omitted. May be given more than once.\n");
+
 	fmt::print("-nobinds\n");
 	fmt::print("\tDisable most emulator keyboard shortcuts.\n");
 
@@ -161,6 +188,10 @@ static void usage()
 	fmt::print("\tSpecify banked RAM size in KB (8, 16, 32, ..., 2048).\n");
 	fmt::print("\tThe default is 512.\n");
 
+	fmt::print("-rewind <seconds>\n");
+	fmt::print("\tKeep enough machine snapshots to step the debugger backwards over the last <seconds>\n");
+	fmt::print("\tof emulated time (default 10). 0 disables reverse execution.\n");
+
 	fmt::print("-rom <rom.bin>\n");
 	fmt::print("\tOverride KERNAL/BASIC/* ROM file.\n");
 
@@ -191,6 +222,10 @@ static void usage()
 	fmt::print("-sdcard <sdcard.img>\n");
 	fmt::print("\tSpecify SD card image (partition map + FAT32)\n");
 
+	fmt::print("-sdcard_overlay [<delta file>]\n");
+	fmt::print("\tOpen the SD card image read-only and keep writes in a copy-on-write overlay, in memory\n");
+	fmt::print("\tor in the given delta file\n");
+
 	fmt::print("-serial\n");
 	fmt::print("\tEnable the serial bus (experimental)\n");
 
@@ -233,6 +268,11 @@ static void usage()
 	fmt::print("\tUse ,wait to start paused.\n");
 	fmt::print("\tUse ,auto to start paused, but begin recording once a non-zero audio signal is detected.\n");
 
+	fmt::print("-wavstems {{none|chips|voices}}\n");
+	fmt::print("\tAlongside the -wav recording, also record each sound chip to its own wav.\n");
+	fmt::print("\t\"chips\" adds <file>-ym.wav, <file>-psg.wav and <file>-pcm.wav.\n");
+	fmt::print("\t\"voices\" additionally adds <file>-ym0.wav ... <file>-ym7.wav and <file>-psg0.wav ... <file>-psg15.wav.\n");
+
 	fmt::print("-widescreen\n");
 	fmt::print("\tDisplay the emulated X16 in a 16:9 aspect ratio instead of 4:3.\n");
 
@@ -383,6 +423,17 @@ static void parse_cmdline(mINI::INIMap<std::string> &ini, int argc, char **argv)
 			argc--;
 			argv++;
 
+		} else if (!strcmp(argv[0], "-alatency")) {
+			argc--;
+			argv++;
+			if (!argc || argv[0][0] == '-') {
+				usage();
+			}
+
+			ini["alatency"] = argv[0];
+			argc--;
+			argv++;
+
 		} else if (!strcmp(argv[0], "-bas")) {
 			argc--;
 			argv++;
@@ -455,6 +506,37 @@ static void parse_cmdline(mINI::INIMap<std::string> &ini, int argc, char **argv)
 			argc--;
 			argv++;
 
+		} else if (!strcmp(argv[0], "-convert_sdcard")) {
+			argc--;
+			argv++;
+			if (argc < 2 || argv[0][0] == '-' || argv[1][0] == '-') {
+				usage();
+			}
+
+			exit(block_image_convert(argv[0], argv[1]) ? 0 : 1);
+
+		} else if (!strcmp(argv[0], "-coverage")) {
+			argc--;
+			argv++;
+			if (!argc || argv[0][0] == '-') {
+				usage();
+			}
+
+			ini["coverage"] = argv[0];
+			argv++;
+			argc--;
+
+		} else if (!strcmp(argv[0], "-history")) {
+			argc--;
+			argv++;
+			if (!argc || argv[0][0] == '-') {
+				usage();
+			}
+
+			ini["history"] = argv[0];
+			argv++;
+			argc--;
+
 		} else if (!strcmp(argv[0], "-gif")) {
 			argc--;
 			argv++;
@@ -495,6 +577,17 @@ static void parse_cmdline(mINI::INIMap<std::string> &ini, int argc, char **argv)
 			argv++;
 			argc--;
 
+		} else if (!strcmp(argv[0], "-kernal_accel")) {
+			argc--;
+			argv++;
+			if (argc && argv[0][0] != '-') {
+				ini["kernal_accel"] = argv[0];
+				argc--;
+				argv++;
+			} else {
+				ini["kernal_accel"] = "fast";
+			}
+
 		} else if (!strcmp(argv[0], "-keymap")) {
 			argc--;
 			argv++;
@@ -529,6 +622,21 @@ static void parse_cmdline(mINI::INIMap<std::string> &ini, int argc, char **argv)
 			argv++;
 			argc--;
 
+		} else if (!strcmp(argv[0], "-mount")) {
+			argc--;
+			argv++;
+			if (!argc || argv[0][0] == '-') {
+				usage();
+			}
+
+			std::string &mounts = ini["mounts"];
+			if (!mounts.empty()) {
+				mounts += ";";
+			}
+			mounts += argv[0];
+			argc--;
+			argv++;
+
 		} else if (!strcmp(argv[0], "-nobinds")) {
 			argc--;
 			argv++;
@@ -684,6 +792,17 @@ static void parse_cmdline(mINI::INIMap<std::string> &ini, int argc, char **argv)
 			argc--;
 			argv++;
 
+		} else if (!strcmp(argv[0], "-rewind")) {
+			argc--;
+			argv++;
+			if (!argc || !isdigit(argv[0][0])) {
+				usage();
+			}
+
+			ini["rewind"] = argv[0];
+			argc--;
+			argv++;
+
 		} else if (!strcmp(argv[0], "-rtc")) {
 			argc--;
 			argv++;
@@ -721,6 +840,17 @@ static void parse_cmdline(mINI::INIMap<std::string> &ini, int argc, char **argv)
 			argc--;
 			argv++;
 
+		} else if (!strcmp(argv[0], "-sdcard_overlay")) {
+			argc--;
+			argv++;
+			if (!argc || argv[0][0] == '-') {
+				ini["sdcard_overlay"] = "memory";
+			} else {
+				ini["sdcard_overlay"] = argv[0];
+				argc--;
+				argv++;
+			}
+
 		} else if (!strcmp(argv[0], "-serial")) {
 			argc--;
 			argv++;
@@ -810,6 +940,17 @@ static void parse_cmdline(mINI::INIMap<std::string> &ini, int argc, char **argv)
 			argv++;
 			argc--;
 
+		} else if (!strcmp(argv[0], "-wavstems")) {
+			argc--;
+			argv++;
+			if (!argc || argv[0][0] == '-') {
+				usage();
+			}
+
+			ini["wavstems"] = argv[0];
+			argv++;
+			argc--;
+
 		} else if (!strcmp(argv[0], "-widescreen")) {
 			argc--;
 			argv++;
@@ -883,6 +1024,20 @@ static char const *set_options(options &opts, mINI::INIMap<std::string> &ini)
 		opts.fsroot_path = ini["hypercall_path"];
 	}
 
+	if (ini.has("mounts")) {
+		// <archive>[,<dir>] for each mount, separated by semicolons
+		std::stringstream mounts(ini["mounts"]);
+		std::string       mount;
+		while (std::getline(mounts, mount, ';')) {
+			const size_t comma = mount.find(',');
+			if (comma == std::string::npos) {
+				opts.archive_mounts.push_back({ mount, "" });
+			} else if (comma > 0) {
+				opts.archive_mounts.push_back({ mount.substr(0, comma), mount.substr(comma + 1) });
+			}
+		}
+	}
+
 	if (ini.has("keymap")) {
 		bool found = false;
 		for (uint8_t i = 0; i < sizeof(keymaps) / sizeof(*keymaps); i++) {
@@ -933,6 +1088,10 @@ static char const *set_options(options &opts, mINI::INIMap<std::string> &ini)
 		opts.sdcard_path = ini["sdcard"];
 	}
 
+	if (ini.has("sdcard_overlay")) {
+		opts.sdcard_overlay = ini["sdcard_overlay"];
+	}
+
 	if (ini.has("warp")) {
 		if (ini["warp"] == "true") {
 			opts.warp_factor = 9;
@@ -956,6 +1115,21 @@ static char const *set_options(options &opts, mINI::INIMap<std::string> &ini)
 		}
 	}
 
+	if (ini.has("kernal_accel")) {
+		char const *kernal_accel = ini["kernal_accel"].c_str();
+		if (!strcmp(kernal_accel, "fast")) {
+			opts.kernal_accel = kernal_accel_mode_t::FAST;
+		} else if (!strcmp(kernal_accel, "timed")) {
+			opts.kernal_accel = kernal_accel_mode_t::TIMED;
+		} else if (!strcmp(kernal_accel, "verify")) {
+			opts.kernal_accel = kernal_accel_mode_t::VERIFY;
+		} else if (!strcmp(kernal_accel, "none")) {
+			opts.kernal_accel = kernal_accel_mode_t::NONE;
+		} else {
+			return "kernal_accel";
+		}
+	}
+
 	if (ini.has("log")) {
 		for (const char *p = ini["log"].c_str(); *p; p++) {
 			switch (tolower(*p)) {
@@ -1049,6 +1223,28 @@ static char const *set_options(options &opts, mINI::INIMap<std::string> &ini)
 		}
 	}
 
+	if (ini.has("coverage")) {
+		opts.coverage_path = ini["coverage"];
+	}
+
+	if (ini.has("history")) {
+		opts.history_path        = token_or_empty(ini["history"], ",");
+		const char *history_size = token_or_empty(nullptr, ",");
+		if (history_size[0] != '\0') {
+			opts.history_size = atoi(history_size);
+			if (opts.history_size <= 0) {
+				return "history";
+			}
+		}
+	}
+
+	if (ini.has("rewind")) {
+		opts.rewind_seconds = atoi(ini["rewind"].c_str());
+		if (opts.rewind_seconds < 0) {
+			return "rewind";
+		}
+	}
+
 	if (ini.has("wav")) {
 		opts.wav_path     = token_or_empty(ini["wav"], ",");
 		char const *start = token_or_empty(nullptr, ",");
@@ -1063,6 +1259,19 @@ static char const *set_options(options &opts, mINI::INIMap<std::string> &ini)
 		}
 	}
 
+	if (ini.has("wavstems")) {
+		char const *stems = ini["wavstems"].c_str();
+		if (!strcmp(stems, "none")) {
+			opts.wav_stems = wav_stems_t::WAV_STEMS_NONE;
+		} else if (!strcmp(stems, "chips")) {
+			opts.wav_stems = wav_stems_t::WAV_STEMS_CHIPS;
+		} else if (!strcmp(stems, "voices")) {
+			opts.wav_stems = wav_stems_t::WAV_STEMS_VOICES;
+		} else {
+			return "wavstems";
+		}
+	}
+
 	if (ini.has("stds")) {
 		opts.load_standard_symbols = true;
 	}
@@ -1133,6 +1342,10 @@ static char const *set_options(options &opts, mINI::INIMap<std::string> &ini)
 		opts.audio_buffers = (int)strtol(ini["abufs"].c_str(), NULL, 10);
 	}
 
+	if (ini.has("alatency")) {
+		opts.audio_latency = (int)strtol(ini["alatency"].c_str(), NULL, 10);
+	}
+
 	if (ini.has("rtc") && ini["rtc"] == "true") {
 		opts.set_system_time = true;
 	}
@@ -1191,6 +1404,9 @@ static void set_panels(mINI::INIMap<std::string> &ini)
 	get_option("disassembler", Show_disassembler);
 	get_option("breakpoints", Show_breakpoints);
 	get_option("watch_list", Show_watch_list);
+	get_option("tracepoints", Show_tracepoints);
+	get_option("profiler", Show_profiler);
+	get_option("raster_timeline", Show_raster_timeline);
 	get_option("symbols_list", Show_symbols_list);
 	get_option("symbols_files", Show_symbols_files);
 	get_option("cpu_visualizer", Show_cpu_visualizer);
@@ -1204,6 +1420,7 @@ static void set_panels(mINI::INIMap<std::string> &ini)
 	get_option("vera_psg_monitor", Show_VERA_PSG_monitor);
 	get_option("ym2151_monitor", Show_YM2151_monitor);
 	get_option("midi_overlay", Show_midi_overlay);
+	get_option("audio_overlay", Show_audio_overlay);
 	get_option("display", Show_display);
 }
 
@@ -1242,6 +1459,26 @@ static void set_ini_main(mINI::INIMap<std::string> &ini_main, bool all)
 			std::string option_value_string  = stringify(option_value);
 			std::string default_value_string = stringify(default_value);
 
+			if (all || option_value_string != default_value_string) {
+				ini_main[name] = option_value_string;
+			}
+		} else if constexpr (std::is_same<decltype(option_value), decltype(options::archive_mounts)>::value) {
+			auto stringify = [](auto &value) -> std::string {
+				std::stringstream value_string;
+				const char       *prefix = "";
+				for (auto &[path, dir] : value) {
+					value_string << prefix << path.generic_string();
+					if (!dir.empty()) {
+						value_string << "," << dir;
+					}
+					prefix = ";";
+				}
+				return value_string.str();
+			};
+
+			std::string option_value_string  = stringify(option_value);
+			std::string default_value_string = stringify(default_value);
+
 			if (all || option_value_string != default_value_string) {
 				ini_main[name] = option_value_string;
 			}
@@ -1319,6 +1556,16 @@ static void set_ini_main(mINI::INIMap<std::string> &ini_main, bool all)
 		return "none";
 	};
 
+	auto kernal_accel_str = [](kernal_accel_mode_t mode) -> const char * {
+		switch (mode) {
+			case kernal_accel_mode_t::NONE: return "none";
+			case kernal_accel_mode_t::FAST: return "fast";
+			case kernal_accel_mode_t::TIMED: return "timed";
+			case kernal_accel_mode_t::VERIFY: return "verify";
+		}
+		return "none";
+	};
+
 	auto quality_str = [](scale_quality_t q) -> const char * {
 		switch (q) {
 			case scale_quality_t::NEAREST: return "nearest";
@@ -1356,6 +1603,15 @@ static void set_ini_main(mINI::INIMap<std::string> &ini_main, bool all)
 		return "now";
 	};
 
+	auto wav_stems_str = [](wav_stems_t stems) -> const char * {
+		switch (stems) {
+			case wav_stems_t::WAV_STEMS_NONE: return "none";
+			case wav_stems_t::WAV_STEMS_CHIPS: return "chips";
+			case wav_stems_t::WAV_STEMS_VOICES: return "voices";
+		}
+		return "none";
+	};
+
 	set_option("rom", Options.rom_path, Default_options.rom_path);
 	set_option("carts", Options.rom_carts, Default_options.rom_carts);
 	// Deprecated and ignored
@@ -1364,14 +1620,17 @@ static void set_ini_main(mINI::INIMap<std::string> &ini_main, bool all)
 	set_option("ram", Options.num_ram_banks * 8, Default_options.num_ram_banks * 8);
 	set_option("keymap", keymaps_strict[Options.keymap], keymaps_strict[Default_options.keymap]);
 	set_option("hypercall_path", Options.fsroot_path, Default_options.fsroot_path);
+	set_option("mounts", Options.archive_mounts, Default_options.archive_mounts);
 	set_comma_option("prg", Options.prg_path, Default_options.prg_path, Options.prg_override_start, Default_options.prg_override_start);
 	set_option("run", Options.run_after_load, Default_options.run_after_load);
 	set_option("bas", Options.bas_path, Default_options.bas_path);
 	set_option("test", Options.test_number, Default_options.test_number);
 	set_option("nvram", Options.nvram_path, Default_options.nvram_path);
 	set_option("sdcard", Options.sdcard_path, Default_options.sdcard_path);
+	set_option("sdcard_overlay", Options.sdcard_overlay, Default_options.sdcard_overlay);
 	set_option("warp", Options.warp_factor > 0, Default_options.warp_factor > 0);
 	set_option("echo", echo_mode_str(Options.echo_mode), echo_mode_str(Default_options.echo_mode));
+	set_option("kernal_accel", kernal_accel_str(Options.kernal_accel), kernal_accel_str(Default_options.kernal_accel));
 
 	if (all || Options.log_keyboard != Default_options.log_keyboard || Options.log_speed != Default_options.log_speed || Options.log_video != Default_options.log_video) {
 		if (Options.log_keyboard) {
@@ -1409,6 +1668,10 @@ static void set_ini_main(mINI::INIMap<std::string> &ini_main, bool all)
 
 	set_comma_option("gif", Options.gif_path, Default_options.gif_path, gif_recorder_start_str(Options.gif_start), gif_recorder_start_str(Default_options.gif_start));
 	set_comma_option("wav", Options.wav_path, Default_options.wav_path, wav_recorder_start_str(Options.wav_start), wav_recorder_start_str(Default_options.wav_start));
+	set_option("coverage", Options.coverage_path, Default_options.coverage_path);
+	set_comma_option("history", Options.history_path, Default_options.history_path, Options.history_size, Default_options.history_size);
+	set_option("rewind", Options.rewind_seconds, Default_options.rewind_seconds);
+	set_option("wavstems", wav_stems_str(Options.wav_stems), wav_stems_str(Default_options.wav_stems));
 	set_option("stds", Options.load_standard_symbols, Default_options.load_standard_symbols);
 	set_option("scale", Options.window_scale, Default_options.window_scale);
 	set_option("quality", quality_str(Options.scale_quality), quality_str(Default_options.scale_quality));
@@ -1416,6 +1679,7 @@ static void set_ini_main(mINI::INIMap<std::string> &ini_main, bool all)
 	set_option("nosound", Options.no_sound, Default_options.no_sound);
 	set_option("sound", Options.audio_dev_name, Default_options.audio_dev_name);
 	set_option("abufs", Options.audio_buffers, Default_options.audio_buffers);
+	set_option("alatency", Options.audio_latency, Default_options.audio_latency);
 	set_option("rtc", Options.set_system_time, Default_options.set_system_time);
 	set_option("nobinds", Options.no_keybinds, Default_options.no_keybinds);
 	set_option("nohostieee", Options.no_ieee_hypercalls, Default_options.no_ieee_hypercalls);
@@ -1476,6 +1740,9 @@ void set_ini_panels(mINI::INIMap<std::string> &ini, bool all)
 	set_option("disassembler", Show_disassembler, false);
 	set_option("breakpoints", Show_breakpoints, false);
 	set_option("watch_list", Show_watch_list, false);
+	set_option("tracepoints", Show_tracepoints, false);
+	set_option("profiler", Show_profiler, false);
+	set_option("raster_timeline", Show_raster_timeline, false);
 	set_option("symbols_list", Show_symbols_list, false);
 	set_option("symbols_files", Show_symbols_files, false);
 	set_option("cpu_visualizer", Show_cpu_visualizer, false);
@@ -1489,6 +1756,7 @@ void set_ini_panels(mINI::INIMap<std::string> &ini, bool all)
 	set_option("vera_psg_monitor", Show_VERA_PSG_monitor, false);
 	set_option("ym2151_monitor", Show_YM2151_monitor, false);
 	set_option("midi_overlay", Show_midi_overlay, false);
+	set_option("audio_overlay", Show_audio_overlay, false);
 }
 
 void set_ini_window(mINI::INIMap<std::string> &ini)
@@ -12,6 +12,13 @@ enum class echo_mode_t {
 	ECHO_MODE_ISO,
 };
 
+enum class kernal_accel_mode_t {
+	NONE = 0,
+	FAST,
+	TIMED,
+	VERIFY,
+};
+
 enum class scale_quality_t {
 	NEAREST,
 	LINEAR,
@@ -43,22 +50,34 @@ enum class wav_recorder_start_t {
 	WAV_RECORDER_START_NOW
 };
 
+enum class wav_stems_t {
+	WAV_STEMS_NONE = 0,
+	WAV_STEMS_CHIPS,
+	WAV_STEMS_VOICES
+};
+
 struct options {
 	std::filesystem::path                                 rom_path = "rom.bin";
 	std::list<std::tuple<std::filesystem::path, uint8_t>> rom_carts;
 	std::filesystem::path                                 nvram_path  = "";
 	std::filesystem::path                                 fsroot_path  = ".";
 	std::filesystem::path                                 startin_path = ".";
+	std::list<std::tuple<std::filesystem::path, std::string>> archive_mounts;
 	std::filesystem::path                                 prg_path    = "";
 	std::filesystem::path                                 bas_path    = "";
 	std::filesystem::path                                 sdcard_path = "";
 	std::filesystem::path                                 gif_path    = "";
 	std::filesystem::path                                 wav_path    = "";
+	std::filesystem::path                                 history_path = "";
+	std::filesystem::path                                 coverage_path = "";
 	std::filesystem::path								  dump_memstats_path = "memory_stats.txt";
 	uint16_t prg_override_start = 0;
+	int      history_size       = 1024; // MB
+	int      rewind_seconds     = 10;
 
 	gif_recorder_start_t gif_start = gif_recorder_start_t::GIF_RECORDER_START_NOW;
 	wav_recorder_start_t wav_start = wav_recorder_start_t::WAV_RECORDER_START_NOW;
+	wav_stems_t          wav_stems = wav_stems_t::WAV_STEMS_NONE;
 
 	bool run_after_load = false;
 	bool run_test       = false;
@@ -83,6 +102,8 @@ struct options {
 
 	echo_mode_t echo_mode = echo_mode_t::ECHO_MODE_NONE;
 
+	kernal_accel_mode_t kernal_accel = kernal_accel_mode_t::NONE;
+
 	int             num_ram_banks = 64; // 512 KB default
 	uint8_t         keymap        = 0;  // KERNAL's default
 	int             test_number   = -1;
@@ -93,9 +114,12 @@ struct options {
 	scale_quality_t scale_quality = scale_quality_t::NEAREST;
 	vsync_mode_t    vsync_mode    = vsync_mode_t::VSYNC_MODE_GET_SYNC;
 
+	std::string sdcard_overlay = "";
+
 	std::string audio_dev_name = "";
 	bool        no_sound       = false;
 	int         audio_buffers  = 8;
+	int         audio_latency  = 20;
 
 	bool set_system_time    = false;
 	bool no_keybinds        = false;
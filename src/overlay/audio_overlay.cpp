@@ -0,0 +1,35 @@
+#include "audio_overlay.h"
+
+#include "imgui/imgui.h"
+
+#include "audio.h"
+#include "options.h"
+
+void draw_audio_overlay()
+{
+	if (Options.no_sound) {
+		ImGui::TextDisabled("Audio is disabled.");
+		return;
+	}
+
+	audio_stats stats;
+	audio_get_stats(&stats);
+
+	static float latency_history[240] = {};
+	static int   latency_history_pos  = 0;
+	latency_history[latency_history_pos] = stats.latency_ms;
+	latency_history_pos                  = (latency_history_pos + 1) % IM_ARRAYSIZE(latency_history);
+
+	ImGui::Text("Latency:     %6.2f ms", stats.latency_ms);
+	ImGui::Text("Target:      %6.2f ms", stats.target_latency_ms);
+	ImGui::Text("Rate adjust: %+6.0f ppm", stats.rate_adjust_ppm);
+	ImGui::Text("Queued:      %6u buffers", stats.queued_buffers);
+	ImGui::Text("Underruns:   %6u", stats.underruns);
+	ImGui::Text("Overruns:    %6u", stats.overruns);
+
+	if (ImGui::Button("Reset Counters")) {
+		audio_reset_stats();
+	}
+
+	ImGui::PlotLines("##latency", latency_history, IM_ARRAYSIZE(latency_history), latency_history_pos, nullptr, 0.0f, stats.target_latency_ms * 2.0f, ImVec2(ImGui::GetContentRegionAvail().x, 64.0f));
+}
@@ -0,0 +1,7 @@
+#pragma once
+#if !defined(AUDIO_OVERLAY_H)
+#	define AUDIO_OVERLAY_H
+
+void draw_audio_overlay();
+
+#endif
@@ -1,5 +1,8 @@
 #include "options_menu.h"
 
+#include <algorithm>
+
+#include "audio.h"
 #include "display.h"
 #include "imgui/imgui.h"
 #include "hypercalls.h"
@@ -326,6 +329,32 @@ void draw_options_menu()
 		ImGui::EndCombo();
 	}
 
+	static auto wav_stems_name = [](wav_stems_t stems) {
+		switch (stems) {
+			case wav_stems_t::WAV_STEMS_NONE: return "None";
+			case wav_stems_t::WAV_STEMS_CHIPS: return "Per chip";
+			case wav_stems_t::WAV_STEMS_VOICES: return "Per chip and voice";
+			default: return "None";
+		}
+	};
+
+	if (ImGui::BeginCombo("WAV Stems", wav_stems_name(Options.wav_stems))) {
+		static auto selection = [](wav_stems_t stems) {
+			if (ImGui::Selectable(wav_stems_name(stems), Options.wav_stems == stems)) {
+				Options.wav_stems = stems;
+			}
+		};
+
+		selection(wav_stems_t::WAV_STEMS_NONE);
+		selection(wav_stems_t::WAV_STEMS_CHIPS);
+		selection(wav_stems_t::WAV_STEMS_VOICES);
+
+		ImGui::EndCombo();
+	}
+	if (ImGui::IsItemHovered()) {
+		ImGui::SetTooltip("Also record each sound chip (and optionally each YM2151 voice and PSG channel) to separate wavs next to the WAV path.\nCommand line: -wavstems {none|chips|voices}");
+	}
+
 	bool_option(Options.load_standard_symbols, "Load Standard Symbols", "Load all symbols files typically included with ROM distributions.\nCommand line: -stds");
 
 	bool_option(Options.no_keybinds, "No Keybinds", "Disable all emulator keyboard bindings.\nDoes not affect F12 (emulator debug break) or key shortcuts when the ASM Monitor is open.\nCommand line: -nobinds");
@@ -357,6 +386,14 @@ void draw_options_menu()
 		ImGui::SetTooltip("Number of audio buffers.\n(Deprecated: No longer has any effect.)\nCommand line: -abufs <qty>");
 	}
 
+	if (ImGui::InputInt("Audio Latency (ms)", &Options.audio_latency)) {
+		Options.audio_latency = std::clamp(Options.audio_latency, 0, 200);
+		audio_set_target_latency(Options.audio_latency);
+	}
+	if (ImGui::IsItemHovered()) {
+		ImGui::SetTooltip("Target amount of queued audio. The audio rendering rate is adjusted slightly to stay at this latency.\nCommand line: -alatency <ms>");
+	}
+
 	if (bool_option(Options.ym_irq, "Enable YM2151 interrupts", "Enable interrupt generation from the YM2151 chip.\nCommand line: -ymirq")) {
 		YM_set_irq_enabled(Options.ym_irq);
 	}
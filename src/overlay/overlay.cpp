@@ -11,6 +11,7 @@
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_sdl2.h"
 
+#include "audio_overlay.h"
 #include "cpu_visualization.h"
 #include "disasm_overlay.h"
 #include "ram_dump.h"
@@ -31,11 +32,16 @@
 #include "keyboard.h"
 #include "midi_overlay.h"
 #include "options_menu.h"
+#include "profiler_overlay.h"
+#include "raster_timeline_overlay.h"
 #include "psg_overlay.h"
+#include "rewind.h"
+#include "trace_overlay.h"
 #include "smc.h"
 #include "symbols.h"
 #include "timing.h"
 #include "vera/sdcard.h"
+#include "vera/sdcard_overlay.h"
 #include "vera/vera_video.h"
 #include "ym2151_overlay.h"
 
@@ -50,6 +56,9 @@ bool Show_cpu_monitor      = false;
 bool Show_disassembler     = false;
 bool Show_breakpoints      = false;
 bool Show_watch_list       = false;
+bool Show_tracepoints      = false;
+bool Show_profiler         = false;
+bool Show_raster_timeline  = false;
 bool Show_symbols_list     = false;
 bool Show_symbols_files    = false;
 bool Show_cpu_visualizer   = false;
@@ -63,6 +72,7 @@ bool Show_VERA_sprites     = false;
 bool Show_VERA_PSG_monitor = false;
 bool Show_YM2151_monitor   = false;
 bool Show_midi_overlay     = false;
+bool Show_audio_overlay    = false;
 bool Show_display          = true;
 
 bool display_focused = false;
@@ -2761,6 +2771,112 @@ static void draw_breakpoints()
 	ImGui::EndGroup();
 }
 
+static void draw_watchpoints()
+{
+	ImGui::BeginGroup();
+	{
+		ImVec2 table_size = ImGui::GetContentRegionAvail();
+		table_size.y      = 0.0f;
+		if (ImGui::BeginTable("watchpoints", 8, ImGuiTableFlags_Resizable, table_size)) {
+			ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed, 16);
+			ImGui::TableSetupColumn("E", ImGuiTableColumnFlags_WidthFixed, 16);
+			ImGui::TableSetupColumn("#", ImGuiTableColumnFlags_WidthFixed, 24);
+			ImGui::TableSetupColumn("Type", ImGuiTableColumnFlags_WidthFixed, 32);
+			ImGui::TableSetupColumn("Space", ImGuiTableColumnFlags_WidthFixed, 40);
+			ImGui::TableSetupColumn("Start", ImGuiTableColumnFlags_WidthFixed, 64);
+			ImGui::TableSetupColumn("End", ImGuiTableColumnFlags_WidthFixed, 64);
+			ImGui::TableSetupColumn("Hits", ImGuiTableColumnFlags_WidthStretch);
+			ImGui::TableHeadersRow();
+
+			for (auto &wp : debugger_get_watchpoints()) {
+				ImGui::PushID(wp.id);
+
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				if (ImGui::TileButton(ICON_REMOVE)) {
+					debugger_remove_watchpoint(wp.id);
+					ImGui::PopID();
+					break;
+				}
+
+				ImGui::TableNextColumn();
+				if (ImGui::TileButton(wp.enabled ? ICON_CHECKED : ICON_UNCHECKED)) {
+					debugger_enable_watchpoint(wp.id, !wp.enabled);
+				}
+
+				ImGui::TableNextColumn();
+				ImGui::Text("%u", wp.id);
+
+				ImGui::TableNextColumn();
+				ImGui::Text("%c%c%c", (wp.flags & DEBUGGER_WATCH_READ) ? 'R' : '-', (wp.flags & DEBUGGER_WATCH_WRITE) ? 'W' : '-', (wp.flags & DEBUGGER_WATCH_CHANGE) ? 'C' : '-');
+
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(wp.vram ? "VRAM" : "CPU");
+
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(debugger_format_watch_address(wp, wp.start).c_str());
+
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(debugger_format_watch_address(wp, wp.end).c_str());
+
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu", static_cast<unsigned long long>(wp.hits));
+
+				ImGui::PopID();
+			}
+
+			ImGui::EndTable();
+		}
+
+		static uint16_t cpu_start    = 0;
+		static uint16_t cpu_end      = 0;
+		static uint8_t  start_bank   = 0;
+		static uint8_t  end_bank     = 0;
+		static uint32_t vram_start   = 0;
+		static uint32_t vram_end     = 0;
+		static bool     vram         = false;
+		static bool     watch_read   = false;
+		static bool     watch_write  = true;
+		static bool     watch_change = false;
+
+		ImGui::PushID("new watchpoint");
+		ImGui::Checkbox("VRAM", &vram);
+		ImGui::SameLine();
+		ImGui::Checkbox("Read", &watch_read);
+		ImGui::SameLine();
+		ImGui::Checkbox("Write", &watch_write);
+		ImGui::SameLine();
+		ImGui::Checkbox("Change", &watch_change);
+
+		if (vram) {
+			ImGui::InputHexLabel<uint32_t, 20>("Start", vram_start);
+			ImGui::SameLine();
+			ImGui::InputHexLabel<uint32_t, 20>("End", vram_end);
+		} else {
+			ImGui::InputHexLabel("Start", cpu_start);
+			ImGui::SameLine();
+			ImGui::InputHexLabel("Bank", start_bank);
+			ImGui::SameLine();
+			ImGui::InputHexLabel("End", cpu_end);
+			ImGui::SameLine();
+			ImGui::PushID("end");
+			ImGui::InputHexLabel("Bank", end_bank);
+			ImGui::PopID();
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Add")) {
+			const uint8_t flags = (watch_read ? DEBUGGER_WATCH_READ : 0) | (watch_write ? DEBUGGER_WATCH_WRITE : 0) | (watch_change ? DEBUGGER_WATCH_CHANGE : 0);
+			if (vram) {
+				debugger_add_vram_watchpoint(vram_start, vram_end, flags);
+			} else {
+				debugger_add_watchpoint(cpu_start, start_bank, cpu_end, end_bank, flags);
+			}
+		}
+		ImGui::PopID();
+	}
+	ImGui::EndGroup();
+}
+
 static void draw_watch_list()
 {
 	ImGui::BeginGroup();
@@ -3151,6 +3267,8 @@ static void draw_debugger_controls()
 {
 	bool paused  = debugger_is_paused();
 	bool shifted = ImGui::IsKeyDown(ImGuiKey_LeftShift) || ImGui::IsKeyDown(ImGuiKey_RightShift);
+	bool control = ImGui::IsKeyDown(ImGuiKey_LeftCtrl) || ImGui::IsKeyDown(ImGuiKey_RightCtrl);
+	bool rewind  = paused && rewind_is_enabled();
 
 	static bool stop_hovered = false;
 	if (ImGui::TileButton(paused ? ICON_STOP_DISABLED : ICON_STOP, !paused, &stop_hovered) || (shifted && ImGui::IsKeyPressed(ImGuiKey_F5))) {
@@ -3164,7 +3282,7 @@ static void draw_debugger_controls()
 	ImGui::SameLine();
 
 	static bool run_hovered = false;
-	if (ImGui::TileButton(paused ? ICON_RUN : ICON_RUN_DISABLED, paused, &run_hovered) || (!shifted && ImGui::IsKeyPressed(ImGuiKey_F5))) {
+	if (ImGui::TileButton(paused ? ICON_RUN : ICON_RUN_DISABLED, paused, &run_hovered) || (!shifted && !control && ImGui::IsKeyPressed(ImGuiKey_F5))) {
 		debugger_continue_execution();
 		disasm.follow_pc();
 	}
@@ -3174,7 +3292,7 @@ static void draw_debugger_controls()
 	ImGui::SameLine();
 
 	static bool step_over_hovered = false;
-	if (ImGui::TileButton(paused ? ICON_STEP_OVER : ICON_STEP_OVER_DISABLED, paused, &step_over_hovered) || (!shifted && ImGui::IsKeyPressed(ImGuiKey_F10))) {
+	if (ImGui::TileButton(paused ? ICON_STEP_OVER : ICON_STEP_OVER_DISABLED, paused, &step_over_hovered) || (!shifted && !control && ImGui::IsKeyPressed(ImGuiKey_F10))) {
 		debugger_step_over_execution();
 		disasm.follow_pc();
 	}
@@ -3184,7 +3302,7 @@ static void draw_debugger_controls()
 	ImGui::SameLine();
 
 	static bool step_into_hovered = false;
-	if (ImGui::TileButton(paused ? ICON_STEP_INTO : ICON_STEP_INTO_DISABLED, paused, &step_into_hovered) || (!shifted && ImGui::IsKeyPressed(ImGuiKey_F11))) {
+	if (ImGui::TileButton(paused ? ICON_STEP_INTO : ICON_STEP_INTO_DISABLED, paused, &step_into_hovered) || (!shifted && !control && ImGui::IsKeyPressed(ImGuiKey_F11))) {
 		debugger_step_execution();
 		disasm.follow_pc();
 	}
@@ -3203,6 +3321,36 @@ static void draw_debugger_controls()
 	}
 	ImGui::SameLine();
 
+	static bool continue_back_hovered = false;
+	if (ImGui::TileButton(rewind ? ICON_RUN : ICON_RUN_DISABLED, rewind, &continue_back_hovered, true) || (rewind && control && ImGui::IsKeyPressed(ImGuiKey_F5))) {
+		rewind_continue_back();
+		disasm.follow_pc();
+	}
+	if (rewind && ImGui::IsItemHovered()) {
+		ImGui::SetTooltip("Reverse Continue (Ctrl+F5)");
+	}
+	ImGui::SameLine();
+
+	static bool step_back_over_hovered = false;
+	if (ImGui::TileButton(rewind ? ICON_STEP_OVER : ICON_STEP_OVER_DISABLED, rewind, &step_back_over_hovered, true) || (rewind && control && ImGui::IsKeyPressed(ImGuiKey_F10))) {
+		rewind_step_back_over();
+		disasm.follow_pc();
+	}
+	if (rewind && ImGui::IsItemHovered()) {
+		ImGui::SetTooltip("Step Back Over (Ctrl+F10)");
+	}
+	ImGui::SameLine();
+
+	static bool step_back_hovered = false;
+	if (ImGui::TileButton(rewind ? ICON_STEP_INTO : ICON_STEP_INTO_DISABLED, rewind, &step_back_hovered, true) || (rewind && control && ImGui::IsKeyPressed(ImGuiKey_F11))) {
+		rewind_step_back();
+		disasm.follow_pc();
+	}
+	if (rewind && ImGui::IsItemHovered()) {
+		ImGui::SetTooltip("Step Back (Ctrl+F11)");
+	}
+	ImGui::SameLine();
+
 	static bool set_breakpoint_hovered = false;
 	const bool  breakpoint_exists      = debugger_has_breakpoint(state6502.pc, memory_get_current_bank(state6502.pc));
 	const bool  breakpoint_active      = debugger_breakpoint_is_active(state6502.pc, memory_get_current_bank(state6502.pc));
@@ -3341,6 +3489,34 @@ static void draw_menu_bar()
 						sdcard_detach();
 					}
 				}
+				if (ImGui::MenuItem("Flush", nullptr, false, sdcard_is_attached())) {
+					sdcard_flush();
+				}
+				if (ImGui::BeginMenu("Overlay", sdcard_has_overlay())) {
+					if (ImGui::MenuItem("Discard")) {
+						sdcard_overlay_discard();
+					}
+					if (ImGui::MenuItem("Save As...")) {
+						char *save_path = nullptr;
+						if (NFD_SaveDialog("x16d", nullptr, &save_path) == NFD_OKAY && save_path != nullptr) {
+							sdcard_overlay_save(save_path);
+						}
+					}
+					if (ImGui::MenuItem("Merge Into Image")) {
+						sdcard_merge_overlay();
+					}
+					ImGui::EndMenu();
+				}
+
+				ImGui::Separator();
+				const sdcard_stats &stats = sdcard_get_stats();
+				ImGui::TextDisabled("Backend: %s", sdcard_get_backend_name());
+				ImGui::TextDisabled("Sectors read: %llu", static_cast<unsigned long long>(stats.sectors_read));
+				ImGui::TextDisabled("Sectors written: %llu", static_cast<unsigned long long>(stats.sectors_written));
+				ImGui::TextDisabled("Flushes: %llu", static_cast<unsigned long long>(stats.flushes));
+				if (sdcard_has_overlay()) {
+					ImGui::TextDisabled("Overlay sectors: %llu", static_cast<unsigned long long>(sdcard_overlay_sector_count()));
+				}
 				ImGui::EndMenu();
 			}
 
@@ -3387,6 +3563,9 @@ static void draw_menu_bar()
 				}
 				ImGui::Checkbox("Breakpoints (Ctrl-Alt-B)", &Show_breakpoints);
 				ImGui::Checkbox("Watch List (Ctrl-Alt-W)", &Show_watch_list);
+				ImGui::Checkbox("Tracepoints", &Show_tracepoints);
+				ImGui::Checkbox("Profiler", &Show_profiler);
+				ImGui::Checkbox("Raster Timeline", &Show_raster_timeline);
 				ImGui::Checkbox("Symbols List (Ctrl-Alt-S)", &Show_symbols_list);
 				ImGui::Checkbox("Symbols Files", &Show_symbols_files);
 				ImGui::EndMenu();
@@ -3404,6 +3583,7 @@ static void draw_menu_bar()
 			ImGui::Checkbox("Monitor Console", &Show_monitor_console);
 			ImGui::Checkbox("PSG Monitor", &Show_VERA_PSG_monitor);
 			ImGui::Checkbox("YM2151 Monitor", &Show_YM2151_monitor);
+			ImGui::Checkbox("Audio Status", &Show_audio_overlay);
 			ImGui::Separator();
 
 			if (ImGui::BeginMenu("Safety Frame")) {
@@ -3567,6 +3747,9 @@ void overlay_draw()
 	if (Show_breakpoints) {
 		if (ImGui::Begin("Breakpoints", &Show_breakpoints)) {
 			draw_breakpoints();
+			if (ImGui::CollapsingHeader("Watchpoints")) {
+				draw_watchpoints();
+			}
 		}
 		ImGui::End();
 	}
@@ -3679,6 +3862,34 @@ void overlay_draw()
 		ImGui::End();
 	}
 
+	if (Show_audio_overlay) {
+		if (ImGui::Begin("Audio Status", &Show_audio_overlay)) {
+			draw_audio_overlay();
+		}
+		ImGui::End();
+	}
+
+	if (Show_tracepoints) {
+		if (ImGui::Begin("Tracepoints", &Show_tracepoints)) {
+			draw_trace_overlay();
+		}
+		ImGui::End();
+	}
+
+	if (Show_profiler) {
+		if (ImGui::Begin("Profiler", &Show_profiler)) {
+			draw_profiler_overlay();
+		}
+		ImGui::End();
+	}
+
+	if (Show_raster_timeline) {
+		if (ImGui::Begin("Raster Timeline", &Show_raster_timeline)) {
+			draw_raster_timeline_overlay();
+		}
+		ImGui::End();
+	}
+
 	// Display should be the last one so it gets focused on startup
 	if (Show_display) {
 		float title_bar_height = ImGui::GetFrameHeight();
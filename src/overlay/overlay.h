@@ -11,6 +11,9 @@ extern bool Show_cpu_monitor;
 extern bool Show_disassembler;
 extern bool Show_breakpoints;
 extern bool Show_watch_list;
+extern bool Show_tracepoints;
+extern bool Show_profiler;
+extern bool Show_raster_timeline;
 extern bool Show_symbols_list;
 extern bool Show_symbols_files;
 extern bool Show_cpu_visualizer;
@@ -24,6 +27,7 @@ extern bool Show_VERA_sprites;
 extern bool Show_VERA_PSG_monitor;
 extern bool Show_YM2151_monitor;
 extern bool Show_midi_overlay;
+extern bool Show_audio_overlay;
 extern bool Show_display;
 
 extern bool display_focused;
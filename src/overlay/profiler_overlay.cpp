@@ -0,0 +1,99 @@
+#include "profiler_overlay.h"
+
+#include <algorithm>
+
+#include "imgui/imgui.h"
+#include "nfd.h"
+
+#include "profiler.h"
+
+static void save_with_dialog(bool collapsed)
+{
+	char *save_path = nullptr;
+	if (NFD_SaveDialog("txt", nullptr, &save_path) == NFD_OKAY && save_path != nullptr) {
+		if (collapsed) {
+			profiler_save_collapsed(save_path);
+		} else {
+			profiler_save_report(save_path);
+		}
+		free(save_path);
+	}
+}
+
+void draw_profiler_overlay()
+{
+	static std::vector<profiler_function_stats> functions;
+	static double                               last_refresh = 0.0;
+
+	// Summing the call tree isn't free, so only do it a couple of times a second.
+	const double now = ImGui::GetTime();
+	if (now - last_refresh > 0.5) {
+		functions    = profiler_get_functions();
+		last_refresh = now;
+	}
+
+	if (profiler_is_running()) {
+		if (ImGui::Button("Stop")) {
+			profiler_stop();
+		}
+	} else if (ImGui::Button("Start")) {
+		profiler_start();
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Clear")) {
+		profiler_clear();
+		functions.clear();
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Save Report")) {
+		save_with_dialog(false);
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Save Flame Graph Stacks")) {
+		save_with_dialog(true);
+	}
+
+	const uint64_t total = profiler_total_cycles();
+	ImGui::Text("%llu cycles profiled, %llu waiting", static_cast<unsigned long long>(total), static_cast<unsigned long long>(profiler_wait_cycles()));
+
+	constexpr ImGuiTableFlags table_flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable | ImGuiTableFlags_Sortable;
+	if (ImGui::BeginTable("profile", 4, table_flags)) {
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("Function", ImGuiTableColumnFlags_WidthStretch | ImGuiTableColumnFlags_NoSort);
+		ImGui::TableSetupColumn("Self", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending, 128);
+		ImGui::TableSetupColumn("Inclusive", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 128);
+		ImGui::TableSetupColumn("Calls", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 80);
+		ImGui::TableHeadersRow();
+
+		if (ImGuiTableSortSpecs *sort_specs = ImGui::TableGetSortSpecs(); sort_specs != nullptr && sort_specs->SpecsCount > 0) {
+			const ImGuiTableColumnSortSpecs &spec       = sort_specs->Specs[0];
+			const bool                       descending = spec.SortDirection == ImGuiSortDirection_Descending;
+			std::stable_sort(functions.begin(), functions.end(), [&](const profiler_function_stats &a, const profiler_function_stats &b) {
+				const uint64_t lhs = spec.ColumnIndex == 2 ? a.inclusive_cycles : spec.ColumnIndex == 3 ? a.calls : a.self_cycles;
+				const uint64_t rhs = spec.ColumnIndex == 2 ? b.inclusive_cycles : spec.ColumnIndex == 3 ? b.calls : b.self_cycles;
+				return descending ? lhs > rhs : lhs < rhs;
+			});
+		}
+
+		const double scale = total ? 100.0 / (double)total : 0.0;
+
+		ImGuiListClipper clipper;
+		clipper.Begin(static_cast<int>(functions.size()));
+		while (clipper.Step()) {
+			for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+				const profiler_function_stats &stats = functions[row];
+
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(profiler_function_name(stats.function).c_str());
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu (%.1f%%)", static_cast<unsigned long long>(stats.self_cycles), stats.self_cycles * scale);
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu (%.1f%%)", static_cast<unsigned long long>(stats.inclusive_cycles), stats.inclusive_cycles * scale);
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu", static_cast<unsigned long long>(stats.calls));
+			}
+		}
+		ImGui::EndTable();
+	}
+}
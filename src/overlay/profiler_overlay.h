@@ -0,0 +1,7 @@
+#pragma once
+#if !defined(PROFILER_OVERLAY_H)
+#	define PROFILER_OVERLAY_H
+
+void draw_profiler_overlay();
+
+#endif
@@ -0,0 +1,149 @@
+#include "raster_timeline_overlay.h"
+
+#include <algorithm>
+#include <stdlib.h>
+
+#include "imgui/imgui.h"
+#include "nfd.h"
+
+#include "glue.h"
+#include "raster_timeline.h"
+
+// VERA draws a line in 800 dots at 25MHz, so this is what the CPU gets per line at full speed.
+static constexpr float Cycles_per_line = MHZ * 800.0f / 25.0f;
+
+static const ImU32 Busy_color = IM_COL32(0x40, 0xc0, 0x40, 0xff);
+static const ImU32 Irq_color  = IM_COL32(0xe0, 0x50, 0x40, 0xff);
+static const ImU32 Wait_color = IM_COL32(0x50, 0x50, 0x60, 0xff);
+
+static void save_with_dialog(size_t frames)
+{
+	char *save_path = nullptr;
+	if (NFD_SaveDialog("csv", nullptr, &save_path) == NFD_OKAY && save_path != nullptr) {
+		raster_timeline_save_csv(save_path, frames);
+		free(save_path);
+	}
+}
+
+static void draw_legend(const char *label, ImU32 color)
+{
+	const float  size = ImGui::GetTextLineHeight();
+	const ImVec2 pos  = ImGui::GetCursorScreenPos();
+	ImGui::GetWindowDrawList()->AddRectFilled(pos, ImVec2(pos.x + size, pos.y + size), color);
+	ImGui::Dummy(ImVec2(size, size));
+	ImGui::SameLine();
+	ImGui::TextUnformatted(label);
+}
+
+void draw_raster_timeline_overlay()
+{
+	static int  frame_index = 0;
+	static bool follow      = true;
+
+	if (Raster_timeline_enabled) {
+		if (ImGui::Button("Stop")) {
+			raster_timeline_stop();
+		}
+	} else if (ImGui::Button("Start")) {
+		raster_timeline_start();
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Clear")) {
+		raster_timeline_clear();
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Save CSV")) {
+		save_with_dialog(raster_timeline_frame_count());
+	}
+	ImGui::SameLine();
+	ImGui::Checkbox("Follow", &follow);
+
+	const int frame_count = static_cast<int>(raster_timeline_frame_count());
+	if (frame_count == 0) {
+		ImGui::TextDisabled("No frames recorded.");
+		return;
+	}
+
+	// Frames are numbered back from the newest, so 0 keeps showing the latest one.
+	if (follow) {
+		frame_index = 0;
+	}
+	ImGui::SetNextItemWidth(160);
+	if (ImGui::SliderInt("Frames ago", &frame_index, 0, frame_count - 1)) {
+		follow = frame_index == 0;
+	}
+	frame_index = std::clamp(frame_index, 0, frame_count - 1);
+
+	const raster_timeline_frame &frame = raster_timeline_get_frame(frame_index);
+
+	uint32_t cycles = 0, wait_cycles = 0, irq_cycles = 0;
+	for (const auto &line : frame.lines) {
+		cycles += line.cycles;
+		wait_cycles += line.wait_cycles;
+		irq_cycles += line.irq_cycles;
+	}
+	const float scale = cycles ? 100.0f / (float)cycles : 0.0f;
+	ImGui::Text("Frame %u: %u cycles, %.1f%% busy, %.1f%% in interrupts, %.1f%% waiting", frame.frame, cycles, (cycles - wait_cycles) * scale, irq_cycles * scale, wait_cycles * scale);
+
+	draw_legend("Running", Busy_color);
+	ImGui::SameLine();
+	draw_legend("Interrupt", Irq_color);
+	ImGui::SameLine();
+	draw_legend("WAI", Wait_color);
+
+	// One bar per scanline, top of the frame at the top, like a border colour change would show.
+	const ImVec2 avail = ImGui::GetContentRegionAvail();
+	const ImVec2 size(std::max(avail.x, 64.0f), std::max(avail.y, (float)Raster_timeline_lines));
+	ImGui::BeginChild("raster", avail, false, ImGuiWindowFlags_HorizontalScrollbar);
+	{
+		ImDrawList  *draw_list = ImGui::GetWindowDrawList();
+		const ImVec2 topleft   = ImGui::GetCursorScreenPos();
+		ImGui::InvisibleButton("lines", size);
+
+		const float line_height = size.y / Raster_timeline_lines;
+		const float x_scale     = size.x / Cycles_per_line;
+
+		draw_list->AddRectFilled(topleft, ImVec2(topleft.x + size.x, topleft.y + size.y), IM_COL32(0x20, 0x20, 0x20, 0xff));
+		for (uint16_t y = 0; y < Raster_timeline_lines; ++y) {
+			const raster_timeline_line &line = frame.lines[y];
+			if (line.cycles == 0) {
+				continue;
+			}
+			const float top    = topleft.y + y * line_height;
+			const float bottom = top + std::max(line_height, 1.0f);
+
+			const uint16_t irq  = std::min(line.irq_cycles, (uint16_t)(line.cycles - line.wait_cycles));
+			const uint16_t busy = line.cycles - line.wait_cycles - irq;
+
+			float x = topleft.x;
+			auto  bar = [&](uint16_t cycles, ImU32 color) {
+				if (cycles != 0) {
+					const float right = std::min(x + cycles * x_scale, topleft.x + size.x);
+					draw_list->AddRectFilled(ImVec2(x, top), ImVec2(right, bottom), color);
+					x = right;
+				}
+			};
+			bar(irq, Irq_color);
+			bar(busy, Busy_color);
+			bar(line.wait_cycles, Wait_color);
+		}
+
+		if (ImGui::IsItemHovered()) {
+			const int y = static_cast<int>((ImGui::GetMousePos().y - topleft.y) / line_height);
+			if (y >= 0 && y < Raster_timeline_lines) {
+				const raster_timeline_line &line = frame.lines[y];
+				ImGui::BeginTooltip();
+				ImGui::Text("Line %d", y);
+				ImGui::Text("%u cycles, %u in interrupts, %u waiting", line.cycles, line.irq_cycles, line.wait_cycles);
+				if (line.cycles != 0) {
+					ImGui::Text("Running: %s", raster_timeline_function_name(line.function).c_str());
+				}
+				if (line.irq_handler != Raster_timeline_none) {
+					ImGui::Text("Interrupt: %s", raster_timeline_function_name(line.irq_handler).c_str());
+				}
+				ImGui::EndTooltip();
+			}
+		}
+	}
+	ImGui::EndChild();
+}
@@ -0,0 +1,7 @@
+#pragma once
+#if !defined(RASTER_TIMELINE_OVERLAY_H)
+#	define RASTER_TIMELINE_OVERLAY_H
+
+void draw_raster_timeline_overlay();
+
+#endif
@@ -0,0 +1,172 @@
+#include "trace_overlay.h"
+
+#include "imgui/imgui.h"
+
+#include "util.h"
+
+#include "debugger.h"
+#include "display.h"
+#include "symbols.h"
+
+static void draw_tracepoints()
+{
+	ImVec2 table_size = ImGui::GetContentRegionAvail();
+	table_size.y      = 0.0f;
+	if (ImGui::BeginTable("tracepoints", 6, ImGuiTableFlags_Resizable, table_size)) {
+		ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed, 16);
+		ImGui::TableSetupColumn("L", ImGuiTableColumnFlags_WidthFixed, 16);
+		ImGui::TableSetupColumn("Address", ImGuiTableColumnFlags_WidthFixed, 64);
+		ImGui::TableSetupColumn("Symbol", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableSetupColumn("Condition", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableSetupColumn("Values", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableHeadersRow();
+
+		for (auto &[address, bank] : debugger_get_tracepoints()) {
+			ImGui::PushID(address);
+			ImGui::PushID(bank);
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			if (ImGui::TileButton(ICON_REMOVE)) {
+				debugger_remove_tracepoint(address, bank);
+				ImGui::PopID();
+				ImGui::PopID();
+				break;
+			}
+
+			ImGui::TableNextColumn();
+			const uint8_t flags = debugger_get_tracepoint_flags(address, bank);
+			if (ImGui::TileButton((flags & DEBUGGER_TRACE_LOG) ? ICON_CHECKED : ICON_UNCHECKED)) {
+				debugger_set_tracepoint_flags(address, bank, flags ^ DEBUGGER_TRACE_LOG);
+			}
+
+			ImGui::TableNextColumn();
+			ImGui::Text("%02X:%04X", bank, address);
+
+			ImGui::TableNextColumn();
+			const auto &symbols = symbols_find(address, bank);
+			if (!symbols.empty()) {
+				ImGui::TextUnformatted(symbols.front().c_str());
+			}
+
+			ImGui::TableNextColumn();
+			std::string cond = debugger_get_tracepoint_condition(address, bank);
+			ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x);
+			if (ImGui::InputText("", cond)) {
+				debugger_set_tracepoint_condition(address, bank, cond);
+			}
+			ImGui::PopItemWidth();
+
+			ImGui::TableNextColumn();
+			std::string values;
+			for (auto &value : debugger_get_tracepoint_values(address, bank)) {
+				if (!values.empty()) {
+					values += ", ";
+				}
+				values += value;
+			}
+			ImGui::TextUnformatted(values.c_str());
+
+			ImGui::PopID();
+			ImGui::PopID();
+		}
+
+		ImGui::EndTable();
+	}
+
+	static uint16_t new_address = 0;
+	static uint8_t  new_bank    = 0;
+	ImGui::InputHexLabel("New Address", new_address);
+	ImGui::SameLine();
+	ImGui::InputHexLabel("Bank", new_bank);
+	ImGui::SameLine();
+	if (ImGui::Button("Add")) {
+		debugger_add_tracepoint(new_address, new_bank);
+	}
+}
+
+static void draw_trace_events()
+{
+	static bool follow = true;
+
+	if (ImGui::Button("Clear")) {
+		debugger_clear_trace();
+	}
+	ImGui::SameLine();
+	ImGui::Checkbox("Follow", &follow);
+	ImGui::SameLine();
+
+	const size_t   num_events = debugger_get_trace_count();
+	const uint64_t total      = debugger_get_trace_total();
+	ImGui::Text("%zu events held, %llu recorded", num_events, static_cast<unsigned long long>(total));
+
+	constexpr ImGuiTableFlags table_flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable;
+	if (ImGui::BeginTable("trace events", 9, table_flags)) {
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("Clock", ImGuiTableColumnFlags_WidthFixed, 96);
+		ImGui::TableSetupColumn("PC", ImGuiTableColumnFlags_WidthFixed, 56);
+		ImGui::TableSetupColumn("Symbol", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableSetupColumn("A", ImGuiTableColumnFlags_WidthFixed, 20);
+		ImGui::TableSetupColumn("X", ImGuiTableColumnFlags_WidthFixed, 20);
+		ImGui::TableSetupColumn("Y", ImGuiTableColumnFlags_WidthFixed, 20);
+		ImGui::TableSetupColumn("SP", ImGuiTableColumnFlags_WidthFixed, 20);
+		ImGui::TableSetupColumn("Status", ImGuiTableColumnFlags_WidthFixed, 64);
+		ImGui::TableSetupColumn("Values", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableHeadersRow();
+
+		ImGuiListClipper clipper;
+		clipper.Begin(static_cast<int>(num_events));
+		while (clipper.Step()) {
+			for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+				const tracepoint_event &event = debugger_get_trace_event(static_cast<size_t>(row));
+				const _state6502       &state = event.state;
+
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu", static_cast<unsigned long long>(event.clock));
+				ImGui::TableNextColumn();
+				ImGui::Text("%02X:%04X", event.bank, state.pc);
+				ImGui::TableNextColumn();
+				const auto &symbols = symbols_find(state.pc, event.bank);
+				if (!symbols.empty()) {
+					ImGui::TextUnformatted(symbols.front().c_str());
+				}
+				ImGui::TableNextColumn();
+				ImGui::Text("%02X", state.a);
+				ImGui::TableNextColumn();
+				ImGui::Text("%02X", state.x);
+				ImGui::TableNextColumn();
+				ImGui::Text("%02X", state.y);
+				ImGui::TableNextColumn();
+				ImGui::Text("%02X", state.sp);
+				ImGui::TableNextColumn();
+				char status[9];
+				for (int i = 0; i < 8; ++i) {
+					status[i] = (state.status & (0x80 >> i)) ? "NV-BDIZC"[i] : '-';
+				}
+				status[8] = '\0';
+				ImGui::TextUnformatted(status);
+				ImGui::TableNextColumn();
+				for (uint8_t i = 0; i < event.num_values; ++i) {
+					if (i > 0) {
+						ImGui::SameLine();
+					}
+					ImGui::Text("%d", event.values[i]);
+				}
+			}
+		}
+
+		if (follow && ImGui::GetScrollY() < ImGui::GetScrollMaxY()) {
+			ImGui::SetScrollHereY(1.0f);
+		}
+		ImGui::EndTable();
+	}
+}
+
+void draw_trace_overlay()
+{
+	if (ImGui::CollapsingHeader("Tracepoints", ImGuiTreeNodeFlags_DefaultOpen)) {
+		draw_tracepoints();
+	}
+	draw_trace_events();
+}
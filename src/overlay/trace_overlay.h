@@ -0,0 +1,7 @@
+#pragma once
+#if !defined(TRACE_OVERLAY_H)
+#	define TRACE_OVERLAY_H
+
+void draw_trace_overlay();
+
+#endif
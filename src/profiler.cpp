@@ -0,0 +1,305 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <unordered_map>
+
+#include "call_tracker.h"
+#include "cpu/fake6502.h"
+#include "fmt/format.h"
+#include "glue.h"
+#include "memory.h"
+#include "symbols.h"
+
+bool Profiler_enabled = false;
+
+// Per-instruction cycles are kept in pages covering the same banked address space as the
+// debugger's breakpoint flags, allocated the first time code runs in them.
+static constexpr uint32_t Pc_page_size  = 0x2000;
+static constexpr uint32_t Pc_space_size = 0xa000 + 0x6000 * NUM_MAX_RAM_BANKS;
+static constexpr uint32_t Num_pc_pages  = Pc_space_size / Pc_page_size;
+
+struct call_node {
+	uint32_t function;
+	uint32_t parent;
+	uint32_t first_child;
+	uint32_t next_sibling;
+	uint64_t self_cycles;
+	uint64_t calls;
+};
+
+static constexpr uint32_t No_node = 0xffffffff;
+
+static std::vector<call_node> Nodes;
+static uint32_t               Current_node = 0;
+
+// Each active call remembers the node of its caller.
+static call_tracker<uint32_t> Calls;
+
+static std::unique_ptr<uint64_t[]> Pc_cycles[Num_pc_pages];
+
+static uint64_t Total_cycles = 0;
+static uint64_t Wait_cycles  = 0;
+
+static void reset_tree()
+{
+	Nodes.clear();
+	Nodes.push_back({ Profiler_root, No_node, No_node, No_node, 0, 0 });
+	Current_node = 0;
+	Calls.clear();
+}
+
+static void enter_function(uint16_t address, uint8_t bank)
+{
+	if (!Calls.enter(state6502.sp, Current_node)) {
+		return;
+	}
+
+	const uint32_t function = call_tracker_function_id(address, bank);
+
+	uint32_t child = Nodes[Current_node].first_child;
+	while (child != No_node && Nodes[child].function != function) {
+		child = Nodes[child].next_sibling;
+	}
+	if (child == No_node) {
+		child = static_cast<uint32_t>(Nodes.size());
+		Nodes.push_back({ function, Current_node, No_node, Nodes[Current_node].first_child, 0, 0 });
+		Nodes[Current_node].first_child = child;
+	}
+
+	++Nodes[child].calls;
+	Current_node = child;
+}
+
+void profiler_start()
+{
+	if (Nodes.empty()) {
+		reset_tree();
+	}
+	// Calls made while stopped weren't seen, so start again from the root.
+	Current_node = 0;
+	Calls.clear();
+	Profiler_enabled = true;
+}
+
+void profiler_stop()
+{
+	Profiler_enabled = false;
+}
+
+void profiler_clear()
+{
+	reset_tree();
+	for (auto &page : Pc_cycles) {
+		page.reset();
+	}
+	Total_cycles = 0;
+	Wait_cycles  = 0;
+}
+
+void profiler_instruction(uint16_t pc, uint8_t bank, uint8_t opcode, uint32_t cycles)
+{
+	Nodes[Current_node].self_cycles += cycles;
+	Total_cycles += cycles;
+
+	const uint32_t offset = banked_offset(pc, bank);
+	auto          &page   = Pc_cycles[offset / Pc_page_size];
+	if (!page) {
+		page = std::make_unique<uint64_t[]>(Pc_page_size);
+	}
+	page[offset % Pc_page_size] += cycles;
+
+	Calls.update(state6502.sp, [](const call_tracker<uint32_t>::frame &call) {
+		Current_node = call.data;
+	});
+
+	switch (opcode) {
+		case 0x00: // brk
+		case 0x20: // jsr
+			enter_function(state6502.pc, memory_get_current_bank(state6502.pc));
+			break;
+		default:
+			break;
+	}
+}
+
+void profiler_interrupt()
+{
+	enter_function(state6502.pc, memory_get_current_bank(state6502.pc));
+}
+
+void profiler_wait(uint32_t cycles)
+{
+	Wait_cycles += cycles;
+}
+
+uint64_t profiler_total_cycles()
+{
+	return Total_cycles;
+}
+
+uint64_t profiler_wait_cycles()
+{
+	return Wait_cycles;
+}
+
+std::vector<profiler_function_stats> profiler_get_functions()
+{
+	if (Nodes.empty()) {
+		return {};
+	}
+
+	// Children are always created after their parents, so a reverse walk sums whole subtrees.
+	std::vector<uint64_t> inclusive(Nodes.size());
+	for (size_t i = Nodes.size(); i-- > 0;) {
+		inclusive[i] += Nodes[i].self_cycles;
+		if (Nodes[i].parent != No_node) {
+			inclusive[Nodes[i].parent] += inclusive[i];
+		}
+	}
+
+	std::vector<profiler_function_stats>   functions;
+	std::unordered_map<uint32_t, size_t> function_index;
+	auto find_function = [&](uint32_t function) -> profiler_function_stats & {
+		auto [iter, inserted] = function_index.try_emplace(function, functions.size());
+		if (inserted) {
+			functions.push_back({ function, 0, 0, 0 });
+		}
+		return functions[iter->second];
+	};
+
+	for (size_t i = 0; i < Nodes.size(); ++i) {
+		const call_node         &node  = Nodes[i];
+		profiler_function_stats &stats = find_function(node.function);
+		stats.self_cycles += node.self_cycles;
+		stats.calls += node.calls;
+
+		// Recursive calls are already counted by the outermost call.
+		bool recursive = false;
+		for (uint32_t parent = node.parent; parent != No_node && !recursive; parent = Nodes[parent].parent) {
+			recursive = Nodes[parent].function == node.function;
+		}
+		if (!recursive) {
+			stats.inclusive_cycles += inclusive[i];
+		}
+	}
+
+	std::sort(functions.begin(), functions.end(), [](const profiler_function_stats &a, const profiler_function_stats &b) { return a.self_cycles > b.self_cycles; });
+	return functions;
+}
+
+std::vector<profiler_instruction_stats> profiler_get_hottest(size_t count)
+{
+	std::vector<profiler_instruction_stats> hottest;
+	for (uint32_t p = 0; p < Num_pc_pages; ++p) {
+		if (!Pc_cycles[p]) {
+			continue;
+		}
+		for (uint32_t i = 0; i < Pc_page_size; ++i) {
+			if (const uint64_t cycles = Pc_cycles[p][i]; cycles != 0) {
+				uint8_t        bank;
+				const uint16_t address = banked_address(p * Pc_page_size + i, bank);
+				hottest.push_back({ address, bank, cycles });
+			}
+		}
+	}
+
+	const auto by_cycles = [](const profiler_instruction_stats &a, const profiler_instruction_stats &b) { return a.cycles > b.cycles; };
+	if (hottest.size() > count) {
+		std::partial_sort(hottest.begin(), hottest.begin() + count, hottest.end(), by_cycles);
+		hottest.resize(count);
+	} else {
+		std::sort(hottest.begin(), hottest.end(), by_cycles);
+	}
+	return hottest;
+}
+
+std::string profiler_function_name(uint32_t function)
+{
+	if (function == Profiler_root) {
+		return "(root)";
+	}
+	return call_tracker_function_name(function);
+}
+
+static double percent(uint64_t cycles)
+{
+	return Total_cycles ? 100.0 * (double)cycles / (double)Total_cycles : 0.0;
+}
+
+std::vector<std::string> profiler_report(size_t count)
+{
+	std::vector<std::string> lines;
+	lines.push_back(fmt::format("{} cycles profiled, plus {} waiting in WAI.", Total_cycles, Wait_cycles));
+
+	auto functions = profiler_get_functions();
+	auto print     = [&](const char *title) {
+		lines.push_back("");
+		lines.push_back(title);
+		lines.push_back(fmt::format("{:>14} {:>6} {:>14} {:>6} {:>10}  {}", "Self", "%", "Inclusive", "%", "Calls", "Function"));
+		for (size_t i = 0; i < functions.size() && i < count; ++i) {
+			const auto &stats = functions[i];
+			lines.push_back(fmt::format("{:>14} {:>6.2f} {:>14} {:>6.2f} {:>10}  {}", stats.self_cycles, percent(stats.self_cycles), stats.inclusive_cycles, percent(stats.inclusive_cycles), stats.calls, profiler_function_name(stats.function)));
+		}
+	};
+
+	print("By self cycles:");
+	std::stable_sort(functions.begin(), functions.end(), [](const profiler_function_stats &a, const profiler_function_stats &b) { return a.inclusive_cycles > b.inclusive_cycles; });
+	print("By inclusive cycles:");
+
+	lines.push_back("");
+	lines.push_back("Hottest instructions:");
+	lines.push_back(fmt::format("{:>14} {:>6}  {:<8} {}", "Cycles", "%", "Address", "Symbol"));
+	for (const auto &stats : profiler_get_hottest(count)) {
+		const auto &symbols = symbols_find(stats.address, stats.bank);
+		lines.push_back(fmt::format("{:>14} {:>6.2f}  {:02X}:{:04X}  {}", stats.cycles, percent(stats.cycles), stats.bank, stats.address, symbols.empty() ? "" : symbols.front()));
+	}
+	return lines;
+}
+
+bool profiler_save_report(const std::filesystem::path &path)
+{
+	std::ofstream out(path);
+	if (!out) {
+		return false;
+	}
+	for (const auto &line : profiler_report(SIZE_MAX)) {
+		out << line << '\n';
+	}
+	return out.good();
+}
+
+bool profiler_save_collapsed(const std::filesystem::path &path)
+{
+	std::ofstream out(path);
+	if (!out) {
+		return false;
+	}
+
+	std::vector<std::string> names(Nodes.size());
+	for (size_t i = 0; i < Nodes.size(); ++i) {
+		names[i] = profiler_function_name(Nodes[i].function);
+	}
+
+	std::vector<uint32_t> path_nodes;
+	for (size_t i = 0; i < Nodes.size(); ++i) {
+		if (Nodes[i].self_cycles == 0) {
+			continue;
+		}
+		path_nodes.clear();
+		for (uint32_t n = static_cast<uint32_t>(i); n != No_node; n = Nodes[n].parent) {
+			path_nodes.push_back(n);
+		}
+
+		std::string line;
+		for (auto n = path_nodes.rbegin(); n != path_nodes.rend(); ++n) {
+			if (!line.empty()) {
+				line += ';';
+			}
+			line += names[*n];
+		}
+		out << line << ' ' << Nodes[i].self_cycles << '\n';
+	}
+	return out.good();
+}
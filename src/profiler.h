@@ -0,0 +1,73 @@
+#pragma once
+#if !defined(PROFILER_H)
+#	define PROFILER_H
+
+#	include <filesystem>
+#	include <stdint.h>
+#	include <string>
+#	include <vector>
+
+//
+// Cycle profiler
+//
+// While running, every executed instruction adds its exact cycle count, including page-crossing
+// penalties, to its bank:PC and to the function it ran in. Functions are tracked with a shadow call
+// stack: JSR, BRK, IRQ and NMI enter a function, and it is left once its return address has been
+// pulled off the stack, whether by RTS, RTI or anything else. The cycles are kept in a calling
+// context tree, so both flat totals and whole call stacks can be reported.
+//
+
+// Function id for code that ran outside any call made since profiling started.
+constexpr uint32_t Profiler_root = 0xffffffff;
+
+struct profiler_function_stats {
+	uint32_t function; // bank << 16 | address of the function's entry point, or Profiler_root
+	uint64_t self_cycles;
+	uint64_t inclusive_cycles;
+	uint64_t calls;
+};
+
+struct profiler_instruction_stats {
+	uint16_t address;
+	uint8_t  bank;
+	uint64_t cycles;
+};
+
+extern bool Profiler_enabled;
+
+void profiler_start();
+void profiler_stop();
+void profiler_clear();
+
+inline bool profiler_is_running()
+{
+	return Profiler_enabled;
+}
+
+// Called by the CPU core after each instruction, with the address it executed from.
+void profiler_instruction(uint16_t pc, uint8_t bank, uint8_t opcode, uint32_t cycles);
+// Called by the CPU core after entering an interrupt handler.
+void profiler_interrupt();
+// Called by the CPU core for cycles spent stopped in WAI.
+void profiler_wait(uint32_t cycles);
+
+uint64_t profiler_total_cycles();
+uint64_t profiler_wait_cycles();
+
+// Functions sorted by self cycles, most expensive first.
+std::vector<profiler_function_stats> profiler_get_functions();
+
+// The instructions that took the most cycles, most expensive first.
+std::vector<profiler_instruction_stats> profiler_get_hottest(size_t count);
+
+std::string profiler_function_name(uint32_t function);
+
+// A flat text report sorted by self and by inclusive cycles.
+std::vector<std::string> profiler_report(size_t count);
+
+bool profiler_save_report(const std::filesystem::path &path);
+
+// One line per call stack, in the "collapsed" format read by flamegraph.pl.
+bool profiler_save_collapsed(const std::filesystem::path &path);
+
+#endif
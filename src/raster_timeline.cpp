@@ -0,0 +1,142 @@
+#include "raster_timeline.h"
+
+#include <fstream>
+
+#include "call_tracker.h"
+#include "fmt/format.h"
+#include "glue.h"
+#include "memory.h"
+#include "ring_buffer.h"
+#include "vera/vera_video.h"
+
+bool Raster_timeline_enabled = false;
+
+static ring_buffer<raster_timeline_frame, Raster_timeline_frames> Frames;
+
+static raster_timeline_frame Current;
+static uint16_t              Current_line = 0;
+static uint32_t              Frame_number = 0;
+
+// Active interrupt handlers.
+static call_tracker<> Irqs;
+
+// The innermost call on the CPU's smart stack, or the PC if there isn't one.
+static uint32_t current_function()
+{
+	for (size_t i = stack6502.count(); i-- > 0;) {
+		const auto &ss = stack6502[i];
+		switch (ss.push.op_type) {
+			case _stack_op_type::nmi:
+			case _stack_op_type::irq:
+			case _stack_op_type::jsr:
+				return call_tracker_function_id(ss.push.jmp_data.dest_pc, ss.push.jmp_data.dest_bank);
+			default:
+				break;
+		}
+	}
+	return call_tracker_function_id(state6502.pc, memory_get_current_bank(state6502.pc));
+}
+
+static void begin_line(uint16_t line)
+{
+	Current_line = line;
+
+	raster_timeline_line &entry = Current.lines[line];
+	entry                       = {};
+	entry.function              = current_function();
+	entry.irq_handler           = Raster_timeline_none;
+}
+
+static void reset_capture()
+{
+	Current       = {};
+	Current.frame = Frame_number;
+	Irqs.clear();
+	begin_line(vera_video_get_scan_pos_y() % Raster_timeline_lines);
+}
+
+void raster_timeline_start()
+{
+	reset_capture();
+	Raster_timeline_enabled = true;
+}
+
+void raster_timeline_stop()
+{
+	Raster_timeline_enabled = false;
+}
+
+void raster_timeline_clear()
+{
+	Frames.clear();
+	Frame_number = 0;
+	reset_capture();
+}
+
+void raster_timeline_step(uint32_t clocks)
+{
+	const uint16_t line = vera_video_get_scan_pos_y() % Raster_timeline_lines;
+	if (line != Current_line) {
+		if (line < Current_line) {
+			Frames.add(Current);
+			Current.frame = ++Frame_number;
+		}
+		begin_line(line);
+	}
+
+	Irqs.update(state6502.sp);
+
+	raster_timeline_line &entry = Current.lines[line];
+	entry.cycles += clocks;
+	if (waiting) {
+		entry.wait_cycles += clocks;
+	}
+	if (!Irqs.empty()) {
+		entry.irq_cycles += clocks;
+	}
+}
+
+void raster_timeline_interrupt()
+{
+	raster_timeline_line &entry = Current.lines[Current_line];
+	if (entry.irq_handler == Raster_timeline_none) {
+		entry.irq_handler = call_tracker_function_id(state6502.pc, memory_get_current_bank(state6502.pc));
+	}
+	Irqs.enter(state6502.sp);
+}
+
+size_t raster_timeline_frame_count()
+{
+	return Frames.count();
+}
+
+const raster_timeline_frame &raster_timeline_get_frame(size_t index)
+{
+	return Frames.get_newest(index);
+}
+
+std::string raster_timeline_function_name(uint32_t function)
+{
+	if (function == Raster_timeline_none) {
+		return "";
+	}
+	return call_tracker_function_name(function);
+}
+
+bool raster_timeline_save_csv(const std::filesystem::path &path, size_t frames)
+{
+	std::ofstream out(path);
+	if (!out) {
+		return false;
+	}
+
+	out << "frame,line,cycles,wait_cycles,irq_cycles,function,irq_handler\n";
+	for (size_t f = std::min(frames, Frames.count()); f-- > 0;) {
+		const raster_timeline_frame &frame = raster_timeline_get_frame(f);
+		for (uint16_t y = 0; y < Raster_timeline_lines; ++y) {
+			const raster_timeline_line &line = frame.lines[y];
+			out << fmt::format("{},{},{},{},{},\"{}\",\"{}\"\n", frame.frame, y, line.cycles, line.wait_cycles, line.irq_cycles, raster_timeline_function_name(line.function), raster_timeline_function_name(line.irq_handler));
+		}
+	}
+	return out.good();
+}
@@ -0,0 +1,58 @@
+#pragma once
+#if !defined(RASTER_TIMELINE_H)
+#	define RASTER_TIMELINE_H
+
+#	include <filesystem>
+#	include <stdint.h>
+#	include <string>
+
+//
+// Raster timeline
+//
+// The software version of changing the border colour around a routine: while enabled, every CPU
+// cycle is charged to the scanline VERA was drawing when it ran, split into cycles spent running,
+// waiting in WAI, and inside interrupt handlers. Each line also remembers the function that was
+// running when it began and the first interrupt handler entered on it.
+//
+
+constexpr uint16_t Raster_timeline_lines  = 525;
+constexpr size_t   Raster_timeline_frames = 60;
+
+constexpr uint32_t Raster_timeline_none = 0xffffffff;
+
+struct raster_timeline_line {
+	uint16_t cycles;      // including wait_cycles and irq_cycles
+	uint16_t wait_cycles; // stopped in WAI
+	uint16_t irq_cycles;  // inside an interrupt handler
+	uint32_t function;    // bank << 16 | address of the innermost call active at the start of the line
+	uint32_t irq_handler; // bank << 16 | address of the first handler entered on this line, or Raster_timeline_none
+};
+
+struct raster_timeline_frame {
+	uint32_t             frame;
+	raster_timeline_line lines[Raster_timeline_lines];
+};
+
+extern bool Raster_timeline_enabled;
+
+void raster_timeline_start();
+void raster_timeline_stop();
+void raster_timeline_clear();
+
+// Called by the main loop after the CPU and VERA have stepped.
+void raster_timeline_step(uint32_t clocks);
+
+// Called by the CPU core after entering an interrupt handler.
+void raster_timeline_interrupt();
+
+// Completed frames, 0 being the most recent.
+size_t                       raster_timeline_frame_count();
+const raster_timeline_frame &raster_timeline_get_frame(size_t index);
+
+// A symbol for a function or irq_handler id, or its address if it has none.
+std::string raster_timeline_function_name(uint32_t function);
+
+// Write the most recent 'frames' frames to a CSV file, one row per scanline, oldest first.
+bool raster_timeline_save_csv(const std::filesystem::path &path, size_t frames);
+
+#endif
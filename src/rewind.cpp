@@ -0,0 +1,341 @@
+#include "rewind.h"
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "cpu/fake6502.h"
+#include "cpu_history.h"
+#include "debugger.h"
+#include "glue.h"
+#include "hypercalls.h"
+#include "i2c.h"
+#include "irq_stats.h"
+#include "joystick.h"
+#include "keyboard.h"
+#include "memory.h"
+#include "options.h"
+#include "profiler.h"
+#include "raster_timeline.h"
+#include "rtc.h"
+#include "serial.h"
+#include "snapshot.h"
+#include "vera/sdcard.h"
+#include "vera/vera_pcm.h"
+#include "vera/vera_psg.h"
+#include "vera/vera_spi.h"
+#include "vera/vera_video.h"
+#include "via.h"
+#include "ym2151/ym2151.h"
+
+bool Rewind_replaying = false;
+
+// A snapshot every 6 frames (100ms) bounds how much a reverse step has to re-execute, while a
+// 10 second window still only needs 100 of them.
+static constexpr int Frames_per_snapshot = 6;
+
+static bool     Rewind_enabled        = false;
+static uint64_t Window_clocks         = 0;
+static int      Frames_since_snapshot = 0;
+
+static std::deque<std::unique_ptr<machine_snapshot>> Snapshots;
+
+// Keyboard and joystick state after each host event update that changed it, keyed by the clock
+// the update happened at.
+static std::deque<machine_snapshot> Input_journal;
+static machine_snapshot             Input_before;
+static bool                         Input_pending = false;
+
+// The machine as it was when the debugger paused, and whether the pause interrupted an
+// instruction whose side effects will be seen again when it is re-executed.
+static machine_snapshot Pause_state;
+static bool             Pause_aborted = false;
+
+static void input_io(machine_snapshot &snapshot)
+{
+	keyboard_snapshot(snapshot);
+	joystick_snapshot(snapshot);
+}
+
+static void machine_io(machine_snapshot &snapshot)
+{
+	snapshot6502(snapshot);
+	memory_snapshot(snapshot);
+	vera_video_snapshot(snapshot);
+	psg_snapshot(snapshot);
+	pcm_snapshot(snapshot);
+	YM_snapshot(snapshot);
+	vera_spi_snapshot(snapshot);
+	sdcard_snapshot(snapshot);
+	via_snapshot(snapshot);
+	i2c_snapshot(snapshot);
+	rtc_snapshot(snapshot);
+	input_io(snapshot);
+}
+
+static void save_machine(machine_snapshot &snapshot)
+{
+	snapshot.begin_save(Snapshots.empty() ? nullptr : Snapshots.back().get());
+	snapshot.clock        = clockticks6502;
+	snapshot.instructions = instructions;
+	machine_io(snapshot);
+}
+
+static void load_machine(machine_snapshot &snapshot)
+{
+	snapshot.begin_load();
+	machine_io(snapshot);
+}
+
+static void push_snapshot(std::unique_ptr<machine_snapshot> snapshot)
+{
+	Snapshots.push_back(std::move(snapshot));
+
+	// Keep the newest snapshot that is at least a window old, so the whole window stays reachable.
+	const uint64_t newest = Snapshots.back()->clock;
+	while (Snapshots.size() > 1 && newest - Snapshots[1]->clock >= Window_clocks) {
+		Snapshots.pop_front();
+	}
+	while (!Input_journal.empty() && Input_journal.front().clock <= Snapshots.front()->clock) {
+		Input_journal.pop_front();
+	}
+}
+
+// Forget everything that happened after 'clock'.
+static void truncate_after(uint64_t clock)
+{
+	while (!Snapshots.empty() && Snapshots.back()->clock > clock) {
+		Snapshots.pop_back();
+	}
+	while (!Input_journal.empty() && Input_journal.back().clock > clock) {
+		Input_journal.pop_back();
+	}
+}
+
+void rewind_init(int seconds)
+{
+	Rewind_enabled = seconds > 0;
+	Window_clocks  = (uint64_t)seconds * MHZ * 1000000;
+	rewind_clear();
+}
+
+void rewind_shutdown()
+{
+	rewind_clear();
+	Rewind_enabled = false;
+}
+
+bool rewind_is_enabled()
+{
+	return Rewind_enabled;
+}
+
+void rewind_clear()
+{
+	Snapshots.clear();
+	Input_journal.clear();
+	Frames_since_snapshot = 0;
+	Input_pending         = false;
+	Pause_aborted         = false;
+}
+
+void rewind_frame()
+{
+	if (!Rewind_enabled || ++Frames_since_snapshot < Frames_per_snapshot) {
+		return;
+	}
+	Frames_since_snapshot = 0;
+
+	auto snapshot = std::make_unique<machine_snapshot>();
+	save_machine(*snapshot);
+	push_snapshot(std::move(snapshot));
+}
+
+void rewind_input_begin()
+{
+	if (!Rewind_enabled) {
+		return;
+	}
+	Input_before.begin_save();
+	input_io(Input_before);
+	Input_pending = true;
+}
+
+void rewind_input_end()
+{
+	if (!Input_pending) {
+		return;
+	}
+	Input_pending = false;
+
+	machine_snapshot input;
+	input.begin_save();
+	input_io(input);
+	if (!input.same_as(Input_before)) {
+		input.clock = clockticks6502;
+		Input_journal.push_back(std::move(input));
+	}
+}
+
+void rewind_pause()
+{
+	if (!Rewind_enabled) {
+		return;
+	}
+	save_machine(Pause_state);
+	Pause_aborted = debug6502 != 0;
+}
+
+void rewind_resume()
+{
+	if (!Rewind_enabled) {
+		return;
+	}
+	auto snapshot = std::make_unique<machine_snapshot>();
+	save_machine(*snapshot);
+	if (Pause_aborted || !snapshot->same_as(Pause_state)) {
+		// Re-executing up to here wouldn't reproduce the machine as it is now, so start from it.
+		while (!Snapshots.empty() && Snapshots.back()->clock >= clockticks6502) {
+			Snapshots.pop_back();
+		}
+		push_snapshot(std::move(snapshot));
+		Frames_since_snapshot = 0;
+	}
+	Pause_aborted = false;
+}
+
+// One iteration of emulator_loop() in main.cpp, with everything that only talks to the host or
+// the debugger left out. The input journal takes the place of sdl_events_update().
+static void replay_step(size_t &journal_index)
+{
+	const uint64_t old_clockticks6502 = clockticks6502;
+	step6502();
+	if (debug6502) {
+		force6502();
+	}
+	const uint8_t clocks    = (uint8_t)(clockticks6502 - old_clockticks6502);
+	const bool    new_frame = vera_video_step(MHZ, clocks);
+	via1_step(clocks);
+	via2_step(clocks);
+	rtc_step(clocks);
+	if (Options.enable_serial) {
+		serial_step(clocks);
+	}
+
+	if (new_frame) {
+		for (; journal_index < Input_journal.size() && Input_journal[journal_index].clock <= clockticks6502; ++journal_index) {
+			if (Input_journal[journal_index].clock == clockticks6502) {
+				Input_journal[journal_index].begin_load();
+				input_io(Input_journal[journal_index]);
+			}
+		}
+	}
+
+	if (vera_video_get_irq_out() || YM_irq() || via1_irq() || via2_irq()) {
+		irq6502();
+	}
+
+	hypercalls_process();
+	keyboard_process();
+}
+
+// Re-execute from the current position until clockticks6502 reaches 'end', calling visit() at the
+// top of each iteration.
+static void replay(uint64_t end, const std::function<void()> &visit)
+{
+	size_t journal_index = std::upper_bound(Input_journal.begin(), Input_journal.end(), clockticks6502, [](uint64_t clock, const machine_snapshot &input) { return clock < input.clock; }) - Input_journal.begin();
+	while (clockticks6502 < end) {
+		if (visit) {
+			visit();
+		}
+		replay_step(journal_index);
+	}
+}
+
+// Move to the count'th most recent position before this one at which match() holds, searching
+// one window between snapshots at a time, newest first.
+static bool seek_back(uint32_t count, const std::function<bool()> &match)
+{
+	if (!Rewind_enabled || Snapshots.empty() || count == 0) {
+		return false;
+	}
+
+	const uint64_t   present_clock = clockticks6502;
+	machine_snapshot present;
+	save_machine(present);
+
+	const bool was_recording = Cpu_history_recording;
+	const bool was_profiling = Profiler_enabled;
+	const bool was_timing    = Raster_timeline_enabled;
+	const bool was_counting  = Irq_stats_enabled;
+	Cpu_history_recording    = false;
+	Profiler_enabled         = false;
+	Raster_timeline_enabled  = false;
+	Irq_stats_enabled        = false;
+	Rewind_replaying         = true;
+
+	bool                  found  = false;
+	uint64_t              target = 0;
+	std::vector<uint64_t> matches;
+	for (size_t i = Snapshots.size(); i-- > 0;) {
+		machine_snapshot &start = *Snapshots[i];
+		if (start.clock >= present_clock) {
+			continue;
+		}
+		const uint64_t end = (i + 1 < Snapshots.size()) ? std::min(Snapshots[i + 1]->clock, present_clock) : present_clock;
+
+		matches.clear();
+		load_machine(start);
+		replay(end, [&]() {
+			if (match()) {
+				matches.push_back(clockticks6502);
+			}
+		});
+
+		if (matches.size() >= count) {
+			target = matches[matches.size() - count];
+			found  = true;
+			load_machine(start);
+			replay(target, nullptr);
+			break;
+		}
+		count -= (uint32_t)matches.size();
+	}
+
+	Rewind_replaying        = false;
+	Cpu_history_recording   = was_recording;
+	Profiler_enabled        = was_profiling;
+	Raster_timeline_enabled = was_timing;
+	Irq_stats_enabled       = was_counting;
+
+	if (!found) {
+		load_machine(present);
+		return false;
+	}
+
+	truncate_after(target);
+	Frames_since_snapshot = 0;
+	save_machine(Pause_state);
+	Pause_aborted = false;
+	debugger_rewind_execution();
+	return true;
+}
+
+bool rewind_step_back(uint32_t count)
+{
+	return seek_back(count, []() { return !waiting; });
+}
+
+bool rewind_step_back_over()
+{
+	// Skip over subroutines and interrupt handlers, which run deeper in the stack than we are now.
+	const uint8_t sp = state6502.sp;
+	return seek_back(1, [sp]() { return !waiting && state6502.sp >= sp; });
+}
+
+bool rewind_continue_back()
+{
+	return seek_back(1, []() { return !waiting && debugger_exec_breakpoint_hit(); });
+}
@@ -0,0 +1,49 @@
+#pragma once
+#if !defined(REWIND_H)
+#	define REWIND_H
+
+#	include <stdint.h>
+
+//
+// Reverse execution
+//
+// While the machine runs, a machine_snapshot is taken every few frames and kept for the last
+// -rewind seconds of emulated time. Changes the host makes to keyboard and joystick state are
+// journaled against clockticks6502, so any point after a snapshot can be reached again by loading
+// it and re-executing forward, with the journal replayed at the same clocks.
+//
+// The reverse debugger commands use this to search backwards: each window between two snapshots
+// is replayed to find the positions it contains, starting from the most recent one, and the
+// machine is then replayed to the chosen position. Anything after it is forgotten, so running
+// again from there starts a new timeline.
+//
+
+// True while re-executing, so the debugger doesn't report accesses it already reported once.
+extern bool Rewind_replaying;
+
+void rewind_init(int seconds);
+void rewind_shutdown();
+bool rewind_is_enabled();
+
+// Forget all snapshots, e.g. because the machine was reset.
+void rewind_clear();
+
+// Called by the main loop at the end of an iteration that finished a frame.
+void rewind_frame();
+
+// Called by the main loop around processing host events, to journal the input they produce.
+void rewind_input_begin();
+void rewind_input_end();
+
+// Called by the main loop when the debugger pauses and resumes, so that changes made while
+// paused are kept in the timeline.
+void rewind_pause();
+void rewind_resume();
+
+// Move the paused machine backwards. Each returns false, leaving the machine untouched, if the
+// target is further back than the snapshots reach.
+bool rewind_step_back(uint32_t count = 1);
+bool rewind_step_back_over();
+bool rewind_continue_back();
+
+#endif
@@ -73,6 +73,12 @@ public:
 		return get(m_count - !!m_count);
 	}
 
+	// 0 being the newest, up to count() - 1 for the oldest.
+	const T &get_newest(size_t age) const
+	{
+		return get(m_count - 1 - age);
+	}
+
 	T &pop_newest()
 	{
 		m_count -= !!m_count;
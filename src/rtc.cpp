@@ -10,6 +10,7 @@
 
 #include "rtc.h"
 #include "glue.h"
+#include "snapshot.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <time.h>
@@ -223,3 +224,22 @@ void rtc_write(uint8_t a, uint8_t v)
 			}
 	}
 }
+
+void rtc_snapshot(machine_snapshot &snapshot)
+{
+	snapshot.io(nvram);
+	if (!snapshot.saving()) {
+		nvram_dirty = true;
+	}
+	snapshot.io(running);
+	snapshot.io(vbaten);
+	snapshot.io(h24);
+	snapshot.io(clocks);
+	snapshot.io(seconds);
+	snapshot.io(minutes);
+	snapshot.io(hours);
+	snapshot.io(day_of_week);
+	snapshot.io(day);
+	snapshot.io(month);
+	snapshot.io(year);
+}
@@ -16,4 +16,7 @@ void    rtc_step(int c);
 uint8_t rtc_read(uint8_t offset);
 void    rtc_write(uint8_t offset, uint8_t value);
 
+class machine_snapshot;
+void rtc_snapshot(machine_snapshot &snapshot);
+
 #endif
@@ -0,0 +1,84 @@
+#include "snapshot.h"
+
+#include <algorithm>
+#include <string.h>
+
+void machine_snapshot::begin_save(const machine_snapshot *previous)
+{
+	m_saving       = true;
+	m_previous     = previous;
+	m_offset       = 0;
+	m_page_index   = 0;
+	m_unique_bytes = 0;
+	m_data.clear();
+	m_pages.clear();
+}
+
+void machine_snapshot::begin_load()
+{
+	m_saving     = false;
+	m_previous   = nullptr;
+	m_offset     = 0;
+	m_page_index = 0;
+}
+
+void machine_snapshot::io(void *data, size_t size)
+{
+	if (m_saving) {
+		const uint8_t *bytes = static_cast<const uint8_t *>(data);
+		m_data.insert(m_data.end(), bytes, bytes + size);
+		m_unique_bytes += size;
+	} else {
+		const size_t available = std::min(size, m_data.size() - std::min(m_offset, m_data.size()));
+		memcpy(data, m_data.data() + m_offset, available);
+		memset(static_cast<uint8_t *>(data) + available, 0, size - available);
+		m_offset += size;
+	}
+}
+
+void machine_snapshot::io(std::string &str)
+{
+	uint32_t length = static_cast<uint32_t>(str.length());
+	io(length);
+	if (m_saving) {
+		io(str.data(), length);
+	} else {
+		str.resize(length);
+		io(str.data(), length);
+	}
+}
+
+void machine_snapshot::io_pages(uint8_t *data, size_t size)
+{
+	for (size_t offset = 0; offset < size; offset += Page_size, ++m_page_index) {
+		const size_t length = std::min(Page_size, size - offset);
+		if (m_saving) {
+			if (m_previous != nullptr && m_page_index < m_previous->m_pages.size()) {
+				const page &old = m_previous->m_pages[m_page_index];
+				if (memcmp(old->data(), data + offset, length) == 0) {
+					m_pages.push_back(old);
+					continue;
+				}
+			}
+			auto fresh = std::make_shared<std::array<uint8_t, Page_size>>();
+			memcpy(fresh->data(), data + offset, length);
+			m_pages.push_back(std::move(fresh));
+			m_unique_bytes += Page_size;
+		} else if (m_page_index < m_pages.size()) {
+			memcpy(data + offset, m_pages[m_page_index]->data(), length);
+		}
+	}
+}
+
+bool machine_snapshot::same_as(const machine_snapshot &other) const
+{
+	if (m_data != other.m_data || m_pages.size() != other.m_pages.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < m_pages.size(); ++i) {
+		if (m_pages[i] != other.m_pages[i] && *m_pages[i] != *other.m_pages[i]) {
+			return false;
+		}
+	}
+	return true;
+}
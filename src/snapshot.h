@@ -0,0 +1,72 @@
+#pragma once
+#if !defined(SNAPSHOT_H)
+#	define SNAPSHOT_H
+
+#	include <array>
+#	include <memory>
+#	include <string>
+#	include <type_traits>
+#	include <vector>
+
+//
+// Machine snapshots
+//
+// Every module with emulated state has a <module>_snapshot(machine_snapshot &) function which
+// passes each of its fields through io(). The same function both saves and restores, depending on
+// which way the snapshot is being run, so the two directions can't drift apart.
+//
+// Large memories go through io_pages() instead, which splits them into 4KB pages and shares the
+// pages that haven't changed with the previous snapshot, so a run of snapshots only costs the
+// memory that was actually written in between.
+//
+
+class machine_snapshot
+{
+public:
+	static constexpr size_t Page_size = 4096;
+
+	using page = std::shared_ptr<const std::array<uint8_t, Page_size>>;
+
+	// Start saving. Pages equal to those at the same position in 'previous' are shared with it.
+	void begin_save(const machine_snapshot *previous = nullptr);
+	void begin_load();
+
+	bool saving() const
+	{
+		return m_saving;
+	}
+
+	void io(void *data, size_t size);
+	void io(std::string &str);
+
+	template <typename T>
+	void io(T &value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "machine_snapshot::io needs a trivially copyable type");
+		io(&value, sizeof(T));
+	}
+
+	void io_pages(uint8_t *data, size_t size);
+
+	bool same_as(const machine_snapshot &other) const;
+
+	// Bytes held by this snapshot alone, not counting pages shared with the previous one.
+	size_t unique_bytes() const
+	{
+		return m_unique_bytes;
+	}
+
+	uint64_t clock        = 0;
+	uint32_t instructions = 0;
+
+private:
+	bool                    m_saving = false;
+	std::vector<uint8_t>    m_data;
+	size_t                  m_offset = 0;
+	std::vector<page>       m_pages;
+	size_t                  m_page_index   = 0;
+	size_t                  m_unique_bytes = 0;
+	const machine_snapshot *m_previous     = nullptr;
+};
+
+#endif
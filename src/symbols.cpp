@@ -1,29 +1,54 @@
 #include "symbols.h"
 
+#include <algorithm>
+#include <charconv>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
-#include <iostream>
-#include <map>
-#include <sstream>
+#include <string.h>
+#include <string_view>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "debugger.h"
+#include "fmt/format.h"
+#include "options.h"
 
-using loaded_symbol_type       = std::tuple<symbol_address_type, std::string>;
-using loaded_symbol_files_type = std::unordered_map<std::string, std::list<loaded_symbol_type>>;
-using symbol_table_type        = std::map<symbol_address_type, symbol_list_type>;
-using symbol_nametable_type    = std::map<std::string, std::list<symbol_address_type>>;
+struct symbol_entry {
+	symbol_address_type address;
+	const std::string  *name;
+};
+
+struct loaded_symbol_file {
+	symbol_bank_type          bank;
+	std::vector<symbol_entry> symbols;
+};
+
+// Every name is stored once, and everything else refers to it by pointer. Nodes of an
+// unordered_set never move, so the pointers stay valid as names are added.
+static std::unordered_set<std::string> Names;
+
+static std::unordered_map<std::string, loaded_symbol_file> Loaded_symbols_by_file;
+static std::vector<symbol_entry>                           Added_symbols;
+
+std::set<std::string> Loaded_symbol_files;
+std::set<std::string> Visible_symbol_files;
 
-symbol_table_type        Symbols_table;
-symbol_nametable_type    Symbols_nametable;
-loaded_symbol_files_type Loaded_symbols_by_file;
-std::set<std::string>    Loaded_symbol_files;
-std::set<std::string>    Visible_symbol_files;
+// Visible files in the order they were shown, which decides the order of names at an address.
+static std::vector<std::string> Visible_order;
 
-const symbol_list_type Empty_symbols_list;
-const symbol_namelist_type Empty_symbols_namelist;
+// The visible symbols as flat arrays, rebuilt on the next lookup after anything changes. The
+// address table is sorted by address, and the name index by name pointer.
+static std::vector<symbol_address_type> Table_addresses;
+static std::vector<const std::string *> Table_names;
+static std::vector<const std::string *> Name_index_names;
+static std::vector<symbol_address_type> Name_index_addresses;
+static bool                             Tables_dirty = false;
 
-std::set<std::string> Ignore_list = {
+static uint32_t Symbols_generation = 0;
+
+static const std::set<std::string, std::less<>> Ignore_list = {
 	//".__BSS_LOAD__",
 	//".__BSS_RUN__",
 	".__BSS_SIZE__",
@@ -48,136 +73,404 @@ std::set<std::string> Ignore_list = {
 	".__ZP_START__"
 };
 
-static void show_file_entries(const std::string &file_path)
+static const std::string *intern(std::string_view name)
 {
-	auto entry = Loaded_symbols_by_file.find(file_path);
-	if (entry != Loaded_symbols_by_file.end()) {
-		auto &symbols = entry->second;
-		for (auto &sym : symbols) {
-			auto &[addr, name] = sym;
-
-			const auto &table_entry = Symbols_table.find(addr);
-			if (table_entry != Symbols_table.end()) {
-				table_entry->second.push_back(name);
-			} else {
-				Symbols_table.insert({ addr, std::list<std::string>{ name } });
-			}
+	return &*Names.emplace(name).first;
+}
 
-			const auto &nametable_entry = Symbols_nametable.find(name);
-			if (nametable_entry != Symbols_nametable.end()) {
-				nametable_entry->second.push_back(addr);
-			} else {
-				Symbols_nametable.insert({ name, std::list<symbol_address_type>{ addr } });
-			}
-		}
+static symbol_address_type make_address(uint32_t addr, symbol_bank_type bank)
+{
+	return ((addr < 0xa000 ? 0 : bank) << 16) + addr;
+}
+
+static void rebuild_tables()
+{
+	std::vector<symbol_entry> visible;
+	for (const auto &file_path : Visible_order) {
+		const auto &file = Loaded_symbols_by_file[file_path];
+		visible.insert(visible.end(), file.symbols.begin(), file.symbols.end());
+	}
+	visible.insert(visible.end(), Added_symbols.begin(), Added_symbols.end());
+
+	std::stable_sort(visible.begin(), visible.end(), [](const symbol_entry &a, const symbol_entry &b) { return a.address < b.address; });
+	Table_addresses.resize(visible.size());
+	Table_names.resize(visible.size());
+	for (size_t i = 0; i < visible.size(); ++i) {
+		Table_addresses[i] = visible[i].address;
+		Table_names[i]     = visible[i].name;
 	}
 
+	std::stable_sort(visible.begin(), visible.end(), [](const symbol_entry &a, const symbol_entry &b) { return std::less<>()(a.name, b.name); });
+	Name_index_names.resize(visible.size());
+	Name_index_addresses.resize(visible.size());
+	for (size_t i = 0; i < visible.size(); ++i) {
+		Name_index_names[i]     = visible[i].name;
+		Name_index_addresses[i] = visible[i].address;
+	}
+
+	Tables_dirty = false;
+}
+
+static void tables_changed()
+{
+	Tables_dirty = true;
+	++Symbols_generation;
+}
+
+static void show_file_entries(const std::string &file_path)
+{
 	Visible_symbol_files.insert(file_path);
+	Visible_order.push_back(file_path);
+	tables_changed();
 }
 
 static void hide_file_entries(const std::string &file_path)
 {
-	auto entry = Loaded_symbols_by_file.find(file_path);
-	if (entry != Loaded_symbols_by_file.end()) {
-		auto &symbols = entry->second;
-		for (auto &sym : symbols) {
-			auto &[addr, name] = sym;
+	Visible_symbol_files.erase(file_path);
+	Visible_order.erase(std::remove(Visible_order.begin(), Visible_order.end(), file_path), Visible_order.end());
+	tables_changed();
+}
 
-			auto &sym_list = Symbols_table[addr];
-			sym_list.remove(name);
-			if (sym_list.empty()) {
-				Symbols_table.erase(addr);
+static bool parse_hex(std::string_view text, uint32_t &value)
+{
+	if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+		text.remove_prefix(2);
+	}
+	const auto result = std::from_chars(text.data(), text.data() + text.size(), value, 16);
+	return result.ec == std::errc() && result.ptr != text.data();
+}
+
+static std::string_view next_token(std::string_view &line)
+{
+	size_t start = 0;
+	while (start < line.size() && isspace((unsigned char)line[start])) {
+		++start;
+	}
+	size_t end = start;
+	while (end < line.size() && !isspace((unsigned char)line[end])) {
+		++end;
+	}
+	const std::string_view token = line.substr(start, end - start);
+	line.remove_prefix(end);
+	return token;
+}
+
+// Parse the VICE-style label commands in 'text'. Breakpoints are returned rather than set, so
+// they can be cached along with the symbols.
+static void parse_symbols(std::string_view text, symbol_bank_type bank, std::vector<symbol_entry> &symbols, std::vector<uint32_t> &breakpoints)
+{
+	while (!text.empty()) {
+		const size_t     eol  = text.find('\n');
+		std::string_view line = text.substr(0, eol);
+		text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+
+		size_t start = 0;
+		while (start < line.size() && !isprint((unsigned char)line[start])) {
+			++start;
+		}
+		line = line.substr(start, line.find(';', start) - start);
+
+		const std::string_view cmd = next_token(line);
+		if (cmd == "al" || cmd == "add_label") {
+			std::string_view addr_str = next_token(line);
+			if (addr_str.size() >= 2 && addr_str[0] == 'C' && addr_str[1] == ':') {
+				addr_str.remove_prefix(2);
 			}
+			const std::string_view label = next_token(line);
 
-			auto &name_list = Symbols_nametable[name];
-			name_list.remove(addr);
-			if (name_list.empty()) {
-				Symbols_nametable.erase(name);
+			uint32_t addr;
+			if (!parse_hex(addr_str, addr) || addr > 0xffff) {
+				continue;
+			}
+			if (label.empty()) {
+				continue;
+			}
+			if (Ignore_list.find(label) != Ignore_list.end()) {
+				continue;
+			}
+
+			symbols.push_back({ make_address(addr, bank), intern(label) });
+		} else if (cmd == "break") {
+			std::string_view addr_str = next_token(line);
+			if (!addr_str.empty() && addr_str[0] == '$') {
+				addr_str.remove_prefix(1);
+			}
+
+			uint32_t addr;
+			if (parse_hex(addr_str, addr)) {
+				breakpoints.push_back(addr);
 			}
 		}
 	}
 
-	Visible_symbol_files.erase(file_path);
+	// Drop repeated labels, keeping the file's order of names at each address.
+	std::stable_sort(symbols.begin(), symbols.end(), [](const symbol_entry &a, const symbol_entry &b) { return a.address < b.address; });
+	auto out = symbols.begin();
+	for (auto run = symbols.begin(); run != symbols.end();) {
+		auto run_end = std::find_if(run, symbols.end(), [&](const symbol_entry &entry) { return entry.address != run->address; });
+		auto run_out = out;
+		for (auto in = run; in != run_end; ++in) {
+			if (std::none_of(run_out, out, [&](const symbol_entry &entry) { return entry.name == in->name; })) {
+				*out++ = *in;
+			}
+		}
+		run = run_end;
+	}
+	symbols.erase(out, symbols.end());
 }
 
-bool symbols_load_file(const std::string &file_path, symbol_bank_type bank)
+//
+// Symbol cache
+//
+
+static constexpr char     Cache_magic[4] = { 'B', 'X', 'S', 'Y' };
+static constexpr uint32_t Cache_version  = 1;
+
+// The first time a cache is written, files whose source is gone or that haven't been used for
+// Cache_max_age are removed, and so are any beyond the Cache_max_files most recently used.
+// load_cache() touches a file each time it is used.
+static constexpr size_t Cache_max_files = 256;
+static constexpr auto   Cache_max_age   = std::chrono::hours(24 * 30);
+
+struct cache_key {
+	uint64_t         size;
+	int64_t          mtime;
+	symbol_bank_type bank;
+};
+
+static bool get_cache_key(const std::filesystem::path &path, symbol_bank_type bank, cache_key &key)
+{
+	std::error_code ec;
+	key.size = std::filesystem::file_size(path, ec);
+	if (ec) {
+		return false;
+	}
+	key.mtime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+	if (ec) {
+		return false;
+	}
+	key.bank = bank;
+	return true;
+}
+
+static std::filesystem::path get_cache_path(const std::string &absolute_path)
+{
+	// The version is part of the name as well as the header, so that caches written by other
+	// versions never share a file with this one.
+	return options_get_prefs_path() / "symbols" / fmt::format("{:016x}-{}.cache", std::hash<std::string>()(absolute_path), Cache_version);
+}
+
+template <typename T>
+static void cache_write(std::string &out, const T &value)
+{
+	out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool cache_read(std::string_view &in, T &value)
+{
+	if (in.size() < sizeof(T)) {
+		return false;
+	}
+	memcpy(&value, in.data(), sizeof(T));
+	in.remove_prefix(sizeof(T));
+	return true;
+}
+
+static bool read_file(const std::filesystem::path &path, std::string &contents)
 {
-	std::ifstream infile(file_path, std::ios_base::in);
+	std::ifstream infile(path, std::ios_base::in | std::ios_base::binary);
 	if (!infile.is_open()) {
 		return false;
 	}
+	infile.seekg(0, std::ios_base::end);
+	contents.resize(static_cast<size_t>(infile.tellg()));
+	infile.seekg(0, std::ios_base::beg);
+	infile.read(contents.data(), contents.size());
+	return infile.good() || infile.eof();
+}
 
-	std::string cmd;
+// Read just enough of a cache file's header to find the path of the symbol file it holds.
+static bool read_cache_source(const std::filesystem::path &path, std::string &source)
+{
+	std::ifstream infile(path, std::ios_base::in | std::ios_base::binary);
+	if (!infile.is_open()) {
+		return false;
+	}
 
-	std::list<loaded_symbol_type> file_symbols;
+	char header[sizeof(Cache_magic) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(int64_t) + sizeof(symbol_bank_type) + sizeof(uint32_t)];
+	if (!infile.read(header, sizeof(header)) || memcmp(header, Cache_magic, sizeof(Cache_magic)) != 0) {
+		return false;
+	}
 
-	std::string line;
-	while (std::getline(infile, line)) {
-		uint32_t start = 0;
-		while (!isprint(line[start]) && (start < line.size())) {
-			++start;
+	std::string_view in(header + sizeof(Cache_magic), sizeof(header) - sizeof(Cache_magic));
+	uint32_t         version;
+	cache_key        cached;
+	uint32_t         path_length;
+	if (!cache_read(in, version) || version != Cache_version || !cache_read(in, cached.size) || !cache_read(in, cached.mtime) || !cache_read(in, cached.bank) || !cache_read(in, path_length)) {
+		return false;
+	}
+	source.resize(path_length);
+	return static_cast<bool>(infile.read(source.data(), path_length));
+}
+
+static void prune_cache(const std::filesystem::path &cache_dir)
+{
+	const auto now = std::filesystem::file_time_type::clock::now();
+
+	std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> kept;
+	std::error_code                                                                ec;
+	for (auto const &entry : std::filesystem::directory_iterator{ cache_dir, ec }) {
+		if (entry.path().extension() != ".cache") {
+			continue;
 		}
+		std::error_code entry_ec;
+		const auto      mtime = entry.last_write_time(entry_ec);
+		std::string     source;
+		if (entry_ec || now - mtime > Cache_max_age || !read_cache_source(entry.path(), source) || !std::filesystem::exists(source, entry_ec)) {
+			std::filesystem::remove(entry.path(), entry_ec);
+			continue;
+		}
+		kept.push_back({ mtime, entry.path() });
+	}
 
-		uint32_t end = start;
-		while ((line[end] != ';') && (end < line.size())) {
-			++end;
+	if (kept.size() > Cache_max_files) {
+		std::sort(kept.begin(), kept.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+		for (size_t i = Cache_max_files; i < kept.size(); ++i) {
+			std::filesystem::remove(kept[i].second, ec);
 		}
+	}
+}
 
-		if (start == end) {
-			continue;
+static bool load_cache(const std::string &absolute_path, const cache_key &key, std::vector<symbol_entry> &symbols, std::vector<uint32_t> &breakpoints)
+{
+	const std::filesystem::path cache_path = get_cache_path(absolute_path);
+
+	std::string contents;
+	if (!read_file(cache_path, contents)) {
+		return false;
+	}
+
+	std::string_view in = contents;
+	if (in.size() < sizeof(Cache_magic) || memcmp(in.data(), Cache_magic, sizeof(Cache_magic)) != 0) {
+		return false;
+	}
+	in.remove_prefix(sizeof(Cache_magic));
+
+	uint32_t  version;
+	cache_key cached;
+	uint32_t  path_length;
+	if (!cache_read(in, version) || version != Cache_version || !cache_read(in, cached.size) || !cache_read(in, cached.mtime) || !cache_read(in, cached.bank) || !cache_read(in, path_length)) {
+		return false;
+	}
+	if (cached.size != key.size || cached.mtime != key.mtime || cached.bank != key.bank || in.substr(0, path_length) != absolute_path) {
+		return false;
+	}
+	in.remove_prefix(path_length);
+
+	uint32_t num_symbols;
+	if (!cache_read(in, num_symbols)) {
+		return false;
+	}
+	symbols.reserve(num_symbols);
+	for (uint32_t i = 0; i < num_symbols; ++i) {
+		symbol_address_type address;
+		uint16_t            name_length;
+		if (!cache_read(in, address) || !cache_read(in, name_length) || in.size() < name_length) {
+			return false;
 		}
+		symbols.push_back({ address, intern(in.substr(0, name_length)) });
+		in.remove_prefix(name_length);
+	}
 
-		std::istringstream sline(line.substr(start, end - start));
-		sline >> cmd;
+	uint32_t num_breakpoints;
+	if (!cache_read(in, num_breakpoints)) {
+		return false;
+	}
+	for (uint32_t i = 0; i < num_breakpoints; ++i) {
+		uint32_t address;
+		if (!cache_read(in, address)) {
+			return false;
+		}
+		breakpoints.push_back(address);
+	}
 
-		if (cmd == "al" || cmd == "add_label") {
-			std::string addr_str;
-			uint32_t    addr;
-			std::string label;
+	std::error_code ec;
+	std::filesystem::last_write_time(cache_path, std::filesystem::file_time_type::clock::now(), ec);
+	return true;
+}
 
-			sline >> addr_str;
-			std::istringstream saddr_str(addr_str[0] == 'C' && addr_str[1] == ':' ? addr_str.substr(2, addr_str.size() - 2) : addr_str);
-			saddr_str >> std::hex;
-			saddr_str >> addr;
-			sline >> label;
+static void save_cache(const std::string &absolute_path, const cache_key &key, const std::vector<symbol_entry> &symbols, const std::vector<uint32_t> &breakpoints)
+{
+	std::string out;
+	out.append(Cache_magic, sizeof(Cache_magic));
+	cache_write(out, Cache_version);
+	cache_write(out, key.size);
+	cache_write(out, key.mtime);
+	cache_write(out, key.bank);
+	cache_write(out, static_cast<uint32_t>(absolute_path.size()));
+	out += absolute_path;
+
+	cache_write(out, static_cast<uint32_t>(symbols.size()));
+	for (const auto &symbol : symbols) {
+		const uint16_t name_length = static_cast<uint16_t>(std::min<size_t>(symbol.name->size(), UINT16_MAX));
+		cache_write(out, symbol.address);
+		cache_write(out, name_length);
+		out.append(symbol.name->data(), name_length);
+	}
 
-			if (addr > 0xffff) {
-				continue;
-			}
-			if (label.size() == 0) {
-				continue;
-			}
-			if (Ignore_list.find(label) != Ignore_list.end()) {
-				continue;
-			}
+	cache_write(out, static_cast<uint32_t>(breakpoints.size()));
+	for (uint32_t address : breakpoints) {
+		cache_write(out, address);
+	}
 
-			const symbol_bank_type sym_bank    = addr < 0xa000 ? 0 : bank;
-			symbol_address_type    symbol_addr = (sym_bank << 16) + addr;
+	const std::filesystem::path cache_path = get_cache_path(absolute_path);
+	std::error_code             ec;
+	std::filesystem::create_directories(cache_path.parent_path(), ec);
+	std::ofstream outfile(cache_path, std::ios_base::out | std::ios_base::binary);
+	if (outfile.is_open()) {
+		outfile.write(out.data(), out.size());
+	}
+	outfile.close();
 
-			bool already_exists = false;
-			for (auto &[address, symbol] : file_symbols) {
-				if ((symbol_addr == address) && !symbol.compare(label)) {
-					already_exists = true;
-					break;
-				}
-			}
+	static bool pruned = false;
+	if (!pruned) {
+		pruned = true;
+		prune_cache(cache_path.parent_path());
+	}
+}
 
-			if (!already_exists) {
-				file_symbols.push_back(std::tuple{ symbol_addr, label });
-			}
-		} else if (cmd == "break") {
-			uint32_t    addr;
-			std::string addr_str;
-
-			sline >> addr_str;
-			std::istringstream saddr_str(addr_str[0] == '$' ? addr_str.substr(1, addr_str.size() - 1) : addr_str);
-			saddr_str >> std::hex;
-			saddr_str >> addr;
-			debugger_add_breakpoint(addr);
+bool symbols_load_file(const std::string &file_path, symbol_bank_type bank)
+{
+	std::error_code   ec;
+	const std::string absolute_path = std::filesystem::absolute(file_path, ec).generic_string();
+
+	std::vector<symbol_entry> file_symbols;
+	std::vector<uint32_t>     breakpoints;
+
+	cache_key  key;
+	const bool have_key = get_cache_key(file_path, bank, key);
+	if (!have_key || !load_cache(absolute_path, key, file_symbols, breakpoints)) {
+		std::string contents;
+		if (!read_file(file_path, contents)) {
+			return false;
+		}
+		file_symbols.clear();
+		breakpoints.clear();
+		parse_symbols(contents, bank, file_symbols, breakpoints);
+		if (have_key) {
+			save_cache(absolute_path, key, file_symbols, breakpoints);
 		}
 	}
 
-	Loaded_symbols_by_file.insert({ file_path, file_symbols });
+	for (uint32_t address : breakpoints) {
+		debugger_add_breakpoint(address);
+	}
+
+	if (Loaded_symbol_files.find(file_path) != Loaded_symbol_files.end()) {
+		symbols_unload_file(file_path);
+	}
+	Loaded_symbols_by_file[file_path] = { bank, std::move(file_symbols) };
 	Loaded_symbol_files.insert(file_path);
 	show_file_entries(file_path);
 
@@ -203,8 +496,11 @@ void symbols_unload_file(const std::string &file_path)
 
 void symbols_refresh_file(const std::string &file_path)
 {
+	const auto            entry = Loaded_symbols_by_file.find(file_path);
+	const symbol_bank_type bank  = entry != Loaded_symbols_by_file.end() ? entry->second.bank : 0;
+
 	symbols_unload_file(file_path);
-	symbols_load_file(file_path);
+	symbols_load_file(file_path, bank);
 }
 
 void symbols_show_file(const std::string &file_path)
@@ -247,54 +543,49 @@ bool symbols_file_is_visible(const std::string &file_path)
 	return Visible_symbol_files.find(file_path) != Visible_symbol_files.end();
 }
 
-const symbol_namelist_type &symbols_find(const std::string &name)
+symbol_namelist_type symbols_find(const std::string &name)
 {
-	auto entry = Symbols_nametable.find(name);
-	if (entry == Symbols_nametable.end()) {
-		return Empty_symbols_namelist;
+	if (Tables_dirty) {
+		rebuild_tables();
+	}
+
+	const auto interned = Names.find(name);
+	if (interned == Names.end()) {
+		return {};
 	}
 
-	return entry->second;
+	const auto [first, last] = std::equal_range(Name_index_names.begin(), Name_index_names.end(), &*interned, std::less<>());
+	return symbol_namelist_type(Name_index_addresses.data() + (first - Name_index_names.begin()), last - first);
 }
 
 void symbols_add(uint16_t addr, symbol_bank_type bank, const std::string &name)
 {
-	const auto &table_entry = Symbols_table.find(addr);
-	if (table_entry != Symbols_table.end()) {
-		table_entry->second.push_back(name);
-	} else {
-		Symbols_table.insert({ addr, std::list<std::string>{ name } });
-	}
-
-	const auto &nametable_entry = Symbols_nametable.find(name);
-	if (nametable_entry != Symbols_nametable.end()) {
-		nametable_entry->second.push_back(addr);
-	} else {
-		Symbols_nametable.insert({ name, std::list<symbol_address_type>{ addr } });
-	}
+	Added_symbols.push_back({ make_address(addr, bank), intern(name) });
+	tables_changed();
 }
 
-const symbol_list_type &symbols_find(uint32_t address, symbol_bank_type bank)
+symbol_list_type symbols_find(uint32_t address, symbol_bank_type bank)
 {
-	if (address < 0xa000) {
-		bank = 0;
+	if (Tables_dirty) {
+		rebuild_tables();
 	}
 
-	auto entry = Symbols_table.find((bank << 16) + address);
-	if (entry == Symbols_table.end()) {
-		return Empty_symbols_list;
-	}
+	const auto [first, last] = std::equal_range(Table_addresses.begin(), Table_addresses.end(), make_address(address, bank));
+	return symbol_list_type(std::span<const std::string *const>(Table_names.data() + (first - Table_addresses.begin()), last - first));
+}
 
-	return entry->second;
+uint32_t symbols_get_generation()
+{
+	return Symbols_generation;
 }
 
 void symbols_for_each(std::function<void(uint16_t, symbol_bank_type, const std::string &)> fn)
 {
-	for (auto &entry : Symbols_table) {
-		uint16_t         addr = entry.first & 0xffff;
-		symbol_bank_type bank = entry.first >> 16;
-		for (const std::string &name : entry.second) {
-			fn(addr, bank, name);
-		}
+	if (Tables_dirty) {
+		rebuild_tables();
 	}
-}
\ No newline at end of file
+
+	for (size_t i = 0; i < Table_addresses.size(); ++i) {
+		fn(Table_addresses[i] & 0xffff, Table_addresses[i] >> 16, *Table_names[i]);
+	}
+}
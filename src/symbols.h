@@ -1,15 +1,88 @@
 #pragma once
 
 #include <functional>
-#include <list>
 #include <set>
+#include <span>
+#include <stdint.h>
 #include <string>
 
-using symbol_address_type  = uint32_t;
-using symbol_list_type     = std::list<std::string>;
-using symbol_namelist_type = std::list<symbol_address_type>;
-using symbol_bank_type     = uint8_t;
+using symbol_address_type = uint32_t;
+using symbol_bank_type    = uint8_t;
 
+// The names of the symbols at one address, in the order their files were shown. Names are
+// interned, so the strings stay valid for the life of the program.
+class symbol_list_type
+{
+public:
+	class iterator
+	{
+	public:
+		iterator(const std::string *const *name)
+		    : m_name(name)
+		{
+		}
+
+		const std::string &operator*() const
+		{
+			return **m_name;
+		}
+
+		iterator &operator++()
+		{
+			++m_name;
+			return *this;
+		}
+
+		bool operator==(const iterator &other) const
+		{
+			return m_name == other.m_name;
+		}
+
+	private:
+		const std::string *const *m_name;
+	};
+
+	symbol_list_type() = default;
+
+	symbol_list_type(std::span<const std::string *const> names)
+	    : m_names(names)
+	{
+	}
+
+	iterator begin() const
+	{
+		return iterator(m_names.data());
+	}
+
+	iterator end() const
+	{
+		return iterator(m_names.data() + m_names.size());
+	}
+
+	bool empty() const
+	{
+		return m_names.empty();
+	}
+
+	size_t size() const
+	{
+		return m_names.size();
+	}
+
+	const std::string &front() const
+	{
+		return *m_names.front();
+	}
+
+private:
+	std::span<const std::string *const> m_names;
+};
+
+// The addresses a name is defined at.
+using symbol_namelist_type = std::span<const symbol_address_type>;
+
+// Parsed symbol files are cached in the prefs directory, and the cache is used instead of the
+// file for as long as the file's size and modification time match.
 bool symbols_load_file(const std::string &file_path, symbol_bank_type bank = 0);
 void symbols_unload_file(const std::string &file_path);
 void symbols_refresh_file(const std::string &file_path);
@@ -22,12 +95,16 @@ bool symbols_file_all_are_visible();
 bool symbols_file_any_is_visible();
 bool symbols_file_is_visible(const std::string &file_path);
 
-const symbol_namelist_type &symbols_find(const std::string &name);
+symbol_namelist_type symbols_find(const std::string &name);
 
 void symbols_add(uint16_t addr, symbol_bank_type bank, const std::string &name);
 
 // Bank parameter is only meaninful for addresses >= $A000.
 // Addresses < $A000 will force bank to 0.
-const symbol_list_type &symbols_find(uint32_t address, symbol_bank_type bank = 0);
+symbol_list_type symbols_find(uint32_t address, symbol_bank_type bank = 0);
+
+// Incremented whenever the set of visible symbols changes, so that anything which
+// resolved symbol names ahead of time knows to resolve them again.
+uint32_t symbols_get_generation();
 
 void symbols_for_each(std::function<void(uint16_t, symbol_bank_type, const std::string &)> fn);
@@ -13,9 +13,13 @@
 #include <stdio.h>
 #include <unordered_map>
 
+#include "block_image.h"
 #include "files.h"
 
 #include "hypercalls.h"
+#include "mapped_file.h"
+#include "sdcard_overlay.h"
+#include "snapshot.h"
 
 // #define VERBOSE 1
 
@@ -48,6 +52,39 @@ char            sdcard_path[PATH_MAX] = "";
 static x16file *sdcard_file           = nullptr;
 bool            sdcard_attached       = false;
 
+// Raw images are mapped into memory when possible, so sector reads and writes are a memcpy and
+// only the pages written since the last flush have to go back to disk. sdcard_file is only used
+// for images that can't be mapped, like compressed ones.
+static mapped_file *sdcard_mapping = nullptr;
+static uint64_t     sdcard_size    = 0;
+
+// Byte range of the mapping written since the last flush.
+static uint64_t dirty_start = UINT64_MAX;
+static uint64_t dirty_end   = 0;
+
+// Frames since the first unflushed write.
+static constexpr int Flush_interval_frames = 120;
+static int           frames_dirty          = 0;
+static bool          overlay_dirty         = false;
+
+// Images that aren't mapped are read ahead and written behind a burst of sectors at a time
+// during multi-block transfers, so a driver streaming a file doesn't cost a seek and a 512 byte
+// read or write on the host per sector.
+static constexpr uint32_t Burst_sectors = 64;
+
+static uint8_t  read_ahead[Burst_sectors * 512];
+static uint32_t read_ahead_start = 0;
+static uint32_t read_ahead_count = 0;
+
+static uint8_t  write_behind[Burst_sectors * 512];
+static uint32_t write_behind_start = 0;
+static uint32_t write_behind_count = 0;
+
+static sdcard_stats stats;
+
+// "" to write to the image itself, "memory" for an in-memory overlay, or the path of a delta file.
+static std::string overlay_spec;
+
 static uint8_t  rxbuf[3 + 512];
 static int      rxbuf_idx;
 static uint32_t lba;
@@ -56,12 +93,20 @@ static bool     is_acmd        = false;
 static bool     is_idle        = true;
 static bool     is_initialized = false;
 
+// Set between CMD18 or CMD25 and the end of the transfer.
+static bool reading_multiple = false;
+static bool writing_multiple = false;
+
 static const uint8_t *response         = nullptr;
 static int            response_length  = 0;
 static int            response_counter = 0;
 
 static bool selected = false;
 
+// Pending response bytes are copied here when a snapshot is restored, since the buffer they were
+// sent from may have been reused by a later command.
+static uint8_t restored_response[2 + 512 + 2];
+
 void sdcard_shutdown()
 {
 	if (sdcard_attached) {
@@ -84,16 +129,68 @@ bool sdcard_path_is_set()
 	return strlen(sdcard_path) > 0;
 }
 
+// Open the image itself, read-only when writes go to an overlay.
+static bool open_base(bool writable)
+{
+	if (!file_is_compressed_type(sdcard_path) && !block_image_detect(sdcard_path)) {
+		sdcard_mapping = mapped_file_open(sdcard_path, writable);
+	}
+	if (sdcard_mapping != nullptr) {
+		sdcard_size = mapped_file_size(sdcard_mapping);
+		return true;
+	}
+
+	sdcard_file = x16open(sdcard_path, writable ? "r+b" : "rb");
+	if (sdcard_file == nullptr) {
+		fmt::print("Cannot open SDCard file {}!\n", sdcard_path);
+		return false;
+	}
+	sdcard_size = x16size(sdcard_file);
+	return true;
+}
+
+static void flush_write_behind()
+{
+	if (write_behind_count == 0) {
+		return;
+	}
+	x16seek(sdcard_file, (Sint64)write_behind_start * 512, XSEEK_SET);
+	size_t bytes_written = x16write(sdcard_file, write_behind, 1, write_behind_count * 512);
+	if (bytes_written != write_behind_count * 512) {
+		fmt::print("Warning: short write!\n");
+	}
+	write_behind_count = 0;
+}
+
+static void close_base()
+{
+	flush_write_behind();
+	read_ahead_count = 0;
+	mapped_file_close(sdcard_mapping);
+	sdcard_mapping = nullptr;
+	x16close(sdcard_file);
+	sdcard_file = nullptr;
+}
+
+void sdcard_set_overlay(const std::string &spec)
+{
+	overlay_spec = spec;
+}
+
 void sdcard_attach()
 {
 	if (!sdcard_attached && sdcard_path_is_set()) {
-		sdcard_file = x16open(sdcard_path, "r+b");
-		if (sdcard_file == nullptr) {
-			fmt::print("Cannot open SDCard file {}!\n", sdcard_path);
+		const bool use_overlay = !overlay_spec.empty();
+		if (!open_base(!use_overlay)) {
+			return;
+		}
+		if (use_overlay && !sdcard_overlay_open(overlay_spec == "memory" ? std::filesystem::path() : std::filesystem::path(overlay_spec), sdcard_size)) {
+			close_base();
 			return;
 		}
+		stats = {};
 
-		fmt::print("SD card attached.\n");
+		fmt::print("SD card attached{}.\n", use_overlay ? " with overlay" : "");
 		sdcard_attached = true;
 		is_initialized  = false;
 
@@ -104,8 +201,9 @@ void sdcard_attach()
 void sdcard_detach()
 {
 	if (sdcard_attached) {
-		x16close(sdcard_file);
-		sdcard_file = nullptr;
+		sdcard_flush();
+		sdcard_overlay_close();
+		close_base();
 
 		fmt::print("SD card detached.\n");
 		sdcard_attached = false;
@@ -116,7 +214,176 @@ void sdcard_detach()
 
 bool sdcard_is_attached()
 {
-	return sdcard_file != nullptr && sdcard_attached;
+	return (sdcard_mapping != nullptr || sdcard_file != nullptr) && sdcard_attached;
+}
+
+void sdcard_flush()
+{
+	flush_write_behind();
+	if (sdcard_mapping != nullptr && dirty_end > dirty_start) {
+		if (!mapped_file_flush(sdcard_mapping, dirty_start, dirty_end - dirty_start)) {
+			fmt::print("Warning: could not flush SD card image!\n");
+		}
+		++stats.flushes;
+	}
+	if (sdcard_overlay_is_active()) {
+		sdcard_overlay_flush();
+	}
+	dirty_start   = UINT64_MAX;
+	dirty_end     = 0;
+	frames_dirty  = 0;
+	overlay_dirty = false;
+}
+
+void sdcard_frame()
+{
+	if ((dirty_end > dirty_start || overlay_dirty || write_behind_count > 0) && ++frames_dirty >= Flush_interval_frames) {
+		sdcard_flush();
+	}
+}
+
+const sdcard_stats &sdcard_get_stats()
+{
+	return stats;
+}
+
+const char *sdcard_get_backend_name()
+{
+	if (sdcard_mapping != nullptr) {
+		return "memory-mapped";
+	}
+	return sdcard_file != nullptr ? "file" : "none";
+}
+
+bool sdcard_has_overlay()
+{
+	return sdcard_overlay_is_active();
+}
+
+bool sdcard_merge_overlay()
+{
+	if (!sdcard_attached || !sdcard_overlay_is_active()) {
+		return false;
+	}
+
+	// Every other instance sharing the image sees the merged sectors from here on.
+	close_base();
+	if (!open_base(true)) {
+		open_base(false);
+		return false;
+	}
+
+	bool ok = true;
+	sdcard_overlay_for_each([&ok](uint32_t sector, const uint8_t *data) {
+		const uint64_t offset = (uint64_t)sector * 512;
+		if (offset + 512 > sdcard_size) {
+			ok = false;
+		} else if (sdcard_mapping != nullptr) {
+			memcpy(mapped_file_data(sdcard_mapping) + offset, data, 512);
+			dirty_start = std::min(dirty_start, offset);
+			dirty_end   = std::max(dirty_end, offset + 512);
+		} else {
+			x16seek(sdcard_file, (Sint64)offset, XSEEK_SET);
+			ok &= x16write(sdcard_file, data, 1, 512) == 512;
+		}
+	});
+	sdcard_flush();
+
+	close_base();
+	open_base(false);
+	if (ok) {
+		sdcard_overlay_discard();
+	}
+	return ok;
+}
+
+// 'sequential' is set during multi-block transfers, when the next sector is likely to follow.
+static bool read_sector(uint32_t sector, uint8_t *data, bool sequential = false)
+{
+	const uint64_t offset = (uint64_t)sector * 512;
+	if (offset + 512 > sdcard_size) {
+		return false;
+	}
+	++stats.sectors_read;
+
+	if (sdcard_overlay_is_active() && sdcard_overlay_read(sector, data)) {
+		return true;
+	}
+	if (sdcard_mapping != nullptr) {
+		memcpy(data, mapped_file_data(sdcard_mapping) + offset, 512);
+		return true;
+	}
+
+	if (sector - read_ahead_start < read_ahead_count) {
+		memcpy(data, &read_ahead[(sector - read_ahead_start) * 512], 512);
+		return true;
+	}
+
+	flush_write_behind();
+	x16seek(sdcard_file, (Sint64)offset, XSEEK_SET);
+	if (sequential) {
+		const uint32_t count = (uint32_t)std::min<uint64_t>(Burst_sectors, (sdcard_size - offset) / 512);
+		size_t         bytes_read = x16read(sdcard_file, read_ahead, 1, count * 512);
+		read_ahead_start = sector;
+		read_ahead_count = (uint32_t)(bytes_read / 512);
+		if (read_ahead_count == 0) {
+			fmt::print("Warning: short read!\n");
+			return true;
+		}
+		memcpy(data, read_ahead, 512);
+		return true;
+	}
+
+	size_t bytes_read = x16read(sdcard_file, data, 1, 512);
+	if (bytes_read != 512) {
+		fmt::print("Warning: short read!\n");
+	}
+	return true;
+}
+
+static bool write_sector(uint32_t sector, const uint8_t *data, bool sequential = false)
+{
+	const uint64_t offset = (uint64_t)sector * 512;
+	if (offset + 512 > sdcard_size) {
+		return false;
+	}
+	++stats.sectors_written;
+
+	if (sdcard_overlay_is_active()) {
+		sdcard_overlay_write(sector, data);
+		overlay_dirty = true;
+		return true;
+	}
+	if (sdcard_mapping != nullptr) {
+		memcpy(mapped_file_data(sdcard_mapping) + offset, data, 512);
+		dirty_start = std::min(dirty_start, offset);
+		dirty_end   = std::max(dirty_end, offset + 512);
+		return true;
+	}
+
+	if (sector - read_ahead_start < read_ahead_count) {
+		memcpy(&read_ahead[(sector - read_ahead_start) * 512], data, 512);
+	}
+
+	if (sequential) {
+		if (write_behind_count == Burst_sectors || (write_behind_count > 0 && sector != write_behind_start + write_behind_count)) {
+			flush_write_behind();
+		}
+		if (write_behind_count == 0) {
+			write_behind_start = sector;
+		}
+		memcpy(&write_behind[write_behind_count * 512], data, 512);
+		++write_behind_count;
+		return true;
+	}
+
+	flush_write_behind();
+	x16seek(sdcard_file, (Sint64)offset, XSEEK_SET);
+	size_t bytes_written = x16write(sdcard_file, data, 1, 512);
+	if (bytes_written != 512) {
+		fmt::print("Warning: short write!\n");
+	}
+	return true;
 }
 
 void sdcard_select(bool select)
@@ -163,9 +430,45 @@ static void set_response_r7(void)
 	response_length           = sizeof(r7);
 }
 
+static uint8_t read_block_response[2 + 512 + 2];
+
+// Respond with the data block for 'sector', preceded by R1 for the command that started the read.
+// The blocks after the first of a multi-block read have no R1.
+static void respond_with_block(uint32_t sector, bool with_r1)
+{
+	read_block_response[0] = 0;
+	read_block_response[1] = 0xFE;
+#ifdef VERBOSE
+	fmt::print("*** SD Reading LBA {:d}\n", sector);
+#endif
+	if (!read_sector(sector, &read_block_response[2], reading_multiple)) {
+		read_block_response[1] = 0x08; // out of range
+		response_length        = 2;
+		reading_multiple       = false;
+	} else {
+		response_length = 2 + 512 + 2;
+	}
+
+	response = read_block_response;
+	if (!with_r1) {
+		++response;
+		--response_length;
+	}
+	response_counter = 0;
+}
+
+static void end_multiple_transfer()
+{
+	reading_multiple = false;
+	if (writing_multiple) {
+		writing_multiple = false;
+		flush_write_behind();
+	}
+}
+
 uint8_t sdcard_handle(uint8_t inbyte)
 {
-	if (!selected || sdcard_file == nullptr) {
+	if (!selected || !sdcard_is_attached()) {
 		return 0xFF;
 	}
 	// fmt::print("sdcard_handle: {:02X}\n", inbyte);
@@ -174,6 +477,9 @@ uint8_t sdcard_handle(uint8_t inbyte)
 
 	if (rxbuf_idx == 0 && inbyte == 0xFF) {
 		// send response data
+		if (!response && reading_multiple) {
+			respond_with_block(++lba, false);
+		}
 		if (response) {
 			outbyte = response[response_counter++];
 			if (response_counter == response_length) {
@@ -202,6 +508,9 @@ uint8_t sdcard_handle(uint8_t inbyte)
 
 			last_cmd = rxbuf[0];
 
+			// Any command ends a multi-block transfer, though only CMD12 should be sent during one.
+			end_multiple_transfer();
+
 #if defined(VERBOSE) && VERBOSE >= 2
 			fmt::print("*** SD {}CMD{:d} -> Response:", (rxbuf[0] & 0x80) ? "A" : "", rxbuf[0] & 0x3F);
 #endif
@@ -237,31 +546,24 @@ uint8_t sdcard_handle(uint8_t inbyte)
 					set_response_r1();
 					break;
 				}
+				case CMD12: {
+					// STOP_TRANSMISSION: Ends a multiple block read
+					set_response_r1();
+					break;
+				}
+
 				case CMD17: {
 					// READ_SINGLE_BLOCK
-					uint32_t       lba = (rxbuf[1] << 24) | (rxbuf[2] << 16) | (rxbuf[3] << 8) | rxbuf[4];
-					static uint8_t read_block_response[2 + 512 + 2];
-					read_block_response[0] = 0;
-					read_block_response[1] = 0xFE;
-#ifdef VERBOSE
-					fmt::print("*** SD Reading LBA {:d}\n", lba);
-#endif
-					if ((uint64_t)lba * 512 >= x16size(sdcard_file)) {
-						read_block_response[1] = 0x08; // out of range
-						response_length        = 2;
-					} else {
-						x16seek(sdcard_file, (Sint64)lba * 512, XSEEK_SET);
-						size_t bytes_read = x16read(sdcard_file, &read_block_response[2], 1, 512);
-						if (bytes_read != 512) {
-							fmt::print("Warning: short read!\n");
-						}
-
-						response        = read_block_response;
-						response_length = 2 + 512 + 2;
-					}
-
-					response        = read_block_response;
-					response_length = 2 + 512 + 2;
+					lba = (rxbuf[1] << 24) | (rxbuf[2] << 16) | (rxbuf[3] << 8) | rxbuf[4];
+					respond_with_block(lba, true);
+					break;
+				}
+
+				case CMD18: {
+					// READ_MULTIPLE_BLOCK: Blocks follow each other until CMD12
+					lba              = (rxbuf[1] << 24) | (rxbuf[2] << 16) | (rxbuf[3] << 8) | rxbuf[4];
+					reading_multiple = true;
+					respond_with_block(lba, true);
 					break;
 				}
 
@@ -272,6 +574,14 @@ uint8_t sdcard_handle(uint8_t inbyte)
 					break;
 				}
 
+				case CMD25: {
+					// WRITE_MULTIPLE_BLOCK: Blocks follow each other until the stop token
+					lba              = (rxbuf[1] << 24) | (rxbuf[2] << 16) | (rxbuf[3] << 8) | rxbuf[4];
+					writing_multiple = true;
+					set_response_r1();
+					break;
+				}
+
 				case CMD55: {
 					// APP_CMD: Next command is an application specific command
 					is_acmd = true;
@@ -299,6 +609,11 @@ uint8_t sdcard_handle(uint8_t inbyte)
 			fmt::print("\n");
 #endif
 
+		} else if (writing_multiple && rxbuf_idx == 1 && rxbuf[0] == 0xFD) {
+			// 'Stop tran' token
+			rxbuf_idx = 0;
+			end_multiple_transfer();
+
 		} else if (rxbuf_idx == 515) {
 			rxbuf_idx = 0;
 			// Check for 'start block' byte
@@ -306,17 +621,55 @@ uint8_t sdcard_handle(uint8_t inbyte)
 #ifdef VERBOSE
 				fmt::print("*** SD Writing LBA {:d}\n", lba);
 #endif
-				if ((uint64_t)lba * 512 >= x16size(sdcard_file)) {
-					// do nothing?
+				write_sector(lba, rxbuf + 1);
+			} else if (writing_multiple && rxbuf[0] == 0xFC) {
+#ifdef VERBOSE
+				fmt::print("*** SD Writing LBA {:d}\n", lba);
+#endif
+				static const uint8_t data_response = 0x05; // data accepted
+				if (write_sector(lba++, rxbuf + 1, true)) {
+					response        = &data_response;
+					response_length = 1;
 				} else {
-					x16seek(sdcard_file, (Sint64)lba * 512, XSEEK_SET);
-					size_t bytes_written = x16write(sdcard_file, rxbuf + 1, 1, 512);
-					if (bytes_written != 512) {
-						fmt::print("Warning: short write!\n");
-					}
+					static const uint8_t write_error = 0x0D;
+					response        = &write_error;
+					response_length = 1;
+					end_multiple_transfer();
 				}
+				response_counter = 0;
 			}
 		}
 	}
 	return outbyte;
 }
+
+void sdcard_snapshot(machine_snapshot &snapshot)
+{
+	flush_write_behind();
+
+	snapshot.io(rxbuf);
+	snapshot.io(rxbuf_idx);
+	snapshot.io(lba);
+	snapshot.io(last_cmd);
+	snapshot.io(is_acmd);
+	snapshot.io(is_idle);
+	snapshot.io(is_initialized);
+	snapshot.io(reading_multiple);
+	snapshot.io(writing_multiple);
+	snapshot.io(selected);
+	snapshot.io(response_length);
+	snapshot.io(response_counter);
+
+	bool has_response = response != nullptr;
+	snapshot.io(has_response);
+	if (has_response) {
+		if (snapshot.saving()) {
+			snapshot.io(const_cast<uint8_t *>(response), response_length);
+		} else {
+			snapshot.io(restored_response, response_length);
+			response = restored_response;
+		}
+	} else {
+		response = nullptr;
+	}
+}
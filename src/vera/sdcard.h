@@ -4,14 +4,46 @@
 #ifndef SD_CARD_H
 #define SD_CARD_H
 
+#include <stdint.h>
+#include <string>
+
 void sdcard_shutdown();
 void sdcard_set_file(char const *path);
+
+// Send writes to a copy-on-write overlay instead of the image, which is then opened read-only
+// and can be shared between instances. 'spec' is "memory", the path of a delta file, or empty
+// to write to the image. Takes effect the next time the card is attached.
+void sdcard_set_overlay(const std::string &spec);
 bool sdcard_path_is_set();
 void sdcard_attach();
 void sdcard_detach();
 bool sdcard_is_attached();
 
+// Write sectors changed since the last flush back to the image. Happens on its own on detach,
+// at shutdown and a couple of seconds after the first unflushed write.
+void sdcard_flush();
+
+// Called by the main loop once per frame.
+void sdcard_frame();
+
+struct sdcard_stats {
+	uint64_t sectors_read;
+	uint64_t sectors_written;
+	uint64_t flushes;
+};
+
+const sdcard_stats &sdcard_get_stats();
+const char         *sdcard_get_backend_name();
+
+bool sdcard_has_overlay();
+
+// Write the overlay's sectors to the image itself and empty the overlay.
+bool sdcard_merge_overlay();
+
 void    sdcard_select(bool select);
 uint8_t sdcard_handle(uint8_t inbyte);
 
+class machine_snapshot;
+void sdcard_snapshot(machine_snapshot &snapshot);
+
 #endif
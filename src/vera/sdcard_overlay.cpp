@@ -0,0 +1,215 @@
+#include "sdcard_overlay.h"
+
+#include <fstream>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+
+#include "fmt/format.h"
+
+// Delta files are a header followed by slots, each a sector number and the sector's contents. A
+// sector keeps its slot once it has one, so rewriting it doesn't grow the file.
+static constexpr char     Delta_magic[4] = { 'B', 'X', 'S', 'D' };
+static constexpr uint32_t Delta_version  = 1;
+static constexpr size_t   Sector_size    = 512;
+
+struct delta_header {
+	char     magic[4];
+	uint32_t version;
+	uint64_t base_size;
+};
+
+static constexpr size_t Slot_size = sizeof(uint32_t) + Sector_size;
+
+static bool                  Active    = false;
+static uint64_t              Base_size = 0;
+static std::filesystem::path Delta_path;
+static std::fstream          Delta_file;
+
+static std::unordered_map<uint32_t, uint32_t> Slots; // sector -> slot
+static std::vector<uint32_t>                  Slot_sectors;
+static std::vector<uint8_t>                   Slot_data;
+static std::vector<uint8_t>                   Slot_dirty;
+static std::vector<uint32_t>                  Dirty_slots;
+
+static void clear_slots()
+{
+	Slots.clear();
+	Slot_sectors.clear();
+	Slot_data.clear();
+	Slot_dirty.clear();
+	Dirty_slots.clear();
+}
+
+static uint32_t add_slot(uint32_t sector)
+{
+	const uint32_t slot = (uint32_t)Slot_sectors.size();
+	Slots[sector]       = slot;
+	Slot_sectors.push_back(sector);
+	Slot_data.resize(Slot_data.size() + Sector_size);
+	Slot_dirty.push_back(0);
+	return slot;
+}
+
+static bool write_delta(std::ostream &out)
+{
+	const delta_header header = { { Delta_magic[0], Delta_magic[1], Delta_magic[2], Delta_magic[3] }, Delta_version, Base_size };
+	out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	for (uint32_t slot = 0; slot < Slot_sectors.size(); ++slot) {
+		out.write(reinterpret_cast<const char *>(&Slot_sectors[slot]), sizeof(uint32_t));
+		out.write(reinterpret_cast<const char *>(&Slot_data[slot * Sector_size]), Sector_size);
+	}
+	return out.good();
+}
+
+static bool load_delta(const std::filesystem::path &path)
+{
+	std::ifstream in(path, std::ios_base::in | std::ios_base::binary);
+	if (!in.is_open()) {
+		return false;
+	}
+
+	delta_header header;
+	if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) || memcmp(header.magic, Delta_magic, sizeof(Delta_magic)) != 0 || header.version != Delta_version) {
+		fmt::print("Not an SD card overlay: {}\n", path.generic_string());
+		return false;
+	}
+	if (header.base_size != Base_size) {
+		fmt::print("SD card overlay {} was made for a different image\n", path.generic_string());
+		return false;
+	}
+
+	uint32_t sector;
+	uint8_t  data[Sector_size];
+	while (in.read(reinterpret_cast<char *>(&sector), sizeof(sector)) && in.read(reinterpret_cast<char *>(data), Sector_size)) {
+		const auto     existing = Slots.find(sector);
+		const uint32_t slot     = existing != Slots.end() ? existing->second : add_slot(sector);
+		memcpy(&Slot_data[slot * Sector_size], data, Sector_size);
+	}
+	return true;
+}
+
+bool sdcard_overlay_open(const std::filesystem::path &delta_path, uint64_t base_size)
+{
+	sdcard_overlay_close();
+
+	Base_size  = base_size;
+	Delta_path = delta_path;
+
+	if (!Delta_path.empty()) {
+		std::error_code ec;
+		if (std::filesystem::exists(Delta_path, ec)) {
+			if (!load_delta(Delta_path)) {
+				clear_slots();
+				return false;
+			}
+		} else {
+			std::ofstream out(Delta_path, std::ios_base::out | std::ios_base::binary);
+			if (!write_delta(out)) {
+				fmt::print("Could not create SD card overlay {}\n", Delta_path.generic_string());
+				return false;
+			}
+		}
+
+		Delta_file.open(Delta_path, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+		if (!Delta_file.is_open()) {
+			fmt::print("Could not open SD card overlay {}\n", Delta_path.generic_string());
+			clear_slots();
+			return false;
+		}
+	}
+
+	Active = true;
+	return true;
+}
+
+void sdcard_overlay_close()
+{
+	if (!Active) {
+		return;
+	}
+	sdcard_overlay_flush();
+	Delta_file.close();
+	clear_slots();
+	Active = false;
+}
+
+bool sdcard_overlay_is_active()
+{
+	return Active;
+}
+
+bool sdcard_overlay_read(uint32_t sector, uint8_t *data)
+{
+	const auto slot = Slots.find(sector);
+	if (slot == Slots.end()) {
+		return false;
+	}
+	memcpy(data, &Slot_data[slot->second * Sector_size], Sector_size);
+	return true;
+}
+
+void sdcard_overlay_write(uint32_t sector, const uint8_t *data)
+{
+	const auto     existing = Slots.find(sector);
+	const uint32_t slot     = existing != Slots.end() ? existing->second : add_slot(sector);
+	memcpy(&Slot_data[slot * Sector_size], data, Sector_size);
+
+	if (!Slot_dirty[slot]) {
+		Slot_dirty[slot] = 1;
+		Dirty_slots.push_back(slot);
+	}
+}
+
+bool sdcard_overlay_flush()
+{
+	if (!Delta_file.is_open()) {
+		Dirty_slots.clear();
+		std::fill(Slot_dirty.begin(), Slot_dirty.end(), 0);
+		return true;
+	}
+
+	for (uint32_t slot : Dirty_slots) {
+		Delta_file.seekp(sizeof(delta_header) + (uint64_t)slot * Slot_size);
+		Delta_file.write(reinterpret_cast<const char *>(&Slot_sectors[slot]), sizeof(uint32_t));
+		Delta_file.write(reinterpret_cast<const char *>(&Slot_data[slot * Sector_size]), Sector_size);
+		Slot_dirty[slot] = 0;
+	}
+	Dirty_slots.clear();
+	Delta_file.flush();
+	if (!Delta_file) {
+		Delta_file.clear();
+		fmt::print("Could not write SD card overlay {}\n", Delta_path.generic_string());
+		return false;
+	}
+	return true;
+}
+
+void sdcard_overlay_discard()
+{
+	clear_slots();
+	if (Delta_file.is_open()) {
+		Delta_file.close();
+		Delta_file.open(Delta_path, std::ios_base::in | std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+		write_delta(Delta_file);
+		Delta_file.flush();
+	}
+}
+
+bool sdcard_overlay_save(const std::filesystem::path &path)
+{
+	std::ofstream out(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+	return out.is_open() && write_delta(out);
+}
+
+size_t sdcard_overlay_sector_count()
+{
+	return Slot_sectors.size();
+}
+
+void sdcard_overlay_for_each(const std::function<void(uint32_t, const uint8_t *)> &fn)
+{
+	for (uint32_t slot = 0; slot < Slot_sectors.size(); ++slot) {
+		fn(Slot_sectors[slot], &Slot_data[slot * Sector_size]);
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#if !defined(SDCARD_OVERLAY_H)
+#	define SDCARD_OVERLAY_H
+
+#	include <filesystem>
+#	include <functional>
+#	include <stdint.h>
+
+//
+// Copy-on-write SD card overlay
+//
+// With an overlay, the SD card image is opened read-only and every written sector goes to the
+// overlay instead, so any number of emulators can share one base image without seeing each
+// other's changes. The overlay lives in memory, and optionally in a sparse delta file holding
+// only the written sectors, which is reloaded the next time it is used with the same image.
+//
+
+// An empty delta_path keeps the overlay in memory only.
+bool sdcard_overlay_open(const std::filesystem::path &delta_path, uint64_t base_size);
+void sdcard_overlay_close();
+bool sdcard_overlay_is_active();
+
+// Returns false if the sector hasn't been written, in which case it comes from the base image.
+bool sdcard_overlay_read(uint32_t sector, uint8_t *data);
+void sdcard_overlay_write(uint32_t sector, const uint8_t *data);
+
+// Write sectors changed since the last flush to the delta file, if there is one.
+bool sdcard_overlay_flush();
+
+// Forget every written sector, emptying the delta file too.
+void sdcard_overlay_discard();
+
+// Write the overlay to a new delta file, which can later be used with -sdcard_overlay.
+bool sdcard_overlay_save(const std::filesystem::path &path);
+
+size_t sdcard_overlay_sector_count();
+void   sdcard_overlay_for_each(const std::function<void(uint32_t, const uint8_t *)> &fn);
+
+#endif
@@ -3,9 +3,12 @@
 // All rights reserved. License: 2-clause BSD
 
 #include "vera_pcm.h"
+#include <algorithm>
 #include <stdio.h>
+#include <string.h>
 
 #include "audio.h"
+#include "snapshot.h"
 
 static uint8_t  fifo[4096 - 1]; // Actual hardware FIFO is 4kB, but you can only use 4095 bytes.
 static unsigned fifo_wridx;
@@ -15,6 +18,8 @@ static unsigned fifo_cnt;
 static uint8_t ctrl;
 static uint8_t rate;
 
+static constexpr unsigned Pcm_block_samples = 256;
+
 static uint8_t volume_lut[16] = {0, 1, 2, 3, 4, 5, 6, 8, 11, 14, 18, 23, 30, 38, 49, 64};
 
 static int16_t cur_l, cur_r;
@@ -87,82 +92,125 @@ void pcm_write_fifo(uint8_t val)
 	}
 }
 
-static uint8_t read_fifo(void)
+bool pcm_is_fifo_almost_empty(void)
 {
-	if (fifo_cnt == 0) {
-		return 0;
-	}
-	uint8_t result = fifo[fifo_rdidx++];
-	if (fifo_rdidx == sizeof(fifo)) {
-		fifo_rdidx = 0;
-	}
-	fifo_cnt--;
-	if (fifo_cnt < dbg_minsiz) {
+	return fifo_cnt < 1024;
+}
+
+// Copy bytes out of the FIFO, handling the wrap at most once.
+static void read_fifo_block(uint8_t *dst, unsigned num_bytes)
+{
+	const unsigned first = std::min<unsigned>(num_bytes, sizeof(fifo) - fifo_rdidx);
+	memcpy(dst, &fifo[fifo_rdidx], first);
+	memcpy(dst + first, fifo, num_bytes - first);
+
+	fifo_rdidx = (fifo_rdidx + num_bytes) % sizeof(fifo);
+	fifo_cnt -= num_bytes;
+	if (num_bytes > 0 && fifo_cnt < dbg_minsiz) {
 		dbg_minsiz = fifo_cnt;
 	}
-	return result;
 }
 
-bool pcm_is_fifo_almost_empty(void)
+// Decode whole sample frames from contiguous FIFO bytes. Written as plain loops over arrays
+// so that the compiler can vectorize them.
+static void decode_frames(const uint8_t *src, int16_t *left, int16_t *right, unsigned num_frames, unsigned format)
 {
-	return fifo_cnt < 1024;
+	switch (format) {
+		case 0: // mono 8-bit
+			for (unsigned i = 0; i < num_frames; ++i) {
+				left[i]  = (int16_t)(src[i] << 8);
+				right[i] = left[i];
+			}
+			break;
+		case 1: // stereo 8-bit
+			for (unsigned i = 0; i < num_frames; ++i) {
+				left[i]  = (int16_t)(src[i * 2] << 8);
+				right[i] = (int16_t)(src[i * 2 + 1] << 8);
+			}
+			break;
+		case 2: // mono 16-bit
+			for (unsigned i = 0; i < num_frames; ++i) {
+				left[i]  = (int16_t)(src[i * 2] | (src[i * 2 + 1] << 8));
+				right[i] = left[i];
+			}
+			break;
+		case 3: // stereo 16-bit
+			for (unsigned i = 0; i < num_frames; ++i) {
+				left[i]  = (int16_t)(src[i * 4] | (src[i * 4 + 1] << 8));
+				right[i] = (int16_t)(src[i * 4 + 2] | (src[i * 4 + 3] << 8));
+			}
+			break;
+	}
 }
 
-void pcm_render(int16_t *buf, unsigned num_samples)
+static void render_block(int16_t *buf, unsigned num_samples)
 {
-	while (num_samples--) {
-		uint8_t old_phase = phase;
+	static constexpr unsigned frame_bytes[4] = { 1, 2, 2, 4 };
+
+	// A sample is fetched whenever bit 7 of the phase accumulator changes.
+	bool     fetch[Pcm_block_samples];
+	unsigned num_fetches = 0;
+	for (unsigned i = 0; i < num_samples; ++i) {
+		const uint8_t old_phase = phase;
 		phase += rate;
-		if ((old_phase & 0x80) != (phase & 0x80)) {
-			if (fifo_cnt == 0) {
-				cur_l = 0;
-				cur_r = 0;
-			} else {
-				switch ((ctrl >> 4) & 3) {
-					case 0: { // mono 8-bit
-						cur_l = (int16_t)read_fifo() << 8;
-						cur_r = cur_l;
-						break;
-					}
-					case 1: { // stereo 8-bit
-						if (fifo_cnt < 2) {
-							fifo_cnt = 0;
-							fifo_rdidx = fifo_wridx;
-						} else {
-							cur_l = read_fifo() << 8;
-							cur_r = read_fifo() << 8;
-						}
-						break;
-					}
-					case 2: { // mono 16-bit
-						if (fifo_cnt < 2) {
-							fifo_cnt = 0;
-							fifo_rdidx = fifo_wridx;
-						} else {
-							cur_l = read_fifo();
-							cur_l |= read_fifo() << 8;
-							cur_r = cur_l;
-						}
-						break;
-					}
-					case 3: { // stereo 16-bit
-						if (fifo_cnt < 4) {
-							fifo_cnt = 0;
-							fifo_rdidx = fifo_wridx;
-						} else {
-							cur_l = read_fifo();
-							cur_l |= read_fifo() << 8;
-							cur_r = read_fifo();
-							cur_r |= read_fifo() << 8;
-						}
-						break;
-					}
-				}
-			}
+		fetch[i] = ((old_phase ^ phase) & 0x80) != 0;
+		num_fetches += fetch[i];
+	}
+
+	const unsigned format      = (ctrl >> 4) & 3;
+	const unsigned frame_size  = frame_bytes[format];
+	const unsigned num_decoded = std::min(num_fetches, fifo_cnt / frame_size);
+
+	// Frame 0 is whatever was playing before this block, decoded frames follow it.
+	int16_t left[Pcm_block_samples + 2];
+	int16_t right[Pcm_block_samples + 2];
+	left[0]  = cur_l;
+	right[0] = cur_r;
+
+	uint8_t bytes[Pcm_block_samples * 4];
+	read_fifo_block(bytes, num_decoded * frame_size);
+	decode_frames(bytes, &left[1], &right[1], num_decoded, format);
+
+	unsigned num_frames = num_decoded + 1;
+	if (num_fetches > num_decoded) {
+		// The FIFO ran dry: a partial frame is discarded and the previous sample is held for one
+		// more fetch, after which the output is silent.
+		if (fifo_cnt > 0) {
+			fifo_cnt   = 0;
+			fifo_rdidx = fifo_wridx;
+			left[num_frames]  = left[num_frames - 1];
+			right[num_frames] = right[num_frames - 1];
+		} else {
+			left[num_frames]  = 0;
+			right[num_frames] = 0;
+		}
+		++num_frames;
+		if (num_fetches > num_decoded + 1) {
+			left[num_frames]  = 0;
+			right[num_frames] = 0;
+			++num_frames;
 		}
+	}
 
-		*(buf++) = ((int)cur_l * (int)volume_lut[ctrl & 0xF]) >> 6;
-		*(buf++) = ((int)cur_r * (int)volume_lut[ctrl & 0xF]) >> 6;
+	const int volume = volume_lut[ctrl & 0xF];
+	unsigned  frame  = 0;
+	for (unsigned i = 0; i < num_samples; ++i) {
+		frame = std::min(frame + fetch[i], num_frames - 1);
+		*(buf++) = ((int)left[frame] * volume) >> 6;
+		*(buf++) = ((int)right[frame] * volume) >> 6;
+	}
+
+	cur_l = left[num_frames - 1];
+	cur_r = right[num_frames - 1];
+}
+
+void pcm_render(int16_t *buf, unsigned num_samples)
+{
+	while (num_samples > 0) {
+		const unsigned block = std::min(num_samples, Pcm_block_samples);
+		render_block(buf, block);
+		buf += block * 2;
+		num_samples -= block;
 	}
 }
 
@@ -176,3 +224,16 @@ void pcm_reset_debug_values(void)
 	dbg_minsiz = fifo_cnt;
 	dbg_maxsiz = fifo_cnt;
 }
+
+void pcm_snapshot(machine_snapshot &snapshot)
+{
+	snapshot.io(fifo);
+	snapshot.io(fifo_wridx);
+	snapshot.io(fifo_rdidx);
+	snapshot.io(fifo_cnt);
+	snapshot.io(ctrl);
+	snapshot.io(rate);
+	snapshot.io(cur_l);
+	snapshot.io(cur_r);
+	snapshot.io(phase);
+}
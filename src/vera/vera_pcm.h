@@ -25,3 +25,6 @@ void           pcm_render(int16_t *buf, unsigned num_samples);
 bool           pcm_is_fifo_almost_empty(void);
 pcm_debug_info pcm_get_debug_info(void);
 void           pcm_reset_debug_values(void);
+
+class machine_snapshot;
+void pcm_snapshot(machine_snapshot &snapshot);
@@ -9,6 +9,7 @@
 #include <string.h>
 
 #include "audio.h"
+#include "snapshot.h"
 
 static psg_channel Channels[PSG_NUM_CHANNELS];
 
@@ -23,13 +24,41 @@ static uint16_t volume_lut[64] = {
 	270, 286, 303, 321, 341, 361, 382, 405, 429, 455, 482, 511
 };
 
+// Render-time state, kept as structure-of-arrays so that the per-sample work over all 16 channels
+// is a set of branchless loops over flat arrays, which the compiler turns into SIMD code.
+struct psg_render_state {
+	alignas(64) uint32_t phase[PSG_NUM_CHANNELS];
+	alignas(64) uint32_t noiseval[PSG_NUM_CHANNELS];
+
+	// Copied from the channel registers at the start of each block.
+	alignas(64) uint32_t freq[PSG_NUM_CHANNELS];
+	alignas(64) uint32_t enabled[PSG_NUM_CHANNELS]; // all bits set if either output is enabled
+	alignas(64) uint32_t pw[PSG_NUM_CHANNELS];
+	alignas(64) uint32_t pw_xor[PSG_NUM_CHANNELS];
+	alignas(64) uint32_t waveform[PSG_NUM_CHANNELS];
+	alignas(64) int32_t  volume[PSG_NUM_CHANNELS];
+	alignas(64) int32_t  left[PSG_NUM_CHANNELS];    // all bits set if left output is enabled
+	alignas(64) int32_t  right[PSG_NUM_CHANNELS];   // all bits set if right output is enabled
+};
+
+static psg_render_state State;
+
 void psg_reset(void)
 {
 	audio_lock_scope lock;
 	memset(Channels, 0, sizeof(Channels));
+	memset(&State, 0, sizeof(State));
 	noise_state = 1;
 }
 
+void psg_snapshot(machine_snapshot &snapshot)
+{
+	audio_lock_scope lock;
+	snapshot.io(Channels);
+	snapshot.io(noise_state);
+	snapshot.io(State);
+}
+
 void psg_writereg(uint8_t reg, uint8_t val)
 {
 	audio_lock_scope lock;
@@ -55,53 +84,97 @@ void psg_writereg(uint8_t reg, uint8_t val)
 	}
 }
 
-static void render(int16_t *left, int16_t *right)
+static void load_render_state()
 {
-	int l = 0;
-	int r = 0;
+	for (int i = 0; i < PSG_NUM_CHANNELS; i++) {
+		const psg_channel &ch = Channels[i];
+
+		State.freq[i]     = ch.freq;
+		State.enabled[i]  = (ch.left || ch.right) ? 0xFFFFFFFF : 0;
+		State.pw[i]       = ch.pw;
+		State.pw_xor[i]   = (ch.pw ^ 0x3f) & 0x3f;
+		State.waveform[i] = ch.waveform;
+		State.volume[i]   = volume_lut[ch.volume];
+		State.left[i]     = ch.left ? -1 : 0;
+		State.right[i]    = ch.right ? -1 : 0;
+	}
+}
 
+static void store_render_state()
+{
 	for (int i = 0; i < PSG_NUM_CHANNELS; i++) {
-		noise_state = (noise_state << 1) | (((noise_state >> 1) ^ (noise_state >> 2) ^ (noise_state >> 4) ^ (noise_state >> 15)) & 1);
-		struct psg_channel *ch = &Channels[i];
+		Channels[i].phase    = State.phase[i];
+		Channels[i].noiseval = (uint8_t)State.noiseval[i];
+	}
+}
 
-		uint32_t new_phase = (ch->left || ch->right) ? ((ch->phase + ch->freq) & 0x1FFFF) : 0;
-		if ((ch->phase & 0x10000) && !(new_phase & 0x10000)) {
-			ch->noiseval = (noise_state >> 1) & 0x3F;
-		}
-		ch->phase = new_phase;
-
-		uint8_t v = 0;
-		switch (ch->waveform) {
-			case WF_PULSE: v = (ch->phase >> 10) > ch->pw ? 0 : 63; break;
-			case WF_SAWTOOTH: v = (ch->phase >> 11) ^ ((ch->pw ^ 0x3f) & 0x3f); break;
-			case WF_TRIANGLE: v = ((ch->phase & 0x10000) ? (~(ch->phase >> 10) & 0x3F) : ((ch->phase >> 10) & 0x3F)) ^ ((ch->pw ^ 0x3f) & 0x3f); break;
-			case WF_NOISE: v = ch->noiseval; break;
-		}
-		int16_t sv = (v ^ 0x20);
-		if (sv & 0x20) {
-			sv |= 0xFFC0;
+template <bool CAPTURE_CHANNELS>
+static void render_block(int16_t *buf, int16_t *const *channel_buffers, unsigned int num_samples)
+{
+	load_render_state();
+
+	uint32_t *phase    = State.phase;
+	uint32_t *noiseval = State.noiseval;
+
+	for (unsigned int s = 0; s < num_samples; s++) {
+		// The noise generator is clocked once per channel, in channel order, so channel i latches the
+		// value after the (i+1)th step of this sample. That part is inherently serial.
+		alignas(64) uint32_t noise[PSG_NUM_CHANNELS];
+		for (int i = 0; i < PSG_NUM_CHANNELS; i++) {
+			noise_state = (noise_state << 1) | (((noise_state >> 1) ^ (noise_state >> 2) ^ (noise_state >> 4) ^ (noise_state >> 15)) & 1);
+			noise[i]    = (noise_state >> 1) & 0x3F;
 		}
 
-		int16_t val = sv * volume_lut[ch->volume];
+		alignas(64) int32_t val[PSG_NUM_CHANNELS];
+		for (int i = 0; i < PSG_NUM_CHANNELS; i++) {
+			const uint32_t new_phase = (phase[i] + State.freq[i]) & 0x1FFFF & State.enabled[i];
+			const uint32_t wrapped   = 0 - (((phase[i] & ~new_phase) >> 16) & 1);
+			noiseval[i]              = (noise[i] & wrapped) | (noiseval[i] & ~wrapped);
+			phase[i]                 = new_phase;
+
+			const uint32_t p        = new_phase;
+			const uint32_t pulse    = (p >> 10) > State.pw[i] ? 0 : 63;
+			const uint32_t sawtooth = (p >> 11) ^ State.pw_xor[i];
+			const uint32_t tri_mask = 0 - ((p >> 16) & 1);
+			const uint32_t triangle = ((((p >> 10) ^ tri_mask) & 0x3F)) ^ State.pw_xor[i];
+
+			const uint32_t wf = State.waveform[i];
+			const uint32_t v  = (pulse & (0 - (uint32_t)(wf == WF_PULSE))) | (sawtooth & (0 - (uint32_t)(wf == WF_SAWTOOTH))) | (triangle & (0 - (uint32_t)(wf == WF_TRIANGLE))) | (noiseval[i] & (0 - (uint32_t)(wf == WF_NOISE)));
 
-		if (ch->left) {
-			l += val >> 3;
+			// v is a 6-bit offset-binary sample; v - 32 is its signed value.
+			val[i] = (((int32_t)v - 32) * State.volume[i]) >> 3;
 		}
-		if (ch->right) {
-			r += val >> 3;
+
+		int32_t l = 0;
+		int32_t r = 0;
+		for (int i = 0; i < PSG_NUM_CHANNELS; i++) {
+			l += val[i] & State.left[i];
+			r += val[i] & State.right[i];
+		}
+
+		if constexpr (CAPTURE_CHANNELS) {
+			for (int i = 0; i < PSG_NUM_CHANNELS; i++) {
+				channel_buffers[i][s * 2]     = (int16_t)(val[i] & State.left[i]);
+				channel_buffers[i][s * 2 + 1] = (int16_t)(val[i] & State.right[i]);
+			}
 		}
+
+		buf[0] = (int16_t)l;
+		buf[1] = (int16_t)r;
+		buf += 2;
 	}
 
-	*left  = l;
-	*right = r;
+	store_render_state();
 }
 
 void psg_render(int16_t *buf, unsigned int num_samples)
 {
-	while (num_samples--) {
-		render(&buf[0], &buf[1]);
-		buf += 2;
-	}
+	render_block<false>(buf, nullptr, num_samples);
+}
+
+void psg_render_channels(int16_t *buf, int16_t *const *channel_buffers, unsigned int num_samples)
+{
+	render_block<true>(buf, channel_buffers, num_samples);
 }
 
 const psg_channel *psg_get_channel(unsigned int channel)
@@ -29,6 +29,7 @@ struct psg_channel {
 void psg_reset(void);
 void psg_writereg(uint8_t reg, uint8_t val);
 void psg_render(int16_t *buf, unsigned int num_samples);
+void psg_render_channels(int16_t *buf, int16_t *const *channel_buffers, unsigned int num_samples);
 
 const psg_channel *psg_get_channel(unsigned int channel);
 psg_channel *      psg_get_channel_debug(unsigned int channel);
@@ -39,3 +40,6 @@ void psg_set_channel_right(unsigned int channel, bool right);
 void psg_set_channel_volume(unsigned int channel, uint8_t volume);
 void psg_set_channel_waveform(unsigned int channel, uint8_t waveform);
 void psg_set_channel_pulse_width(unsigned int channel, uint8_t pw);
+
+class machine_snapshot;
+void psg_snapshot(machine_snapshot &snapshot);
@@ -9,6 +9,7 @@
 #include <stdio.h>
 
 #include "cpu/fake6502.h"
+#include "snapshot.h"
 
 bool    ss;
 bool    busy;
@@ -16,6 +17,8 @@ bool    autotx;
 uint8_t sending_byte, received_byte;
 int     outcounter;
 
+static uint64_t autostep_clocks = 0;
+
 void vera_spi_init()
 {
 	ss            = false;
@@ -26,9 +29,19 @@ void vera_spi_init()
 
 void vera_spi_autostep()
 {
-	static uint64_t clocks = 0;
-	vera_spi_step((int)(clockticks6502 - clocks));
-	clocks = clockticks6502;
+	vera_spi_step((int)(clockticks6502 - autostep_clocks));
+	autostep_clocks = clockticks6502;
+}
+
+void vera_spi_snapshot(machine_snapshot &snapshot)
+{
+	snapshot.io(ss);
+	snapshot.io(busy);
+	snapshot.io(autotx);
+	snapshot.io(sending_byte);
+	snapshot.io(received_byte);
+	snapshot.io(outcounter);
+	snapshot.io(autostep_clocks);
 }
 
 void vera_spi_step(int clocks)
@@ -9,3 +9,6 @@ void    vera_spi_step(int clocks);
 uint8_t debug_vera_spi_read(uint8_t reg);
 uint8_t vera_spi_read(uint8_t address);
 void    vera_spi_write(uint8_t address, uint8_t value);
+
+class machine_snapshot;
+void vera_spi_snapshot(machine_snapshot &snapshot);
@@ -9,8 +9,10 @@
 #include "vera_pcm.h"
 #include "vera_psg.h"
 #include "vera_spi.h"
+#include "debugger.h"
 #include "files.h"
 #include "glue.h"
+#include "snapshot.h"
 
 #include <algorithm>
 #include <limits.h>
@@ -1082,6 +1084,69 @@ void vera_video_save(x16file *f)
 	x16write_bankdump(f, "VERA SPRITES", sprite_data, 0, sizeof(sprite_data[0]), sizeof(sprite_data) / sizeof(sprite_data[0]), 0, 0);
 }
 
+void vera_video_snapshot(machine_snapshot &snapshot)
+{
+	snapshot.io_pages(video_ram, sizeof(video_ram));
+	snapshot.io(palette);
+	snapshot.io(sprite_data);
+
+	snapshot.io(io_addr);
+	snapshot.io(io_rddata);
+	snapshot.io(io_inc);
+	snapshot.io(io_addrsel);
+	snapshot.io(io_dcsel);
+	snapshot.io(ien);
+	snapshot.io(isr);
+	snapshot.io(irq_line);
+	snapshot.io(reg_layer);
+	snapshot.io(reg_composer);
+
+	snapshot.io(sprite_line_collisions);
+	snapshot.io(vga_scan_pos_x);
+	snapshot.io(vga_scan_pos_y);
+	snapshot.io(ntsc_half_cnt);
+	snapshot.io(ntsc_scan_pos_y);
+	snapshot.io(frame_count);
+
+	snapshot.io(fx_addr1_mode);
+	snapshot.io(fx_x_pixel_increment);
+	snapshot.io(fx_y_pixel_increment);
+	snapshot.io(fx_x_pixel_position);
+	snapshot.io(fx_y_pixel_position);
+	snapshot.io(fx_poly_fill_length);
+	snapshot.io(fx_affine_tile_base);
+	snapshot.io(fx_affine_map_base);
+	snapshot.io(fx_affine_map_size);
+	snapshot.io(fx_4bit_mode);
+	snapshot.io(fx_16bit_hop);
+	snapshot.io(fx_cache_byte_cycling);
+	snapshot.io(fx_cache_fill);
+	snapshot.io(fx_cache_write);
+	snapshot.io(fx_trans_writes);
+	snapshot.io(fx_2bit_poly);
+	snapshot.io(fx_2bit_poking);
+	snapshot.io(fx_cache_increment_mode);
+	snapshot.io(fx_cache_nibble_index);
+	snapshot.io(fx_cache_byte_index);
+	snapshot.io(fx_multiplier);
+	snapshot.io(fx_subtract);
+	snapshot.io(fx_affine_clip);
+	snapshot.io(fx_16bit_hop_align);
+	snapshot.io(fx_nibble_bit);
+	snapshot.io(fx_nibble_incr);
+	snapshot.io(fx_cache);
+	snapshot.io(fx_mult_accumulator);
+
+	if (!snapshot.saving()) {
+		refresh_layer_properties(0);
+		refresh_layer_properties(1);
+		for (uint16_t i = 0; i < NUM_SPRITES; ++i) {
+			refresh_sprite_properties(i);
+		}
+		refresh_palette();
+	}
+}
+
 static const int increments[32] = {
 	0,
 	0,
@@ -1232,6 +1297,7 @@ void fx_affine_prefetch(void)
 void fx_vram_cache_write(uint32_t address, uint8_t value, uint8_t mask)
 {
 	if (!fx_trans_writes || value > 0) {
+		const uint8_t old_value = video_ram[address & 0x1FFFF];
 		switch (mask) {
 			case 0:
 				video_ram[address & 0x1FFFF] = value;
@@ -1246,6 +1312,7 @@ void fx_vram_cache_write(uint32_t address, uint8_t value, uint8_t mask)
 				// Do nothing
 				break;
 		}
+		debugger_watch_vram_write(address, old_value, video_ram[address & 0x1FFFF]);
 	}
 }
 
@@ -1264,6 +1331,7 @@ void vera_video_space_read_range(uint8_t *dest, uint32_t address, uint32_t size)
 
 void fx_vera_video_space_write(uint32_t address, bool nibble, uint8_t value)
 {
+	const uint8_t old_value = video_ram[address & 0x1FFFF];
 	if (fx_4bit_mode) {
 		if (nibble) {
 			if (!fx_trans_writes || (value & 0x0f) > 0) {
@@ -1277,6 +1345,7 @@ void fx_vera_video_space_write(uint32_t address, bool nibble, uint8_t value)
 	} else {
 		if (!fx_trans_writes || value > 0) video_ram[address & 0x1FFFF] = value;
 	}
+	debugger_watch_vram_write(address, old_value, video_ram[address & 0x1FFFF]);
 
 	if (address >= ADDR_PSG_START && address < ADDR_PSG_END) {
 		psg_writereg(address & 0x3f, value);
@@ -1291,6 +1360,7 @@ void fx_vera_video_space_write(uint32_t address, bool nibble, uint8_t value)
 
 void vera_video_space_write(uint32_t address, uint8_t value)
 {
+	debugger_watch_vram_write(address, video_ram[address & 0x1FFFF], value);
 	video_ram[address & 0x1FFFF] = value;
 
 	if (address >= ADDR_PSG_START && address < ADDR_PSG_END) {
@@ -1505,6 +1575,7 @@ uint8_t vera_video_read(uint8_t reg)
 			uint32_t address = get_and_inc_address(reg - 3, false);
 
 			uint8_t value      = io_rddata[reg - 3];
+			debugger_watch_vram_read(address, value);
 
 			if (reg == 4 && fx_addr1_mode == 3)
 				fx_affine_prefetch();
@@ -1672,6 +1743,7 @@ void vera_video_write(uint8_t reg, uint8_t value)
 		case 0x04: {
 			if (fx_2bit_poking && fx_addr1_mode) {
 				fx_2bit_poking = false;
+				const uint8_t old_value = video_ram[io_addr[1] & 0x1FFFF];
 				uint8_t mask = value >> 6;
 				switch (mask) {
 					case 0x00:
@@ -1687,6 +1759,7 @@ void vera_video_write(uint8_t reg, uint8_t value)
 						video_ram[io_addr[1] & 0x1FFFF] = (fx_cache[fx_cache_byte_index] & 0x03) | (io_rddata[1] & 0xfc);
 						break;
 				}
+				debugger_watch_vram_write(io_addr[1], old_value, video_ram[io_addr[1] & 0x1FFFF]);
 				break; // break out of the enclosing switch statement early, too
 			}
 			bool nibble = fx_nibble_bit[reg - 3];
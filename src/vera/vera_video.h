@@ -86,6 +86,9 @@ void vera_video_force_redraw_screen();
 bool vera_video_get_irq_out(void);
 void vera_video_save(x16file *f);
 
+class machine_snapshot;
+void vera_video_snapshot(machine_snapshot &snapshot);
+
 uint8_t vera_debug_video_read(uint8_t reg);
 uint8_t vera_video_read(uint8_t reg);
 void    vera_video_write(uint8_t reg, uint8_t value);
@@ -15,6 +15,7 @@
 #include "joystick.h"
 #include "memory.h"
 #include "serial.h"
+#include "snapshot.h"
 
 static struct via_t {
 	int32_t  timer_count[2]; // signed int to distinguish between 0xffffffff (final clock before reset, counter reads "0xffff") and 0x0000ffff (maximum possible count value)
@@ -342,3 +343,8 @@ bool via2_irq()
 {
 	return (via[1].registers[13] & via[1].registers[14]) != 0;
 }
+
+void via_snapshot(machine_snapshot &snapshot)
+{
+	snapshot.io(via);
+}
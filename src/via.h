@@ -21,4 +21,7 @@ void    via2_write(uint8_t reg, uint8_t value);
 void    via2_step(uint32_t clocks);
 bool    via2_irq();
 
+class machine_snapshot;
+void via_snapshot(machine_snapshot &snapshot);
+
 #endif
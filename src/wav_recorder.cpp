@@ -1,7 +1,11 @@
 #include "wav_recorder.h"
 
-#include "SDL.h"
+#include <atomic>
+#include <filesystem>
+#include <vector>
+
 #include "audio.h"
+#include "background_writer.h"
 #include "files.h"
 
 // WAV recorder states
@@ -14,13 +18,53 @@ enum wav_recorder_state_t {
 
 static wav_recorder_state_t Wav_record_state = RECORD_WAV_DISABLED;
 static char *               Wav_path         = nullptr;
+static wav_recorder_stems_t Wav_stems        = RECORD_WAV_STEMS_NONE;
+
+// Samples are collected into blocks of this many stereo frames (~1.3 seconds of audio) before
+// being handed to the writer thread. The header is rewritten after each block, so a crash loses
+// at most one block per file.
+static constexpr size_t Wav_block_frames = 65536;
+
+class wav_stream;
+
+struct wav_block {
+	wav_stream          *stream = nullptr;
+	std::vector<int16_t> samples;
+};
+
+//
+// Writer thread
+//
+// All file output happens here. The emulation thread only copies samples into blocks, so the cost
+// of recording is a memcpy per audio buffer.
+//
 
-class wav_recorder
+static void writer_write_block(wav_block *block);
+
+static background_writer<wav_block> Writer(
+    "wav_recorder",
+    []() {
+	    wav_block *block = new wav_block;
+	    block->samples.reserve(Wav_block_frames * 2);
+	    return block;
+    },
+    writer_write_block);
+
+//
+// wav_stream
+//
+// One output file. The emulation thread owns the block being filled, the writer thread owns the
+// file handle and header between begin() and end().
+//
+
+class wav_stream
 {
 public:
-	void begin(const char *path, int32_t sample_rate);
+	void begin(const std::filesystem::path &path, int32_t sample_rate);
 	void end();
-	void add(const int16_t *samples, const int num_samples);
+	void add(const int16_t *samples, const int num_samples, const int gain_shift = 0);
+
+	void write_block(const wav_block &block);
 
 private:
 #pragma pack(push, 1)
@@ -53,22 +97,32 @@ private:
 	};
 #pragma pack(pop)
 
-	file_header header;
-	uint32_t    samples_written = 0;
+	file_header       header;
+	uint32_t          samples_written = 0;
+	std::atomic<bool> write_failed    = false;
 
-	x16file *wav_file = nullptr;
+	x16file   *wav_file = nullptr;
+	wav_block *filling  = nullptr;
 
 	void update_sizes()
 	{
 		header.data.size = sizeof(int16_t) * header.fmt.channels * samples_written;
 		header.riff.size = 4 + sizeof(fmt_chunk) + sizeof(data_chunk) + (header.data.size);
 	}
+
+	void write_header()
+	{
+		update_sizes();
+		x16seek(wav_file, 0, RW_SEEK_SET);
+		x16write(wav_file, &header, sizeof(file_header), 1);
+		x16seek(wav_file, sizeof(file_header) + header.data.size, RW_SEEK_SET);
+	}
 };
 
-void wav_recorder::begin(const char *path, int32_t sample_rate)
+void wav_stream::begin(const std::filesystem::path &path, int32_t sample_rate)
 {
 	if (wav_file != nullptr) {
-		if (header.fmt.samples_per_sec != sample_rate) {
+		if (header.fmt.samples_per_sec != (uint32_t)sample_rate) {
 			end();
 		}
 	}
@@ -77,10 +131,13 @@ void wav_recorder::begin(const char *path, int32_t sample_rate)
 		wav_file = x16open(path, "wb");
 
 		if (wav_file != nullptr) {
+			header                     = file_header();
 			header.fmt.samples_per_sec = sample_rate;
 			header.fmt.bytes_per_sec   = sample_rate * sizeof(int16_t) * header.fmt.channels;
 			header.fmt.block_align     = sizeof(int16_t) * header.fmt.channels;
 			header.fmt.bits_per_sample = (sizeof(int16_t)) << 3;
+			samples_written            = 0;
+			write_failed               = false;
 
 			const size_t written = x16write(wav_file, &header, sizeof(file_header), 1);
 			if (written == 0) {
@@ -91,32 +148,153 @@ void wav_recorder::begin(const char *path, int32_t sample_rate)
 	}
 }
 
-void wav_recorder::end()
+void wav_stream::end()
 {
 	if (wav_file != nullptr) {
-		update_sizes();
-		x16seek(wav_file, 0, RW_SEEK_SET);
-		x16write(wav_file, &header, sizeof(file_header), 1);
+		if (filling != nullptr) {
+			Writer.submit(filling);
+			filling = nullptr;
+		}
+		Writer.wait_idle();
+
+		write_header();
 		x16close(wav_file);
 		wav_file = nullptr;
 	}
 }
 
-void wav_recorder::add(const int16_t *samples, const int num_samples)
+void wav_stream::add(const int16_t *samples, const int num_samples, const int gain_shift)
 {
-	if (wav_file) {
-		const size_t bytes   = sizeof(int16_t) * 2 * num_samples;
-		const size_t written = x16write(wav_file, samples, bytes, 1);
-		if (written == 0) {
-			x16close(wav_file);
-			wav_file = nullptr;
+	if (wav_file == nullptr) {
+		return;
+	}
+
+	if (write_failed) {
+		end();
+		return;
+	}
+
+	int remaining = num_samples * 2;
+	while (remaining > 0) {
+		if (filling == nullptr) {
+			filling         = Writer.alloc();
+			filling->stream = this;
+			filling->samples.clear();
+		}
+
+		std::vector<int16_t> &dst   = filling->samples;
+		const int             count = std::min(remaining, (int)(Wav_block_frames * 2 - dst.size()));
+		if (gain_shift == 0) {
+			dst.insert(dst.end(), samples, samples + count);
 		} else {
-			samples_written += num_samples;
+			for (int i = 0; i < count; ++i) {
+				dst.push_back((int16_t)std::clamp((int32_t)samples[i] << gain_shift, -32768, 32767));
+			}
 		}
+		samples += count;
+		remaining -= count;
+
+		if (dst.size() == Wav_block_frames * 2) {
+			Writer.submit(filling);
+			filling = nullptr;
+		}
+	}
+}
+
+void wav_stream::write_block(const wav_block &block)
+{
+	if (write_failed || block.samples.empty()) {
+		return;
+	}
+
+	const size_t bytes   = sizeof(int16_t) * block.samples.size();
+	const size_t written = x16write(wav_file, block.samples.data(), bytes, 1);
+	if (written == 0) {
+		write_failed = true;
+		return;
+	}
+
+	samples_written += (uint32_t)(block.samples.size() / 2);
+	write_header();
+}
+
+static void writer_write_block(wav_block *block)
+{
+	block->stream->write_block(*block);
+}
+
+//
+// Recorder
+//
+
+static wav_stream Wav_mix;
+static wav_stream Wav_stem_streams[AUDIO_STEM_COUNT];
+
+// Stems are written at the gain they are mixed with, before the limiter.
+static int stem_gain_shift(int stem)
+{
+	return (stem == AUDIO_STEM_YM || (stem >= AUDIO_STEM_YM_VOICE && stem < AUDIO_STEM_PSG_CHANNEL)) ? 0 : 1;
+}
+
+static std::filesystem::path stem_path(const char *path, int stem)
+{
+	const std::filesystem::path base(path);
+
+	std::string suffix;
+	switch (stem) {
+		case AUDIO_STEM_YM: suffix = "-ym"; break;
+		case AUDIO_STEM_PSG: suffix = "-psg"; break;
+		case AUDIO_STEM_PCM: suffix = "-pcm"; break;
+		default:
+			if (stem < AUDIO_STEM_PSG_CHANNEL) {
+				suffix = fmt::format("-ym{:d}", stem - AUDIO_STEM_YM_VOICE);
+			} else {
+				suffix = fmt::format("-psg{:d}", stem - AUDIO_STEM_PSG_CHANNEL);
+			}
+			break;
+	}
+
+	return base.parent_path() / (base.stem().generic_string() + suffix + base.extension().generic_string());
+}
+
+static int num_stems()
+{
+	switch (Wav_stems) {
+		case RECORD_WAV_STEMS_CHIPS: return AUDIO_STEM_YM_VOICE;
+		case RECORD_WAV_STEMS_VOICES: return AUDIO_STEM_COUNT;
+		default: return 0;
+	}
+}
+
+static void wav_recorder_begin()
+{
+	Writer.start();
+
+	const int sample_rate = audio_get_sample_rate();
+	Wav_mix.begin(Wav_path, sample_rate);
+	for (int i = 0; i < num_stems(); ++i) {
+		Wav_stem_streams[i].begin(stem_path(Wav_path, i), sample_rate);
+	}
+}
+
+static void wav_recorder_end()
+{
+	Wav_mix.end();
+	for (int i = 0; i < AUDIO_STEM_COUNT; ++i) {
+		Wav_stem_streams[i].end();
 	}
 }
 
-wav_recorder Wav_recorder;
+static void wav_recorder_process_stems(const int16_t *const *stems, const int num_samples)
+{
+	if (Wav_record_state == RECORD_WAV_RECORDING) {
+		for (int i = 0; i < num_stems(); ++i) {
+			if (stems[i] != nullptr) {
+				Wav_stem_streams[i].add(stems[i], num_samples, stem_gain_shift(i));
+			}
+		}
+	}
+}
 
 void wav_recorder_init()
 {
@@ -124,7 +302,9 @@ void wav_recorder_init()
 
 void wav_recorder_shutdown()
 {
-	Wav_recorder.end();
+	audio_set_stem_callback(nullptr, false);
+	wav_recorder_end();
+	Writer.stop();
 }
 
 void wav_recorder_process(const int16_t *samples, const int num_samples)
@@ -133,14 +313,14 @@ void wav_recorder_process(const int16_t *samples, const int num_samples)
 		for (int i = 0; i < num_samples; ++i) {
 			if (samples[i] != 0) {
 				Wav_record_state = RECORD_WAV_RECORDING;
-				Wav_recorder.begin(Wav_path, audio_get_sample_rate());
+				wav_recorder_begin();
 				break;
 			}
 		}
 	}
 
 	if (Wav_record_state == RECORD_WAV_RECORDING) {
-		Wav_recorder.add(samples, num_samples);
+		Wav_mix.add(samples, num_samples);
 	}
 }
 
@@ -153,11 +333,11 @@ void wav_recorder_set(wav_recorder_command_t command)
 				break;
 			case RECORD_WAV_RECORD:
 				Wav_record_state = RECORD_WAV_RECORDING;
-				Wav_recorder.begin(Wav_path, audio_get_sample_rate());
+				wav_recorder_begin();
 				break;
 			case RECORD_WAV_AUTOSTART:
 				if (Wav_record_state == RECORD_WAV_RECORDING) {
-					Wav_recorder.end();
+					wav_recorder_end();
 				}
 				Wav_record_state = RECORD_WAV_AUTOSTARTING;
 				break;
@@ -176,7 +356,7 @@ uint8_t wav_recorder_get_state()
 void wav_recorder_set_path(const char *path)
 {
 	if (Wav_record_state == RECORD_WAV_RECORDING) {
-		Wav_recorder.end();
+		wav_recorder_end();
 	}
 
 	if (Wav_path != nullptr) {
@@ -196,9 +376,28 @@ void wav_recorder_set_path(const char *path)
 			Wav_record_state               = RECORD_WAV_AUTOSTARTING;
 		} else {
 			Wav_record_state = RECORD_WAV_RECORDING;
-			Wav_recorder.begin(Wav_path, audio_get_sample_rate());
+			wav_recorder_begin();
 		}
 	} else {
 		Wav_record_state = RECORD_WAV_DISABLED;
 	}
-}
\ No newline at end of file
+}
+
+void wav_recorder_set_stems(wav_recorder_stems_t stems)
+{
+	if (Wav_record_state == RECORD_WAV_RECORDING) {
+		for (int i = 0; i < AUDIO_STEM_COUNT; ++i) {
+			Wav_stem_streams[i].end();
+		}
+	}
+
+	Wav_stems = stems;
+	audio_set_stem_callback(Wav_stems != RECORD_WAV_STEMS_NONE ? wav_recorder_process_stems : nullptr, Wav_stems == RECORD_WAV_STEMS_VOICES);
+
+	if (Wav_record_state == RECORD_WAV_RECORDING) {
+		const int sample_rate = audio_get_sample_rate();
+		for (int i = 0; i < num_stems(); ++i) {
+			Wav_stem_streams[i].begin(stem_path(Wav_path, i), sample_rate);
+		}
+	}
+}
@@ -8,6 +8,12 @@ enum wav_recorder_command_t {
 	RECORD_WAV_AUTOSTART,
 };
 
+enum wav_recorder_stems_t {
+	RECORD_WAV_STEMS_NONE = 0,
+	RECORD_WAV_STEMS_CHIPS,
+	RECORD_WAV_STEMS_VOICES,
+};
+
 void wav_recorder_init();
 void wav_recorder_shutdown();
 void wav_recorder_process(const int16_t *samples, const int num_samples);
@@ -16,5 +22,6 @@ void    wav_recorder_set(wav_recorder_command_t command);
 uint8_t wav_recorder_get_state();
 
 void wav_recorder_set_path(const char *path);
+void wav_recorder_set_stems(wav_recorder_stems_t stems);
 
 #endif
\ No newline at end of file
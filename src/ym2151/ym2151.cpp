@@ -1,6 +1,7 @@
 #include "ym2151.h"
 
 #include <queue>
+#include <vector>
 
 #include "ymfm_opm.h"
 
@@ -8,6 +9,42 @@
 
 #include "audio.h"
 #include "bitutils.h"
+#include "cpu/fake6502.h"
+#include "glue.h"
+#include "snapshot.h"
+
+// ymfm's ym2151 only hands back the mix of all its channels. Its engine is protected, so this
+// derives from it to add a variant of generate() that also keeps each channel's output for the
+// per-voice wav stems, leaving the vendored sources untouched.
+class ym2151_chip : public ymfm::ym2151
+{
+public:
+	ym2151_chip(ymfm::ymfm_interface &intf)
+	    : ymfm::ym2151(intf)
+	{
+		// Nothing to do.
+	}
+
+	void generate_channels(output_data *output, output_data *const *channel_output, uint32_t numsamples)
+	{
+		for (uint32_t samp = 0; samp < numsamples; ++samp, ++output) {
+			m_fm.clock(fm_engine::ALL_CHANNELS);
+
+			// OPM has no intermediate clipping, so the channels' outputs sum to what generate() would
+			// have produced for all of them at once.
+			output->clear();
+			for (uint32_t chnum = 0; chnum < fm_engine::CHANNELS; ++chnum) {
+				output_data &chout = channel_output[chnum][samp];
+				m_fm.output(chout.clear(), 0, 32767, 1 << chnum);
+				for (uint32_t index = 0; index < OUTPUTS; ++index) {
+					output->data[index] += chout.data[index];
+				}
+				chout.roundtrip_fp();
+			}
+			output->roundtrip_fp();
+		}
+	}
+};
 
 class ym2151_interface : public ymfm::ymfm_interface
 {
@@ -15,13 +52,15 @@ public:
 	ym2151_interface()
 	    : m_chip(*this),
 	      m_chip_sample_rate(m_chip.sample_rate(YM_CLOCK_RATE)),
-	      m_generation_time(0),
+	      m_sync_clock(0),
+	      m_sync_remainder(0),
+	      m_next_event_clock(UINT64_MAX),
 	      m_backbuffer_size(m_chip.sample_rate(YM_CLOCK_RATE)),
 	      m_backbuffer_used(0),
-	      m_previous_samples{ { 0, 0 }, { 0, 0 } },
 	      m_timers{0, 0},
 	      m_busy_timer{ 0 },
-	      m_irq_status{ false }
+	      m_irq_status{ false },
+	      m_capture_voices{ false }
 	{
 	}
 
@@ -134,63 +173,131 @@ public:
 		}	
 	}
 
-	void pregenerate()
+	// Catch the chip up to the given CPU clock, generating every sample between the previous sync and now
+	// in one batch. Register writes and status reads sync first, so they land on the chip sample that
+	// corresponds to the CPU cycle they happened on, independently of when audio is rendered.
+	void sync(uint64_t cpu_clock)
 	{
-		if (m_backbuffer_used < m_backbuffer_size) {
+		if (cpu_clock <= m_sync_clock) {
+			// The clock may step backwards when the debugger rewinds an instruction.
+			m_sync_clock = std::min(m_sync_clock, cpu_clock);
+			return;
+		}
+
+		m_sync_remainder += (cpu_clock - m_sync_clock) * YM_CLOCK_RATE;
+		m_sync_clock = cpu_clock;
+
+		const uint64_t samples = m_sync_remainder / Sync_divisor;
+		m_sync_remainder -= samples * Sync_divisor;
+		pregenerate(samples);
+		update_next_event();
+	}
+
+	void pregenerate(uint64_t samples)
+	{
+		while (samples > 0) {
+			if (m_backbuffer_used == m_backbuffer_size) {
+				// Nobody has been consuming audio (e.g. sound is disabled), but the chip's timers still need to run.
+				consume_backbuffer(m_backbuffer_size / 2);
+			}
+
 			if (m_write_queue.size() > 0) {
 				auto [addr, value] = m_write_queue.front();
 				m_chip.write_address(addr);
 				m_chip.write_data(value, false);
+				m_write_queue.pop();
+
+				generate_samples(1);
+				--samples;
+				continue;
 			}
 
-			m_chip.generate(&m_backbuffer[m_backbuffer_used], 1);
-			update_clocks();
-			++m_backbuffer_used;
+			// Stop at timer expiries so that reloaded timers keep their exact period.
+			const uint32_t batch = (uint32_t)std::min<uint64_t>({ samples, m_backbuffer_size - m_backbuffer_used, samples_until_timer() });
+			generate_samples(batch);
+			samples -= batch;
 		}
 	}
-		
 
-	void pregenerate(uint32_t samples)
+	void generate_samples(uint32_t samples)
 	{
-		if (m_backbuffer_used + samples > m_backbuffer_size) {
-			samples = m_backbuffer_size - m_backbuffer_used;
+		if (m_capture_voices) {
+			ymfm::ym2151::output_data *voice_outputs[MAX_YM2151_VOICES];
+			for (int v = 0; v < MAX_YM2151_VOICES; ++v) {
+				voice_outputs[v] = &m_voice_backbuffer[v * m_backbuffer_size + m_backbuffer_used];
+			}
+			m_chip.generate_channels(&m_backbuffer[m_backbuffer_used], voice_outputs, samples);
+		} else {
+			m_chip.generate(&m_backbuffer[m_backbuffer_used], samples);
 		}
+		update_clocks(samples);
+		m_backbuffer_used += samples;
+	}
 
-		while (samples > 0 && m_write_queue.size() > 0) {
-			auto [addr, value] = m_write_queue.front();
-			m_chip.write_address(addr);
-			m_chip.write_data(value, false);
-
-			m_chip.generate(&m_backbuffer[m_backbuffer_used], 1);
-			update_clocks();
-			++m_backbuffer_used;
-			--samples;
+	uint64_t samples_until_timer() const
+	{
+		int32_t next_timer = INT32_MAX;
+		for (int i = 0; i < 2; ++i) {
+			if (m_timers[i] > 0) {
+				next_timer = std::min(next_timer, m_timers[i]);
+			}
+		}
+		return (next_timer == INT32_MAX) ? UINT64_MAX : (uint64_t)(next_timer + 63) / 64;
+	}
 
-			m_write_queue.pop();
+	// Work out the CPU clock at which the next timer expires, so that YM_irq() only has to sync when
+	// something can actually change.
+	void update_next_event()
+	{
+		const uint64_t samples = samples_until_timer();
+		if (samples == UINT64_MAX) {
+			m_next_event_clock = UINT64_MAX;
+			return;
 		}
+		m_next_event_clock = m_sync_clock + (samples * Sync_divisor - m_sync_remainder + YM_CLOCK_RATE - 1) / YM_CLOCK_RATE;
+	}
 
-		if (samples > 0) {
-			m_chip.generate(&m_backbuffer[m_backbuffer_used], samples);
-			update_clocks(samples);
+	bool needs_sync(uint64_t cpu_clock) const
+	{
+		return cpu_clock >= m_next_event_clock;
+	}
 
-			m_backbuffer_used += samples;
+	void consume_backbuffer(uint32_t samples)
+	{
+		samples = std::min(samples, m_backbuffer_used);
+		if (samples < m_backbuffer_used) {
+			memmove(&m_backbuffer[0], &m_backbuffer[samples], sizeof(ymfm::ym2151::output_data) * (m_backbuffer_used - samples));
+			if (m_capture_voices) {
+				for (int v = 0; v < MAX_YM2151_VOICES; ++v) {
+					ymfm::ym2151::output_data *voice_backbuffer = &m_voice_backbuffer[v * m_backbuffer_size];
+					memmove(&voice_backbuffer[0], &voice_backbuffer[samples], sizeof(ymfm::ym2151::output_data) * (m_backbuffer_used - samples));
+				}
+			}
 		}
+		m_backbuffer_used -= samples;
 	}
 
-	void generate(int16_t *buffers, uint32_t samples, uint32_t sample_rate)
+	// Pad the backbuffer by repeating its last sample.
+	void hold_backbuffer(uint32_t samples)
 	{
-		uint32_t samples_needed = samples * m_chip_sample_rate / sample_rate;
-		if (m_backbuffer_used < samples_needed) {
-			pregenerate(samples_needed - m_backbuffer_used);
+		for (uint32_t s = 0; s < samples; ++s, ++m_backbuffer_used) {
+			m_backbuffer[m_backbuffer_used] = (m_backbuffer_used > 0) ? m_backbuffer[m_backbuffer_used - 1] : m_filter_memory[0];
+			if (m_capture_voices) {
+				for (int v = 0; v < MAX_YM2151_VOICES; ++v) {
+					ymfm::ym2151::output_data *voice_backbuffer = &m_voice_backbuffer[v * m_backbuffer_size];
+					voice_backbuffer[m_backbuffer_used]         = (m_backbuffer_used > 0) ? voice_backbuffer[m_backbuffer_used - 1] : m_voice_filter_memory[v][0];
+				}
+			}
 		}
+	}
 
-		uint32_t samples_used = 0;
-
+	void resample(const ymfm::ym2151::output_data *source, ymfm::ym2151::output_data *filter_memory, int16_t *buffers, uint32_t samples, uint32_t samples_needed, uint64_t step)
+	{
 		// iterate over output samples
 		int16_t *out_streams[2] = {&buffers[0], &buffers[1]};
 		for (uint32_t s = 0; s < samples; s++) {
 			// which sample in the upsampled, filtered signal will we use for the given output sample?
-			int32_t pick_index = (int32_t)(((float)(s * m_chip_sample_rate * upsampling_factor)) / sample_rate);
+			int32_t pick_index = (int32_t)(((m_resample_phase + s * step) * upsampling_factor) >> Resample_fraction_bits);
 			// now, compute this sample (L/R)
 			for (int i = 0; i < 2; i++) {
 				double sum = 0.0f;
@@ -198,9 +305,9 @@ public:
 				int32_t k = 0;
 				for (int32_t filter_index = pick_index % upsampling_factor; filter_index < filter_kernel_length; filter_index += upsampling_factor) {
 					if (source_sample - k >= 0) {
-						sum += filter_kernel[filter_index] * m_backbuffer[source_sample - k].data[i];
+						sum += filter_kernel[filter_index] * source[source_sample - k].data[i];
 					} else {
-						sum += filter_kernel[filter_index] * m_filter_memory[k - source_sample - 1].data[i];
+						sum += filter_kernel[filter_index] * filter_memory[k - source_sample - 1].data[i];
 					}
 					k++;
 				}
@@ -211,22 +318,61 @@ public:
 
 		// fill filter memory with the last few input samples
 		for (int32_t s = 0; s < filter_memory_length; s++) {
-			m_filter_memory[s] = m_backbuffer[samples_needed - 1 - s];
+			filter_memory[s] = source[samples_needed - 1 - s];
+		}
+	}
+
+	void generate(int16_t *buffers, uint32_t samples, double sample_rate, int16_t *const *voice_buffers)
+	{
+		// The chip is only ever generated up to the current CPU clock, so the emulated timers never run
+		// ahead of the CPU. The resampler trails slightly behind that and steps through the backbuffer at
+		// exactly the chip rate, dropping or holding samples if it drifts outside its window (e.g. when
+		// audio tops up its buffers faster than the CPU runs).
+		const uint64_t step           = (uint64_t)((YM_CLOCK_RATE / 64.0) / sample_rate * ((uint64_t)1 << Resample_fraction_bits));
+		const uint64_t end            = m_resample_phase + samples * step;
+		const uint32_t samples_needed = (uint32_t)(end >> Resample_fraction_bits);
+
+		if (m_backbuffer_used < samples_needed || m_backbuffer_used > samples_needed + 2 * Resample_lag) {
+			const uint32_t target = samples_needed + Resample_lag;
+			if (m_backbuffer_used > target) {
+				consume_backbuffer(m_backbuffer_used - target);
+			} else {
+				hold_backbuffer(target - m_backbuffer_used);
+			}
 		}
 
-		samples_used = samples_needed;
+		resample(m_backbuffer, m_filter_memory, buffers, samples, samples_needed, step);
+		if (m_capture_voices && voice_buffers != nullptr) {
+			for (int v = 0; v < MAX_YM2151_VOICES; ++v) {
+				resample(&m_voice_backbuffer[v * m_backbuffer_size], m_voice_filter_memory[v], voice_buffers[v], samples, samples_needed, step);
+			}
+		}
+
+		m_resample_phase = end & (((uint64_t)1 << Resample_fraction_bits) - 1);
+		consume_backbuffer(samples_needed);
+	}
 
-		if (samples_used < m_backbuffer_used) {
-			memmove(&m_backbuffer[0], &m_backbuffer[samples_used], sizeof(ymfm::ym2151::output_data) * (m_backbuffer_used - samples_used));
-			m_backbuffer_used -= samples;
+	void set_voice_capture(bool enable)
+	{
+		if (enable == m_capture_voices) {
+			return;
+		}
+
+		if (enable) {
+			// Voices are silent for whatever is already in the backbuffer.
+			m_voice_backbuffer.assign(MAX_YM2151_VOICES * m_backbuffer_size, ymfm::ym2151::output_data{});
+			memset(m_voice_filter_memory, 0, sizeof(m_voice_filter_memory));
 		} else {
-			m_backbuffer_used = 0;
+			m_voice_backbuffer.clear();
+			m_voice_backbuffer.shrink_to_fit();
 		}
+		m_capture_voices = enable;
 	}
 
 	void clear_backbuffer()
 	{
 		m_backbuffer_used = 0;
+		m_resample_phase  = 0;
 	}
 
 	void write(uint8_t addr, uint8_t value)
@@ -240,12 +386,60 @@ public:
 		} else {
 			m_chip.write_address(addr);
 			m_chip.write_data(value, false);
+			update_next_event();
 		}
 	}
 
 	void reset()
 	{
 		m_chip.reset();
+		update_next_event();
+	}
+
+	void snapshot(machine_snapshot &snapshot)
+	{
+		std::vector<uint8_t> chip_state;
+		if (snapshot.saving()) {
+			ymfm::ymfm_saved_state state(chip_state, true);
+			m_chip.save_restore(state);
+		}
+		uint32_t chip_state_size = static_cast<uint32_t>(chip_state.size());
+		snapshot.io(chip_state_size);
+		chip_state.resize(chip_state_size);
+		snapshot.io(chip_state.data(), chip_state_size);
+		if (!snapshot.saving()) {
+			ymfm::ymfm_saved_state state(chip_state, false);
+			m_chip.save_restore(state);
+		}
+
+		snapshot.io(m_sync_clock);
+		snapshot.io(m_sync_remainder);
+		snapshot.io(m_next_event_clock);
+		snapshot.io(m_timers);
+		snapshot.io(m_busy_timer);
+		snapshot.io(m_irq_status);
+
+		uint32_t queued = static_cast<uint32_t>(m_write_queue.size());
+		snapshot.io(queued);
+		if (snapshot.saving()) {
+			auto pending = m_write_queue;
+			for (; !pending.empty(); pending.pop()) {
+				auto [addr, value] = pending.front();
+				snapshot.io(addr);
+				snapshot.io(value);
+			}
+		} else {
+			m_write_queue = {};
+			for (uint32_t i = 0; i < queued; ++i) {
+				uint8_t addr  = 0;
+				uint8_t value = 0;
+				snapshot.io(addr);
+				snapshot.io(value);
+				m_write_queue.push({ addr, value });
+			}
+			// Samples generated past the restored clock belong to a timeline that no longer exists.
+			clear_backbuffer();
+		}
 	}
 
 	void debug_write(uint8_t addr, uint8_t value)
@@ -325,9 +519,15 @@ public:
 	}
 
 private:
-	ymfm::ym2151 m_chip;
+	ym2151_chip  m_chip;
 	uint32_t     m_chip_sample_rate;
-	uint64_t     m_generation_time;
+
+	// CPU clocks are converted to chip samples exactly: one sample is 64 chip clocks.
+	static constexpr uint64_t Sync_divisor = 64 * (uint64_t)MHZ * 1000000;
+
+	uint64_t m_sync_clock;
+	uint64_t m_sync_remainder;
+	uint64_t m_next_event_clock;
 
 	ymfm::ym2151::output_data m_backbuffer[YM_SAMPLE_RATE];
 	uint32_t                  m_backbuffer_size;
@@ -335,8 +535,6 @@ private:
 
 	std::queue<std::tuple<uint8_t, uint8_t>> m_write_queue;
 
-	ymfm::ym2151::output_data m_previous_samples[2];
-
 	int32_t m_timers[2];
 	int32_t m_busy_timer;
 
@@ -347,7 +545,19 @@ private:
 #include "resampling_filter_kernel.inl"
 	
 	static constexpr int filter_memory_length = filter_kernel_length / upsampling_factor + 1;
+
+	// Resampler position within the backbuffer, in 32.32 fixed point chip samples, and how many chip
+	// samples it may trail behind the generated audio before it skips ahead.
+	static constexpr int      Resample_fraction_bits = 32;
+	static constexpr uint32_t Resample_lag           = 16;
+	uint64_t                  m_resample_phase = 0;
+
 	ymfm::ym2151::output_data m_filter_memory[filter_kernel_length];
+
+	// Per-voice copies of the backbuffer and filter state, only allocated while voice capture is enabled.
+	bool                                   m_capture_voices;
+	std::vector<ymfm::ym2151::output_data> m_voice_backbuffer;
+	ymfm::ym2151::output_data              m_voice_filter_memory[MAX_YM2151_VOICES][filter_kernel_length];
 };
 
 static ym2151_interface Ym_interface;
@@ -357,23 +567,15 @@ static uint8_t          Ym_registers[256];
 static bool             Ym_irq_enabled = false;
 static bool             Ym_strict_busy = false;
 
-void YM_prerender(uint32_t clocks)
+void YM_render(int16_t *buffer, uint32_t samples, double sample_rate, int16_t *const *voice_buffers)
 {
-	static uint32_t clocks_elapsed = 0;
-	clocks_elapsed += clocks;
-
-	const uint32_t clocks_per_sample = 8000000 / Ym_interface.get_sample_rate();
-	const uint32_t samples_to_render = clocks_elapsed / clocks_per_sample;
-
-	if (samples_to_render > 0) {
-		Ym_interface.pregenerate(samples_to_render);
-		clocks_elapsed -= samples_to_render * clocks_per_sample;
-	}
+	Ym_interface.sync(clockticks6502);
+	Ym_interface.generate(buffer, samples, sample_rate, voice_buffers);
 }
 
-void YM_render(int16_t *buffer, uint32_t samples, uint32_t sample_rate)
+void YM_set_voice_capture(bool enable)
 {
-	Ym_interface.generate(buffer, samples, sample_rate);
+	Ym_interface.set_voice_capture(enable);
 }
 
 void YM_clear_backbuffer()
@@ -413,6 +615,7 @@ void YM_write(uint8_t offset, uint8_t value)
 		Last_data                  = value;
 		Ym_registers[Last_address] = Last_data;
 
+		Ym_interface.sync(clockticks6502);
 		Ym_interface.write(Last_address, Last_data);
 	} else { // address port
 		Last_address = value;
@@ -421,12 +624,19 @@ void YM_write(uint8_t offset, uint8_t value)
 
 uint8_t YM_read_status()
 {
+	Ym_interface.sync(clockticks6502);
 	return Ym_interface.read_status();
 }
 
 bool YM_irq()
 {
-	return Ym_irq_enabled && Ym_interface.get_irq_status();
+	if (!Ym_irq_enabled) {
+		return false;
+	}
+	if (Ym_interface.needs_sync(clockticks6502)) {
+		Ym_interface.sync(clockticks6502);
+	}
+	return Ym_interface.get_irq_status();
 }
 
 void YM_reset()
@@ -436,6 +646,14 @@ void YM_reset()
 	memset(&Ym_registers[0x20], 0xc0, 8);
 }
 
+void YM_snapshot(machine_snapshot &snapshot)
+{
+	Ym_interface.snapshot(snapshot);
+	snapshot.io(Last_address);
+	snapshot.io(Last_data);
+	snapshot.io(Ym_registers);
+}
+
 void YM_debug_write(uint8_t addr, uint8_t value)
 {
 	Ym_registers[addr] = value;
@@ -29,8 +29,8 @@
 #	define YM_CLOCK_RATE (3579545)
 #	define YM_SAMPLE_RATE (YM_CLOCK_RATE >> 6)
 
-void     YM_prerender(uint32_t clocks);
-void     YM_render(int16_t *buffers, uint32_t samples, uint32_t sample_rate);
+void     YM_render(int16_t *buffers, uint32_t samples, double sample_rate, int16_t *const *voice_buffers = nullptr);
+void     YM_set_voice_capture(bool enable);
 void     YM_clear_backbuffer();
 uint32_t YM_get_sample_rate();
 
@@ -45,6 +45,9 @@ uint8_t YM_read_status();
 bool    YM_irq();
 void    YM_reset();
 
+class machine_snapshot;
+void YM_snapshot(machine_snapshot &snapshot);
+
 // debug stuff
 void    YM_debug_write(uint8_t addr, uint8_t value);
 uint8_t YM_debug_read(uint8_t addr);